@@ -0,0 +1,141 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_BENCH_BENCH_H__
+#define __ITK_BENCH_BENCH_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/* Results are printed as text, or as one JSON object per line if the
+ * environment variable BENCH_FORMAT is set to "json", the names of
+ * benchmarks and operations are printed as is, so they must not
+ * contain quotes or backslashes */
+
+
+/**
+ * Read the monotonic clock
+ * 
+ * @return  The time in seconds
+ */
+static inline double bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1000000000.;
+}
+
+
+/**
+ * Check whether results shall be printed as JSON
+ * 
+ * @return  Whether BENCH_FORMAT is "json"
+ */
+static inline int bench_json(void)
+{
+  const char* format = getenv("BENCH_FORMAT");
+  return format && !strcmp(format, "json");
+}
+
+
+/**
+ * Print the result of a measurement
+ * 
+ * @param  benchmark  The name of the benchmark
+ * @param  operation  The name of the measured operation
+ * @param  n          The problem size
+ * @param  ops        The number of times the operation was performed
+ * @param  seconds    The total time spent performing the operation
+ */
+static inline void bench_report(const char* benchmark, const char* operation, long n, long ops, double seconds)
+{
+  if (bench_json())
+    printf("{\"benchmark\": \"%s\", \"operation\": \"%s\", \"n\": %li, \"ops\": %li, \"ns_per_op\": %.2f}\n",
+	   benchmark, operation, n, ops, seconds * 1000000000. / ops);
+  else
+    printf("%-16s %-24s n=%-10li %12.2f ns/op\n", benchmark, operation, n, seconds * 1000000000. / ops);
+  fflush(stdout);
+}
+
+
+/**
+ * Print a measured quantity that is not a duration
+ * 
+ * @param  benchmark  The name of the benchmark
+ * @param  operation  The name of the measured quantity
+ * @param  n          The problem size
+ * @param  value      The measured value
+ * @param  unit       The unit of `value`
+ */
+static inline void bench_report_value(const char* benchmark, const char* operation, long n,
+				      double value, const char* unit)
+{
+  if (bench_json())
+    printf("{\"benchmark\": \"%s\", \"operation\": \"%s\", \"n\": %li, \"value\": %.2f, \"unit\": \"%s\"}\n",
+	   benchmark, operation, n, value, unit);
+  else
+    printf("%-16s %-24s n=%-10li %12.2f %s\n", benchmark, operation, n, value, unit);
+  fflush(stdout);
+}
+
+
+/**
+ * Compare two durations, for `qsort`
+ * 
+ * @param   a  The first duration
+ * @param   b  The second duration
+ * @return     Negative if `a` is shorter, positive if `a` is longer, otherwise zero
+ */
+static inline int bench_compare_durations(const void* a, const void* b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : x > y;
+}
+
+
+/**
+ * Print the distribution of the durations of individual operations
+ * 
+ * @param  benchmark  The name of the benchmark
+ * @param  operation  The name of the measured operation
+ * @param  n          The problem size
+ * @param  durations  The duration of each operation, in seconds, will be sorted
+ * @param  ops        The number of elements in `durations`
+ */
+static inline void bench_report_latency(const char* benchmark, const char* operation, long n,
+					double* durations, long ops)
+{
+#define __(P)  (*(durations + (long)((ops - 1) * P)) * 1000000000.)
+  qsort(durations, ops, sizeof(double), bench_compare_durations);
+  if (bench_json())
+    printf("{\"benchmark\": \"%s\", \"operation\": \"%s\", \"n\": %li, \"ops\": %li, "
+	   "\"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p99.9_ns\": %.0f, \"p99.99_ns\": %.0f, \"max_ns\": %.0f}\n",
+	   benchmark, operation, n, ops, __(0.5), __(0.99), __(0.999), __(0.9999), __(1.0));
+  else
+    printf("%-16s %-24s n=%-10li p50=%.0fns p99=%.0fns p99.9=%.0fns p99.99=%.0fns max=%.0fns\n",
+	   benchmark, operation, n, __(0.5), __(0.99), __(0.999), __(0.9999), __(1.0));
+  fflush(stdout);
+#undef __
+}
+
+
+#endif
+
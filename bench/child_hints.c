@@ -0,0 +1,196 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#include "../src/component.h"
+#include "../src/child_hints.h"
+#include "../src/line_layout.h"
+#include "../src/stack_layout.h"
+#include "../src/itkmacros.h"
+
+#include <stdlib.h>
+
+
+/**
+ * Create a container with children of varying sizes
+ * 
+ * @param   n  The number of children
+ * @return     The container
+ */
+static itk_component* fill(long n)
+{
+  itk_component* container = itk_new_component("container");
+  itk_component** children = malloc(n * sizeof(itk_component*));
+  long i;
+  
+  for (i = 0; i < n; i++)
+    {
+      itk_component* child = *(children + i) = itk_new_component("child");
+      child->visible = (i % 7) != 0;
+      child->minimum_size = new_size2(i % 13, i % 5);
+      child->preferred_size = new_size2(16 + i % 17, 16 + i % 11);
+      child->maximum_size = i % 3 ? new_size2(64 + i % 19, 64) : new_size2(UNBOUNDED, UNBOUNDED);
+    }
+  container->vtable->add_children(container, children, n);
+  container->size = new_size2(20 * n, 32);
+  free(children);
+  return container;
+}
+
+
+/**
+ * The line layout's minimum size calculation as it was before `itk_child_hints`,
+ * reading each child's hints where they are in the child, for comparison
+ * 
+ * @param   container  The container
+ * @param   gap        The gap between the children
+ * @return             The advisory minimum size of the container
+ */
+static size2_t baseline_minimum_size(itk_component* container, dimension_t gap)
+{
+  itk_component** children = container->children;
+  long i, n = container->children_count, n_ = 0;
+  size2_t rc, t;
+  rc.width = rc.height = 0;
+  rc.defined = true;
+  for (i = 0; i < n; i++)
+    if ((*(children + i))->visible)
+      {
+	t = (*(children + i))->minimum_size;
+	if (t.width > 0)
+	  rc.width += t.width;
+	if ((rc.height < t.height) && (t.height > 0))
+	  rc.height = t.height;
+      }
+    else
+      n_++;
+  if ((n -= n_))
+    rc.width += gap * (n - 1);
+  return rc;
+}
+
+
+/**
+ * Measure a layout manager's size calculations
+ * 
+ * @param  name       The name of the benchmark
+ * @param  container  The container using the layout manager
+ * @param  layout     The layout manager
+ */
+static void sizes(const char* name, itk_component* container, itk_layout_manager* layout)
+{
+  long i, n = container->children_count, reps = 10000000 / n;
+  dimension_t total = 0;
+  double start;
+  bool_t cached;
+  
+  for (cached = 0; cached < 2; cached++)
+    {
+      container->cache_child_hints = cached;
+      
+      start = bench_now();
+      for (i = 0; i < reps; i++)
+	total += layout->vtable->minimum_size(layout).width;
+      bench_report(name, cached ? "minimum_size (cached)" : "minimum_size", n, reps, bench_now() - start);
+      
+      start = bench_now();
+      for (i = 0; i < reps; i++)
+	total += layout->vtable->maximum_size(layout).height;
+      bench_report(name, cached ? "maximum_size (cached)" : "maximum_size", n, reps, bench_now() - start);
+      
+      start = bench_now();
+      for (i = 0; i < reps; i++)
+	total += layout->vtable->preferred_size(layout).width;
+      bench_report(name, cached ? "preferred_size (cached)" : "preferred_size", n, reps, bench_now() - start);
+      
+      if (cached)
+	{
+	  start = bench_now();
+	  for (i = 0; i < reps; i++)
+	    {
+	      itk_component_invalidate_child_hints(container);
+	      total += layout->vtable->minimum_size(layout).width;
+	    }
+	  bench_report(name, "invalidate+minimum_size", n, reps, bench_now() - start);
+	}
+    }
+  
+  if (total == 0)
+    fprintf(stderr, "nothing was measured\n");
+}
+
+
+/**
+ * Run all measurements at one number of children
+ * 
+ * @param  n  The number of children
+ */
+static void run(long n)
+{
+  itk_component* container = fill(n);
+  itk_layout_manager* layout;
+  long i, reps = 1000000 / n;
+  dimension_t total;
+  double start;
+  
+  layout = itk_new_stack_layout(container);
+  sizes("stack_layout", container, layout);
+  layout->vtable->free(layout);
+  
+  layout = container->layout_manager = itk_new_line_layout(container, ORIENTATION_LEFT_TO_RIGHT, 2);
+  sizes("line_layout", container, layout);
+  
+  start = bench_now();
+  for (i = 0, total = 0; i < 10000000 / n; i++)
+    total += baseline_minimum_size(container, 2).width;
+  bench_report("line_layout", "minimum_size (baseline)", n, 10000000 / n, bench_now() - start);
+  if (total == 0)
+    fprintf(stderr, "nothing was measured\n");
+  
+  reps = reps < 1 ? 1 : reps;
+  container->cache_child_hints = true;
+  start = bench_now();
+  for (i = 0; i < reps; i++)
+    {
+      layout->vtable->prepare(layout);
+      layout->vtable->done(layout);
+    }
+  bench_report("line_layout", "prepare (cached)", n, reps, bench_now() - start);
+  
+  container->vtable->free_everything(container);
+}
+
+
+/**
+ * Microbenchmarks for the layout managers' use of `itk_child_hints`
+ * 
+ * @param   argc  The number of command line arguments
+ * @param   argv  The command line arguments, unused
+ * @return        Zero on success
+ */
+int main(int argc, char** argv)
+{
+  (void) argc;
+  (void) argv;
+  
+  run(1000);
+  run(100000);
+  return 0;
+}
+
@@ -0,0 +1,273 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#include "../src/concurrent_hash_table.h"
+#include "../src/hash_table.h"
+#include "../src/itkmacros.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+
+/**
+ * The number of operations each thread performs
+ */
+#define OPERATIONS  2000000
+
+/**
+ * The number of locks the baseline table is striped over
+ */
+#define STRIPES  ITK_CONCURRENT_HASH_STRIPES
+
+
+/**
+ * The baseline, plain hash tables each guarded by a mutex,
+ * a key is stored in the table selected by its hash
+ */
+typedef struct _striped_table
+{
+  /**
+   * The tables
+   */
+  itk_hash_table* tables[STRIPES];
+  
+  /**
+   * The locks of the tables
+   */
+  pthread_mutex_t locks[STRIPES];
+  
+} striped_table;
+
+
+/**
+ * The work of one thread
+ */
+typedef struct _worker
+{
+  /**
+   * The table to use if measuring `itk_concurrent_hash_table`
+   */
+  itk_concurrent_hash_table* concurrent;
+  
+  /**
+   * The table to use if measuring the baseline
+   */
+  striped_table* striped;
+  
+  /**
+   * The number of entries in the table
+   */
+  long n;
+  
+  /**
+   * One in how many operations is a write, zero for none
+   */
+  long write_interval;
+  
+  /**
+   * The state of the thread's random number generator
+   */
+  unsigned long seed;
+  
+  /**
+   * The number of keys that were found
+   */
+  long found;
+  
+} worker;
+
+
+/**
+ * Key hasher that spreads sequential keys
+ * 
+ * @param   key  The key
+ * @return       The hash of the key
+ */
+static long mix(void* key)
+{
+  unsigned long h = (unsigned long)key;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDUL;
+  h ^= h >> 33;
+  return (long)h;
+}
+
+
+/**
+ * Get a random key
+ * 
+ * @param   w  The thread's work
+ * @return     A key from 1 to `w->n`
+ */
+static inline long random_key(worker* w)
+{
+  w->seed ^= w->seed << 13;
+  w->seed ^= w->seed >> 7;
+  w->seed ^= w->seed << 17;
+  return (long)(w->seed % (unsigned long)(w->n)) + 1;
+}
+
+
+/**
+ * Look up and overwrite random keys in `itk_concurrent_hash_table`
+ * 
+ * @param   data  The thread's work
+ * @return        `NULL`
+ */
+static void* run_concurrent(void* data)
+{
+  worker* w = data;
+  long i, key;
+  
+  for (i = 1; i <= OPERATIONS; i++)
+    {
+      key = random_key(w);
+      if (w->write_interval && (i % w->write_interval == 0))
+	itk_concurrent_hash_table_put(w->concurrent, (void*)key, (void*)(key + i));
+      else
+	w->found += itk_concurrent_hash_table_get(w->concurrent, (void*)key) != NULL;
+    }
+  
+  return NULL;
+}
+
+
+/**
+ * Look up and overwrite random keys in the baseline
+ * 
+ * @param   data  The thread's work
+ * @return        `NULL`
+ */
+static void* run_striped(void* data)
+{
+  worker* w = data;
+  long i, key, stripe;
+  
+  for (i = 1; i <= OPERATIONS; i++)
+    {
+      key = random_key(w);
+      stripe = (long)((unsigned long)mix((void*)key) >> 40) & (STRIPES - 1);
+      pthread_mutex_lock(w->striped->locks + stripe);
+      if (w->write_interval && (i % w->write_interval == 0))
+	itk_hash_table_put(w->striped->tables[stripe], (void*)key, (void*)(key + i));
+      else
+	w->found += itk_hash_table_get(w->striped->tables[stripe], (void*)key) != NULL;
+      pthread_mutex_unlock(w->striped->locks + stripe);
+    }
+  
+  return NULL;
+}
+
+
+/**
+ * Run threads against one of the tables and report the time per operation
+ * 
+ * @param  name      The name of the benchmark
+ * @param  routine   `run_concurrent` or `run_striped`
+ * @param  template  The work, copied to each thread
+ * @param  threads   The number of threads
+ */
+static void measure(const char* name, void* (*routine)(void*), worker template, long threads)
+{
+  pthread_t* ids = malloc(threads * sizeof(pthread_t));
+  worker* workers = malloc(threads * sizeof(worker));
+  char operation[64];
+  long i, found = 0;
+  double start;
+  
+  for (i = 0; i < threads; i++)
+    {
+      *(workers + i) = template;
+      (workers + i)->seed = 0x9E3779B97F4A7C15UL * (unsigned long)(i + 1);
+    }
+  
+  start = bench_now();
+  for (i = 0; i < threads; i++)
+    pthread_create(ids + i, NULL, routine, workers + i);
+  for (i = 0; i < threads; i++)
+    {
+      pthread_join(*(ids + i), NULL);
+      found += (workers + i)->found;
+    }
+  
+  snprintf(operation, sizeof(operation), "%s %li threads",
+	   template.write_interval ? "get+put" : "get", threads);
+  bench_report(name, operation, template.n, threads * OPERATIONS, bench_now() - start);
+  if (found == 0)
+    fprintf(stderr, "nothing was found\n");
+  
+  free(workers);
+  free(ids);
+}
+
+
+/**
+ * Compare `itk_concurrent_hash_table` with a mutex-striped hash table,
+ * with any number of threads looking up keys, and with every tenth
+ * operation overwriting a value
+ * 
+ * @param   argc  The number of command line arguments
+ * @param   argv  The command line arguments, the number of entries and
+ *                the largest number of threads, 100000 and 8 by default
+ * @return        Zero on success
+ */
+int main(int argc, char** argv)
+{
+  long n = argc > 1 ? atol(argv[1]) : 100000;
+  long max_threads = argc > 2 ? atol(argv[2]) : 8;
+  itk_concurrent_hash_table* concurrent = itk_new_concurrent_hash_table_tuned(n);
+  striped_table striped;
+  worker template;
+  long i, threads;
+  
+  concurrent->hasher = mix;
+  for (i = 0; i < STRIPES; i++)
+    {
+      striped.tables[i] = itk_new_hash_table();
+      striped.tables[i]->hasher = mix;
+      pthread_mutex_init(striped.locks + i, NULL);
+    }
+  for (i = 1; i <= n; i++)
+    {
+      itk_concurrent_hash_table_put(concurrent, (void*)i, (void*)(i + n));
+      itk_hash_table_put(striped.tables[(unsigned long)mix((void*)i) >> 40 & (STRIPES - 1)],
+			 (void*)i, (void*)(i + n));
+    }
+  
+  template.concurrent = concurrent;
+  template.striped = &striped;
+  template.n = n;
+  template.found = 0;
+  
+  for (template.write_interval = 0; template.write_interval <= 10; template.write_interval += 10)
+    for (threads = 1; threads <= max_threads; threads <<= 1)
+      {
+	measure("concurrent_hash_table", run_concurrent, template, threads);
+	measure("striped_hash_table", run_striped, template, threads);
+      }
+  
+  for (i = 0; i < STRIPES; i++)
+    {
+      itk_free_hash_table(striped.tables[i], false, false);
+      pthread_mutex_destroy(striped.locks + i);
+    }
+  itk_free_concurrent_hash_table(concurrent, false, false);
+  return 0;
+}
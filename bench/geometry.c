@@ -0,0 +1,115 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#include "../src/geometry.h"
+#include "../src/itkmacros.h"
+
+#include <stdlib.h>
+
+
+/**
+ * Create rectangles scattered around and across a clip rectangle
+ * 
+ * @param   n  The number of rectangles
+ * @return     The rectangles
+ */
+static packed_rectangle_t* fill(long n)
+{
+  packed_rectangle_t* rects = malloc(n * sizeof(packed_rectangle_t));
+  long i;
+  
+  srand(n);
+  for (i = 0; i < n; i++)
+    *(rects + i) = i % 31 ? new_packed_rectangle(rand() % 4096 - 1024, rand() % 4096 - 1024,
+						  rand() % 512, rand() % 512)
+			  : undefined_packed_rectangle();
+  return rects;
+}
+
+
+/**
+ * Run all measurements at one number of rectangles
+ * 
+ * @param  n  The number of rectangles
+ */
+static void run(long n)
+{
+  packed_rectangle_t* rects = fill(n);
+  packed_rectangle_t* out = malloc(n * sizeof(packed_rectangle_t));
+  bool_t* visible = malloc(n * sizeof(bool_t));
+  packed_rectangle_t clip = new_packed_rectangle(0, 0, 1920, 1080);
+  long i, j, reps = 100000000 / n, total = 0;
+  double start;
+  
+  start = bench_now();
+  for (i = 0; i < reps; i++)
+    for (j = 0; j < n; j++)
+      *(out + j) = itk_rectangle_intersection(*(rects + j), clip);
+  bench_report("geometry", "intersection (scalar)", n, reps * n, bench_now() - start);
+  total += (out + n / 2)->width;
+  
+  start = bench_now();
+  for (i = 0; i < reps; i++)
+    itk_rectangles_intersect(out, rects, n, clip);
+  bench_report("geometry", "intersect (batch)", n, reps * n, bench_now() - start);
+  total += (out + n / 2)->width;
+  
+  start = bench_now();
+  for (i = 0; i < reps; i++)
+    for (j = 0; j < n; j++)
+      total += *(visible + j) = !itk_rectangle_is_empty(itk_rectangle_intersection(*(rects + j), clip));
+  bench_report("geometry", "cull (scalar)", n, reps * n, bench_now() - start);
+  
+  start = bench_now();
+  for (i = 0; i < reps; i++)
+    total += itk_rectangles_cull(visible, rects, n, clip);
+  bench_report("geometry", "cull (batch)", n, reps * n, bench_now() - start);
+  
+  start = bench_now();
+  for (i = 0; i < reps; i++)
+    total += itk_rectangles_union(rects, n).width;
+  bench_report("geometry", "union (batch)", n, reps * n, bench_now() - start);
+  
+  if (total == 0)
+    fprintf(stderr, "nothing was measured\n");
+  
+  free(rects);
+  free(out);
+  free(visible);
+}
+
+
+/**
+ * Microbenchmarks for the rectangle kernels
+ * 
+ * @param   argc  The number of command line arguments
+ * @param   argv  The command line arguments, unused
+ * @return        Zero on success
+ */
+int main(int argc, char** argv)
+{
+  (void) argc;
+  (void) argv;
+  
+  run(1000);
+  run(100000);
+  return 0;
+}
+
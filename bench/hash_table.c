@@ -0,0 +1,212 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#include "../src/hash_table.h"
+#include "../src/itkmacros.h"
+
+#include <stdlib.h>
+
+
+/**
+ * Key hasher that spreads sequential keys
+ * 
+ * @param   key  The key
+ * @return       The hash of the key
+ */
+static long mix(void* key)
+{
+  unsigned long h = (unsigned long)key;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDUL;
+  h ^= h >> 33;
+  return (long)h;
+}
+
+
+/**
+ * Create a table with the keys 1 to `n`, the value
+ * associated with a key is the key plus `n`
+ * 
+ * @param   n  The number of entries
+ * @return     The table
+ */
+static itk_hash_table* fill(long n)
+{
+  itk_hash_table* table = itk_new_hash_table();
+  long i;
+  table->hasher = mix;
+  for (i = 1; i <= n; i++)
+    itk_hash_table_put(table, (void*)i, (void*)(i + n));
+  return table;
+}
+
+
+/**
+ * Run all operations at one table size
+ * 
+ * @param  n  The number of entries
+ */
+static void run(long n)
+{
+  itk_hash_table* table;
+  itk_hash_cursor cursor;
+  void** keys;
+  void** values;
+  long i, queries, found = 0;
+  double start;
+  
+  start = bench_now();
+  table = fill(n);
+  bench_report("hash_table", "put", n, n, bench_now() - start);
+  itk_free_hash_table(table, false, false);
+  
+  table = itk_new_hash_table();
+  table->hasher = mix;
+  start = bench_now();
+  itk_hash_table_reserve(table, n);
+  for (i = 1; i <= n; i++)
+    itk_hash_table_put(table, (void*)i, (void*)(i + n));
+  bench_report("hash_table", "reserve+put", n, n, bench_now() - start);
+  itk_free_hash_table(table, false, false);
+  
+  keys = malloc(n * sizeof(void*));
+  values = malloc(n * sizeof(void*));
+  for (i = 0; i < n; i++)
+    {
+      *(keys + i) = (void*)(i + 1);
+      *(values + i) = (void*)(i + 1 + n);
+    }
+  table = itk_new_hash_table();
+  table->hasher = mix;
+  start = bench_now();
+  itk_hash_table_put_all(table, keys, values, n);
+  bench_report("hash_table", "put_all", n, n, bench_now() - start);
+  free(keys);
+  free(values);
+  
+  start = bench_now();
+  for (i = 1; i <= n; i++)
+    found += itk_hash_table_get(table, (void*)i) != NULL;
+  bench_report("hash_table", "get", n, n, bench_now() - start);
+  
+  start = bench_now();
+  for (i = 1; i <= n; i++)
+    found += itk_hash_table_get(table, (void*)(i + n)) != NULL;
+  bench_report("hash_table", "get (miss)", n, n, bench_now() - start);
+  
+  start = bench_now();
+  itk_hash_table_cursor(table, &cursor);
+  while (itk_hash_cursor_next(&cursor))
+    found++;
+  bench_report("hash_table", "iterate", n, n, bench_now() - start);
+  
+  queries = 10000000 / n;
+  queries = queries < 1 ? 1 : queries > 1000 ? 1000 : queries;
+  start = bench_now();
+  for (i = 0; i < queries; i++)
+    found += itk_hash_table_contains_value(table, (void*)(n + 1 + (i * 7919) % n));
+  bench_report("hash_table", "contains_value", n, queries, bench_now() - start);
+  
+  start = bench_now();
+  itk_hash_table_index_values(table, mix);
+  bench_report("hash_table", "index_values", n, n, bench_now() - start);
+  
+  start = bench_now();
+  for (i = 1; i <= n; i++)
+    found += itk_hash_table_contains_value(table, (void*)(i + n));
+  bench_report("hash_table", "contains_value (indexed)", n, n, bench_now() - start);
+  
+  start = bench_now();
+  for (i = 1; i <= n; i++)
+    found += itk_hash_table_remove(table, (void*)i) != NULL;
+  bench_report("hash_table", "remove (indexed)", n, n, bench_now() - start);
+  itk_free_hash_table(table, false, false);
+  
+  table = fill(n);
+  start = bench_now();
+  for (i = 1; i <= n; i++)
+    found += itk_hash_table_remove(table, (void*)i) != NULL;
+  bench_report("hash_table", "remove", n, n, bench_now() - start);
+  
+  for (i = 1; i <= n; i++)
+    itk_hash_table_put(table, (void*)i, (void*)(i + n));
+  start = bench_now();
+  itk_hash_table_clear(table);
+  bench_report("hash_table", "clear", n, n, bench_now() - start);
+  itk_free_hash_table(table, false, false);
+  
+  if (found == 0)
+    fprintf(stderr, "nothing was found\n");
+}
+
+
+/**
+ * Measure the latency of each insertion into a growing table
+ * 
+ * @param  n            The number of entries to insert
+ * @param  incremental  Whether the table should grow incrementally
+ */
+static void latency(long n, bool_t incremental)
+{
+  itk_hash_table* table = itk_new_hash_table();
+  double* durations = malloc(n * sizeof(double));
+  double start;
+  long i;
+  
+  table->hasher = mix;
+  table->incremental = incremental;
+  for (i = 1; i <= n; i++)
+    {
+      start = bench_now();
+      itk_hash_table_put(table, (void*)i, (void*)i);
+      *(durations + i - 1) = bench_now() - start;
+    }
+  
+  bench_report_latency("hash_table", incremental ? "put latency (incremental)" : "put latency",
+		       n, durations, n);
+  itk_free_hash_table(table, false, false);
+  free(durations);
+}
+
+
+/**
+ * Microbenchmarks for `itk_hash_table`
+ * 
+ * @param   argc  The number of command line arguments
+ * @param   argv  The command line arguments, the optional first argument
+ *                is the largest table size to measure, 10000000 by default
+ * @return        Zero on success
+ */
+int main(int argc, char** argv)
+{
+  long n, max = argc > 1 ? atol(argv[1]) : 10000000;
+  
+  for (n = 1000; n <= max; n *= 10)
+    run(n);
+  
+  for (n = 1000; n <= max; n *= 10)
+    {
+      latency(n, false);
+      latency(n, true);
+    }
+  
+  return 0;
+}
+
@@ -0,0 +1,146 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#include "../src/component.h"
+#include "../src/dock_layout.h"
+#include "../src/flow_layout.h"
+#include "../src/line_layout.h"
+#include "../src/margin_layout.h"
+#include "../src/stack_layout.h"
+#include "../src/itkmacros.h"
+
+#include <stdlib.h>
+
+
+/**
+ * The edges children of dock layouts are docked to, in turn
+ */
+static char* edges[] = {"left", "top", "right", "bottom"};
+
+
+/**
+ * Create a container with children of varying sizes
+ * 
+ * @param   n     The number of children
+ * @param   dock  Whether the children shall have dock layout constraints
+ * @return        The container
+ */
+static itk_component* fill(long n, bool_t dock)
+{
+  itk_component* container = itk_new_component("container");
+  itk_component** children = malloc(n * sizeof(itk_component*));
+  long i;
+  
+  for (i = 0; i < n; i++)
+    {
+      itk_component* child = *(children + i) = itk_new_component("child");
+      child->minimum_size = new_size2(1 + i % 13, 1 + i % 5);
+      child->preferred_size = new_size2(16 + i % 17, 16 + i % 11);
+      child->maximum_size = i % 3 ? new_size2(64 + i % 19, 64) : new_size2(UNBOUNDED, UNBOUNDED);
+      child->constraints = dock ? *(edges + i % 4) : NULL;
+    }
+  container->vtable->add_children(container, children, n);
+  container->size = new_size2(1920, 1080);
+  free(children);
+  return container;
+}
+
+
+/**
+ * Measure a layout manager
+ * 
+ * @param  name       The name of the layout manager
+ * @param  container  The container, with the layout manager set
+ * @param  sizes      Whether the size calculations shall be measured
+ */
+static void measure(const char* name, itk_component* container, bool_t sizes)
+{
+  itk_layout_manager* layout = container->layout_manager;
+  long i, j, n = container->children_count, reps = 1000000 / n;
+  long total = 0;
+  double start;
+  
+  reps = reps < 1 ? 1 : reps;
+  
+  start = bench_now();
+  for (i = 0; i < reps; i++)
+    {
+      layout->vtable->prepare(layout);
+      for (j = 0; j < n; j++)
+	total += layout->vtable->locate(layout, *(container->children + j)).width;
+      layout->vtable->done(layout);
+    }
+  bench_report(name, "layout per child", n, reps * n, bench_now() - start);
+  
+  if (sizes)
+    {
+      start = bench_now();
+      for (i = 0; i < reps; i++)
+	total += layout->vtable->preferred_size(layout).width;
+      bench_report(name, "preferred_size", n, reps, bench_now() - start);
+    }
+  
+  if (total == 0)
+    fprintf(stderr, "nothing was measured\n");
+}
+
+
+/**
+ * Run all measurements at one number of children
+ * 
+ * @param  n  The number of children
+ */
+static void run(long n)
+{
+  itk_component* container;
+  
+#define __(NAME, DOCK, SIZES, CONSTRUCTOR)			\
+  container = fill(n, DOCK);					\
+  container->layout_manager = CONSTRUCTOR;			\
+  measure(NAME, container, SIZES);				\
+  container->vtable->free_everything(container)
+  
+  __("dock_layout",   true,  true,  itk_new_dock_layout(container));
+  __("flow_layout",   false, true,  itk_new_flow_layout(container, ALIGNMENT_LEFT, 2, 2));
+  __("line_layout",   false, true,  itk_new_line_layout(container, ORIENTATION_LEFT_TO_RIGHT, 2));
+  __("margin_layout", false, true,  itk_new_margin_layout(container, 2, 2, 2, 2));
+  __("stack_layout",  false, true,  itk_new_stack_layout(container));
+  
+#undef __
+}
+
+
+/**
+ * Benchmarks for the layout managers, at 10 to 100000 children
+ * 
+ * @param   argc  The number of command line arguments
+ * @param   argv  The command line arguments, the first one is
+ *                the maximum number of children, optional
+ * @return        Zero on success
+ */
+int main(int argc, char** argv)
+{
+  long n, max = argc > 1 ? atol(argv[1]) : 100000;
+  
+  for (n = 10; n <= max; n *= 10)
+    run(n);
+  return 0;
+}
+
@@ -0,0 +1,353 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#include "../src/component.h"
+#include "../src/fb_graphics.h"
+#include "../src/flow_layout.h"
+#include "../src/line_layout.h"
+#include "../src/margin_layout.h"
+#include "../src/render_thread.h"
+#include "../src/snapshot.h"
+#include "../src/stack_layout.h"
+#include "../src/trace.h"
+#include "../src/itkmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/**
+ * The number of components that have been created
+ */
+static long created = 0;
+
+/**
+ * The names of the layout managers to use, one per level, cycling
+ */
+static char** layouts;
+
+/**
+ * The number of elements in `layouts`
+ */
+static long layout_count = 0;
+
+/**
+ * The number of pixels that have been presented
+ */
+static long presented_pixels = 0;
+
+
+/**
+ * Create a layout manager for a container
+ * 
+ * @param   name       The name of the layout manager
+ * @param   container  The container
+ * @return             The layout manager, `NULL` if the name is not recognised
+ */
+static itk_layout_manager* new_layout(const char* name, itk_component* container)
+{
+  if (!strcmp(name, "stack"))   return itk_new_stack_layout(container);
+  if (!strcmp(name, "line"))    return itk_new_line_layout(container, ORIENTATION_LEFT_TO_RIGHT, 1);
+  if (!strcmp(name, "column"))  return itk_new_line_layout(container, ORIENTATION_TOP_DOWN, 1);
+  if (!strcmp(name, "flow"))    return itk_new_flow_layout(container, ALIGNMENT_LEFT, 1, 1);
+  if (!strcmp(name, "margin"))  return itk_new_margin_layout(container, 2, 2, 2, 2);
+  return NULL;
+}
+
+
+/**
+ * Check whether a layout manager name is recognised by `new_layout`
+ * 
+ * @param   name  The name of the layout manager
+ * @return        Whether the name is recognised
+ */
+static bool_t known_layout(const char* name)
+{
+  return !strcmp(name, "stack") || !strcmp(name, "line") || !strcmp(name, "column") ||
+    !strcmp(name, "flow") || !strcmp(name, "margin");
+}
+
+
+/**
+ * Create a synthetic component tree
+ * 
+ * @param   level     The level of the created component, 0 for the root
+ * @param   depth     The number of levels below the component
+ * @param   children  The number of children each container has
+ * @param   size      The preferred size of the component
+ * @return            The component
+ */
+static itk_component* build(long level, long depth, long children, size2_t size)
+{
+  itk_component* rc = itk_new_component("synthetic");
+  itk_component** kids;
+  size2_t child_size;
+  long i;
+  
+  rc->background_colour.defined = true;
+  rc->background_colour.argb_colour.value = 0xFF000000 | ((uint32_t)(++created * 2654435761UL) & 0xFFFFFF);
+  rc->minimum_size = new_size2(1, 1);
+  rc->preferred_size = rc->size = size;
+  rc->maximum_size = new_size2(UNBOUNDED, UNBOUNDED);
+  
+  if (depth == 0)
+    return rc;
+  
+  rc->layout_manager = new_layout(*(layouts + level % layout_count), rc);
+  
+  child_size.width = size.width / children > 1 ? size.width / children - 1 : 1;
+  child_size.height = size.height / children > 1 ? size.height / children - 1 : 1;
+  
+  kids = malloc(children * sizeof(itk_component*));
+  for (i = 0; i < children; i++)
+    *(kids + i) = build(level + 1, depth - 1, children, child_size);
+  rc->vtable->add_children(rc, kids, children);
+  free(kids);
+  
+  return rc;
+}
+
+
+/**
+ * Perform the layout pass alone, as painting does it
+ * 
+ * @param  this  The component
+ */
+static void layout(itk_component* this)
+{
+  long i, n = itk_component_compact_children(this)->children_count;
+  
+  if (this->layout_manager)
+    this->layout_manager->vtable->prepare(this->layout_manager);
+  for (i = 0; i < n; i++)
+    {
+      this->vtable->locate_child(this, *(this->children + i));
+      layout(*(this->children + i));
+    }
+  if (this->layout_manager)
+    this->layout_manager->vtable->done(this->layout_manager);
+}
+
+
+/**
+ * Present a frame drawn by the render thread
+ * 
+ * @param  render_thread  The render thread
+ * @param  user_data      The framebuffer
+ */
+static void present(itk_render_thread* render_thread, void* user_data)
+{
+  (void) render_thread;
+  
+  presented_pixels += itk_framebuffer_present(user_data);
+}
+
+
+/**
+ * Print usage information and exit
+ * 
+ * @param  argv0  The name of the program
+ */
+static void usage(const char* argv0)
+{
+  fprintf(stderr,
+	  "Usage: %s [-n children] [-d depth] [-l layout,...] [-k frames] [-W width] [-H height] [-o file] [-t file] [-r]\n"
+	  "\n"
+	  "Renders a synthetic component tree into a memory framebuffer and reports\n"
+	  "frames per second and the time per frame of each phase, n is the number\n"
+	  "of components.  Set BENCH_FORMAT=json for JSON output.  Layouts are\n"
+	  "stack, line, column, flow and margin, one is used per level, cycling.\n"
+	  "The last frame is written to the file if -o is used, as PNG if the\n"
+	  "name ends with .png, otherwise as PPM.  The frames are traced, and the\n"
+	  "trace written to the file in Chrome's trace event format, if -t is used.\n"
+	  "With -r, frames are recorded as display lists and drawn and presented by\n"
+	  "a render thread, and the time the painting thread spends per frame, and\n"
+	  "waiting for the render thread, is reported instead.\n",
+	  argv0);
+  exit(2);
+}
+
+
+/**
+ * Render synthetic component trees without a display
+ * 
+ * @param   argc  The number of command line arguments
+ * @param   argv  The command line arguments
+ * @return        Zero on success
+ */
+int main(int argc, char** argv)
+{
+  long children = 8, depth = 3, frames = 100, i, n, pixels = 0;
+  dimension_t width = 1280, height = 720;
+  static char default_layouts[] = "line,column";
+  char* layout_list = default_layouts;
+  char* output = NULL;
+  char* trace = NULL;
+  char* p;
+  double t_layout = 0, t_paint = 0, t_present = 0, t_wait = 0, start, now, begin;
+  bool_t threaded = false;
+  itk_render_thread* render_thread = NULL;
+  itk_display_list* list;
+  itk_graphics* recorder;
+  itk_framebuffer* framebuffer;
+  itk_graphics* g;
+  itk_component* root;
+  uint32_t* memory;
+  char name[256];
+  int opt;
+  
+  while ((opt = getopt(argc, argv, "n:d:l:k:W:H:o:t:r")) != -1)
+    switch (opt)
+      {
+      case 'n':  children = atol(optarg);  break;
+      case 'd':  depth = atol(optarg);     break;
+      case 'l':  layout_list = optarg;     break;
+      case 'k':  frames = atol(optarg);    break;
+      case 'W':  width = atoi(optarg);     break;
+      case 'H':  height = atoi(optarg);    break;
+      case 'o':  output = optarg;          break;
+      case 't':  trace = optarg;           break;
+      case 'r':  threaded = true;          break;
+      default:
+	usage(*argv);
+      }
+  if ((optind != argc) || (children < 1) || (depth < 0) || (frames < 1) || (width < 1) || (height < 1))
+    usage(*argv);
+  
+  /* Name the benchmark after the tree, so different trees can be told apart */
+  snprintf(name, sizeof(name), "render%s/%s/%lix%li", threaded ? "-threaded" : "", layout_list, children, depth);
+  
+  layouts = malloc((strlen(layout_list) / 2 + 1) * sizeof(char*));
+  for (p = strtok(layout_list, ","); p; p = strtok(NULL, ","))
+    {
+      if (known_layout(p) == false)
+	{
+	  fprintf(stderr, "%s: unknown layout: %s\n", *argv, p);
+	  return 2;
+	}
+      *(layouts + layout_count++) = p;
+    }
+  if (layout_count == 0)
+    usage(*argv);
+  
+  memory = calloc((long)width * height, sizeof(uint32_t));
+  framebuffer = itk_new_memory_framebuffer(memory, width, height, width * sizeof(uint32_t));
+  g = itk_new_fb_graphics(framebuffer);
+  root = build(0, depth, children, new_size2(width, height));
+  
+  if (trace)
+    itk_trace_start(0);
+  
+  if (threaded)
+    {
+      render_thread = itk_new_render_thread(g, present, framebuffer, NULL);
+      if (render_thread == NULL)
+	{
+	  perror(*argv);
+	  return 1;
+	}
+    }
+  
+  begin = bench_now();
+  for (i = 0; i < frames; i++)
+    {
+      /* Change the root's colour so every frame differs from the previous */
+      root->background_colour.argb_colour.c.red = (uint8_t)i;
+      
+      start = bench_now();
+      layout(root);
+      now = bench_now(), t_layout += now - start, start = now;
+      
+      if (threaded)
+	{
+	  /* Stay at most one frame ahead of the render thread */
+	  if (itk_render_thread_ready(render_thread) == false)
+	    itk_render_thread_wait(render_thread);
+	  now = bench_now(), t_wait += now - start, start = now;
+	  list = itk_render_thread_begin(render_thread);
+	  recorder = itk_new_recording_graphics(list);
+	  root->vtable->paint(root, recorder);
+	  recorder->free(recorder);
+	  itk_render_thread_submit(render_thread, list);
+	  now = bench_now(), t_paint += now - start;
+	  continue;
+	}
+      
+      root->vtable->paint(root, g);
+      now = bench_now(), t_paint += now - start, start = now;
+      pixels += itk_framebuffer_present(framebuffer);
+      now = bench_now(), t_present += now - start;
+    }
+  
+  if (threaded)
+    {
+      itk_render_thread_wait(render_thread);
+      t_present = bench_now() - begin;
+      pixels = presented_pixels;
+      itk_free_render_thread(render_thread);
+    }
+  
+  if (trace)
+    {
+      itk_trace_stop();
+      if (itk_trace_export(trace))
+	{
+	  perror(*argv);
+	  return 1;
+	}
+    }
+  
+  if (threaded)
+    {
+      bench_report_value(name, "frames", created, frames / t_present, "frames/s");
+      bench_report(name, "layout", created, frames, t_layout);
+      bench_report(name, "record (with layout)", created, frames, t_paint);
+      bench_report(name, "wait for render thread", created, frames, t_wait);
+    }
+  else
+    {
+      bench_report_value(name, "frames", created, frames / (t_layout + t_paint + t_present), "frames/s");
+      bench_report(name, "layout", created, frames, t_layout);
+      bench_report(name, "paint (with layout)", created, frames, t_paint);
+      bench_report(name, "present", created, frames, t_present);
+    }
+  bench_report_value(name, "presented", created, (double)pixels / frames, "pixels/frame");
+  
+  if (output)
+    {
+      start = bench_now();
+      n = strlen(output);
+      if (((n >= 4) && !strcmp(output + n - 4, ".png")) ? itk_write_png(framebuffer, output) : itk_write_ppm(framebuffer, output))
+	{
+	  perror(*argv);
+	  return 1;
+	}
+      bench_report(name, "write snapshot", created, 1, bench_now() - start);
+    }
+  
+  root->vtable->free_everything(root);
+  g->free(g);
+  itk_free_framebuffer(framebuffer);
+  free(memory);
+  free(layouts);
+  return 0;
+}
+
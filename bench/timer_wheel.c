@@ -0,0 +1,107 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#include "../src/timer_wheel.h"
+
+#include <stdlib.h>
+
+
+/**
+ * The number of timers that have fired
+ */
+static long fired = 0;
+
+
+/**
+ * Timer callback that counts expirations
+ * 
+ * @param  wheel  The timer wheel
+ * @param  timer  The timer
+ */
+static void count(itk_timer_wheel* wheel, itk_timer* timer)
+{
+  (void) wheel;
+  (void) timer;
+  fired++;
+}
+
+
+/**
+ * Run all measurements at one number of timers
+ * 
+ * @param  n  The number of timers
+ */
+static void run(long n)
+{
+  itk_timer_wheel* wheel = itk_new_timer_wheel(NULL, 1000000);
+  itk_timer* timers = malloc(n * sizeof(itk_timer));
+  long* delays = malloc(n * sizeof(long));
+  uint64_t t;
+  double start;
+  long i;
+  
+  /* Delays up to ten minutes, at 1 ms ticks, so every level is used */
+  srand(n);
+  for (i = 0; i < n; i++)
+    {
+      itk_init_timer(timers + i, count, NULL);
+      *(delays + i) = (long)(rand() % 600000) * 1000000L;
+    }
+  
+  start = bench_now();
+  for (i = 0; i < n; i++)
+    itk_timer_wheel_start(wheel, timers + i, *(delays + i), 0);
+  bench_report("timer_wheel", "start", n, n, bench_now() - start);
+  
+  start = bench_now();
+  for (i = 0; i < n; i += 2)
+    itk_timer_wheel_cancel(wheel, timers + i);
+  bench_report("timer_wheel", "cancel", n, (n + 1) / 2, bench_now() - start);
+  
+  /* Advance at 60 Hz through the ten minutes */
+  fired = 0;
+  start = bench_now();
+  for (t = wheel->origin; wheel->count; t += 16666667)
+    itk_timer_wheel_advance(wheel, t);
+  bench_report("timer_wheel", "expire", n, fired, bench_now() - start);
+  
+  itk_free_timer_wheel(wheel);
+  free(timers);
+  free(delays);
+}
+
+
+/**
+ * Microbenchmarks for the timer wheel
+ * 
+ * @param   argc  The number of command line arguments
+ * @param   argv  The command line arguments, unused
+ * @return        Zero on success
+ */
+int main(int argc, char** argv)
+{
+  (void) argc;
+  (void) argv;
+  
+  run(1000);
+  run(100000);
+  return 0;
+}
+
@@ -0,0 +1,108 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bench.h"
+
+#include "../src/x_graphics.h"
+#include "../src/itkmacros.h"
+
+#include <stdlib.h>
+
+
+/**
+ * The width and height of the pixmap that is drawn on
+ */
+#define SIZE  1024
+
+
+/**
+ * Measure a drawing primitive, including the round trip
+ * that waits for the X server to finish drawing
+ * 
+ * @param  OPERATION  The name of the primitive
+ * @param  REPS       The number of times to draw
+ * @param  DRAW       Statement that draws once, with `i` being the iteration
+ */
+#define MEASURE(OPERATION, REPS, DRAW)			\
+  do							\
+    {							\
+      start = bench_now();				\
+      for (i = 0; i < REPS; i++)			\
+	DRAW;						\
+      XSync(display, False);				\
+      bench_report("x_graphics", OPERATION, SIZE, REPS, bench_now() - start); \
+    }							\
+  while (0)
+
+
+/**
+ * Throughput of the X graphics primitives, drawing on an off-screen pixmap
+ * 
+ * Requires an X server, for example run with `xvfb-run`, without
+ * one the benchmark is skipped, and reported as such on stderr
+ * 
+ * @param   argc  The number of command line arguments
+ * @param   argv  The command line arguments, unused
+ * @return        Zero on success
+ */
+int main(int argc, char** argv)
+{
+  Display* display = XOpenDisplay(NULL);
+  position2_t* points = malloc(64 * sizeof(position2_t));
+  itk_graphics* g;
+  Pixmap pixmap;
+  double start;
+  int screen;
+  long i;
+  
+  (void) argc;
+  
+  if (display == NULL)
+    {
+      fprintf(stderr, "%s: cannot open display, skipped\n", *argv);
+      free(points);
+      return 0;
+    }
+  
+  screen = DefaultScreen(display);
+  pixmap = XCreatePixmap(display, RootWindow(display, screen), SIZE, SIZE, DefaultDepth(display, screen));
+  g = itk_new_x_graphics(display, screen, pixmap);
+  
+  for (i = 0; i < 64; i++)
+    {
+      (points + i)->x = (position_t)(SIZE / 2 + (i % 2 ? 100 : 400) * ((i * 37) % 64 - 32) / 32);
+      (points + i)->y = (position_t)(SIZE / 2 + (i % 2 ? 100 : 400) * ((i * 11) % 64 - 32) / 32);
+    }
+  
+  MEASURE("fill_rectangle 16x16",   100000, g->fill_rectangle(g, new_rectangle(i % 1000, i % 997, 16, 16)));
+  MEASURE("fill_rectangle 512x512", 10000,  g->fill_rectangle(g, new_rectangle(i % 500, i % 499, 512, 512)));
+  MEASURE("draw_rectangle 64x64",   100000, g->draw_rectangle(g, new_rectangle(i % 900, i % 899, 64, 64)));
+  MEASURE("draw_line",              100000, g->draw_line(g, new_position2(i % SIZE, 0), new_position2(SIZE - i % SIZE, SIZE - 1)));
+  MEASURE("fill_oval 64x64",        100000, g->fill_oval(g, new_rectangle(i % 900, i % 899, 64, 64)));
+  MEASURE("draw_oval 64x64",        100000, g->draw_oval(g, new_rectangle(i % 900, i % 899, 64, 64)));
+  MEASURE("fill_polygon 64",        10000,  g->fill_polygon(g, points, 64, ITK_GRAPHICS_SHAPE_COMPLEX, ITK_GRAPHICS_MODE_ABSOLUTE));
+  MEASURE("draw_polyline 64",       10000,  g->draw_polyline(g, points, 64, ITK_GRAPHICS_MODE_ABSOLUTE));
+  MEASURE("clip",                   100000, g->clip(g, new_packed_rectangle(i % 100, i % 99, SIZE, SIZE)));
+  
+  g->free(g);
+  XFreePixmap(display, pixmap);
+  XCloseDisplay(display);
+  free(points);
+  return 0;
+}
+
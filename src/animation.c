@@ -0,0 +1,400 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "animation.h"
+#include "geometry.h"
+#include "itkmacros.h"
+#include "trace.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+
+#define __this__  itk_animator* this
+
+
+/**
+ * Interpolate between two integers
+ * 
+ * @param  FROM      The value at progress 0
+ * @param  TO        The value at progress 1
+ * @param  PROGRESS  The progress
+ */
+#define LERP(FROM, TO, PROGRESS)  ((FROM) + (long)lround(((double)(TO) - (double)(FROM)) * (PROGRESS)))
+
+
+
+/**
+ * Linear easing
+ * 
+ * @param   t  The elapsed part of the duration
+ * @return     `t`
+ */
+double itk_ease_linear(double t)
+{
+  return t;
+}
+
+
+/**
+ * Cubic easing that starts slowly and ends slowly
+ * 
+ * @param   t  The elapsed part of the duration
+ * @return     The progress
+ */
+double itk_ease_in_out(double t)
+{
+  return t < 0.5 ? 4 * t * t * t : 1 - 4 * (1 - t) * (1 - t) * (1 - t);
+}
+
+
+/**
+ * Cubic easing that starts quickly and ends slowly
+ * 
+ * @param   t  The elapsed part of the duration
+ * @return     The progress
+ */
+double itk_ease_out(double t)
+{
+  return 1 - (1 - t) * (1 - t) * (1 - t);
+}
+
+
+/**
+ * Start an animation, replacing any running animation of the same property of the same component
+ * 
+ * @param   component  The component
+ * @param   property   The property, `ITK_ANIMATE_*`
+ * @param   duration   The number of nanoseconds the animation runs
+ * @param   easing     The easing function, `NULL` for `itk_ease_in_out`
+ * @return             The animation, with `from` and `to` left to be set
+ */
+static itk_animation* add(__this__, itk_component* component, int8_t property,
+			  long duration, double (*easing)(double t))
+{
+  itk_animation* rc;
+  itk_animation* a;
+  
+  if (property != ITK_ANIMATE_CUSTOM)
+    for (a = this->animations; a; a = a->next)
+      if ((a->component == component) && (a->property == property))
+	{
+	  itk_animation_cancel(this, a);
+	  break;
+	}
+  
+  rc = calloc(1, sizeof(itk_animation));
+  rc->component = component;
+  rc->property = property;
+  rc->duration = duration > 0 ? duration : 1;
+  rc->easing = easing ? easing : itk_ease_in_out;
+  rc->next = this->animations;
+  this->animations = rc;
+  
+  if (this->loop)
+    itk_main_loop_request_frame(this->loop);
+  return rc;
+}
+
+
+/**
+ * Get the area an animation changes, in the coordinates of the component's root
+ * 
+ * @param   animation  The animation
+ * @return             The area
+ */
+static packed_rectangle_t affected_area(itk_animation* animation)
+{
+  /* A new size or position moves the siblings as well, and the
+   * layout is not redone until the parent is painted, moreover,
+   * a component that grows from nothing, or moves into view,
+   * cannot be seen at the start of the animation */
+  if ((animation->property == ITK_ANIMATE_SIZE) || (animation->property == ITK_ANIMATE_POSITION))
+    if (animation->component->parent)
+      return itk_component_locate_in_root(animation->component->parent);
+  return itk_component_locate_in_root(animation->component);
+}
+
+
+/**
+ * Apply the progress of an animation to its component
+ * 
+ * @param  animation  The animation
+ * @param  progress   The progress
+ */
+static void apply(itk_animation* animation, double progress)
+{
+  itk_component* component = animation->component;
+  position2_t* position;
+  
+  switch (animation->property)
+    {
+    case ITK_ANIMATE_SIZE:
+      component->preferred_size.width  = LERP(animation->from.size.width,  animation->to.size.width,  progress);
+      component->preferred_size.height = LERP(animation->from.size.height, animation->to.size.height, progress);
+      if (component->parent)
+	itk_component_invalidate_child_hints(component->parent);
+      else
+	component->size = component->preferred_size;
+      break;
+      
+    case ITK_ANIMATE_POSITION:
+      position = component->constraints;
+      position->x = LERP(animation->from.position.x, animation->to.position.x, progress);
+      position->y = LERP(animation->from.position.y, animation->to.position.y, progress);
+      break;
+      
+    case ITK_ANIMATE_COLOUR:
+      /* Named system colours cannot be interpolated */
+      component->background_colour.defined = true;
+      component->background_colour.system_colour = NULL;
+#define __(C)  component->background_colour.argb_colour.c.C =				\
+	(uint8_t)LERP(animation->from.colour.argb_colour.c.C, animation->to.colour.argb_colour.c.C, progress)
+      __(alpha);
+      __(red);
+      __(green);
+      __(blue);
+#undef __
+      break;
+      
+    default:
+      animation->step(animation, progress);
+      break;
+    }
+}
+
+
+
+/**
+ * Constructor
+ * 
+ * @param   loop  The main loop to request frames from, may be `NULL`
+ * @return        The animator
+ */
+itk_animator* itk_new_animator(itk_main_loop* loop)
+{
+  itk_animator* rc = calloc(1, sizeof(itk_animator));
+  rc->loop = loop;
+  return rc;
+}
+
+
+/**
+ * Destructor, running animations are cancelled
+ */
+void itk_free_animator(__this__)
+{
+  while (this->animations)
+    itk_animation_cancel(this, this->animations);
+  free(this);
+}
+
+
+/**
+ * Animate the preferred size of a component, replacing any running animation of it
+ * 
+ * @param   component  The component
+ * @param   to         The final size
+ * @param   duration   The number of nanoseconds the animation runs
+ * @param   easing     The easing function, `NULL` for `itk_ease_in_out`
+ * @return             The animation
+ */
+itk_animation* itk_animate_size(__this__, itk_component* component, size2_t to,
+				long duration, double (*easing)(double t))
+{
+  itk_animation* rc = add(this, component, ITK_ANIMATE_SIZE, duration, easing);
+  rc->from.size = component->preferred_size;
+  rc->to.size = to;
+  return rc;
+}
+
+
+/**
+ * Animate the position of a component, whose `constraints` is a `position2_t`,
+ * replacing any running animation of it
+ * 
+ * @param   component  The component
+ * @param   to         The final position
+ * @param   duration   The number of nanoseconds the animation runs
+ * @param   easing     The easing function, `NULL` for `itk_ease_in_out`
+ * @return             The animation
+ */
+itk_animation* itk_animate_position(__this__, itk_component* component, position2_t to,
+				    long duration, double (*easing)(double t))
+{
+  itk_animation* rc = add(this, component, ITK_ANIMATE_POSITION, duration, easing);
+  rc->from.position = *(position2_t*)(component->constraints);
+  rc->to.position = to;
+  return rc;
+}
+
+
+/**
+ * Animate the background colour of a component, replacing any running animation of it
+ * 
+ * @param   component  The component
+ * @param   to         The final colour, an ARGB colour
+ * @param   duration   The number of nanoseconds the animation runs
+ * @param   easing     The easing function, `NULL` for `itk_ease_in_out`
+ * @return             The animation
+ */
+itk_animation* itk_animate_colour(__this__, itk_component* component, colour_t to,
+				  long duration, double (*easing)(double t))
+{
+  itk_animation* rc = add(this, component, ITK_ANIMATE_COLOUR, duration, easing);
+  rc->from.colour = component->background_colour;
+  rc->to.colour = to;
+  return rc;
+}
+
+
+/**
+ * Animate something else about a component
+ * 
+ * @param   component  The component, its area is damaged every frame
+ * @param   step       Applies the progress
+ * @param   user_data  User data for `step`
+ * @param   duration   The number of nanoseconds the animation runs
+ * @param   easing     The easing function, `NULL` for `itk_ease_in_out`
+ * @return             The animation
+ */
+itk_animation* itk_animate(__this__, itk_component* component,
+			   void (*step)(itk_animation* animation, double progress), void* user_data,
+			   long duration, double (*easing)(double t))
+{
+  itk_animation* rc = add(this, component, ITK_ANIMATE_CUSTOM, duration, easing);
+  rc->step = step;
+  rc->user_data = user_data;
+  return rc;
+}
+
+
+/**
+ * Stop an animation where it is
+ * 
+ * @param  animation  The animation
+ */
+void itk_animation_cancel(__this__, itk_animation* animation)
+{
+  itk_animation** link = &(this->animations);
+  
+  while (*link != animation)
+    link = &((*link)->next);
+  *link = animation->next;
+  free(animation);
+}
+
+
+/**
+ * Stop all animations of a component, this must be done before it is freed
+ * 
+ * @param  component  The component
+ */
+void itk_animator_cancel_component(__this__, itk_component* component)
+{
+  itk_animation** link = &(this->animations);
+  itk_animation* animation;
+  
+  while ((animation = *link))
+    if (animation->component == component)
+      {
+	*link = animation->next;
+	free(animation);
+      }
+    else
+      link = &(animation->next);
+}
+
+
+/**
+ * Advance all animations to a frame
+ * 
+ * @param   now     The time of the frame, in nanoseconds on the monotonic clock
+ * @param   damage  The region, in the coordinates of the components' roots,
+ *                  that the changes are added to
+ * @return          Whether any animation is still running and not suspended,
+ *                  in which case another frame has been requested
+ */
+bool_t itk_animator_frame(__this__, uint64_t now, itk_region* damage)
+{
+  itk_animation** link = &(this->animations);
+  itk_animation* finished = NULL;
+  itk_animation* animation;
+  packed_rectangle_t area;
+  bool_t running = false;
+  double t;
+  
+  ITK_TRACE_BEGIN("animator.frame", NULL);
+  this->frame_time = now;
+  
+  while ((animation = *link))
+    {
+      /* Nothing changes on screen for a hidden component, so wait until it can be seen */
+      area = affected_area(animation);
+      if (itk_rectangle_is_empty(area))
+	{
+	  if (animation->suspended == 0)
+	    animation->suspended = now;
+	  link = &(animation->next);
+	  continue;
+	}
+      if (animation->suspended)
+	{
+	  if (animation->start)
+	    animation->start += now - animation->suspended;
+	  animation->suspended = 0;
+	}
+      if (animation->start == 0)
+	animation->start = now;
+      
+      t = (double)(now - animation->start) / (double)(animation->duration);
+      t = t < 1 ? t : 1;
+      
+      itk_region_add_rectangle(damage, area);
+      apply(animation, animation->easing(t));
+      itk_region_add_rectangle(damage, affected_area(animation));
+      
+      if (t < 1)
+	{
+	  running = true;
+	  link = &(animation->next);
+	}
+      else
+	{
+	  *link = animation->next;
+	  animation->next = finished;
+	  finished = animation;
+	}
+    }
+  
+  /* The list is consistent again, so `done` may start and cancel animations */
+  while ((animation = finished))
+    {
+      finished = animation->next;
+      if (animation->done)
+	animation->done(animation);
+      free(animation);
+    }
+  
+  if (running && this->loop)
+    itk_main_loop_request_frame(this->loop);
+  
+  ITK_TRACE_END("animator.frame", NULL);
+  return running;
+}
+
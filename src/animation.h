@@ -0,0 +1,290 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_ANIMATION_H__
+#define __ITK_ANIMATION_H__
+
+#include "itktypes.h"
+#include "component.h"
+#include "main_loop.h"
+#include "region.h"
+
+
+/**
+ * The animation changes the component's preferred size
+ */
+#define ITK_ANIMATE_SIZE  0
+
+/**
+ * The animation changes the component's position, `constraints` must point
+ * to a `position2_t`, as is used when the parent has no layout manager
+ */
+#define ITK_ANIMATE_POSITION  1
+
+/**
+ * The animation changes the component's background colour, which must be an ARGB colour
+ */
+#define ITK_ANIMATE_COLOUR  2
+
+/**
+ * The animation calls `step`
+ */
+#define ITK_ANIMATE_CUSTOM  3
+
+
+struct _itk_animator;
+
+
+/**
+ * A running animation of a property of a component
+ */
+typedef struct _itk_animation
+{
+  /**
+   * The animated component
+   */
+  itk_component* component;
+  
+  /**
+   * The animated property, `ITK_ANIMATE_*`
+   */
+  int8_t property;
+  
+  /**
+   * The value of the property at the start
+   */
+  union
+  {
+    size2_t size;
+    position2_t position;
+    colour_t colour;
+  } from;
+  
+  /**
+   * The value of the property at the end
+   */
+  union
+  {
+    size2_t size;
+    position2_t position;
+    colour_t colour;
+  } to;
+  
+  /**
+   * The frame time of the first frame of the animation, 0 until it has been drawn
+   */
+  uint64_t start;
+  
+  /**
+   * The number of nanoseconds the animation runs
+   */
+  long duration;
+  
+  /**
+   * When the animation was suspended, 0 if it is not suspended
+   */
+  uint64_t suspended;
+  
+  /**
+   * Maps the elapsed part of the duration to the progress of the animation
+   * 
+   * @param   t  The elapsed part, between 0 and 1
+   * @return     The progress, 0 at the start and 1 at the end
+   */
+  double (*easing)(double t);
+  
+  /**
+   * Applies the progress, for `ITK_ANIMATE_CUSTOM`, the component's whole area is damaged
+   * 
+   * @param  animation  The animation
+   * @param  progress   The progress, as returned by `easing`
+   */
+  void (*step)(struct _itk_animation* animation, double progress);
+  
+  /**
+   * Called when the animation has finished, may be `NULL`, not called if it is cancelled
+   * 
+   * @param  animation  The animation, it is freed when the function returns
+   */
+  void (*done)(struct _itk_animation* animation);
+  
+  /**
+   * User data for `step` and `done`
+   */
+  void* user_data;
+  
+  /**
+   * The next animation of the animator
+   */
+  struct _itk_animation* next;
+  
+} itk_animation;
+
+
+/**
+ * Runs animations, sampling a monotonic frame clock once per frame so all
+ * animations advance together, and collecting what they change into one
+ * damage region, animations whose components are hidden or completely
+ * clipped away are suspended until they can be seen again
+ */
+typedef struct _itk_animator
+{
+  /**
+   * The running animations
+   */
+  itk_animation* animations;
+  
+  /**
+   * The main loop, frames are requested from it while animations run, may be `NULL`
+   */
+  itk_main_loop* loop;
+  
+  /**
+   * The time of the current frame, in nanoseconds on the monotonic clock
+   */
+  uint64_t frame_time;
+  
+} itk_animator;
+
+
+/**
+ * Linear easing
+ * 
+ * @param   t  The elapsed part of the duration
+ * @return     `t`
+ */
+double itk_ease_linear(double t);
+
+/**
+ * Cubic easing that starts slowly and ends slowly
+ * 
+ * @param   t  The elapsed part of the duration
+ * @return     The progress
+ */
+double itk_ease_in_out(double t);
+
+/**
+ * Cubic easing that starts quickly and ends slowly
+ * 
+ * @param   t  The elapsed part of the duration
+ * @return     The progress
+ */
+double itk_ease_out(double t);
+
+
+/**
+ * Constructor
+ * 
+ * @param   loop  The main loop to request frames from, may be `NULL`
+ * @return        The animator
+ */
+itk_animator* itk_new_animator(itk_main_loop* loop);
+
+/**
+ * Destructor, running animations are cancelled
+ * 
+ * @param  this  The animator
+ */
+void itk_free_animator(itk_animator* this);
+
+/**
+ * Animate the preferred size of a component, replacing any running animation of it
+ * 
+ * @param   this       The animator
+ * @param   component  The component
+ * @param   to         The final size
+ * @param   duration   The number of nanoseconds the animation runs
+ * @param   easing     The easing function, `NULL` for `itk_ease_in_out`
+ * @return             The animation
+ */
+itk_animation* itk_animate_size(itk_animator* this, itk_component* component, size2_t to,
+				long duration, double (*easing)(double t));
+
+/**
+ * Animate the position of a component, whose `constraints` is a `position2_t`,
+ * replacing any running animation of it
+ * 
+ * @param   this       The animator
+ * @param   component  The component
+ * @param   to         The final position
+ * @param   duration   The number of nanoseconds the animation runs
+ * @param   easing     The easing function, `NULL` for `itk_ease_in_out`
+ * @return             The animation
+ */
+itk_animation* itk_animate_position(itk_animator* this, itk_component* component, position2_t to,
+				    long duration, double (*easing)(double t));
+
+/**
+ * Animate the background colour of a component, replacing any running animation of it
+ * 
+ * @param   this       The animator
+ * @param   component  The component
+ * @param   to         The final colour, an ARGB colour
+ * @param   duration   The number of nanoseconds the animation runs
+ * @param   easing     The easing function, `NULL` for `itk_ease_in_out`
+ * @return             The animation
+ */
+itk_animation* itk_animate_colour(itk_animator* this, itk_component* component, colour_t to,
+				  long duration, double (*easing)(double t));
+
+/**
+ * Animate something else about a component
+ * 
+ * @param   this       The animator
+ * @param   component  The component, its area is damaged every frame
+ * @param   step       Applies the progress
+ * @param   user_data  User data for `step`
+ * @param   duration   The number of nanoseconds the animation runs
+ * @param   easing     The easing function, `NULL` for `itk_ease_in_out`
+ * @return             The animation
+ */
+itk_animation* itk_animate(itk_animator* this, itk_component* component,
+			   void (*step)(itk_animation* animation, double progress), void* user_data,
+			   long duration, double (*easing)(double t));
+
+/**
+ * Stop an animation where it is
+ * 
+ * @param  this       The animator
+ * @param  animation  The animation
+ */
+void itk_animation_cancel(itk_animator* this, itk_animation* animation);
+
+/**
+ * Stop all animations of a component, this must be done before it is freed
+ * 
+ * @param  this       The animator
+ * @param  component  The component
+ */
+void itk_animator_cancel_component(itk_animator* this, itk_component* component);
+
+/**
+ * Advance all animations to a frame
+ * 
+ * @param   this    The animator
+ * @param   now     The time of the frame, in nanoseconds on the monotonic clock
+ * @param   damage  The region, in the coordinates of the components' roots,
+ *                  that the changes are added to
+ * @return          Whether any animation is still running and not suspended,
+ *                  in which case another frame has been requested
+ */
+bool_t itk_animator_frame(itk_animator* this, uint64_t now, itk_region* damage);
+
+
+#endif
+
@@ -0,0 +1,367 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "child_hints.h"
+#include "component.h"
+#include "itkmacros.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+
+/**
+ * The number of children the arrays have room for at least
+ */
+#define MINIMUM_CAPACITY  16
+
+
+/**
+ * Constructor
+ * 
+ * @return  Empty hints, that are not valid
+ */
+itk_child_hints* itk_new_child_hints(void)
+{
+  return calloc(1, sizeof(itk_child_hints));
+}
+
+
+/**
+ * Destructor
+ * 
+ * @param  this  The hints
+ */
+void itk_free_child_hints(itk_child_hints* this)
+{
+  free(this->constraints);
+  free(this);
+}
+
+
+/**
+ * Reallocate the arrays, they are allocated together, pointers first
+ * to keep the alignment, so that they end up close to each other
+ * 
+ * @param  this      The hints
+ * @param  capacity  The new capacity
+ */
+static void resize(itk_child_hints* this, long capacity)
+{
+  char* block;
+  
+  free(this->constraints);
+  block = malloc(capacity * (sizeof(void*) + 6 * sizeof(dimension_t) + sizeof(bool_t)));
+  
+  this->constraints      = (void**)block;
+  this->minimum_width    = (dimension_t*)(this->constraints + capacity);
+  this->minimum_height   = this->minimum_width    + capacity;
+  this->preferred_width  = this->minimum_height   + capacity;
+  this->preferred_height = this->preferred_width  + capacity;
+  this->maximum_width    = this->preferred_height + capacity;
+  this->maximum_height   = this->maximum_width    + capacity;
+  this->visible          = (bool_t*)(this->maximum_height + capacity);
+  this->capacity = capacity;
+}
+
+
+/**
+ * Copy the hints of the children of a container into the arrays
+ * 
+ * @param  this       The hints
+ * @param  container  The container, its `children` must be compacted
+ */
+void itk_child_hints_update(itk_child_hints* this, itk_component* container)
+{
+  long i, n = container->children_count, visible = 0, capacity = this->capacity;
+  itk_component* child;
+  
+  if ((n > capacity) || (n < capacity / 4))
+    {
+      capacity = MINIMUM_CAPACITY;
+      while (capacity < n)
+	capacity *= 2;
+      if (capacity != this->capacity)
+	resize(this, capacity);
+    }
+  
+  for (i = 0; i < n; i++)
+    {
+      child = *(container->children + i);
+      visible += *(this->visible + i) = child->visible ? 1 : 0;
+      *(this->minimum_width    + i) = child->minimum_size.width;
+      *(this->minimum_height   + i) = child->minimum_size.height;
+      *(this->preferred_width  + i) = child->preferred_size.width;
+      *(this->preferred_height + i) = child->preferred_size.height;
+      *(this->maximum_width    + i) = child->maximum_size.width;
+      *(this->maximum_height   + i) = child->maximum_size.height;
+      *(this->constraints      + i) = child->constraints;
+    }
+  
+  this->count = n;
+  this->visible_count = visible;
+  this->valid = true;
+}
+
+
+/* The loops below are branch free so that the compiler can vectorise them,
+   `visible` is 0 or 1, so its negation masks out hidden children's values */
+
+
+/**
+ * Calculate the sum of the visible children's values
+ * 
+ * @param   this    The hints
+ * @param   values  One of the hints' arrays
+ * @return          The sum
+ */
+static dimension_t sum(const itk_child_hints* this, const dimension_t* values)
+{
+  const bool_t* visible = this->visible;
+  dimension_t rc = 0;
+  long i, n = this->count;
+  
+  for (i = 0; i < n; i++)
+    rc += *(values + i) & -(dimension_t)*(visible + i);
+  
+  return rc;
+}
+
+
+/**
+ * Calculate the sum of the visible children's values that are not `UNBOUNDED`
+ * 
+ * @param   this       The hints
+ * @param   values     One of the hints' arrays
+ * @param   unbounded  Set to `true` if any visible child's value is `UNBOUNDED`,
+ *                     otherwise left as is
+ * @return             The sum
+ */
+static dimension_t sum_bounded(const itk_child_hints* this, const dimension_t* values, bool_t* unbounded)
+{
+  const bool_t* visible = this->visible;
+  dimension_t rc = 0, value, negative = 0;
+  long i, n = this->count;
+  
+  for (i = 0; i < n; i++)
+    {
+      value = *(values + i) & -(dimension_t)*(visible + i);
+      negative |= value;
+      rc += value < 0 ? 0 : value;
+    }
+  
+  if (negative < 0)
+    *unbounded = true;
+  return rc;
+}
+
+
+/**
+ * Calculate the largest of the visible children's values
+ * 
+ * @param   this     The hints
+ * @param   values   One of the hints' arrays
+ * @param   initial  The value to return if no visible child has a larger value
+ * @return           The largest value
+ */
+static dimension_t max(const itk_child_hints* this, const dimension_t* values, dimension_t initial)
+{
+  const bool_t* visible = this->visible;
+  dimension_t rc = initial, value, mask;
+  long i, n = this->count;
+  
+  for (i = 0; i < n; i++)
+    {
+      mask = -(dimension_t)*(visible + i);
+      value = (*(values + i) & mask) | (initial & ~mask);
+      rc = rc < value ? value : rc;
+    }
+  
+  return rc;
+}
+
+
+/**
+ * Calculate the smallest of the visible children's values that are not `UNBOUNDED`
+ * 
+ * @param   this    The hints
+ * @param   values  One of the hints' arrays
+ * @return          The smallest value, `UNBOUNDED` if there is none
+ */
+static dimension_t min_bounded(const itk_child_hints* this, const dimension_t* values)
+{
+  const bool_t* visible = this->visible;
+  uint32_t rc = UINT32_MAX, value;
+  long i, n = this->count;
+  
+  /* Negative values, that is `UNBOUNDED`, are larger than any bounded
+     value when unsigned, and hidden children's values become all ones */
+  for (i = 0; i < n; i++)
+    {
+      value = (uint32_t)*(values + i) | ((uint32_t)*(visible + i) - 1);
+      rc = rc > value ? value : rc;
+    }
+  
+  return rc > INT32_MAX ? UNBOUNDED : (dimension_t)rc;
+}
+
+
+/**
+ * Calculate a total of one of the hints' arrays
+ * 
+ * @param   this       The hints
+ * @param   values     One of the hints' arrays
+ * @param   total      The total to calculate, `ITK_CHILD_TOTAL_*`
+ * @param   unbounded  Set to `true` if `total` is `ITK_CHILD_TOTAL_BOUNDED_SUM`
+ *                     and any visible child's value is `UNBOUNDED`
+ * @return             The total
+ */
+static dimension_t total_values(const itk_child_hints* this, const dimension_t* values, int total,
+				bool_t* unbounded)
+{
+  switch (total)
+    {
+    case ITK_CHILD_TOTAL_SUM:          return sum(this, values);
+    case ITK_CHILD_TOTAL_BOUNDED_SUM:  return sum_bounded(this, values, unbounded);
+    case ITK_CHILD_TOTAL_MAX:          return max(this, values, 0);
+    default:                           return min_bounded(this, values);
+    }
+}
+
+
+/**
+ * Add a visible child's value to a total
+ * 
+ * @param  rc         The total
+ * @param  value      The value
+ * @param  total      The total to calculate, `ITK_CHILD_TOTAL_*`
+ * @param  unbounded  Set to `true` if `total` is `ITK_CHILD_TOTAL_BOUNDED_SUM`
+ *                    and `value` is `UNBOUNDED`
+ */
+static inline void total_value(dimension_t* rc, dimension_t value, int total, bool_t* unbounded)
+{
+  switch (total)
+    {
+    case ITK_CHILD_TOTAL_SUM:
+      *rc += value;
+      break;
+      
+    case ITK_CHILD_TOTAL_BOUNDED_SUM:
+      if (value < 0)
+	*unbounded = true;
+      else
+	*rc += value;
+      break;
+      
+    case ITK_CHILD_TOTAL_MAX:
+      if (*rc < value)
+	*rc = value;
+      break;
+      
+    default:
+      if ((value >= 0) && ((*rc < 0) || (*rc > value)))
+	*rc = value;
+      break;
+    }
+}
+
+
+/**
+ * Add the visible children's values to the totals, with the
+ * totals to calculate known at compile time, so that choosing
+ * between them is not done for every child
+ * 
+ * @param  WIDTH_TOTAL   The total to calculate of the widths, `ITK_CHILD_TOTAL_*`
+ * @param  HEIGHT_TOTAL  The total to calculate of the heights, `ITK_CHILD_TOTAL_*`
+ */
+#define total_children(container, offset, rc, WIDTH_TOTAL, HEIGHT_TOTAL)	\
+  ({									\
+    itk_component** children = container->children;			\
+    itk_component* child;						\
+    long i, n = container->children_count;				\
+    size2_t size;							\
+    for (i = 0; i < n; i++)						\
+      if ((child = *(children + i))->visible)				\
+	{								\
+	  size = *(size2_t*)((char*)child + offset);			\
+	  rc.visible_count++;						\
+	  total_value(&(rc.width), size.width, WIDTH_TOTAL, &(rc.width_unbounded)); \
+	  total_value(&(rc.height), size.height, HEIGHT_TOTAL, &(rc.height_unbounded)); \
+	}								\
+  })
+
+
+/**
+ * Calculate totals of one of the sizes of the visible children of a container
+ * 
+ * If the container has `cache_child_hints` set, the totals are calculated from
+ * its cached hints, otherwise they are calculated directly from the children,
+ * in one pass and without copying their hints
+ * 
+ * This compacts `children`
+ * 
+ * @param   container     The container
+ * @param   hint          The size, `ITK_CHILD_HINT_*`
+ * @param   width_total   The total to calculate of the widths, `ITK_CHILD_TOTAL_*`
+ * @param   height_total  The total to calculate of the heights, `ITK_CHILD_TOTAL_*`
+ * @return                The totals
+ */
+itk_child_totals itk_child_hints_totals(itk_component* container, int hint,
+					int width_total, int height_total)
+{
+  itk_child_totals rc;
+  itk_child_hints* hints;
+  size_t offset;
+  
+  rc.width_unbounded = rc.height_unbounded = false;
+  
+  if (container->cache_child_hints)
+    {
+      /* The arrays are in the order of the `ITK_CHILD_HINT_*`, width before height */
+      hints = itk_component_child_hints(container);
+      rc.visible_count = hints->visible_count;
+      rc.width = total_values(hints, hints->minimum_width + (2 * hint + 0) * hints->capacity,
+			      width_total, &(rc.width_unbounded));
+      rc.height = total_values(hints, hints->minimum_width + (2 * hint + 1) * hints->capacity,
+			       height_total, &(rc.height_unbounded));
+      return rc;
+    }
+  
+  offset = hint == ITK_CHILD_HINT_MINIMUM   ? offsetof(itk_component, minimum_size)   :
+	   hint == ITK_CHILD_HINT_PREFERRED ? offsetof(itk_component, preferred_size) :
+					      offsetof(itk_component, maximum_size);
+  
+  itk_component_compact_children(container);
+  rc.visible_count = 0;
+  rc.width = width_total == ITK_CHILD_TOTAL_BOUNDED_MIN ? UNBOUNDED : 0;
+  rc.height = height_total == ITK_CHILD_TOTAL_BOUNDED_MIN ? UNBOUNDED : 0;
+  
+#define __(W, H)							\
+  case ITK_CHILD_TOTAL_##W * 4 + ITK_CHILD_TOTAL_##H:			\
+    total_children(container, offset, rc, ITK_CHILD_TOTAL_##W, ITK_CHILD_TOTAL_##H); \
+    break
+  switch (width_total * 4 + height_total)
+    {
+    __(SUM, SUM);          __(SUM, BOUNDED_SUM);          __(SUM, MAX);          __(SUM, BOUNDED_MIN);
+    __(BOUNDED_SUM, SUM);  __(BOUNDED_SUM, BOUNDED_SUM);  __(BOUNDED_SUM, MAX);  __(BOUNDED_SUM, BOUNDED_MIN);
+    __(MAX, SUM);          __(MAX, BOUNDED_SUM);          __(MAX, MAX);          __(MAX, BOUNDED_MIN);
+    __(BOUNDED_MIN, SUM);  __(BOUNDED_MIN, BOUNDED_SUM);  __(BOUNDED_MIN, MAX);  __(BOUNDED_MIN, BOUNDED_MIN);
+    }
+#undef __
+  
+  return rc;
+}
@@ -0,0 +1,209 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_CHILD_HINTS_H__
+#define __ITK_CHILD_HINTS_H__
+
+#include "itktypes.h"
+
+struct _itk_component;
+
+
+/**
+ * The layout hints of a container's children, stored as parallel
+ * arrays so that layout managers can read them contiguously
+ */
+typedef struct _itk_child_hints
+{
+  /**
+   * The number of children in the arrays
+   */
+  long count;
+  
+  /**
+   * The number of children the arrays have room for
+   */
+  long capacity;
+  
+  /**
+   * The number of visible children
+   */
+  long visible_count;
+  
+  /**
+   * Whether the arrays are up to date with the children
+   */
+  bool_t valid;
+  
+  /**
+   * Whether each child is visible, 1 if visible and 0 otherwise
+   */
+  bool_t* visible;
+  
+  /**
+   * The width of each child's advisory minimum size
+   */
+  dimension_t* minimum_width;
+  
+  /**
+   * The height of each child's advisory minimum size
+   */
+  dimension_t* minimum_height;
+  
+  /**
+   * The width of each child's preferred size
+   */
+  dimension_t* preferred_width;
+  
+  /**
+   * The height of each child's preferred size
+   */
+  dimension_t* preferred_height;
+  
+  /**
+   * The width of each child's advisory maximum size
+   */
+  dimension_t* maximum_width;
+  
+  /**
+   * The height of each child's advisory maximum size
+   */
+  dimension_t* maximum_height;
+  
+  /**
+   * Each child's layout constraints
+   */
+  void** constraints;
+  
+} itk_child_hints;
+
+
+/**
+ * Constructor
+ * 
+ * @return  Empty hints, that are not valid
+ */
+itk_child_hints* itk_new_child_hints(void);
+
+/**
+ * Destructor
+ * 
+ * @param  this  The hints
+ */
+void itk_free_child_hints(itk_child_hints* this);
+
+/**
+ * Copy the hints of the children of a container into the arrays
+ * 
+ * @param  this       The hints
+ * @param  container  The container, its `children` must be compacted
+ */
+void itk_child_hints_update(itk_child_hints* this, struct _itk_component* container);
+
+
+/**
+ * Calculate the totals of the children's advisory minimum sizes
+ */
+#define ITK_CHILD_HINT_MINIMUM  0
+
+/**
+ * Calculate the totals of the children's preferred sizes
+ */
+#define ITK_CHILD_HINT_PREFERRED  1
+
+/**
+ * Calculate the totals of the children's advisory maximum sizes
+ */
+#define ITK_CHILD_HINT_MAXIMUM  2
+
+
+/**
+ * Calculate the sum of the values
+ */
+#define ITK_CHILD_TOTAL_SUM  0
+
+/**
+ * Calculate the sum of the values that are not `UNBOUNDED`,
+ * and whether any value is `UNBOUNDED`
+ */
+#define ITK_CHILD_TOTAL_BOUNDED_SUM  1
+
+/**
+ * Calculate the largest value, zero if none is positive
+ */
+#define ITK_CHILD_TOTAL_MAX  2
+
+/**
+ * Calculate the smallest value that is not `UNBOUNDED`, `UNBOUNDED` if there is none
+ */
+#define ITK_CHILD_TOTAL_BOUNDED_MIN  3
+
+
+/**
+ * Totals of one of the visible children's sizes
+ */
+typedef struct _itk_child_totals
+{
+  /**
+   * The number of visible children
+   */
+  long visible_count;
+  
+  /**
+   * The total of the widths
+   */
+  dimension_t width;
+  
+  /**
+   * The total of the heights
+   */
+  dimension_t height;
+  
+  /**
+   * Whether any width is `UNBOUNDED`, if the total is `ITK_CHILD_TOTAL_BOUNDED_SUM`
+   */
+  bool_t width_unbounded;
+  
+  /**
+   * Whether any height is `UNBOUNDED`, if the total is `ITK_CHILD_TOTAL_BOUNDED_SUM`
+   */
+  bool_t height_unbounded;
+  
+} itk_child_totals;
+
+
+/**
+ * Calculate totals of one of the sizes of the visible children of a container
+ * 
+ * If the container has `cache_child_hints` set, the totals are calculated from
+ * its cached hints, otherwise they are calculated directly from the children,
+ * in one pass and without copying their hints
+ * 
+ * This compacts `children`
+ * 
+ * @param   container     The container
+ * @param   hint          The size, `ITK_CHILD_HINT_*`
+ * @param   width_total   The total to calculate of the widths, `ITK_CHILD_TOTAL_*`
+ * @param   height_total  The total to calculate of the heights, `ITK_CHILD_TOTAL_*`
+ * @return                The totals
+ */
+itk_child_totals itk_child_hints_totals(struct _itk_component* container, int hint,
+					int width_total, int height_total);
+
+#endif
+
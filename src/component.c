@@ -19,28 +19,44 @@
 #include "component.h"
 #include "layout_manager.h"
 #include "graphics.h"
+#include "child_hints.h"
+#include "geometry.h"
 #include "itktypes.h"
 #include "itkmacros.h"
+#include "trace.h"
+#include "probes.h"
+#include "metrics.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #define __this__  itk_component* this
 
 
+/**
+ * The smallest capacity `children` is allocated with
+ */
+#define MINIMUM_CHILDREN_CAPACITY  4
+
+
 /**
  * Locates the positions of the corners of a child
  * 
  * @param   child  The child
  * @return         The rectangle the child is confound in
  */
-static rectangle_t locate_child(__this__, struct _itk_component* child)
+static packed_rectangle_t locate_child(__this__, struct _itk_component* child)
 {
-  rectangle_t rc;
+  packed_rectangle_t rc;
   
   if (this->layout_manager)
-    return this->layout_manager->locate(this->layout_manager, child);
+    {
+      ITK_PROBE(layout_locate_entry, this->layout_manager, this->layout_manager->vtable, child->name);
+      rc = this->layout_manager->vtable->locate(this->layout_manager, child);
+      ITK_PROBE(layout_locate_return, this->layout_manager, rc.width, rc.height);
+      return rc;
+    }
   
-  rc.defined = true;
   rc.x = 0;
   rc.y = 0;
   rc.width = child->preferred_size.width;
@@ -56,6 +72,36 @@ static rectangle_t locate_child(__this__, struct _itk_component* child)
 }
 
 
+/**
+ * Defer synchronisation of an area until the end of the current batch
+ * 
+ * @param  area  Area to synchronise, `NULL` for everything
+ */
+static void defer_sync(__this__, rectangle_t* area)
+{
+  rectangle_t* pending = &(this->update_area);
+  position_t x2, y2;
+  
+  if ((area == NULL) || (area->defined == false) || ((area->width | area->height) < 0))
+    pending->defined = false;
+  else if (this->update_pending == false)
+    *pending = *area;
+  else if (pending->defined)
+    {
+      x2 = pending->x + pending->width;
+      y2 = pending->y + pending->height;
+      if (x2 < area->x + area->width)   x2 = area->x + area->width;
+      if (y2 < area->y + area->height)  y2 = area->y + area->height;
+      if (pending->x > area->x)  pending->x = area->x;
+      if (pending->y > area->y)  pending->y = area->y;
+      pending->width = x2 - pending->x;
+      pending->height = y2 - pending->y;
+    }
+  
+  this->update_pending = true;
+}
+
+
 /**
  * Synchronises the graphics
  * 
@@ -66,32 +112,40 @@ static void sync_area(__this__, rectangle_t* area)
   itk_graphics* g;
   rectangle_t rect;
   
+  if (this->update_depth)
+    {
+      defer_sync(this, area);
+      return;
+    }
+  
   if (this->parent == NULL)
     return;
   
+  ITK_TRACE_BEGIN("sync_area", this->name);
   if (this->background_colour.argb_colour.c.alpha != 255)
     {
-      rect = this->parent->locate_child(this->parent, this);
+      rect = unpack_rectangle(this->parent->vtable->locate_child(this->parent, this));
       if (rect.defined && ((rect.width | rect.height) > 0))
 	{
 	  if ((area == NULL) || (area->defined == false) || ((area->width | area->height) < 0))
-	    this->parent->sync_area(this->parent, &rect);
+	    this->parent->vtable->sync_area(this->parent, &rect);
 	  else
 	    {
 	      rect.x += area->x;
 	      rect.y += area->y;
 	      rect.width = area->width;
 	      rect.height = area->height;
-	      this->parent->sync_area(this->parent, &rect);
+	      this->parent->vtable->sync_area(this->parent, &rect);
 	    }
 	}
     }
-  else if ((g = this->parent->sync_child(this->parent, this)))
+  else if ((g = this->parent->vtable->sync_child(this->parent, this)))
     {
-      if ((area->defined) && ((area->width | area->height) >= 0))
-	g->clip(g, *area);
-      this->paint(this, g);
+      if (area && (area->defined) && ((area->width | area->height) >= 0))
+	g->clip(g, pack_rectangle(*area));
+      this->vtable->paint(this, g);
     }
+  ITK_TRACE_END("sync_area", this->name);
 }
 
 /**
@@ -102,19 +156,31 @@ static void sync_area(__this__, rectangle_t* area)
  */
 static itk_graphics* sync_child(__this__, itk_component* child)
 {
+  packed_rectangle_t rect;
+  rectangle_t area;
+  
+  itk_component_invalidate_child_hints(this);
+  
+  if (this->update_depth)
+    {
+      area = unpack_rectangle(this->vtable->locate_child(this, child));
+      defer_sync(this, &area);
+      return NULL;
+    }
+  
   if (this->parent == NULL)
     return NULL;
   
-  itk_graphics* g = this->parent->sync_child(this->parent, this);
+  itk_graphics* g = this->parent->vtable->sync_child(this->parent, this);
   if (g == NULL)
     return NULL;
   
-  rectangle_t rect = this->locate_child(this, child);
-  if ((rect.defined == false) && (rect.width | rect.height) < 0)
+  rect = this->vtable->locate_child(this, child);
+  if ((packed_rectangle_defined(rect) == false) && (rect.width | rect.height) < 0)
     return NULL;
   
   g->clip(g, rect);
-  g->translate(g, new_position2(-(rect.x), -(rect.y)));
+  g->translate(g, new_packed_position2(-(rect.x), -(rect.y)));
   return g;
 }
 
@@ -135,10 +201,18 @@ static void sync(__this__)
  */
 static void paint(__this__, itk_graphics* g)
 {
+  uint64_t start = this->parent ? 0 : itk_metrics_now();
+  
   /* TODO implement buffer support */
   
-  this->paint_component(this, g);
-  this->paint_children(this, g);
+  ITK_TRACE_BEGIN("paint", this->name);
+  this->vtable->paint_component(this, g);
+  this->vtable->paint_children(this, g);
+  ITK_TRACE_END("paint", this->name);
+  
+  itk_metrics_add(ITK_METRIC_COMPONENTS_PAINTED, 1);
+  if (this->parent == NULL)
+    itk_metrics_record(ITK_METRIC_FRAME_TIME, itk_metrics_now() - start);
 }
 
 /**
@@ -152,6 +226,41 @@ static void paint_component(__this__, itk_graphics* g)
   g->fill_rectangle(g, new_rectangle(0, 0, this->size.width, this->size.height));
 }
 
+/**
+ * Let the layout manager of a component prepare for its children to be located
+ * 
+ * @param  n  The number of children
+ */
+static inline void begin_layout(__this__, long n)
+{
+  (void) n;
+  
+  if (this->layout_manager)
+    {
+      ITK_TRACE_BEGIN("layout.prepare", this->name);
+      ITK_PROBE(layout_prepare_entry, this->layout_manager, this->layout_manager->vtable, this->name, n);
+      itk_metrics_add(ITK_METRIC_LAYOUT_PASSES, 1);
+      this->layout_manager->vtable->prepare(this->layout_manager);
+      ITK_PROBE(layout_prepare_return, this->layout_manager);
+      ITK_TRACE_END("layout.prepare", this->name);
+    }
+}
+
+/**
+ * Let the layout manager of a component know that its children have been located
+ */
+static inline void end_layout(__this__)
+{
+  if (this->layout_manager)
+    {
+      ITK_TRACE_BEGIN("layout.done", this->name);
+      ITK_PROBE(layout_done_entry, this->layout_manager, this->layout_manager->vtable, this->name);
+      this->layout_manager->vtable->done(this->layout_manager);
+      ITK_PROBE(layout_done_return, this->layout_manager);
+      ITK_TRACE_END("layout.done", this->name);
+    }
+}
+
 /**
  * Repaint the component's children
  * 
@@ -159,27 +268,203 @@ static void paint_component(__this__, itk_graphics* g)
  */
 static void paint_children(__this__, itk_graphics* g)
 {
-  rectangle_t rect;
+  packed_rectangle_t rect;
   itk_component* child;
-  long i = 0, n = this->children_count;
+  long i = 0, n = itk_component_compact_children(this)->children_count;
   
-  if (this->layout_manager)
-    this->layout_manager->prepare(this->layout_manager);
+  begin_layout(this, n);
   
   for (; i < n; i++)
     {
       child = *(this->children + i);
-      rect = this->locate_child(this, child);
-      if (rect.defined && (rect.width | rect.height) > 0)
+      rect = this->vtable->locate_child(this, child);
+      if (packed_rectangle_defined(rect) && (rect.width | rect.height) > 0)
 	{
+	  ITK_PROBE(paint_child_entry, this->name, child->name, rect.width, rect.height);
+	  ITK_TRACE_BEGIN("graphics.create", child->name);
 	  itk_graphics* child_g = g->create(g, rect);
-	  child->paint(child, child_g);
+	  ITK_TRACE_END("graphics.create", child->name);
+	  child->vtable->paint(child, child_g);
+	  ITK_TRACE_BEGIN("graphics.free", child->name);
 	  child_g->free(child_g);
+	  ITK_TRACE_END("graphics.free", child->name);
+	  ITK_PROBE(paint_child_return, this->name, child->name);
 	}
     }
   
-  if (this->layout_manager)
-    this->layout_manager->done(this->layout_manager);
+  end_layout(this);
+}
+
+
+/**
+ * The header stored before the elements of `children`, forks share
+ * `children` with their origin until either side modifies it
+ */
+typedef union
+{
+  /**
+   * The number of components using the array
+   */
+  long references;
+  
+  /**
+   * Keeps the elements aligned
+   */
+  void* alignment;
+  
+} shared_header_t;
+
+/**
+ * The header of a shared array
+ */
+#define SHARED_HEADER(array)  (((shared_header_t*)(array)) - 1)
+
+
+/**
+ * Release a reference to `children`, freeing it if it was the last
+ */
+static void release_children(__this__)
+{
+  if (this->children && (--(SHARED_HEADER(this->children)->references) == 0))
+    free(SHARED_HEADER(this->children));
+}
+
+
+/**
+ * Reallocate `children`, giving the component its own copy if it is shared
+ * 
+ * @param  capacity  The new capacity, it must not be less than
+ *                   the number of occupied slots, including holes
+ */
+static void resize_children(__this__, long capacity)
+{
+  shared_header_t* header;
+  size_t size = sizeof(shared_header_t) + capacity * sizeof(itk_component*);
+  long used = this->children_count + this->children_holes;
+  
+  if (this->children == NULL)
+    header = malloc(size);
+  else if (SHARED_HEADER(this->children)->references == 1)
+    header = realloc(SHARED_HEADER(this->children), size);
+  else
+    {
+      header = malloc(size);
+      memcpy(header + 1, this->children, used * sizeof(itk_component*));
+      SHARED_HEADER(this->children)->references--;
+    }
+  
+  header->references = 1;
+  this->children = (itk_component**)(header + 1);
+  this->children_capacity = capacity;
+}
+
+
+/**
+ * Give the component its own copy of `children` if it is shared with a fork
+ */
+static inline void unshare_children(__this__)
+{
+  if (this->children && (SHARED_HEADER(this->children)->references > 1))
+    resize_children(this, this->children_capacity);
+}
+
+
+/**
+ * Halve the capacity of `children` while it is less than a quarter
+ * full, this hysteresis keeps alternating insertions and removals
+ * from reallocating the array every time
+ */
+static void shrink_children(__this__)
+{
+  long used = this->children_count + this->children_holes;
+  long capacity = this->children_capacity;
+  
+  while ((capacity > MINIMUM_CHILDREN_CAPACITY) && (used < capacity / 4))
+    capacity /= 2;
+  
+  if (capacity != this->children_capacity)
+    resize_children(this, capacity);
+}
+
+
+/**
+ * Called when children have been added or removed, so that the
+ * current batch, if any, relayouts and synchronises everything
+ */
+static inline void structure_changed(__this__)
+{
+  itk_component_invalidate_child_hints(this);
+  if (this->update_depth)
+    defer_sync(this, NULL);
+}
+
+
+/**
+ * Make room for more children at the end of `children`,
+ * and make sure `children` is not shared with a fork
+ * 
+ * @param  count  The number of children to make room for
+ */
+static void reserve_children(__this__, long count)
+{
+  long used = this->children_count + this->children_holes;
+  long capacity = this->children_capacity;
+  
+  if (used + count <= capacity)
+    {
+      unshare_children(this);
+      return;
+    }
+  
+  if (this->children_holes)
+    {
+      used = itk_component_compact_children(this)->children_count;
+      capacity = this->children_capacity;
+    }
+  
+  if (capacity < MINIMUM_CHILDREN_CAPACITY)
+    capacity = MINIMUM_CHILDREN_CAPACITY;
+  while (capacity < used + count)
+    capacity *= 2;
+  
+  if (capacity != this->children_capacity)
+    resize_children(this, capacity);
+}
+
+
+/**
+ * Remove the child in a slot of `children`
+ * 
+ * @param  slot  The index of the slot
+ */
+static void remove_slot(__this__, long slot)
+{
+  itk_component* child = *(this->children + slot);
+  long used = this->children_count + this->children_holes;
+  
+  unshare_children(this);
+  
+  if (child->parent == this)
+    child->parent = NULL;
+  
+  *(this->children + slot) = NULL;
+  this->children_count--;
+  
+  if (slot == used - 1)
+    {
+      /* The last slot does not become a hole, nor do holes that end up last */
+      for (used--; used && (*(this->children + used - 1) == NULL); used--)
+	this->children_holes--;
+    }
+  else
+    this->children_holes++;
+  
+  if (this->children_holes > this->children_count)
+    itk_component_compact_children(this);
+  else
+    shrink_children(this);
+  
+  structure_changed(this);
 }
 
 
@@ -190,11 +475,17 @@ static void paint_children(__this__, itk_graphics* g)
  */
 static void add_child(__this__, itk_component* child)
 {
-  if (this->children_count == 0)
-    this->children = malloc(sizeof(itk_component*));
-  else if (this->children_count & -(this->children_count) == this->children_count)
-    this->children = realloc(this->children, this->children_count * 2 * sizeof(itk_component*));
-  *(this->children + this->children_count++) = child;
+  long slot;
+  
+  reserve_children(this, 1);
+  slot = this->children_count + this->children_holes;
+  
+  *(this->children + slot) = child;
+  child->parent = this;
+  child->index = slot;
+  this->children_count++;
+  
+  structure_changed(this);
 }
 
 /**
@@ -204,32 +495,115 @@ static void add_child(__this__, itk_component* child)
  */
 static void remove_child(__this__, itk_component* child)
 {
-  long i;
-  for (i = 0;; i++)
-    if (*(this->children + i) == child)
-      {
-	this->remove_child_by_index(this, i);
+  long i = child->index, n = this->children_count + this->children_holes;
+  
+  /* `index` is only a hint, a child can be shared with a forked container */
+  if ((i < 0) || (i >= n) || (*(this->children + i) != child))
+    for (i = 0; i < n; i++)
+      if (*(this->children + i) == child)
 	break;
-      }
+  
+  if (i < n)
+    remove_slot(this, i);
 }
 
 /**
  * Remove a child component from the component
  * 
+ * If children have been removed with `remove_child` since
+ * `children` was last compacted, it will be compacted first
+ * 
  * @param  child  The index of the child
  */
 static void remove_child_by_index(__this__, long child)
 {
-  long i, n = this->children_count -= 1;
-  for (i = child; i < n; i++)
-    *(this->children + i) = *(this->children + i + 1);
-  if (this->children_count == 0)
+  itk_component_compact_children(this);
+  remove_slot(this, child);
+}
+
+/**
+ * Add multiple child components to the component
+ * 
+ * @param  children  The children
+ * @param  count     The number of elements in `children`
+ */
+static void add_children(__this__, itk_component** children, long count)
+{
+  long i, slot;
+  
+  if (count <= 0)
+    return;
+  
+  reserve_children(this, count);
+  slot = this->children_count + this->children_holes;
+  
+  memcpy(this->children + slot, children, count * sizeof(itk_component*));
+  for (i = 0; i < count; i++)
     {
-      free(this->children);
-      this->children = NULL;
+      (*(children + i))->parent = this;
+      (*(children + i))->index = slot + i;
     }
-  else if (this->children_count & -(this->children_count) == this->children_count)
-    this->children = realloc(this->children, this->children_count * sizeof(itk_component*));
+  this->children_count += count;
+  
+  structure_changed(this);
+}
+
+/**
+ * Remove a range of child components from the component
+ * 
+ * @param  first  The index of the first child to remove
+ * @param  count  The number of children to remove
+ */
+static void remove_children(__this__, long first, long count)
+{
+  long i, n = itk_component_compact_children(this)->children_count;
+  itk_component* child;
+  
+  if (count <= 0)
+    return;
+  
+  unshare_children(this);
+  
+  for (i = first; i < first + count; i++)
+    if ((child = *(this->children + i))->parent == this)
+      child->parent = NULL;
+  
+  memmove(this->children + first, this->children + first + count,
+	  (n - first - count) * sizeof(itk_component*));
+  for (i = first, n -= count; i < n; i++)
+    (*(this->children + i))->index = i;
+  this->children_count = n;
+  
+  shrink_children(this);
+  structure_changed(this);
+}
+
+
+/**
+ * Start a batch of changes, until the matching call to `end_update`
+ * synchronisation of the component and its children is deferred,
+ * and then performed once for everything that was requested
+ * 
+ * Batches can be nested, only the outermost `end_update` synchronises
+ */
+static void begin_update(__this__)
+{
+  this->update_depth++;
+}
+
+/**
+ * End a batch of changes started by `begin_update`
+ */
+static void end_update(__this__)
+{
+  rectangle_t area;
+  
+  if (--(this->update_depth) || (this->update_pending == false))
+    return;
+  
+  area = this->update_area;
+  this->update_pending = false;
+  this->vtable->sync_area(this, area.defined ? &area : NULL);
 }
 
 
@@ -238,8 +612,9 @@ static void remove_child_by_index(__this__, long child)
  */
 void free_component(__this__)
 {
-  if (this->children_count)
-    free(this->children);
+  release_children(this);
+  if (this->child_hints)
+    itk_free_child_hints(this->child_hints);
   if (this->buffer_count)
     free(this->buffers);
   free(this);
@@ -251,15 +626,15 @@ void free_component(__this__)
  */
 void free_everything_component(__this__)
 {
-  long i = 0, n = this->children_count;
+  long i = 0, n = itk_component_compact_children(this)->children_count;
   
   if (this->layout_manager)
-    this->layout_manager->free(this->layout_manager);
+    this->layout_manager->vtable->free(this->layout_manager);
   
   for (; i < n; i++)
-    (*(this->children + i))->free_everything(*(this->children + i));
+    (*(this->children + i))->vtable->free_everything(*(this->children + i));
   
-  this->free(this);
+  this->vtable->free(this);
 }
 
 
@@ -270,26 +645,51 @@ void free_everything_component(__this__)
  * forks, if neccessary, methods, `constraints` and elements
  * in `children`, additionally, `layout_manager` should be
  * forked and `name` should be changed.
+ * 
+ * `children` is not copied, it is shared with the fork
+ * and copied when either component modifies it, so
+ * forking takes constant time
  */
 itk_component* fork_component(__this__)
 {
   itk_component* rc = calloc(1, sizeof(itk_component));
-  *rc = *this;
+  *rc = *itk_component_compact_children(this);
   if (rc->buffer_count && rc->buffers)
     rc->buffers = calloc(rc->buffer_count, sizeof(void*));
-  if (rc->children_count && rc->children)
-    {
-      long i, n = rc->children_count, m = rc->children_count, s = 1;
-      while ((m + 1) & ~m != m + 1)
-	m |= m >> s++;
-      rc->children = malloc((m + 1) * sizeof(void*));
-      for (i = 0; i < n; i++)
-	*(rc->children + i) = *(this->children + i);
-    }
+  if (rc->children)
+    SHARED_HEADER(rc->children)->references++;
+  rc->update_depth = 0;
+  rc->update_pending = false;
+  rc->child_hints = NULL;
   return rc;
 }
 
 
+/**
+ * The methods of the root component class
+ */
+const itk_component_vtable itk_component_class =
+  {
+    .locate_child          = locate_child,
+    .sync                  = sync,
+    .sync_area             = sync_area,
+    .sync_child            = sync_child,
+    .paint                 = paint,
+    .paint_component       = paint_component,
+    .paint_children        = paint_children,
+    .add_child             = add_child,
+    .remove_child          = remove_child,
+    .remove_child_by_index = remove_child_by_index,
+    .add_children          = add_children,
+    .remove_children       = remove_children,
+    .begin_update          = begin_update,
+    .end_update            = end_update,
+    .free                  = free_component,
+    .free_everything       = free_everything_component,
+    .fork                  = fork_component
+  };
+
+
 /**
  * Constructor
  * 
@@ -304,19 +704,156 @@ itk_component* itk_new_component(char* name)
   rc->preferred_size = new_size2(16, 16);
   rc->size = new_size2(16, 16);
   rc->maximum_size = new_size2(UNBOUNDED, UNBOUNDED);
-  rc->locate_child = locate_child;
-  rc->sync = sync;
-  rc->sync_area = sync_area;
-  rc->sync_child = sync_child;
-  rc->paint = paint;
-  rc->paint_component = paint_component;
-  rc->paint_children = paint_children;
-  rc->add_child = add_child;
-  rc->remove_child = remove_child;
-  rc->remove_child_by_index = remove_child_by_index;
-  rc->free = free_component;
-  rc->free_everything = free_everything_component;
-  rc->fork = fork_component;
+  rc->vtable = &itk_component_class;
   return rc;
 }
 
+
+/**
+ * Fill in the methods that a vtable does not set, that is,
+ * are `NULL`, with the methods of another vtable
+ * 
+ * @param  this  The new vtable, with its overriding methods set
+ * @param  base  The vtable to derive from, normally `&itk_component_class`
+ */
+void itk_derive_component_vtable(itk_component_vtable* this, const itk_component_vtable* base)
+{
+#define __(METHOD)  if (this->METHOD == NULL)  this->METHOD = base->METHOD
+  __(locate_child);
+  __(sync);
+  __(sync_area);
+  __(sync_child);
+  __(paint);
+  __(paint_component);
+  __(paint_children);
+  __(add_child);
+  __(remove_child);
+  __(remove_child_by_index);
+  __(add_children);
+  __(remove_children);
+  __(begin_update);
+  __(end_update);
+  __(free);
+  __(free_everything);
+  __(fork);
+#undef __
+}
+
+
+/**
+ * Remove the `NULL` slots left behind in `children` by removed children
+ * 
+ * This must be called before `children` is read, it
+ * takes constant time if nothing needs to be done
+ * 
+ * @param   this  The component
+ * @return        `this`
+ */
+itk_component* itk_component_compact_children(__this__)
+{
+  itk_component* child;
+  long i, j = 0, n;
+  
+  if (this->children_holes == 0)
+    return this;
+  
+  unshare_children(this);
+  n = this->children_count + this->children_holes;
+  for (i = 0; i < n; i++)
+    if ((child = *(this->children + i)))
+      {
+	child->index = j;
+	*(this->children + j++) = child;
+      }
+  
+  this->children_holes = 0;
+  shrink_children(this);
+  return this;
+}
+
+
+/**
+ * Get the layout hints of the children of a component,
+ * rereading them unless they are cached and still valid
+ * 
+ * This compacts `children`
+ * 
+ * @param   this  The component
+ * @return        The children's layout hints
+ */
+itk_child_hints* itk_component_child_hints(__this__)
+{
+  itk_child_hints* hints = this->child_hints;
+  
+  itk_component_compact_children(this);
+  
+  if (hints == NULL)
+    hints = this->child_hints = itk_new_child_hints();
+  if ((hints->valid == false) || (this->cache_child_hints == false))
+    itk_child_hints_update(hints, this);
+  
+  return hints;
+}
+
+
+/**
+ * Mark the cached layout hints of the children of a component as outdated
+ * 
+ * @param  this  The component
+ */
+void itk_component_invalidate_child_hints(__this__)
+{
+  if (this->child_hints)
+    this->child_hints->valid = false;
+}
+
+
+/**
+ * Lay out the children of a component, as painting does, without painting them
+ * 
+ * This compacts `children`
+ * 
+ * @param  rects  Output parameter for the rectangles the children are
+ *                confound in, in the same order as `children`
+ */
+void itk_component_locate_children(__this__, packed_rectangle_t* rects)
+{
+  long i, n = itk_component_compact_children(this)->children_count;
+  
+  begin_layout(this, n);
+  for (i = 0; i < n; i++)
+    *(rects + i) = this->vtable->locate_child(this, *(this->children + i));
+  end_layout(this);
+}
+
+
+/**
+ * Locate a component in the coordinates of its root, the ancestor without a parent
+ * 
+ * @return  The visible part of the component, that is, clipped to its
+ *          ancestors, in the root's coordinates, with zero width or height
+ *          if nothing is visible, not defined if the component or an
+ *          ancestor is hidden or not located
+ */
+packed_rectangle_t itk_component_locate_in_root(__this__)
+{
+  packed_rectangle_t rc = new_packed_rectangle(0, 0, this->size.width, this->size.height);
+  packed_rectangle_t area;
+  
+  for (; this->parent; this = this->parent)
+    {
+      if (this->visible == false)
+	return undefined_packed_rectangle();
+      area = this->parent->vtable->locate_child(this->parent, this);
+      if (packed_rectangle_defined(area) == false)
+	return undefined_packed_rectangle();
+      rc.x += area.x;
+      rc.y += area.y;
+      rc = itk_rectangle_intersection(rc, area);
+    }
+  
+  if (this->visible == false)
+    return undefined_packed_rectangle();
+  return itk_rectangle_intersection(rc, new_packed_rectangle(0, 0, this->size.width, this->size.height));
+}
+
@@ -21,12 +21,154 @@
 
 #include "itktypes.h"
 
+struct _itk_component;
 struct _itk_graphics;
 struct _itk_layout_manager;
+struct _itk_child_hints;
 
 
 #define __this__  struct _itk_component* this
 
+/**
+ * The methods of a kind of component
+ * 
+ * Components of the same kind share one vtable, to override
+ * methods create a new vtable with `itk_derive_component_vtable`
+ */
+typedef struct _itk_component_vtable
+{
+  /**
+   * Locates the positions of the corners of a child
+   * 
+   * @param   child  The child
+   * @return         The rectangle the child is confound in
+   */
+  packed_rectangle_t (*locate_child)(__this__, struct _itk_component* child);
+  
+  
+  /**
+   * Synchronises the graphics
+   */
+  void (*sync)(__this__);
+  
+  /**
+   * Synchronises the graphics
+   * 
+   * @param  area  Area to synchronise, `NULL` for everything
+   */
+  void (*sync_area)(__this__, rectangle_t* area);
+  
+  /**
+   * Synchronises the graphics on a child
+   * 
+   * @param   child  The child
+   * @return         The object with which to paint
+   */
+  struct _itk_graphics* (*sync_child)(__this__, struct _itk_component* child);
+  
+  
+  /**
+   * Repaint the component and its childred
+   * 
+   * @param  g  The object with which to paint
+   */
+  void (*paint)(__this__, struct _itk_graphics* g);
+  
+  /**
+   * Repaint the component
+   * 
+   * @param  g  The object with which to paint
+   */
+  void (*paint_component)(__this__, struct _itk_graphics* g);
+  
+  /**
+   * Repaint the component's children
+   * 
+   * @param  g  The object with which to paint
+   */
+  void (*paint_children)(__this__, struct _itk_graphics* g);
+  
+  
+  /**
+   * Add a child component to the component
+   * 
+   * @param  child  The child
+   */
+  void (*add_child)(__this__, struct _itk_component* child);
+  
+  /**
+   * Remove a child component from the component
+   * 
+   * @param  child  The child
+   */
+  void (*remove_child)(__this__, struct _itk_component* child);
+  
+  /**
+   * Remove a child component from the component
+   * 
+   * If children have been removed with `remove_child` since
+   * `children` was last compacted, it will be compacted first
+   * 
+   * @param  child  The index of the child
+   */
+  void (*remove_child_by_index)(__this__, long child);
+  
+  /**
+   * Add multiple child components to the component
+   * 
+   * @param  children  The children
+   * @param  count     The number of elements in `children`
+   */
+  void (*add_children)(__this__, struct _itk_component** children, long count);
+  
+  /**
+   * Remove a range of child components from the component
+   * 
+   * @param  first  The index of the first child to remove
+   * @param  count  The number of children to remove
+   */
+  void (*remove_children)(__this__, long first, long count);
+  
+  /**
+   * Start a batch of changes, until the matching call to `end_update`
+   * synchronisation of the component and its children is deferred,
+   * and then performed once for everything that was requested
+   * 
+   * Batches can be nested, only the outermost `end_update` synchronises
+   */
+  void (*begin_update)(__this__);
+  
+  /**
+   * End a batch of changes started by `begin_update`
+   */
+  void (*end_update)(__this__);
+  
+  
+  /**
+   * Destructor
+   */
+  void (*free)(__this__);
+  
+  /**
+   * Destructor that also frees the layout manager and children
+   */
+  void (*free_everything)(__this__);
+  
+  /**
+   * Forker
+   * 
+   * This function should be onioned with a function that
+   * forks, if neccessary, `constraints` and elements in
+   * `children`, additionally, `layout_manager` should be
+   * forked and `name` should be changed.
+   * 
+   * `children` is shared with the fork until either is modified
+   */
+  struct _itk_component* (*fork)(__this__);
+  
+} itk_component_vtable;
+
+
 /**
  * The root component class
  */
@@ -79,134 +221,105 @@ typedef struct _itk_component
   
   /**
    * The component's childred
+   * 
+   * Removed children leave `NULL` slots behind, call
+   * `itk_component_compact_children` before reading
+   * 
+   * The array may be shared with forks of the component,
+   * so it must only be modified through the component
    */
   struct _itk_component** children;
   
   /**
-   * Layout constraints
+   * The number of elements `children` has room for
    */
-  void* constraints;
+  long children_capacity;
   
   /**
-   * The component's layout manager
+   * The number of `NULL` slots, left behind by removed
+   * children, in `children` before the last child
    */
-  struct _itk_layout_manager* layout_manager;
+  long children_holes;
   
   /**
-   * The number of off-screen buffers the component uses
-   */
-  int8_t buffer_count;
-  
-  /**
-   * The index of the currently off-screen buffer in use by the component
-   */
-  int8_t buffer_pointer;
-  
-  /**
-   * The component's off-screen buffers
-   */
-  void** buffers;
-  
-  
-  /**
-   * Locates the positions of the corners of a child
-   * 
-   * @param   child  The child
-   * @return         The rectangle the child is confound in
-   */
-  rectangle_t (*locate_child)(__this__, struct _itk_component* child);
-  
-  
-  /**
-   * Synchronises the graphics
+   * The component's slot in its parent's `children`
    */
-  void (*sync)(__this__);
+  long index;
   
   /**
-   * Synchronises the graphics
-   * 
-   * @param  area  Area to synchronise, `NULL` for everything
+   * The number of `begin_update` calls that have not yet been
+   * matched by `end_update`
    */
-  void (*sync_area)(__this__, rectangle_t* area);
+  long update_depth;
   
   /**
-   * Synchronises the graphics on a child
-   * 
-   * @param   child  The child
-   * @return         The object with which to paint
+   * Whether synchronisation has been deferred until `end_update`
    */
-  struct _itk_graphics* (*sync_child)(__this__, struct _itk_component* child);
-  
+  bool_t update_pending;
   
   /**
-   * Repaint the component and its childred
-   * 
-   * @param  g  The object with which to paint
+   * The area whose synchronisation has been deferred until `end_update`,
+   * `update_area.defined` is `false` if everything shall be synchronised
    */
-  void (*paint)(__this__, struct _itk_graphics* g);
+  rectangle_t update_area;
   
   /**
-   * Repaint the component
+   * Whether `child_hints` is kept between layouts, rather than being
+   * reread from the children every time a layout manager needs it,
+   * if not set, the size calculations read the children directly
    * 
-   * @param  g  The object with which to paint
+   * If set, `itk_component_invalidate_child_hints` must be called
+   * when a child's hints are modified, unless the child is synchronised
    */
-  void (*paint_component)(__this__, struct _itk_graphics* g);
+  bool_t cache_child_hints;
   
   /**
-   * Repaint the component's children
-   * 
-   * @param  g  The object with which to paint
+   * The children's layout hints, as parallel arrays, `NULL` until
+   * first requested by `itk_component_child_hints`
    */
-  void (*paint_children)(__this__, struct _itk_graphics* g);
-  
+  struct _itk_child_hints* child_hints;
   
   /**
-   * Add a child component to the component
-   * 
-   * @param  child  The child
+   * Layout constraints
    */
-  void (*add_child)(__this__, struct _itk_component* child);
+  void* constraints;
   
   /**
-   * Remove a child component from the component
-   * 
-   * @param  child  The child
+   * The component's layout manager
    */
-  void (*remove_child)(__this__, struct _itk_component* child);
+  struct _itk_layout_manager* layout_manager;
   
   /**
-   * Remove a child component from the component
-   * 
-   * @param  child  The index of the child
+   * The number of off-screen buffers the component uses
    */
-  void (*remove_child_by_index)(__this__, long child);
-  
+  int8_t buffer_count;
   
   /**
-   * Destructor
+   * The index of the currently off-screen buffer in use by the component
    */
-  void (*free)(__this__);
+  int8_t buffer_pointer;
   
   /**
-   * Destructor that also frees the layout manager and children
+   * The component's off-screen buffers
    */
-  void (*free_everything)(__this__);
+  void** buffers;
   
   /**
-   * Forker
-   * 
-   * This function should be onioned with a function that
-   * forks, if neccessary, methods, `constraints` and elements
-   * in `children`, additionally, `layout_manager` should be
-   * forked and `name` should be changed.
+   * The component's methods, shared with other components of the same kind
    */
-  struct _itk_component* (*fork)(__this__);
+  const itk_component_vtable* vtable;
   
 } itk_component;
 
 #undef __this__
 
 
+/**
+ * The methods of the root component class
+ */
+extern const itk_component_vtable itk_component_class;
+
+
 /**
  * Constructor
  * 
@@ -214,5 +327,65 @@ typedef struct _itk_component
  */
 itk_component* itk_new_component(char* name);
 
+/**
+ * Fill in the methods that a vtable does not set, that is,
+ * are `NULL`, with the methods of another vtable
+ * 
+ * @param  this  The new vtable, with its overriding methods set
+ * @param  base  The vtable to derive from, normally `&itk_component_class`
+ */
+void itk_derive_component_vtable(itk_component_vtable* this, const itk_component_vtable* base);
+
+/**
+ * Remove the `NULL` slots left behind in `children` by removed children
+ * 
+ * This must be called before `children` is read, it
+ * takes constant time if nothing needs to be done
+ * 
+ * @param   this  The component
+ * @return        `this`
+ */
+itk_component* itk_component_compact_children(itk_component* this);
+
+/**
+ * Get the layout hints of the children of a component,
+ * rereading them unless they are cached and still valid
+ * 
+ * This compacts `children`
+ * 
+ * @param   this  The component
+ * @return        The children's layout hints
+ */
+struct _itk_child_hints* itk_component_child_hints(itk_component* this);
+
+/**
+ * Mark the cached layout hints of the children of a component as outdated
+ * 
+ * @param  this  The component
+ */
+void itk_component_invalidate_child_hints(itk_component* this);
+
+/**
+ * Lay out the children of a component, as painting does, without painting them
+ * 
+ * This compacts `children`
+ * 
+ * @param  this   The component
+ * @param  rects  Output parameter for the rectangles the children are
+ *                confound in, in the same order as `children`
+ */
+void itk_component_locate_children(itk_component* this, packed_rectangle_t* rects);
+
+/**
+ * Locate a component in the coordinates of its root, the ancestor without a parent
+ * 
+ * @param   this  The component
+ * @return        The visible part of the component, that is, clipped to its
+ *                ancestors, in the root's coordinates, with zero width or height
+ *                if nothing is visible, not defined if the component or an
+ *                ancestor is hidden or not located
+ */
+packed_rectangle_t itk_component_locate_in_root(itk_component* this);
+
 #endif
 
@@ -0,0 +1,577 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "concurrent_hash_table.h"
+#include "itkmacros.h"
+
+#include <sched.h>
+#include <stdlib.h>
+
+
+#define __this__  itk_concurrent_hash_table* this
+
+/**
+ * Get the first bucket in a bucket array
+ * 
+ * @param  B  The bucket array
+ */
+#define BUCKETS(B)  ((itk_concurrent_hash_entry* _Atomic*)((B) + 1))
+
+/**
+ * Test if a key matches the key in an entry
+ * 
+ * @param  T  The instance of the hash table
+ * @param  E  The entry
+ * @param  K  The key
+ * @param  H  The hash of the key
+ */
+#define TEST_KEY(T, E, K, H) \
+  ((E->key == K) || (T->key_comparator && (E->hash == H) && T->key_comparator(E->key, K)))
+
+
+/**
+ * The reader slot of the thread, shared by all tables, -1 until first used
+ */
+static __thread long reader_slot = -1;
+
+/**
+ * The slot to give the next thread that reads
+ */
+static _Atomic unsigned long next_reader_slot = 0;
+
+
+
+/**
+ * Calculate the hash of a key
+ * 
+ * @param   key  The key to hash
+ * @return       The hash of the key
+ */
+static inline long hash(__this__, void* key)
+{
+  return this->hasher ? this->hasher(key) : (long)key;
+}
+
+
+/**
+ * Spread the bits of a hash so that it can be truncated with a mask,
+ * the identity hash of pointers otherwise leave the lowest bits unused
+ * 
+ * @param   hash  The hash of a key
+ * @return        The spread hash
+ */
+static inline unsigned long spread(long hash)
+{
+  unsigned long h = (unsigned long)hash;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDUL;
+  h ^= h >> 33;
+  return h;
+}
+
+
+/**
+ * Get the writer lock for a key
+ * 
+ * Because the capacity is a power of two no less than the number
+ * of stripes, all keys in a bucket are guarded by the same stripe
+ * 
+ * @param   hash  The hash of the key
+ * @return        The lock
+ */
+static inline pthread_mutex_t* stripe(__this__, long hash)
+{
+  return this->stripes + (spread(hash) & (ITK_CONCURRENT_HASH_STRIPES - 1));
+}
+
+
+/**
+ * Allocate an empty bucket array
+ * 
+ * @param   capacity  The number of buckets, a power of two
+ * @return            The bucket array
+ */
+static itk_concurrent_hash_buckets* new_buckets(long capacity)
+{
+  itk_concurrent_hash_buckets* rc = calloc(1, sizeof(itk_concurrent_hash_buckets) +
+					      capacity * sizeof(itk_concurrent_hash_entry*));
+  rc->capacity = capacity;
+  return rc;
+}
+
+
+/**
+ * Free a bucket array and all entries in it
+ * 
+ * @param  buckets  The bucket array
+ * @param  values   Whether to free all stored values
+ * @param  keys     Whether to free all stored keys
+ */
+static void free_buckets(itk_concurrent_hash_buckets* buckets, bool_t values, bool_t keys)
+{
+  long i = buckets->capacity;
+  itk_concurrent_hash_entry* entry;
+  itk_concurrent_hash_entry* next;
+  
+  while (i)
+    {
+      entry = atomic_load_explicit(BUCKETS(buckets) + --i, memory_order_relaxed);
+      while (entry)
+	{
+	  next = atomic_load_explicit(&(entry->next), memory_order_relaxed);
+	  if (values)
+	    free(atomic_load_explicit(&(entry->value), memory_order_relaxed));
+	  if (keys)
+	    free(entry->key);
+	  free(entry);
+	  entry = next;
+	}
+    }
+  
+  free(buckets);
+}
+
+
+/**
+ * Enter a read-side critical section, during which
+ * no entry or bucket array that can be reached will be freed
+ * 
+ * @return  The token to pass to `read_unlock`
+ */
+static inline int read_lock(__this__)
+{
+  _Atomic long* count;
+  unsigned long epoch;
+  int parity;
+  
+  /* Threads count themselves in different cache lines, so that
+   * readers do not serialise on a shared counter */
+  if (reader_slot < 0)
+    reader_slot = (long)(atomic_fetch_add(&next_reader_slot, 1) & (ITK_CONCURRENT_HASH_READER_SLOTS - 1));
+  count = (this->readers + reader_slot)->count;
+  
+  for (;;)
+    {
+      epoch = atomic_load(&(this->epoch));
+      parity = (int)(epoch & 1);
+      atomic_fetch_add(count + parity, 1);
+      if (atomic_load(&(this->epoch)) == epoch)
+	return parity;
+      atomic_fetch_sub(count + parity, 1);
+    }
+}
+
+
+/**
+ * Leave a read-side critical section
+ * 
+ * Must be called by the thread that called `read_lock`
+ * 
+ * @param  parity  The return value of `read_lock`
+ */
+static inline void read_unlock(__this__, int parity)
+{
+  atomic_fetch_sub_explicit((this->readers + reader_slot)->count + parity, 1, memory_order_release);
+}
+
+
+/**
+ * Wait until all readers that may have seen something that
+ * has been retired have left their critical sections
+ * 
+ * `grace_lock` must be held by the caller
+ */
+static void synchronise(__this__)
+{
+  unsigned long epoch = atomic_fetch_add(&(this->epoch), 1);
+  long i;
+  
+  /* Readers that enter after this point count themselves in the other
+   * parity, and readers that were already counted in this parity were
+   * counted before the flip and must therefore be waited for. A slot's
+   * count in this parity can only rise again briefly, by a reader that
+   * then sees the new epoch and leaves, so each slot is waited for once. */
+  for (i = 0; i < ITK_CONCURRENT_HASH_READER_SLOTS; i++)
+    while (atomic_load((this->readers + i)->count + (epoch & 1)))
+      sched_yield();
+}
+
+
+/**
+ * Queue a removed entry to be freed after the next grace period
+ * 
+ * @param  entry  The entry, it must no longer be reachable from the buckets
+ */
+static void retire_entry(__this__, itk_concurrent_hash_entry* entry)
+{
+  long count;
+  
+  pthread_mutex_lock(&(this->retire_lock));
+  entry->retired = this->retired_entries;
+  this->retired_entries = entry;
+  count = ++(this->retired_count);
+  pthread_mutex_unlock(&(this->retire_lock));
+  
+  if (count >= ITK_CONCURRENT_HASH_RETIRE_BATCH)
+    itk_concurrent_hash_table_reclaim(this);
+}
+
+
+/**
+ * Queue a replaced bucket array, and its entries, to be freed after the next grace period
+ * 
+ * @param  buckets  The bucket array, it must no longer be `this->buckets`
+ */
+static void retire_buckets(__this__, itk_concurrent_hash_buckets* buckets)
+{
+  pthread_mutex_lock(&(this->retire_lock));
+  buckets->retired = this->retired_buckets;
+  this->retired_buckets = buckets;
+  this->retired_count += buckets->capacity;
+  pthread_mutex_unlock(&(this->retire_lock));
+  
+  itk_concurrent_hash_table_reclaim(this);
+}
+
+
+/**
+ * Lock all stripes, this excludes all writers
+ */
+static void lock_all(__this__)
+{
+  long i;
+  for (i = 0; i < ITK_CONCURRENT_HASH_STRIPES; i++)
+    pthread_mutex_lock(this->stripes + i);
+}
+
+
+/**
+ * Unlock all stripes
+ */
+static void unlock_all(__this__)
+{
+  long i = ITK_CONCURRENT_HASH_STRIPES;
+  while (i)
+    pthread_mutex_unlock(this->stripes + --i);
+}
+
+
+/**
+ * Grow the table
+ * 
+ * Readers may still be walking the old buckets, so the entries
+ * are copied rather than relinked, and the old bucket array is
+ * retired together with the old entries
+ */
+static void rehash(__this__)
+{
+  itk_concurrent_hash_buckets* old_buckets;
+  itk_concurrent_hash_buckets* buckets;
+  itk_concurrent_hash_entry* entry;
+  itk_concurrent_hash_entry* copy;
+  long i, index, mask;
+  
+  lock_all(this);
+  
+  old_buckets = atomic_load_explicit(&(this->buckets), memory_order_relaxed);
+  if (atomic_load_explicit(&(this->size), memory_order_relaxed) <= atomic_load(&(this->threshold)))
+    {
+      /* Another writer grew the table first */
+      unlock_all(this);
+      return;
+    }
+  
+  buckets = new_buckets(old_buckets->capacity << 1);
+  mask = buckets->capacity - 1;
+  
+  for (i = 0; i < old_buckets->capacity; i++)
+    {
+      entry = atomic_load_explicit(BUCKETS(old_buckets) + i, memory_order_relaxed);
+      while (entry)
+	{
+	  copy = malloc(sizeof(itk_concurrent_hash_entry));
+	  copy->key = entry->key;
+	  copy->hash = entry->hash;
+	  atomic_init(&(copy->value), atomic_load_explicit(&(entry->value), memory_order_relaxed));
+	  index = (long)(spread(entry->hash) & mask);
+	  atomic_init(&(copy->next), atomic_load_explicit(BUCKETS(buckets) + index, memory_order_relaxed));
+	  atomic_init(BUCKETS(buckets) + index, copy);
+	  entry = atomic_load_explicit(&(entry->next), memory_order_relaxed);
+	}
+    }
+  
+  atomic_store(&(this->threshold), (long)(buckets->capacity * this->load_factor));
+  atomic_store_explicit(&(this->buckets), buckets, memory_order_release);
+  
+  unlock_all(this);
+  retire_buckets(this, old_buckets);
+}
+
+
+/**
+ * Constructor
+ * 
+ * @param  initial_capacity  The initial capacity of the table, rounded up to a power of two
+ * @param  load_factor       The load factor of the table, i.e. when to grow the table
+ */
+itk_concurrent_hash_table* itk_new_concurrent_hash_table_fine_tuned(long initial_capacity, float load_factor)
+{
+  itk_concurrent_hash_table* this = calloc(1, sizeof(itk_concurrent_hash_table));
+  long capacity = ITK_CONCURRENT_HASH_STRIPES, i;
+  
+  while (capacity < initial_capacity)
+    capacity <<= 1;
+  
+  atomic_init(&(this->buckets), new_buckets(capacity));
+  this->load_factor = load_factor;
+  atomic_init(&(this->threshold), (long)(capacity * load_factor));
+  atomic_init(&(this->size), 0);
+  atomic_init(&(this->epoch), 0);
+  
+  this->readers = aligned_alloc(ITK_CONCURRENT_HASH_CACHE_LINE,
+				ITK_CONCURRENT_HASH_READER_SLOTS * sizeof(itk_concurrent_hash_readers));
+  for (i = 0; i < ITK_CONCURRENT_HASH_READER_SLOTS; i++)
+    {
+      atomic_init((this->readers + i)->count + 0, 0);
+      atomic_init((this->readers + i)->count + 1, 0);
+    }
+  
+  for (i = 0; i < ITK_CONCURRENT_HASH_STRIPES; i++)
+    pthread_mutex_init(this->stripes + i, NULL);
+  pthread_mutex_init(&(this->grace_lock), NULL);
+  pthread_mutex_init(&(this->retire_lock), NULL);
+  
+  return this;
+}
+
+
+/**
+ * Destructor
+ * 
+ * No other thread may use the table when it is freed
+ * 
+ * @param  values  Whether to free all stored values
+ * @param  keys    Whether to free all stored keys
+ */
+void itk_free_concurrent_hash_table(__this__, bool_t values, bool_t keys)
+{
+  long i;
+  
+  itk_concurrent_hash_table_reclaim(this);
+  free_buckets(atomic_load(&(this->buckets)), values, keys);
+  
+  for (i = 0; i < ITK_CONCURRENT_HASH_STRIPES; i++)
+    pthread_mutex_destroy(this->stripes + i);
+  pthread_mutex_destroy(&(this->grace_lock));
+  pthread_mutex_destroy(&(this->retire_lock));
+  free(this->readers);
+  free(this);
+}
+
+
+/**
+ * Check whether a key is used in the table, without locking
+ * 
+ * @param   key  The key
+ * @return       Whether the key is used
+ */
+bool_t itk_concurrent_hash_table_contains_key(__this__, void* key)
+{
+  return itk_concurrent_hash_table_get(this, key) != NULL;
+}
+
+
+/**
+ * Look up a value in the table, without locking
+ * 
+ * The returned value remains valid only as long as the
+ * caller makes sure that it is not freed by another thread
+ * 
+ * @param   key    The key associated with the value
+ * @return         The value associated with the key, `NULL` i the key was not used
+ */
+void* itk_concurrent_hash_table_get(__this__, void* key)
+{
+  long key_hash = hash(this, key);
+  int parity = read_lock(this);
+  itk_concurrent_hash_buckets* buckets = atomic_load_explicit(&(this->buckets), memory_order_acquire);
+  long index = (long)(spread(key_hash) & (buckets->capacity - 1));
+  itk_concurrent_hash_entry* entry = atomic_load_explicit(BUCKETS(buckets) + index, memory_order_acquire);
+  void* rc = NULL;
+  
+  while (entry)
+    {
+      if (TEST_KEY(this, entry, key, key_hash))
+	{
+	  rc = atomic_load_explicit(&(entry->value), memory_order_acquire);
+	  break;
+	}
+      entry = atomic_load_explicit(&(entry->next), memory_order_acquire);
+    }
+  
+  read_unlock(this, parity);
+  return rc;
+}
+
+
+/**
+ * Add an entry to the table
+ * 
+ * @param   key    The key of the entry to add
+ * @param   value  The value of the entry to add
+ * @return         The previous value associated with the key, `NULL` i the key was not used
+ */
+void* itk_concurrent_hash_table_put(__this__, void* key, void* value)
+{
+  long key_hash = hash(this, key);
+  pthread_mutex_t* lock = stripe(this, key_hash);
+  itk_concurrent_hash_buckets* buckets;
+  itk_concurrent_hash_entry* _Atomic* bucket;
+  itk_concurrent_hash_entry* entry;
+  void* rc;
+  
+  pthread_mutex_lock(lock);
+  
+  buckets = atomic_load_explicit(&(this->buckets), memory_order_relaxed);
+  bucket = BUCKETS(buckets) + (spread(key_hash) & (buckets->capacity - 1));
+  entry = atomic_load_explicit(bucket, memory_order_relaxed);
+  
+  while (entry)
+    if (TEST_KEY(this, entry, key, key_hash))
+      {
+	rc = atomic_exchange_explicit(&(entry->value), value, memory_order_acq_rel);
+	pthread_mutex_unlock(lock);
+	return rc;
+      }
+    else
+      entry = atomic_load_explicit(&(entry->next), memory_order_relaxed);
+  
+  entry = malloc(sizeof(itk_concurrent_hash_entry));
+  entry->key = key;
+  entry->hash = key_hash;
+  atomic_init(&(entry->value), value);
+  atomic_init(&(entry->next), atomic_load_explicit(bucket, memory_order_relaxed));
+  atomic_store_explicit(bucket, entry, memory_order_release);
+  
+  pthread_mutex_unlock(lock);
+  
+  if (atomic_fetch_add(&(this->size), 1) + 1 > atomic_load(&(this->threshold)))
+    rehash(this);
+  
+  return NULL;
+}
+
+
+/**
+ * Remove an entry in the table
+ * 
+ * @param   key  The key of the entry to remove
+ * @return       The previous value associated with the key, `NULL` i the key was not used
+ */
+void* itk_concurrent_hash_table_remove(__this__, void* key)
+{
+  long key_hash = hash(this, key);
+  pthread_mutex_t* lock = stripe(this, key_hash);
+  itk_concurrent_hash_buckets* buckets;
+  itk_concurrent_hash_entry* _Atomic* link;
+  itk_concurrent_hash_entry* entry;
+  void* rc;
+  
+  pthread_mutex_lock(lock);
+  
+  buckets = atomic_load_explicit(&(this->buckets), memory_order_relaxed);
+  link = BUCKETS(buckets) + (spread(key_hash) & (buckets->capacity - 1));
+  
+  while ((entry = atomic_load_explicit(link, memory_order_relaxed)))
+    {
+      if (TEST_KEY(this, entry, key, key_hash))
+	{
+	  atomic_store_explicit(link, atomic_load_explicit(&(entry->next), memory_order_relaxed),
+				memory_order_release);
+	  atomic_fetch_sub(&(this->size), 1);
+	  rc = atomic_load_explicit(&(entry->value), memory_order_relaxed);
+	  pthread_mutex_unlock(lock);
+	  retire_entry(this, entry);
+	  return rc;
+	}
+      link = &(entry->next);
+    }
+  
+  pthread_mutex_unlock(lock);
+  return NULL;
+}
+
+
+/**
+ * Remove all entries in the table
+ */
+void itk_concurrent_hash_table_clear(__this__)
+{
+  itk_concurrent_hash_buckets* old_buckets;
+  
+  lock_all(this);
+  old_buckets = atomic_load_explicit(&(this->buckets), memory_order_relaxed);
+  atomic_store_explicit(&(this->buckets), new_buckets(old_buckets->capacity), memory_order_release);
+  atomic_store(&(this->size), 0);
+  unlock_all(this);
+  
+  retire_buckets(this, old_buckets);
+}
+
+
+/**
+ * Wait until no reader can see entries that have been removed,
+ * and free them, this is done automatically, but can be called
+ * to release memory earlier
+ */
+void itk_concurrent_hash_table_reclaim(__this__)
+{
+  itk_concurrent_hash_entry* entries;
+  itk_concurrent_hash_entry* entry;
+  itk_concurrent_hash_buckets* buckets;
+  itk_concurrent_hash_buckets* next;
+  
+  pthread_mutex_lock(&(this->grace_lock));
+  
+  pthread_mutex_lock(&(this->retire_lock));
+  entries = this->retired_entries;
+  buckets = this->retired_buckets;
+  this->retired_entries = NULL;
+  this->retired_buckets = NULL;
+  this->retired_count = 0;
+  pthread_mutex_unlock(&(this->retire_lock));
+  
+  if (entries || buckets)
+    synchronise(this);
+  
+  pthread_mutex_unlock(&(this->grace_lock));
+  
+  while ((entry = entries))
+    {
+      entries = entry->retired;
+      free(entry);
+    }
+  
+  while (buckets)
+    {
+      next = buckets->retired;
+      free_buckets(buckets, false, false);
+      buckets = next;
+    }
+}
+
@@ -0,0 +1,306 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_CONCURRENT_HASH_TABLE_H__
+#define __ITK_CONCURRENT_HASH_TABLE_H__
+
+#include "itktypes.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+
+/**
+ * The number of locks writers are spread over, must be a power of two
+ */
+#define ITK_CONCURRENT_HASH_STRIPES  16
+
+/**
+ * The number of removed entries to collect before they are reclaimed
+ */
+#define ITK_CONCURRENT_HASH_RETIRE_BATCH  256
+
+/**
+ * The number of counters readers are spread over, must be a power of two,
+ * threads share counters only if there are more threads than counters
+ */
+#define ITK_CONCURRENT_HASH_READER_SLOTS  64
+
+/**
+ * The size of a cache line, each reader counter is kept in its own
+ */
+#define ITK_CONCURRENT_HASH_CACHE_LINE  64
+
+
+/**
+ * Concurrent hash table entry
+ */
+typedef struct _itk_concurrent_hash_entry
+{
+  /**
+   * A key
+   */
+  void* key;
+  
+  /**
+   * The value associated with the key
+   */
+  void* _Atomic value;
+  
+  /**
+   * The hash value of the key
+   */
+  long hash;
+  
+  /**
+   * The next entry in the bucket
+   */
+  struct _itk_concurrent_hash_entry* _Atomic next;
+  
+  /**
+   * The next entry waiting to be reclaimed, once the entry has been removed
+   */
+  struct _itk_concurrent_hash_entry* retired;
+  
+} itk_concurrent_hash_entry;
+
+
+/**
+ * The number of readers in one slot of a concurrent hash table, padded
+ * to a cache line so that readers in other slots do not contend for it
+ */
+typedef union _itk_concurrent_hash_readers
+{
+  /**
+   * The number of readers that entered in an even and an odd epoch, respectively
+   */
+  _Atomic long count[2];
+  
+  /**
+   * Padding to the size of a cache line
+   */
+  char padding[ITK_CONCURRENT_HASH_CACHE_LINE];
+  
+} itk_concurrent_hash_readers;
+
+
+/**
+ * Bucket array of a concurrent hash table, the buckets
+ * are allocated directly after this header
+ */
+typedef struct _itk_concurrent_hash_buckets
+{
+  /**
+   * The number of buckets, a power of two
+   */
+  long capacity;
+  
+  /**
+   * The next bucket array waiting to be reclaimed, once it has been replaced
+   */
+  struct _itk_concurrent_hash_buckets* retired;
+  
+} itk_concurrent_hash_buckets;
+
+
+/**
+ * Value lookup table based on hash value, that do not support `NULL` keys nor `NULL` values,
+ * and that can be read by any number of threads without locking while other threads write
+ * 
+ * Readers see a consistent snapshot of every bucket, even while the table is grown.
+ * Writers lock one of `ITK_CONCURRENT_HASH_STRIPES` stripes, chosen by the key's hash,
+ * so writers of unrelated keys rarely wait for each other. Removed entries and replaced
+ * bucket arrays are freed once no reader that could have seen them is still reading,
+ * readers count themselves in per-thread slots, so that they do not contend.
+ */
+typedef struct _itk_concurrent_hash_table
+{
+  /**
+   * The current bucket array
+   */
+  itk_concurrent_hash_buckets* _Atomic buckets;
+  
+  /**
+   * When, in the ratio of entries comparied to the capacity, to grow the table
+   */
+  float load_factor;
+  
+  /**
+   * When, in the number of entries, to grow the table
+   */
+  _Atomic long threshold;
+  
+  /**
+   * The number of entries stored in the table
+   */
+  _Atomic long size;
+  
+  /**
+   * Writer locks, a key is guarded by the stripe selected by its hash
+   */
+  pthread_mutex_t stripes[ITK_CONCURRENT_HASH_STRIPES];
+  
+  /**
+   * Incremented at the start of each grace period
+   */
+  _Atomic unsigned long epoch;
+  
+  /**
+   * The number of readers in each slot, a thread always uses the same slot,
+   * aligned to a cache line
+   */
+  itk_concurrent_hash_readers* readers;
+  
+  /**
+   * Serialises grace periods
+   */
+  pthread_mutex_t grace_lock;
+  
+  /**
+   * Guards `retired_entries`, `retired_buckets` and `retired_count`
+   */
+  pthread_mutex_t retire_lock;
+  
+  /**
+   * Removed entries waiting to be reclaimed
+   */
+  itk_concurrent_hash_entry* retired_entries;
+  
+  /**
+   * Replaced bucket arrays, with their entries, waiting to be reclaimed
+   */
+  itk_concurrent_hash_buckets* retired_buckets;
+  
+  /**
+   * The number of items waiting to be reclaimed
+   */
+  long retired_count;
+  
+  /**
+   * Check whether two keys are equal
+   * 
+   * If this function pointer is `NULL`, the identity is used
+   * 
+   * This function may be called from multiple threads at the same time
+   * 
+   * @param   key_a  The first key
+   * @param   key_b  The second key
+   * @return         Whether the keys are equals
+   */
+  bool_t (*key_comparator)(void* key_a, void* key_b);
+  
+  /**
+   * Calculate the hash of a key
+   * 
+   * If this function pointer is `NULL`, the identity hash is used
+   * 
+   * This function may be called from multiple threads at the same time
+   * 
+   * @param   key  The key
+   * @return       The hash of the key
+   */
+  long (*hasher)(void* key);
+  
+} itk_concurrent_hash_table;
+
+
+#define __this__  itk_concurrent_hash_table* this
+
+/**
+ * Constructor
+ * 
+ * @param  initial_capacity  The initial capacity of the table, rounded up to a power of two
+ * @param  load_factor       The load factor of the table, i.e. when to grow the table
+ */
+itk_concurrent_hash_table* itk_new_concurrent_hash_table_fine_tuned(long initial_capacity, float load_factor);
+
+/**
+ * Constructor
+ * 
+ * @param  initial_capacity:long  The initial capacity of the table
+ */
+#define itk_new_concurrent_hash_table_tuned(initial_capacity) itk_new_concurrent_hash_table_fine_tuned(initial_capacity, 0.75)
+
+/**
+ * Constructor
+ */
+#define itk_new_concurrent_hash_table() itk_new_concurrent_hash_table_tuned(16)
+
+/**
+ * Destructor
+ * 
+ * No other thread may use the table when it is freed
+ * 
+ * @param  values  Whether to free all stored values
+ * @param  keys    Whether to free all stored keys
+ */
+void itk_free_concurrent_hash_table(__this__, bool_t values, bool_t keys);
+
+/**
+ * Check whether a key is used in the table, without locking
+ * 
+ * @param   key  The key
+ * @return       Whether the key is used
+ */
+bool_t itk_concurrent_hash_table_contains_key(__this__, void* key);
+
+/**
+ * Look up a value in the table, without locking
+ * 
+ * The returned value remains valid only as long as the
+ * caller makes sure that it is not freed by another thread
+ * 
+ * @param   key    The key associated with the value
+ * @return         The value associated with the key, `NULL` i the key was not used
+ */
+void* itk_concurrent_hash_table_get(__this__, void* key);
+
+/**
+ * Add an entry to the table
+ * 
+ * @param   key    The key of the entry to add
+ * @param   value  The value of the entry to add
+ * @return         The previous value associated with the key, `NULL` i the key was not used
+ */
+void* itk_concurrent_hash_table_put(__this__, void* key, void* value);
+
+/**
+ * Remove an entry in the table
+ * 
+ * @param   key  The key of the entry to remove
+ * @return       The previous value associated with the key, `NULL` i the key was not used
+ */
+void* itk_concurrent_hash_table_remove(__this__, void* key);
+
+/**
+ * Remove all entries in the table
+ */
+void itk_concurrent_hash_table_clear(__this__);
+
+/**
+ * Wait until no reader can see entries that have been removed,
+ * and free them, this is done automatically, but can be called
+ * to release memory earlier
+ */
+void itk_concurrent_hash_table_reclaim(__this__);
+
+#undef __this__
+
+
+#endif
+
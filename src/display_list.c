@@ -0,0 +1,631 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "display_list.h"
+#include "itkmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define DATA(this)  ((itk_recording_graphics_data*)(this->data))
+
+/**
+ * The alignment of arrays in a display list's `data`
+ */
+#define DATA_ALIGNMENT  16
+
+/**
+ * The initial number of operations a display list has room for
+ */
+#define INITIAL_CAPACITY  64
+
+
+
+/**
+ * Append an operation to the display list of a recording graphics context
+ * 
+ * @param   this    The recording graphics context
+ * @param   opcode  The method, `ITK_DISPLAY_*`
+ * @return          The operation, with only `opcode` and `context` set
+ */
+static itk_display_op* append(itk_graphics* this, int8_t opcode)
+{
+  itk_display_list* list = DATA(this)->list;
+  itk_display_op* rc;
+  
+  if (list->count == list->capacity)
+    {
+      list->capacity = list->capacity ? list->capacity << 1 : INITIAL_CAPACITY;
+      list->ops = realloc(list->ops, list->capacity * sizeof(itk_display_op));
+    }
+  
+  rc = list->ops + list->count++;
+  rc->opcode = opcode;
+  rc->context = DATA(this)->context;
+  return rc;
+}
+
+
+/**
+ * Copy an array into the display list of a recording graphics context
+ * 
+ * @param   this   The recording graphics context
+ * @param   array  The array
+ * @param   size   The size of the array, in bytes
+ * @return         The offset of the copy in the display list's `data`
+ */
+static size_t store(itk_graphics* this, const void* array, size_t size)
+{
+  itk_display_list* list = DATA(this)->list;
+  size_t rc = (list->data_size + DATA_ALIGNMENT - 1) & ~(size_t)(DATA_ALIGNMENT - 1);
+  
+  if (rc + size > list->data_capacity)
+    {
+      list->data_capacity = list->data_capacity ? list->data_capacity << 1 : INITIAL_CAPACITY * DATA_ALIGNMENT;
+      while (rc + size > list->data_capacity)
+	list->data_capacity <<= 1;
+      list->data = realloc(list->data, list->data_capacity);
+    }
+  
+  memcpy(list->data + rc, array, size);
+  list->data_size = rc + size;
+  return rc;
+}
+
+
+/**
+ * Create a recording graphics context in the same display list as another
+ * 
+ * @param   this  The recording graphics context
+ * @return        The new graphics context, with the next number in the list
+ */
+static itk_graphics* new_context(itk_graphics* this)
+{
+  itk_graphics* rc = malloc(sizeof(itk_graphics));
+  *rc = *this;
+  rc->data = malloc(sizeof(itk_recording_graphics_data));
+  DATA(rc)->list = DATA(this)->list;
+  DATA(rc)->context = DATA(this)->list->contexts++;
+  return rc;
+}
+
+
+
+#define __this__  itk_graphics* this
+
+/**
+ * Record `create`
+ */
+static itk_graphics* create(__this__, packed_rectangle_t area)
+{
+  itk_graphics* rc = new_context(this);
+  itk_display_op* op = append(this, ITK_DISPLAY_CREATE);
+  op->created = DATA(rc)->context;
+  op->args.packed_area = area;
+  return rc;
+}
+
+
+/**
+ * Record `fork`
+ */
+static itk_graphics* fork_recording(__this__)
+{
+  itk_graphics* rc = new_context(this);
+  itk_display_op* op = append(this, ITK_DISPLAY_FORK);
+  op->created = DATA(rc)->context;
+  return rc;
+}
+
+
+/**
+ * Record `free`
+ */
+static void free_recording(__this__)
+{
+  append(this, ITK_DISPLAY_FREE);
+  free(this->data);
+  free(this);
+}
+
+
+/**
+ * Record `clip`
+ */
+static void clip(__this__, packed_rectangle_t area)
+{
+  append(this, ITK_DISPLAY_CLIP)->args.packed_area = area;
+}
+
+
+/**
+ * Record `clip_region`
+ */
+static void clip_region(__this__, const itk_region* region)
+{
+  size_t offset = store(this, region->rectangles, region->count * sizeof(packed_rectangle_t));
+  itk_display_op* op = append(this, ITK_DISPLAY_CLIP_REGION);
+  op->count = region->count;
+  op->offset = offset;
+}
+
+
+/**
+ * Record `translate`
+ */
+static void translate(__this__, packed_position2_t offset)
+{
+  append(this, ITK_DISPLAY_TRANSLATE)->args.offset = offset;
+}
+
+
+/**
+ * Record `set_colour`
+ */
+static void set_colour(__this__, colour_t colour)
+{
+  append(this, ITK_DISPLAY_SET_COLOUR)->args.colour = colour;
+}
+
+
+/**
+ * Record `set_background_colour`
+ */
+static void set_background_colour(__this__, colour_t colour)
+{
+  append(this, ITK_DISPLAY_SET_BACKGROUND_COLOUR)->args.colour = colour;
+}
+
+
+/**
+ * Record a method whose only argument is an area
+ * 
+ * @param  opcode  The method, `ITK_DISPLAY_*`
+ * @param  area    The area
+ */
+static void record_area(__this__, int8_t opcode, rectangle_t area)
+{
+  append(this, opcode)->args.shape.area = area;
+}
+
+
+/**
+ * Record a method whose arguments are an area, a start angle and an arc angle
+ * 
+ * @param  opcode       The method, `ITK_DISPLAY_*`
+ * @param  area         The area
+ * @param  start_angle  The start angle
+ * @param  arc_angles   The arc angle
+ */
+static void record_arc(__this__, int8_t opcode, rectangle_t area, float start_angle, float arc_angles)
+{
+  itk_display_op* op = append(this, opcode);
+  op->args.shape.area = area;
+  op->args.shape.start_angle = start_angle;
+  op->args.shape.arc_angles = arc_angles;
+}
+
+
+/**
+ * Record a method whose arguments are an array of points and how they are to be interpreted
+ * 
+ * @param  opcode       The method, `ITK_DISPLAY_*`
+ * @param  points       The points
+ * @param  point_count  The number of elements in `points`
+ * @param  shape        The shape of the polygon
+ * @param  mode         Whether the points are absolute or relative to the previous one
+ */
+static void record_points(__this__, int8_t opcode, position2_t* points, long point_count, int8_t shape, int8_t mode)
+{
+  size_t offset = store(this, points, point_count * sizeof(position2_t));
+  itk_display_op* op = append(this, opcode);
+  op->count = point_count;
+  op->offset = offset;
+  op->shape = shape;
+  op->mode = mode;
+}
+
+
+/**
+ * Record `fill_rectangle`
+ */
+static void fill_rectangle(__this__, rectangle_t area)
+{
+  record_area(this, ITK_DISPLAY_FILL_RECTANGLE, area);
+}
+
+
+/**
+ * Record `fill_rounded_rectangle`
+ */
+static void fill_rounded_rectangle(__this__, rectangle_t area, size2_t arc_size)
+{
+  itk_display_op* op = append(this, ITK_DISPLAY_FILL_ROUNDED_RECTANGLE);
+  op->args.shape.area = area;
+  op->args.shape.arc_size = arc_size;
+}
+
+
+/**
+ * Record `fill_polygon`
+ */
+static void fill_polygon(__this__, position2_t* points, long point_count, int8_t shape, int8_t mode)
+{
+  record_points(this, ITK_DISPLAY_FILL_POLYGON, points, point_count, shape, mode);
+}
+
+
+/**
+ * Record `fill_pie`
+ */
+static void fill_pie(__this__, rectangle_t area, float start_angle, float arc_angles)
+{
+  record_arc(this, ITK_DISPLAY_FILL_PIE, area, start_angle, arc_angles);
+}
+
+
+/**
+ * Record `fill_chord`
+ */
+static void fill_chord(__this__, rectangle_t area, float start_angle, float arc_angles)
+{
+  record_arc(this, ITK_DISPLAY_FILL_CHORD, area, start_angle, arc_angles);
+}
+
+
+/**
+ * Record `fill_oval`
+ */
+static void fill_oval(__this__, rectangle_t area)
+{
+  record_area(this, ITK_DISPLAY_FILL_OVAL, area);
+}
+
+
+/**
+ * Record `draw_rectangle`
+ */
+static void draw_rectangle(__this__, rectangle_t area)
+{
+  record_area(this, ITK_DISPLAY_DRAW_RECTANGLE, area);
+}
+
+
+/**
+ * Record `draw_rounded_rectangle`
+ */
+static void draw_rounded_rectangle(__this__, rectangle_t area, size2_t arc_size)
+{
+  itk_display_op* op = append(this, ITK_DISPLAY_DRAW_ROUNDED_RECTANGLE);
+  op->args.shape.area = area;
+  op->args.shape.arc_size = arc_size;
+}
+
+
+/**
+ * Record `draw_polygon`
+ */
+static void draw_polygon(__this__, position2_t* points, long point_count, int8_t mode)
+{
+  record_points(this, ITK_DISPLAY_DRAW_POLYGON, points, point_count, ITK_GRAPHICS_SHAPE_COMPLEX, mode);
+}
+
+
+/**
+ * Record `draw_polyline`
+ */
+static void draw_polyline(__this__, position2_t* points, long point_count, int8_t mode)
+{
+  record_points(this, ITK_DISPLAY_DRAW_POLYLINE, points, point_count, ITK_GRAPHICS_SHAPE_COMPLEX, mode);
+}
+
+
+/**
+ * Record `draw_line`
+ */
+static void draw_line(__this__, position2_t start, position2_t end)
+{
+  itk_display_op* op = append(this, ITK_DISPLAY_DRAW_LINE);
+  op->args.points.start = start;
+  op->args.points.end = end;
+}
+
+
+/**
+ * Record `draw_lines`
+ */
+static void draw_lines(__this__, position2_t* starts, position2_t* ends, long lines)
+{
+  size_t offset = store(this, starts, lines * sizeof(position2_t));
+  size_t offset2 = store(this, ends, lines * sizeof(position2_t));
+  itk_display_op* op = append(this, ITK_DISPLAY_DRAW_LINES);
+  op->count = lines;
+  op->offset = offset;
+  op->offset2 = offset2;
+}
+
+
+/**
+ * Record `draw_arc`
+ */
+static void draw_arc(__this__, rectangle_t area, float start_angle, float arc_angles)
+{
+  record_arc(this, ITK_DISPLAY_DRAW_ARC, area, start_angle, arc_angles);
+}
+
+
+/**
+ * Record `draw_oval`
+ */
+static void draw_oval(__this__, rectangle_t area)
+{
+  record_area(this, ITK_DISPLAY_DRAW_OVAL, area);
+}
+
+
+/**
+ * Record `draw_point`
+ */
+static void draw_point(__this__, position2_t point)
+{
+  append(this, ITK_DISPLAY_DRAW_POINT)->args.points.start = point;
+}
+
+
+/**
+ * Record `draw_string`
+ */
+static void draw_string(__this__, position2_t point, char* text)
+{
+  size_t offset = store(this, text, strlen(text) + 1);
+  itk_display_op* op = append(this, ITK_DISPLAY_DRAW_STRING);
+  op->args.points.start = point;
+  op->offset = offset;
+}
+
+#undef __this__
+
+
+
+#define __this__  itk_display_list* this
+
+/**
+ * Constructor
+ * 
+ * @return  An empty display list
+ */
+itk_display_list* itk_new_display_list(void)
+{
+  return calloc(1, sizeof(itk_display_list));
+}
+
+
+/**
+ * Destructor
+ */
+void itk_free_display_list(__this__)
+{
+  free(this->ops);
+  free(this->data);
+  free(this);
+}
+
+
+/**
+ * Remove all operations from a display list, keeping its memory for reuse
+ * 
+ * Graphics contexts recording the list must not be used afterwards
+ */
+void itk_display_list_clear(__this__)
+{
+  this->count = 0;
+  this->data_size = 0;
+  this->contexts = 0;
+}
+
+
+/**
+ * Draw the operations of a display list
+ * 
+ * @param  target  The graphics context to draw with, in place of the context the
+ *                 list was recorded with, contexts forked from it are freed by the
+ *                 end even if they were not freed while recording, `target` is not
+ */
+void itk_display_list_replay(const __this__, itk_graphics* target)
+{
+  itk_graphics** contexts = calloc(this->contexts > 0 ? this->contexts : 1, sizeof(itk_graphics*));
+  itk_display_op* op = this->ops;
+  itk_display_op* end = this->ops + this->count;
+  itk_graphics* g;
+  itk_region region;
+  long i;
+  
+  *contexts = target;
+  
+#define POINTS(OFFSET)  ((position2_t*)(this->data + (OFFSET)))
+  
+  for (; op != end; op++)
+    {
+      g = *(contexts + op->context);
+      switch (op->opcode)
+	{
+	case ITK_DISPLAY_CREATE:
+	  *(contexts + op->created) = g->create(g, op->args.packed_area);
+	  break;
+	  
+	case ITK_DISPLAY_FORK:
+	  *(contexts + op->created) = g->fork(g);
+	  break;
+	  
+	case ITK_DISPLAY_FREE:
+	  if (op->context)
+	    {
+	      g->free(g);
+	      *(contexts + op->context) = NULL;
+	    }
+	  break;
+	  
+	case ITK_DISPLAY_CLIP:
+	  g->clip(g, op->args.packed_area);
+	  break;
+	  
+	case ITK_DISPLAY_CLIP_REGION:
+	  /* The rectangles are already banded, so they can be used as they are */
+	  region.count = region.capacity = op->count;
+	  region.rectangles = (packed_rectangle_t*)(this->data + op->offset);
+	  g->clip_region(g, &region);
+	  break;
+	  
+	case ITK_DISPLAY_TRANSLATE:
+	  g->translate(g, op->args.offset);
+	  break;
+	  
+	case ITK_DISPLAY_SET_COLOUR:
+	  g->set_colour(g, op->args.colour);
+	  break;
+	  
+	case ITK_DISPLAY_SET_BACKGROUND_COLOUR:
+	  g->set_background_colour(g, op->args.colour);
+	  break;
+	  
+	case ITK_DISPLAY_FILL_RECTANGLE:
+	  g->fill_rectangle(g, op->args.shape.area);
+	  break;
+	  
+	case ITK_DISPLAY_FILL_ROUNDED_RECTANGLE:
+	  g->fill_rounded_rectangle(g, op->args.shape.area, op->args.shape.arc_size);
+	  break;
+	  
+	case ITK_DISPLAY_FILL_POLYGON:
+	  g->fill_polygon(g, POINTS(op->offset), op->count, op->shape, op->mode);
+	  break;
+	  
+	case ITK_DISPLAY_FILL_PIE:
+	  g->fill_pie(g, op->args.shape.area, op->args.shape.start_angle, op->args.shape.arc_angles);
+	  break;
+	  
+	case ITK_DISPLAY_FILL_CHORD:
+	  g->fill_chord(g, op->args.shape.area, op->args.shape.start_angle, op->args.shape.arc_angles);
+	  break;
+	  
+	case ITK_DISPLAY_FILL_OVAL:
+	  g->fill_oval(g, op->args.shape.area);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_RECTANGLE:
+	  g->draw_rectangle(g, op->args.shape.area);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_ROUNDED_RECTANGLE:
+	  g->draw_rounded_rectangle(g, op->args.shape.area, op->args.shape.arc_size);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_POLYGON:
+	  g->draw_polygon(g, POINTS(op->offset), op->count, op->mode);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_POLYLINE:
+	  g->draw_polyline(g, POINTS(op->offset), op->count, op->mode);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_LINE:
+	  g->draw_line(g, op->args.points.start, op->args.points.end);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_LINES:
+	  g->draw_lines(g, POINTS(op->offset), POINTS(op->offset2), op->count);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_ARC:
+	  g->draw_arc(g, op->args.shape.area, op->args.shape.start_angle, op->args.shape.arc_angles);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_OVAL:
+	  g->draw_oval(g, op->args.shape.area);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_POINT:
+	  g->draw_point(g, op->args.points.start);
+	  break;
+	  
+	case ITK_DISPLAY_DRAW_STRING:
+	  g->draw_string(g, op->args.points.start, this->data + op->offset);
+	  break;
+	}
+    }
+  
+#undef POINTS
+  
+  /* Contexts the painter forgot to free would otherwise leak on every replay */
+  for (i = 1; i < this->contexts; i++)
+    if (*(contexts + i))
+      (*(contexts + i))->free(*(contexts + i));
+  free(contexts);
+}
+
+
+/**
+ * Create a graphics context that records, rather than draws, into a display list
+ * 
+ * It has no clip area or origin of its own, those are set
+ * by the graphics context the list is replayed with
+ * 
+ * @param   list  The display list, it should be empty
+ * @return        The graphics context, number 0 in the list
+ */
+itk_graphics* itk_new_recording_graphics(itk_display_list* list)
+{
+  itk_graphics* rc = calloc(1, sizeof(itk_graphics));
+  itk_recording_graphics_data* data = rc->data = malloc(sizeof(itk_recording_graphics_data));
+  
+  /* Every method is recorded as it is called, deriving methods from
+   * others would lose the target's native implementations of them */
+#define __(FUNC)  rc->FUNC = FUNC
+  __(create);
+  __(clip);
+  __(clip_region);
+  __(translate);
+  __(set_colour);
+  __(set_background_colour);
+  __(fill_rectangle);
+  __(fill_rounded_rectangle);
+  __(fill_polygon);
+  __(fill_pie);
+  __(fill_chord);
+  __(fill_oval);
+  __(draw_rectangle);
+  __(draw_rounded_rectangle);
+  __(draw_polygon);
+  __(draw_polyline);
+  __(draw_line);
+  __(draw_lines);
+  __(draw_arc);
+  __(draw_oval);
+  __(draw_point);
+  __(draw_string);
+#undef __
+  
+  rc->free = free_recording;
+  rc->fork = fork_recording;
+  
+  data->list = list;
+  data->context = list->contexts++;
+  return rc;
+}
+
@@ -0,0 +1,269 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_DISPLAY_LIST_H__
+#define __ITK_DISPLAY_LIST_H__
+
+#include "graphics.h"
+#include "region.h"
+
+#include <stddef.h>
+
+
+/**
+ * Operation codes of display list operations, one per method of `itk_graphics`
+ */
+#define ITK_DISPLAY_CREATE                  0
+#define ITK_DISPLAY_FORK                    1
+#define ITK_DISPLAY_FREE                    2
+#define ITK_DISPLAY_CLIP                    3
+#define ITK_DISPLAY_CLIP_REGION             4
+#define ITK_DISPLAY_TRANSLATE               5
+#define ITK_DISPLAY_SET_COLOUR              6
+#define ITK_DISPLAY_SET_BACKGROUND_COLOUR   7
+#define ITK_DISPLAY_FILL_RECTANGLE          8
+#define ITK_DISPLAY_FILL_ROUNDED_RECTANGLE  9
+#define ITK_DISPLAY_FILL_POLYGON            10
+#define ITK_DISPLAY_FILL_PIE                11
+#define ITK_DISPLAY_FILL_CHORD              12
+#define ITK_DISPLAY_FILL_OVAL               13
+#define ITK_DISPLAY_DRAW_RECTANGLE          14
+#define ITK_DISPLAY_DRAW_ROUNDED_RECTANGLE  15
+#define ITK_DISPLAY_DRAW_POLYGON            16
+#define ITK_DISPLAY_DRAW_POLYLINE           17
+#define ITK_DISPLAY_DRAW_LINE               18
+#define ITK_DISPLAY_DRAW_LINES              19
+#define ITK_DISPLAY_DRAW_ARC                20
+#define ITK_DISPLAY_DRAW_OVAL               21
+#define ITK_DISPLAY_DRAW_POINT              22
+#define ITK_DISPLAY_DRAW_STRING             23
+
+
+
+/**
+ * A recorded call to a method of a graphics context
+ * 
+ * Arrays and strings are stored in the display list's
+ * `data`, and are referred to by their offsets in it,
+ * so that `data` can be reallocated while recording
+ */
+typedef struct _itk_display_op
+{
+  /**
+   * The method, `ITK_DISPLAY_*`
+   */
+  int8_t opcode;
+  
+  /**
+   * The shape of a polygon, `ITK_GRAPHICS_SHAPE_*`
+   */
+  int8_t shape;
+  
+  /**
+   * Whether the points are absolute or relative, `ITK_GRAPHICS_MODE_*`
+   */
+  int8_t mode;
+  
+  /**
+   * The graphics context the method was called on, contexts are numbered
+   * in the order they were created, 0 is the one the list was recorded with
+   */
+  int32_t context;
+  
+  /**
+   * The graphics context created by `create` and `fork`
+   */
+  int32_t created;
+  
+  /**
+   * The number of points, lines or clip rectangles
+   */
+  long count;
+  
+  /**
+   * The offset of the points, the lines' start points, the clip
+   * rectangles or the string, in the display list's `data`
+   */
+  size_t offset;
+  
+  /**
+   * The offset of the lines' end points in the display list's `data`
+   */
+  size_t offset2;
+  
+  /**
+   * The arguments that are not arrays
+   */
+  union
+  {
+    /**
+     * The area of `create` and `clip`
+     */
+    packed_rectangle_t packed_area;
+    
+    /**
+     * The offset of `translate`
+     */
+    packed_position2_t offset;
+    
+    /**
+     * The colour of `set_colour` and `set_background_colour`
+     */
+    colour_t colour;
+    
+    /**
+     * The area of rectangles, ovals and arcs, and
+     * the arc size and angles where applicable
+     */
+    struct
+    {
+      rectangle_t area;
+      size2_t arc_size;
+      float start_angle;
+      float arc_angles;
+    } shape;
+    
+    /**
+     * The points of `draw_line`, `draw_point` and `draw_string`
+     */
+    struct
+    {
+      position2_t start;
+      position2_t end;
+    } points;
+    
+  } args;
+  
+} itk_display_op;
+
+
+/**
+ * A frame recorded as graphics operations, so that it can be drawn later,
+ * by another thread, without access to the components that painted it
+ */
+typedef struct _itk_display_list
+{
+  /**
+   * The number of recorded operations
+   */
+  long count;
+  
+  /**
+   * The number of operations `ops` has room for
+   */
+  long capacity;
+  
+  /**
+   * The recorded operations, in order
+   */
+  itk_display_op* ops;
+  
+  /**
+   * The arrays and strings of the operations
+   */
+  char* data;
+  
+  /**
+   * The number of used bytes in `data`
+   */
+  size_t data_size;
+  
+  /**
+   * The number of bytes `data` has room for
+   */
+  size_t data_capacity;
+  
+  /**
+   * The number of graphics contexts that have been created while recording,
+   * including the one the list was recorded with
+   */
+  int32_t contexts;
+  
+  /**
+   * The next list in a queue of lists, may be used by the owner of the list
+   */
+  struct _itk_display_list* next;
+  
+} itk_display_list;
+
+
+/**
+ * Internal use data for recording graphics context
+ */
+typedef struct _itk_recording_graphics_data
+{
+  /**
+   * The display list that is being recorded
+   */
+  itk_display_list* list;
+  
+  /**
+   * The number of the graphics context in the display list
+   */
+  int32_t context;
+  
+} itk_recording_graphics_data;
+
+
+/**
+ * Constructor
+ * 
+ * @return  An empty display list
+ */
+itk_display_list* itk_new_display_list(void);
+
+/**
+ * Destructor
+ * 
+ * @param  this  The display list
+ */
+void itk_free_display_list(itk_display_list* this);
+
+/**
+ * Remove all operations from a display list, keeping its memory for reuse
+ * 
+ * Graphics contexts recording the list must not be used afterwards
+ * 
+ * @param  this  The display list
+ */
+void itk_display_list_clear(itk_display_list* this);
+
+/**
+ * Draw the operations of a display list
+ * 
+ * @param  this    The display list
+ * @param  target  The graphics context to draw with, in place of the context the
+ *                 list was recorded with, contexts forked from it are freed by the
+ *                 end even if they were not freed while recording, `target` is not
+ */
+void itk_display_list_replay(const itk_display_list* this, itk_graphics* target);
+
+/**
+ * Create a graphics context that records, rather than draws, into a display list
+ * 
+ * It has no clip area or origin of its own, those are set
+ * by the graphics context the list is replayed with
+ * 
+ * @param   list  The display list, it should be empty
+ * @return        The graphics context, number 0 in the list
+ */
+itk_graphics* itk_new_recording_graphics(itk_display_list* list);
+
+
+#endif
+
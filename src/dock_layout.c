@@ -18,6 +18,7 @@
  */
 #include "dock_layout.h"
 #include "hash_table.h"
+#include "child_hints.h"
 #include "itkmacros.h"
 
 #include <stdio.h>
@@ -27,8 +28,10 @@
 
 #define __this__  itk_layout_manager* this
 
-#define CONTAINER(layout)  *((void**)(layout->data) + 0)
-#define PREPARED(layout)   *((void**)(layout->data) + 1)
+#define CONTAINER_(layout)  *((void**)(layout->data) + 0)
+#define PREPARED(layout)    *((void**)(layout->data) + 1)
+#define CONTAINER(layout)   itk_component_compact_children(CONTAINER_(layout))
+#define HINTS(layout)       itk_component_child_hints(CONTAINER_(layout))
 #define MIN(a, b)          ((a) < (b) ? (a) : (b))
 #define MAX(a, b)          ((a) > (b) ? (a) : (b))
 
@@ -61,27 +64,39 @@ rectangle_t* nonzero(position_t x, position_t y, dimension_t width, dimension_t
 static void prepare_(__this__, char mode)
 {
   itk_hash_table* prepared = PREPARED(this) = itk_new_hash_table();
-  itk_component* container = CONTAINER(this);
+  itk_child_hints* hints = HINTS(this);
+  itk_component* container = CONTAINER_(this);
   
   position_t x = 0, y = 0;
   dimension_t w = container->size.width;
   dimension_t h = container->size.height;
   
-  long children_count = container->children_count;
+  long children_count = hints->count;
   itk_component** children = container->children;
   long children_ptr = 0;
   
+  dimension_t* child_widths =
+    mode == 1 ? hints->minimum_width :
+    mode == 2 ? hints->maximum_width :
+		hints->preferred_width;
+  dimension_t* child_heights =
+    mode == 1 ? hints->minimum_height :
+    mode == 2 ? hints->maximum_height :
+		hints->preferred_height;
+  
   long yeild_left_head   = 0, yeild_left_tail   = 0;
   long yeild_top_head    = 0, yeild_top_tail    = 0;
   long yeild_right_head  = 0, yeild_right_tail  = 0;
   long yeild_bottom_head = 0, yeild_bottom_tail = 0;
   
   itk_component** yeilds       = alloca(4 * children_count * sizeof(itk_component*));
-  itk_component** yeild_left   = yeilds      + children_count;
+  itk_component** yeild_left   = yeilds;
   itk_component** yeild_top    = yeild_left  + children_count;
   itk_component** yeild_right  = yeild_top   + children_count;
   itk_component** yeild_bottom = yeild_right + children_count;
   
+  itk_hash_table_reserve(prepared, children_count);
+  
   if (mode)
     w = h = (1 << (sizeof(dimension_t) / sizeof(int8_t) - 1)) - 1;
   
@@ -110,11 +125,12 @@ static void prepare_(__this__, char mode)
 		    P -= y##PERP;					\
 		}							\
 	  }								\
-	itk_hash_table_put(prepared, child, HORZ ? nonzero(PUT, P, _, S) : nonzero(P, PUT, S, _)); \
+	r = HORZ ? nonzero(PUT, P, _, S) : nonzero(P, PUT, S, _);	\
+	itk_hash_table_put(prepared, child, r);				\
 	if (IS_LOW)							\
 	  AXIS += _;							\
 	SAME -= _;							\
-	if (r->defined && !strcmp(constraints, #EDGE))			\
+	if (r->defined && strcmp(constraints, #EDGE))			\
 	  {								\
 	    long n = strstr(constraints, " ") - constraints;		\
 	    char* FIRST##_ = alloca((n + 1) * sizeof(char));		\
@@ -137,17 +153,13 @@ static void prepare_(__this__, char mode)
   for (; children_ptr < children_count; children_ptr++)
     {
       itk_component* child = *(children + children_ptr);
-      char* constraints = child->constraints;
+      char* constraints = *(hints->constraints + children_ptr);
+      bool_t visible = *(hints->visible + children_ptr);
       rectangle_t* r;
-      if (child->visible && constraints)
+      if (visible && constraints)
 	{
-	  size2_t child_size =
-	    mode == 0 ? child->preferred_size :
-	    mode == 1 ? child->minimum_size   :
-	    mode == 2 ? child->maximum_size   :
-			child->preferred_size;
-	  dimension_t child_width  = child_size.width;
-	  dimension_t child_height = child_size.height;
+	  dimension_t child_width  = *(child_widths  + children_ptr);
+	  dimension_t child_height = *(child_heights + children_ptr);
 	  
 	  if ((child_width | child_height) < 0)
 	    {
@@ -178,14 +190,14 @@ static void prepare_(__this__, char mode)
 	      }
 	  }
 	}
-      else if (child->visible)
+      else if (visible)
 	{
 	  itk_hash_table_put(prepared, child, nonzero(x, y, w, h)); /* contraint == "center" */
 	  w = h = 0;
 	}
       else
 	{
-	  r = malloc(sizeof(position_t));
+	  r = malloc(sizeof(rectangle_t));
 	  r->defined = false;
 	  itk_hash_table_put(prepared, child, r);
 	}
@@ -220,28 +232,25 @@ static void done(__this__)
  * @param   child  The child, to the component using the layout manager, of interest
  * @return         The rectangle the child is confound in
  */
-static rectangle_t locate(__this__, itk_component* child)
+static packed_rectangle_t locate(__this__, itk_component* child)
 {
+  packed_rectangle_t rc = undefined_packed_rectangle();
   rectangle_t* r;
   bool_t p = PREPARED(this) == NULL;
   
   if (p)
-    this->prepare(this);
+    this->vtable->prepare(this);
   
   if ((r = itk_hash_table_get(PREPARED(this), child)))
-    child->size = new_size2(r->width, r->height);
+    {
+      child->size = new_size2(r->width, r->height);
+      rc = pack_rectangle(*r);
+    }
   
   if (p)
-    this->done(this);
+    this->vtable->done(this);
   
-  if (r)
-    return *r;
-  else
-    {
-      rectangle_t rc;
-      rc.defined = false;
-      return rc;
-    }
+  return rc;
 }
 
 
@@ -254,7 +263,7 @@ static rectangle_t locate(__this__, itk_component* child)
     dimension_t w, h;						\
 								\
     if (PREPARED(this) == NULL)					\
-      this->done(this);						\
+      this->vtable->done(this);					\
     prepare_(this, MODE);					\
     {								\
       itk_hash_table* prepared = PREPARED(this);		\
@@ -305,7 +314,7 @@ static rectangle_t locate(__this__, itk_component* child)
 	      }							\
 	}							\
     }								\
-    this->done(this);						\
+    this->vtable->done(this);					\
 								\
     w = lw + cw + rw;						\
     h = th + ch + bh;						\
@@ -360,11 +369,25 @@ static void free_dock_layout(__this__)
   itk_hash_table* hash_table = PREPARED(this);
   if (hash_table)
     itk_free_hash_table(hash_table, true, false);
-  free(this->data);
   free(this);
 }
 
 
+/**
+ * The methods of dock layout managers
+ */
+static const itk_layout_manager_vtable dock_layout_vtable =
+  {
+    .prepare        = prepare,
+    .done           = done,
+    .locate         = locate,
+    .minimum_size   = minimum_size,
+    .preferred_size = preferred_size,
+    .maximum_size   = maximum_size,
+    .free           = free_dock_layout
+  };
+
+
 /**
  * Constructor
  * 
@@ -382,16 +405,10 @@ static void free_dock_layout(__this__)
  */
 itk_layout_manager* itk_new_dock_layout(itk_component* container)
 {
-  itk_layout_manager* rc = malloc(sizeof(itk_layout_manager));
-  rc->data = malloc(2 * sizeof(void*));
-  rc->prepare = prepare;
-  rc->done = done;
-  rc->locate = locate;
-  rc->minimum_size = minimum_size;
-  rc->preferred_size = preferred_size;
-  rc->maximum_size = maximum_size;
-  rc->free = free_dock_layout;
-  CONTAINER(rc) = container;
+  itk_layout_manager* rc = malloc(sizeof(itk_layout_manager) + 2 * sizeof(void*));
+  rc->vtable = &dock_layout_vtable;
+  rc->data = (void**)(rc + 1);
+  CONTAINER_(rc) = container;
   PREPARED(rc) = NULL;
   return rc;
 }
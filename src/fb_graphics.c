@@ -0,0 +1,701 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fb_graphics.h"
+#include "geometry.h"
+#include "itkmacros.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+
+
+#define DATA(this)  ((itk_fb_graphics_data*)(this->data))
+#define FB(this)    (DATA(this)->framebuffer)
+
+#define MIN(a, b)  ((a) < (b) ? (a) : (b))
+#define MAX(a, b)  ((a) > (b) ? (a) : (b))
+
+/**
+ * The maximum number of line segments an arc is approximated with
+ */
+#define MAXIMUM_ARC_SEGMENTS  512
+
+
+
+/**
+ * Allocate the back buffer of a framebuffer and copy the front buffer into it
+ * 
+ * @param   this  The framebuffer, with `front` and its dimensions set
+ * @return        `this`
+ */
+static itk_framebuffer* init_framebuffer(itk_framebuffer* this)
+{
+  long y;
+  
+  this->back = malloc((long)(this->width) * this->height * sizeof(uint32_t));
+  this->damage = itk_new_region();
+  itk_metrics_add(ITK_METRIC_BUFFER_BYTES, (long)(this->width) * this->height * sizeof(uint32_t));
+  
+  for (y = 0; y < this->height; y++)
+    memcpy(this->back + y * this->width, (char*)(this->front) + y * this->stride,
+	   this->width * sizeof(uint32_t));
+  
+  return this;
+}
+
+
+/**
+ * Create a framebuffer in memory provided by the caller
+ * 
+ * @param   pixels  The front buffer, its current content is kept
+ * @param   width   The width of the framebuffer, in pixels
+ * @param   height  The height of the framebuffer, in pixels
+ * @param   stride  The number of bytes between the starts of two rows
+ * @return          The framebuffer
+ */
+itk_framebuffer* itk_new_memory_framebuffer(void* pixels, dimension_t width, dimension_t height, long stride)
+{
+  itk_framebuffer* rc = calloc(1, sizeof(itk_framebuffer));
+  rc->front = pixels;
+  rc->width = width;
+  rc->height = height;
+  rc->stride = stride;
+  rc->fd = -1;
+  return init_framebuffer(rc);
+}
+
+
+/**
+ * Open a framebuffer device, only 32 bits per pixel is supported
+ * 
+ * @param   device  The pathname of the device, `NULL` for `$FRAMEBUFFER`,
+ *                  or `/dev/fb0` if it is not set
+ * @return          The framebuffer, `NULL` on error, in which case `errno` is set
+ */
+itk_framebuffer* itk_open_framebuffer(const char* device)
+{
+  struct fb_var_screeninfo var;
+  struct fb_fix_screeninfo fix;
+  itk_framebuffer* rc;
+  void* map;
+  int fd, saved_errno;
+  
+  if (device == NULL)
+    device = getenv("FRAMEBUFFER");
+  if ((device == NULL) || (*device == '\0'))
+    device = "/dev/fb0";
+  
+  fd = open(device, O_RDWR | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+  
+  if (ioctl(fd, FBIOGET_VSCREENINFO, &var) || ioctl(fd, FBIOGET_FSCREENINFO, &fix))
+    goto fail;
+  if (var.bits_per_pixel != 32)
+    {
+      errno = ENOTSUP;
+      goto fail;
+    }
+  
+  map = mmap(NULL, fix.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+    goto fail;
+  
+  rc = calloc(1, sizeof(itk_framebuffer));
+  rc->front = (uint32_t*)((char*)map + var.yoffset * fix.line_length + var.xoffset * sizeof(uint32_t));
+  rc->width = var.xres;
+  rc->height = var.yres;
+  rc->stride = fix.line_length;
+  rc->fd = fd;
+  rc->map = map;
+  rc->map_size = fix.smem_len;
+  return init_framebuffer(rc);
+  
+ fail:
+  saved_errno = errno;
+  close(fd);
+  errno = saved_errno;
+  return NULL;
+}
+
+
+/**
+ * Destructor, this does not free the memory of memory framebuffers
+ * 
+ * @param  this  The framebuffer
+ */
+void itk_free_framebuffer(itk_framebuffer* this)
+{
+  if (this->map)
+    munmap(this->map, this->map_size);
+  if (this->fd >= 0)
+    close(this->fd);
+  itk_free_region(this->damage);
+  itk_metrics_add(ITK_METRIC_BUFFER_BYTES, -(long)(this->width) * this->height * (long)sizeof(uint32_t));
+  free(this->back);
+  free(this);
+}
+
+
+/**
+ * Mark an area of the back buffer as drawn on
+ * 
+ * @param  this  The framebuffer
+ * @param  area  The area
+ */
+void itk_framebuffer_damage(itk_framebuffer* this, packed_rectangle_t area)
+{
+  area = itk_rectangle_intersection(area, new_packed_rectangle(0, 0, this->width, this->height));
+  if (itk_rectangle_is_empty(area) == false)
+    itk_region_add_rectangle(this->damage, area);
+}
+
+
+/**
+ * Copy the area that has been drawn on since the
+ * last call from the back buffer to the front buffer
+ * 
+ * @param   this  The framebuffer
+ * @return        The number of pixels that were copied
+ */
+long itk_framebuffer_present(itk_framebuffer* this)
+{
+  packed_rectangle_t* r;
+  long i, y, rc = 0;
+  uint64_t now;
+  
+  ITK_TRACE_BEGIN("framebuffer.present", NULL);
+  
+  /* The rectangles of a region do not overlap, so no pixel is copied twice */
+  for (i = 0; i < this->damage->count; i++)
+    {
+      r = this->damage->rectangles + i;
+      for (y = r->y; y < r->y + r->height; y++)
+	memcpy((char*)(this->front) + y * this->stride + r->x * sizeof(uint32_t),
+	       this->back + y * this->width + r->x,
+	       r->width * sizeof(uint32_t));
+      rc += (long)(r->width) * r->height;
+    }
+  
+  itk_region_clear(this->damage);
+  
+  now = itk_metrics_now();
+  if (this->last_present)
+    itk_metrics_record(ITK_METRIC_FRAME_INTERVAL, now - this->last_present);
+  this->last_present = now;
+  itk_metrics_add(ITK_METRIC_FRAMES, 1);
+  
+  ITK_TRACE_END("framebuffer.present", NULL);
+  return rc;
+}
+
+
+
+#define __this__  itk_graphics* this
+
+
+/**
+ * Mark an area, in framebuffer coordinates, as drawn on
+ * 
+ * @param  area  The area, it does not have to be inside the clip area
+ */
+static void damage(__this__, packed_rectangle_t area)
+{
+  area = itk_rectangle_intersection(area, itk_region_bounds(DATA(this)->clip_region));
+  if (itk_rectangle_is_empty(area) == false)
+    itk_region_add_rectangle(FB(this)->damage, area);
+}
+
+
+/**
+ * Paint the part of an area, in framebuffer coordinates, that is inside the
+ * clip area, the caller is responsible for marking the area as drawn on
+ * 
+ * @param  area  The area
+ */
+static void fill_block(__this__, packed_rectangle_t area)
+{
+  itk_region* clip = DATA(this)->clip_region;
+  argb_colour_t colour = DATA(this)->colour;
+  packed_rectangle_t r;
+  uint32_t* pixel;
+  long i, x, y, c;
+  
+  if (colour.c.alpha == 0)
+    return;
+  
+  for (i = 0; i < clip->count; i++)
+    {
+      if ((clip->rectangles + i)->y >= area.y + area.height)
+	break;
+      r = itk_rectangle_intersection(*(clip->rectangles + i), area);
+      if (itk_rectangle_is_empty(r))
+	continue;
+      
+      for (y = r.y; y < r.y + r.height; y++)
+	{
+	  pixel = FB(this)->back + y * FB(this)->width + r.x;
+	  if (colour.c.alpha == 255)
+	    for (x = 0; x < r.width; x++)
+	      *(pixel + x) = colour.value;
+	  else
+	    for (x = 0; x < r.width; x++)
+	      {
+		argb_colour_t p = { .value = *(pixel + x) };
+		for (c = 0; c < 3; c++)
+		  p.by_index[c] = (colour.by_index[c] * colour.c.alpha +
+				   p.by_index[c] * (255 - colour.c.alpha) + 127) / 255;
+		*(pixel + x) = p.value;
+	      }
+	}
+    }
+}
+
+
+/**
+ * Convert points to absolute framebuffer coordinates
+ * 
+ * @param  out          Output array for the points
+ * @param  points       The points
+ * @param  point_count  The number of elements in `points`
+ * @param  mode         Whether the points are absolute or relative to the previous one
+ */
+static void to_framebuffer(__this__, position2_t* out, position2_t* points, long point_count, int8_t mode)
+{
+  position_t x = DATA(this)->origin.x, y = DATA(this)->origin.y;
+  long i;
+  
+  for (i = 0; i < point_count; i++)
+    {
+      if ((mode == ITK_GRAPHICS_MODE_RELATIVE) && i)
+	{
+	  (out + i)->x = (out + i - 1)->x + (points + i)->x;
+	  (out + i)->y = (out + i - 1)->y + (points + i)->y;
+	}
+      else
+	{
+	  (out + i)->x = x + (points + i)->x;
+	  (out + i)->y = y + (points + i)->y;
+	}
+    }
+}
+
+
+/**
+ * Calculate the smallest rectangle that contains points
+ * 
+ * @param   points       The points
+ * @param   point_count  The number of elements in `points`, must be positive
+ * @return               The bounding box, including the pixels at the points
+ */
+static packed_rectangle_t bounds(position2_t* points, long point_count)
+{
+  position_t x1 = points->x, y1 = points->y, x2 = x1, y2 = y1;
+  long i;
+  
+  for (i = 1; i < point_count; i++)
+    {
+      x1 = MIN(x1, (points + i)->x);
+      y1 = MIN(y1, (points + i)->y);
+      x2 = MAX(x2, (points + i)->x);
+      y2 = MAX(y2, (points + i)->y);
+    }
+  
+  return new_packed_rectangle(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+}
+
+
+/**
+ * Draw a line segment, in framebuffer coordinates, with Bresenham's algorithm
+ * 
+ * @param  start  The start point of the line segment
+ * @param  end    The end point of the line segment
+ */
+static void line(__this__, position2_t start, position2_t end)
+{
+  long dx = labs((long)(end.x) - start.x), dy = -labs((long)(end.y) - start.y);
+  long sx = start.x < end.x ? 1 : -1, sy = start.y < end.y ? 1 : -1;
+  long error = dx + dy, x = start.x, y = start.y, e2;
+  
+  for (;;)
+    {
+      fill_block(this, new_packed_rectangle(x, y, 1, 1));
+      if ((x == end.x) && (y == end.y))
+	break;
+      e2 = 2 * error;
+      if (e2 >= dy)
+	error += dy, x += sx;
+      if (e2 <= dx)
+	error += dx, y += sy;
+    }
+}
+
+
+/**
+ * Approximate an arc with points, with as many segments as can be told apart at its size
+ * 
+ * @param   points       Output array for the points, with room for `MAXIMUM_ARC_SEGMENTS + 1` points
+ * @param   area         The rectangle the sliced circles is scribed into
+ * @param   start_angle  The start of the arc, the number of degrees, anti-clockwise
+ *                       from the three-o'clock position.
+ * @param   arc_angles   The number of degrees between the arc start and arc end.
+ * @return               The number of points
+ */
+static long arc_points(position2_t* points, rectangle_t area, float start_angle, float arc_angles)
+{
+  long segments = MIN((long)(area.width) + area.height + 1, MAXIMUM_ARC_SEGMENTS);
+  return itk_graphics_arc_points(points, area, start_angle, arc_angles, segments);
+}
+
+
+/**
+ * Clip the affected area
+ * 
+ * @param  area  The new only area is affected by usage of this
+ *               graphics context. The effective area is the
+ *               intersection area and the old clip area.
+ */
+static void clip(__this__, packed_rectangle_t area)
+{
+  if (packed_rectangle_defined(area))
+    {
+      area.x += DATA(this)->origin.x;
+      area.y += DATA(this)->origin.y;
+    }
+  itk_region_intersect_rectangle(DATA(this)->clip_region, area);
+}
+
+
+/**
+ * Clip the affected area to a region
+ * 
+ * @param  region  The new only area is affected by usage of this
+ *                 graphics context. The effective area is the
+ *                 intersection of the region and the old clip area.
+ */
+static void clip_region(__this__, const itk_region* region)
+{
+  itk_region* translated = itk_new_region();
+  itk_region_copy(translated, region);
+  itk_region_translate(translated, DATA(this)->origin);
+  itk_region_intersect(DATA(this)->clip_region, translated);
+  itk_free_region(translated);
+}
+
+
+/**
+ * Translate origin to `offset`
+ * 
+ * @param  offset  The new position of the old origin
+ */
+static void translate(__this__, packed_position2_t offset)
+{
+  DATA(this)->origin.x -= offset.x;
+  DATA(this)->origin.y -= offset.y;
+}
+
+
+/**
+ * Set this graphics context's current drawing colour
+ */
+static void set_colour(__this__, colour_t colour)
+{
+  if (colour.defined)
+    DATA(this)->colour = colour.argb_colour;
+}
+
+
+/**
+ * Set this graphics context's current background colour
+ */
+static void set_background_colour(__this__, colour_t colour)
+{
+  if (colour.defined)
+    DATA(this)->background_colour = colour.argb_colour;
+}
+
+
+/**
+ * Draw a solid rectangle
+ * 
+ * @param  area  The rectangle to draw
+ */
+static void fill_rectangle(__this__, rectangle_t area)
+{
+  packed_rectangle_t r = pack_rectangle(area);
+  r.x += DATA(this)->origin.x;
+  r.y += DATA(this)->origin.y;
+  fill_block(this, r);
+  damage(this, r);
+}
+
+
+/**
+ * Draw an automatically closed solid polygon, with the even-odd rule
+ * 
+ * @param  points       Array of points from which the polygon is constructed
+ * @param  point_count  The number of elements in `points`
+ * @param  shape        The shape of the polygon, this is used to improve performance
+ * @param  mode         Whether the points are absolute or relative to the previous one
+ */
+static void fill_polygon(__this__, position2_t* points, long point_count, int8_t shape, int8_t mode)
+{
+  position2_t* p = alloca(point_count * sizeof(position2_t));
+  float* crossings = alloca(point_count * sizeof(float));
+  packed_rectangle_t box;
+  long i, j, k, n, y;
+  float t, sy;
+  
+  (void) shape;
+  
+  if (point_count < 3)
+    return;
+  
+  to_framebuffer(this, p, points, point_count, mode);
+  box = bounds(p, point_count);
+  
+  for (y = box.y; y < box.y + box.height; y++)
+    {
+      /* Sample at the centre of the pixels, and find where the edges cross the row */
+      sy = y + 0.5f;
+      for (i = 0, j = point_count - 1, n = 0; i < point_count; j = i++)
+	if (((p + i)->y <= sy) != ((p + j)->y <= sy))
+	  {
+	    t = (sy - (p + i)->y) / ((p + j)->y - (p + i)->y);
+	    t = (p + i)->x + t * ((p + j)->x - (p + i)->x);
+	    for (k = n++; (k > 0) && (*(crossings + k - 1) > t); k--)
+	      *(crossings + k) = *(crossings + k - 1);
+	    *(crossings + k) = t;
+	  }
+      
+      for (k = 0; k + 1 < n; k += 2)
+	{
+	  position_t x1 = (position_t)ceilf(*(crossings + k) - 0.5f);
+	  position_t x2 = (position_t)ceilf(*(crossings + k + 1) - 0.5f);
+	  if (x1 < x2)
+	    fill_block(this, new_packed_rectangle(x1, y, x2 - x1, 1));
+	}
+    }
+  
+  damage(this, box);
+}
+
+
+/**
+ * Draw solid pie slice
+ * 
+ * @param  area         The rectangle the sliced circles is scribed into
+ * @param  start_angle  The start of the arc, the number of degrees, anti-clockwise
+ *                      from the three-o'clock position.
+ * @param  arc_angles   The number of degrees between the arc start and arc end.
+ *                      The magnitude if this value is truncated to 360. If it is
+ *                      negative, the arc is drawn clockwise, otherwise it is drawn
+ *                      anti-clockwise.
+ */
+static void fill_pie(__this__, rectangle_t area, float start_angle, float arc_angles)
+{
+  position2_t* points = alloca((MAXIMUM_ARC_SEGMENTS + 2) * sizeof(position2_t));
+  long n = arc_points(points, area, start_angle, arc_angles);
+  
+  if (fabsf(arc_angles) < 360.f)
+    {
+      (points + n)->x = area.x + area.width / 2;
+      (points + n)->y = area.y + area.height / 2;
+      n++;
+    }
+  this->fill_polygon(this, points, n, ITK_GRAPHICS_SHAPE_COMPLEX, ITK_GRAPHICS_MODE_ABSOLUTE);
+}
+
+
+/**
+ * Draw solid arc chord
+ * 
+ * @param  area         The rectangle the sliced circles is scribed into
+ * @param  start_angle  The start of the arc, the number of degrees, anti-clockwise
+ *                      from the three-o'clock position.
+ * @param  arc_angles   The number of degrees between the arc start and arc end.
+ *                      The magnitude if this value is truncated to 360. If it is
+ *                      negative, the arc is drawn clockwise, otherwise it is drawn
+ *                      anti-clockwise.
+ */
+static void fill_chord(__this__, rectangle_t area, float start_angle, float arc_angles)
+{
+  position2_t* points = alloca((MAXIMUM_ARC_SEGMENTS + 1) * sizeof(position2_t));
+  long n = arc_points(points, area, start_angle, arc_angles);
+  this->fill_polygon(this, points, n, ITK_GRAPHICS_SHAPE_CONVEX, ITK_GRAPHICS_MODE_ABSOLUTE);
+}
+
+
+/**
+ * Draw a polyline, an unclosed polygon
+ * 
+ * @param  points       Array of points from which the polygline is constructed
+ * @param  point_count  The number of elements in `points`, if 1, then a point is drawn
+ * @param  mode         Whether the points are absolute or relative to the previous one
+ */
+static void draw_polyline(__this__, position2_t* points, long point_count, int8_t mode)
+{
+  position2_t* p = alloca(point_count * sizeof(position2_t));
+  long i;
+  
+  if (point_count < 1)
+    return;
+  
+  to_framebuffer(this, p, points, point_count, mode);
+  
+  if (point_count == 1)
+    fill_block(this, new_packed_rectangle(p->x, p->y, 1, 1));
+  for (i = 1; i < point_count; i++)
+    line(this, *(p + i - 1), *(p + i));
+  
+  damage(this, bounds(p, point_count));
+}
+
+
+/**
+ * Draw many line segments
+ * 
+ * @param  starts  The start point of each line segment
+ * @param  ends    The end point of each line segment
+ * @param  lines   The number of line segments to draw
+ */
+static void draw_lines(__this__, position2_t* starts, position2_t* ends, long lines)
+{
+  position2_t* p = alloca(2 * sizeof(position2_t));
+  long i;
+  
+  for (i = 0; i < lines; i++)
+    {
+      to_framebuffer(this, p + 0, starts + i, 1, ITK_GRAPHICS_MODE_ABSOLUTE);
+      to_framebuffer(this, p + 1, ends + i, 1, ITK_GRAPHICS_MODE_ABSOLUTE);
+      line(this, *(p + 0), *(p + 1));
+      damage(this, bounds(p, 2));
+    }
+}
+
+
+/**
+ * Draw an arc
+ * 
+ * @param  area         The rectangle the sliced circles is scribed into
+ * @param  start_angle  The start of the arc, the number of degrees, anti-clockwise
+ *                      from the three-o'clock position.
+ * @param  arc_angles   The number of degrees between the arc start and arc end.
+ *                      The magnitude if this value is truncated to 360. If it is
+ *                      negative, the arc is drawn clockwise, otherwise it is drawn
+ *                      anti-clockwise.
+ */
+static void draw_arc(__this__, rectangle_t area, float start_angle, float arc_angles)
+{
+  position2_t* points = alloca((MAXIMUM_ARC_SEGMENTS + 1) * sizeof(position2_t));
+  long n = arc_points(points, area, start_angle, arc_angles);
+  draw_polyline(this, points, n, ITK_GRAPHICS_MODE_ABSOLUTE);
+}
+
+
+/**
+ * Draw a string, this is not supported as framebuffers have no fonts,
+ * nothing is drawn, text must be drawn with a graphics context that
+ * has fonts, such as the one of `x_graphics.h`
+ * 
+ * @param  point  The position of the left end of the baseline, unused
+ * @param  text   The text, unused
+ */
+static void draw_string(__this__, position2_t point, char* text)
+{
+  (void) this;
+  (void) point;
+  (void) text;
+}
+
+
+/**
+ * Destructor
+ */
+static void free_fbgc(__this__)
+{
+  itk_free_region(DATA(this)->clip_region);
+  free(this->data);
+  free(this);
+}
+
+
+/**
+ * Create a duplicate of this graphics context
+ */
+static itk_graphics* fork_fbgc(__this__)
+{
+  itk_graphics* rc = malloc(sizeof(itk_graphics));
+  *rc = *this;
+  rc->data = malloc(sizeof(itk_fb_graphics_data));
+  *(DATA(rc)) = *(DATA(this));
+  DATA(rc)->clip_region = itk_new_region();
+  itk_region_copy(DATA(rc)->clip_region, DATA(this)->clip_region);
+  return rc;
+}
+
+
+/**
+ * Constructor
+ * 
+ * @param  framebuffer  The framebuffer to draw on
+ */
+itk_graphics* itk_new_fb_graphics(itk_framebuffer* framebuffer)
+{
+  itk_graphics* rc = calloc(1, sizeof(itk_graphics));
+  itk_fb_graphics_data* data = rc->data = malloc(sizeof(itk_fb_graphics_data));
+  
+#define __(FUNC)  rc->FUNC = FUNC
+  __(clip);
+  __(clip_region);
+  __(translate);
+  __(set_colour);
+  __(set_background_colour);
+  __(fill_rectangle);
+  __(fill_polygon);
+  __(fill_pie);
+  __(fill_chord);
+  __(draw_polyline);
+  __(draw_lines);
+  __(draw_arc);
+  __(draw_string);
+#undef __
+  
+  rc->free = free_fbgc;
+  rc->fork = fork_fbgc;
+  
+  data->framebuffer = framebuffer;
+  data->clip_region = itk_new_region();
+  itk_region_set_rectangle(data->clip_region, new_packed_rectangle(0, 0, framebuffer->width, framebuffer->height));
+  data->origin = new_packed_position2(0, 0);
+  data->colour.value = 0xFF000000;
+  data->background_colour.value = 0xFFFFFFFF;
+  
+  itk_graphics_derive_methods(rc);
+  return rc;
+}
+
@@ -0,0 +1,180 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_FB_GRAPHICS_H__
+#define __ITK_FB_GRAPHICS_H__
+
+#include "graphics.h"
+#include "region.h"
+
+
+/**
+ * A linear framebuffer with 32-bit pixels in the same format as
+ * `argb_colour_t.value`, either a framebuffer device or memory
+ * provided by the caller
+ * 
+ * Graphics contexts draw into an off-screen buffer, the back buffer,
+ * and `itk_framebuffer_present` emulates a page flip by copying the
+ * area that has been drawn on since the last present to the front
+ * buffer, so the screen never shows a partially drawn frame
+ */
+typedef struct _itk_framebuffer
+{
+  /**
+   * The visible pixels
+   */
+  uint32_t* front;
+  
+  /**
+   * The off-screen buffer that graphics contexts draw into,
+   * its rows are `width` pixels long
+   */
+  uint32_t* back;
+  
+  /**
+   * The width of the framebuffer, in pixels
+   */
+  dimension_t width;
+  
+  /**
+   * The height of the framebuffer, in pixels
+   */
+  dimension_t height;
+  
+  /**
+   * The number of bytes between the starts of two rows in `front`
+   */
+  long stride;
+  
+  /**
+   * The area of the back buffer that has been drawn
+   * on and not yet been copied to the front buffer
+   */
+  itk_region* damage;
+  
+  /**
+   * The file descriptor of the framebuffer device, -1 if `front` is memory
+   */
+  int fd;
+  
+  /**
+   * The address of the device's memory mapping, `NULL` if `front` is memory
+   */
+  void* map;
+  
+  /**
+   * The size of the device's memory mapping
+   */
+  long map_size;
+  
+  /**
+   * When `itk_framebuffer_present` was last called, 0 if never
+   */
+  uint64_t last_present;
+  
+} itk_framebuffer;
+
+
+/**
+ * Internal use data for framebuffer graphics context
+ */
+typedef struct _itk_fb_graphics_data
+{
+  /**
+   * The framebuffer that is being drawn on
+   */
+  itk_framebuffer* framebuffer;
+  
+  /**
+   * The current clip area, in framebuffer coordinates
+   */
+  itk_region* clip_region;
+  
+  /**
+   * The position of the origin in the framebuffer
+   */
+  packed_position2_t origin;
+  
+  /**
+   * The current drawing colour
+   */
+  argb_colour_t colour;
+  
+  /**
+   * The current background colour
+   */
+  argb_colour_t background_colour;
+  
+} itk_fb_graphics_data;
+
+
+/**
+ * Create a framebuffer in memory provided by the caller
+ * 
+ * @param   pixels  The front buffer, its current content is kept
+ * @param   width   The width of the framebuffer, in pixels
+ * @param   height  The height of the framebuffer, in pixels
+ * @param   stride  The number of bytes between the starts of two rows
+ * @return          The framebuffer
+ */
+itk_framebuffer* itk_new_memory_framebuffer(void* pixels, dimension_t width, dimension_t height, long stride);
+
+/**
+ * Open a framebuffer device, only 32 bits per pixel is supported
+ * 
+ * @param   device  The pathname of the device, `NULL` for `$FRAMEBUFFER`,
+ *                  or `/dev/fb0` if it is not set
+ * @return          The framebuffer, `NULL` on error, in which case `errno` is set
+ */
+itk_framebuffer* itk_open_framebuffer(const char* device);
+
+/**
+ * Destructor, this does not free the memory of memory framebuffers
+ * 
+ * @param  this  The framebuffer
+ */
+void itk_free_framebuffer(itk_framebuffer* this);
+
+/**
+ * Mark an area of the back buffer as drawn on
+ * 
+ * @param  this  The framebuffer
+ * @param  area  The area
+ */
+void itk_framebuffer_damage(itk_framebuffer* this, packed_rectangle_t area);
+
+/**
+ * Copy the area that has been drawn on since the
+ * last call from the back buffer to the front buffer
+ * 
+ * @param   this  The framebuffer
+ * @return        The number of pixels that were copied
+ */
+long itk_framebuffer_present(itk_framebuffer* this);
+
+
+/**
+ * Constructor
+ * 
+ * @param  framebuffer  The framebuffer to draw on
+ */
+itk_graphics* itk_new_fb_graphics(itk_framebuffer* framebuffer);
+
+
+#endif
+
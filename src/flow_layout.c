@@ -18,6 +18,7 @@
  */
 #include "flow_layout.h"
 #include "hash_table.h"
+#include "child_hints.h"
 #include "itkmacros.h"
 
 #include <stdlib.h>
@@ -30,10 +31,11 @@
 #define GAP_(layout)        *((void**)(layout->data) + 2)
 #define ALIGN_(layout)      *((void**)(layout->data) + 3)
 
-#define CONTAINER(layout)   ((itk_component*)(CONTAINER_(layout)))
+#define CONTAINER(layout)   itk_component_compact_children(CONTAINER_(layout))
+#define HINTS(layout)       itk_component_child_hints(CONTAINER_(layout))
 #define PREPARED(layout)    ((itk_hash_table*)(PREPARED_(layout)))
-#define HGAP(layout)        *((dimension_t*)(GAP_(layout) + 0))
-#define VGAP(layout)        *((dimension_t*)(GAP_(layout) + 1))
+#define HGAP(layout)        *((dimension_t*)(GAP_(layout)) + 0)
+#define VGAP(layout)        *((dimension_t*)(GAP_(layout)) + 1)
 #define ALIGN(layout)       *((int8_t*)(ALIGN_(layout)))
 
 
@@ -43,10 +45,15 @@
 static void prepare(__this__)
 {
   itk_hash_table* prepared = PREPARED_(this) = itk_new_hash_table();
-  itk_component* container = CONTAINER(this);
+  itk_child_hints* hints = HINTS(this);
+  itk_component* container = CONTAINER_(this);
   itk_component** children = container->children;
-  long n = container->children_count, line_n = 0;
-  itk_component** line_c = alloca(n * sizeof(itk_component*));
+  dimension_t* preferred_width = hints->preferred_width;
+  dimension_t* preferred_height = hints->preferred_height;
+  dimension_t* maximum_width = hints->maximum_width;
+  dimension_t* maximum_height = hints->maximum_height;
+  long n = hints->count, line_n = 0;
+  long* line_i = alloca(n * sizeof(long));
   rectangle_t** line_r = alloca(n * sizeof(rectangle_t*));
   int8_t align = ALIGN(this);
   size2_t bounds = container->size;
@@ -57,6 +64,7 @@ static void prepare(__this__)
   rectangle_t* r;
   long i, j;
   
+  itk_hash_table_reserve(prepared, n);
   bounds.width += hgap;
   
   for (i = 0; i < n; i++)
@@ -64,23 +72,26 @@ static void prepare(__this__)
     add_components:
       child = *(children + i);
       r = malloc(sizeof(rectangle_t));
-      if ((r->defined = child->visible) == false)
+      if ((r->defined = *(hints->visible + i)) == false)
 	{
 	  itk_hash_table_put(prepared, child, r);
 	  continue;
 	}
-      if (width + child->preferred_size.width + hgap <= bounds.width)
+      if ((width + *(preferred_width + i) + hgap <= bounds.width) || (line_n == 0))
 	{
 	  r->y = y;
 	  r->x = (position_t)width;
-	  r->height = child->preferred_size.height;
-	  r->width = child->preferred_size.width;
-	  width += child->preferred_size.width + hgap;
-	  itk_hash_table_put(prepared, *(line_c + line_n) = child, *(line_r + line_n) = r);
-	  line_n++;
+	  r->height = *(preferred_height + i);
+	  r->width = *(preferred_width + i);
+	  width += *(preferred_width + i) + hgap;
+	  itk_hash_table_put(prepared, child, *(line_r + line_n) = r);
+	  *(line_i + line_n++) = i;
 	}
       else
-	goto align_components;
+	{
+	  free(r);
+	  goto align_components;
+	}
     }
   
  align_components:
@@ -97,7 +108,7 @@ static void prepare(__this__)
 	    dimension_t max;
 	    for (j = 0; j < line_n; j++)
 	      {
-		max = (*(line_c + j))->maximum_size.width;
+		max = *(maximum_width + *(line_i + j));
 		if ((max < 0) || ((*(line_r + j))->width < max))
 		  can_grow++;
 	      }
@@ -109,7 +120,7 @@ static void prepare(__this__)
 		for (j = 0; (j < line_n) && width; j++)
 		  {
 		    now = (*(line_r + j))->width;
-		    max = (*(line_c + j))->maximum_size.width;
+		    max = *(maximum_width + *(line_i + j));
 		    if ((max < 0) || (now < max))
 		      {
 			dimension_t soon = now + increment;
@@ -143,8 +154,8 @@ static void prepare(__this__)
     if (height < (*(line_r + j))->height)
       height = (*(line_r + j))->height;
   for (j = 0; j < line_n; j++)
-    if (height > (*(line_c + j))->maximum_size.height)
-      (*(line_r + j))->height = (*(line_c + j))->maximum_size.height;
+    if ((*(maximum_height + *(line_i + j)) >= 0) && (height > *(maximum_height + *(line_i + j))))
+      (*(line_r + j))->height = *(maximum_height + *(line_i + j));
     else
       (*(line_r + j))->height = height;
   
@@ -176,28 +187,45 @@ static void done(__this__)
  * @param   child  The child, to the component using the layout manager, of interest
  * @return         The rectangle the child is confound in
  */
-static rectangle_t locate(__this__, itk_component* child)
+static packed_rectangle_t locate(__this__, itk_component* child)
 {
+  packed_rectangle_t rc = undefined_packed_rectangle();
   rectangle_t* r;
   bool_t p = PREPARED(this) == NULL;
   
   if (p)
-    this->prepare(this);
+    this->vtable->prepare(this);
   
   if ((r = itk_hash_table_get(PREPARED(this), child)))
-    child->size = new_size2(r->width, r->height);
+    {
+      child->size = new_size2(r->width, r->height);
+      rc = pack_rectangle(*r);
+    }
   
   if (p)
-    this->done(this);
+    this->vtable->done(this);
   
-  if (r)
-    return *r;
-  else
-    {
-      rectangle_t rc;
-      rc.defined = false;
-      return rc;
-    }
+  return rc;
+}
+
+
+/**
+ * Calculate the combined advisory minimum size of all components
+ * 
+ * The components can be wrapped onto a line each, so the container
+ * must only fit the widest and the tallest of them
+ * 
+ * @return  Advisory minimum size for the container
+ */
+static size2_t minimum_size(__this__)
+{
+  itk_child_totals totals = itk_child_hints_totals(CONTAINER_(this), ITK_CHILD_HINT_MINIMUM,
+						   ITK_CHILD_TOTAL_MAX, ITK_CHILD_TOTAL_MAX);
+  size2_t rc;
+  rc.defined = true;
+  rc.width = totals.width;
+  rc.height = totals.height;
+  return rc;
 }
 
 
@@ -208,30 +236,17 @@ static rectangle_t locate(__this__, itk_component* child)
  */
 static size2_t maximum_size(__this__)
 {
-  bool_t unbounded = false;
-  itk_component** children = CONTAINER(this)->children;
-  long i, n = CONTAINER(this)->children_count, n_ = 0;
-  size2_t rc, t;
-  rc.width = 0;
-  rc.height = UNBOUNDED;
+  itk_child_totals totals = itk_child_hints_totals(CONTAINER_(this), ITK_CHILD_HINT_MAXIMUM,
+						   ITK_CHILD_TOTAL_BOUNDED_SUM, ITK_CHILD_TOTAL_BOUNDED_MIN);
+  long n = totals.visible_count;
+  size2_t rc;
   rc.defined = true;
-  for (i = 0; i < n; i++)
-    if ((*(children + i))->visible)
-      {
-	t = (*(children + i))->maximum_size;
-	if (t.width < 0)
-	  unbounded = true;
-	else
-	  rc.width += t.width;
-	if (((rc.height < 0) || (rc.height > t.height)) && (t.height >= 0))
-	  rc.height = t.height;
-      }
-    else
-      n_++;
-  if ((n -= n_))
+  rc.width = totals.width;
+  rc.height = totals.height;
+  if (n)
     rc.width += HGAP(this) * (n - 1);
   else
-    if (unbounded)
+    if (totals.width_unbounded)
       rc.width = UNBOUNDED;
   return rc;
 }
@@ -244,26 +259,16 @@ static size2_t maximum_size(__this__)
  */
 static size2_t preferred_size(__this__)
 {
-  size2_t min = this->minimum_size(this);
-  size2_t max = this->minimum_size(this);
-  itk_component** children = CONTAINER(this)->children;
-  long i, n = CONTAINER(this)->children_count, n_ = 0;
-  size2_t rc, t;
+  size2_t min = this->vtable->minimum_size(this);
+  size2_t max = this->vtable->maximum_size(this);
+  itk_child_totals totals = itk_child_hints_totals(CONTAINER_(this), ITK_CHILD_HINT_PREFERRED,
+						   ITK_CHILD_TOTAL_SUM, ITK_CHILD_TOTAL_MAX);
+  long n = totals.visible_count;
+  size2_t rc;
   rc.defined = true;
-  rc.height = min.height;
-  rc.width = 0;
-  
-  for (i = 0; i < n; i++)
-    if ((*(children + i))->visible)
-      {
-	t = (*(children + i))->preferred_size;
-	if (rc.height < t.height)
-	  rc.height = t.height;
-	rc.width += t.width;
-      }
-    else
-      n_++;
-  if ((n -= n_))
+  rc.height = totals.height < min.height ? min.height : totals.height;
+  rc.width = totals.width;
+  if (n)
     rc.width += HGAP(this) * (n - 1);
   
   if ((rc.height > max.height) && (max.height >= 0))
@@ -284,13 +289,39 @@ static void free_line_layout(__this__)
   itk_hash_table* hash_table = PREPARED(this);
   if (hash_table)
     itk_free_hash_table(hash_table, true, false);
-  free(GAP_(this));
-  free(ALIGN_(this));
-  free(this->data);
   free(this);
 }
 
 
+/**
+ * The methods of flow layout managers
+ */
+static const itk_layout_manager_vtable flow_layout_vtable =
+  {
+    .prepare        = prepare,
+    .done           = done,
+    .locate         = locate,
+    .minimum_size   = minimum_size,
+    .preferred_size = preferred_size,
+    .maximum_size   = maximum_size,
+    .free           = free_line_layout
+  };
+
+/**
+ * The methods of justifying flow layout managers
+ */
+static const itk_layout_manager_vtable justified_flow_layout_vtable =
+  {
+    .prepare        = prepare,
+    .done           = done,
+    .locate         = locate,
+    .minimum_size   = minimum_size,
+    .preferred_size = preferred_size,
+    .maximum_size   = maximum_size,
+    .free           = free_line_layout
+  };
+
+
 /**
  * Constructor
  * 
@@ -301,23 +332,16 @@ static void free_line_layout(__this__)
  */
 itk_layout_manager* itk_new_flow_layout(itk_component* container, int8_t alignment, dimension_t hgap, dimension_t vgap)
 {
-  itk_layout_manager* rc = malloc(sizeof(itk_layout_manager));
-  dimension_t* gap_ = malloc(2 * sizeof(dimension_t));
-  int8_t* align_ = malloc(sizeof(int8_t));
-  rc->data = malloc(4 * sizeof(void*));
-  rc->prepare        = prepare;
-  rc->done           = done;
-  rc->locate         = locate;
-  rc->minimum_size   = preferred_size;
-  rc->preferred_size = preferred_size;
-  rc->maximum_size   = alignment == ALIGNMENT_JUSTIFY ? maximum_size : preferred_size;
-  rc->free = free_line_layout;
+  itk_layout_manager* rc = malloc(sizeof(itk_layout_manager) + 4 * sizeof(void*) +
+				  2 * sizeof(dimension_t) + sizeof(int8_t));
+  rc->vtable = alignment == ALIGNMENT_JUSTIFY ? &justified_flow_layout_vtable : &flow_layout_vtable;
+  rc->data = (void**)(rc + 1);
   CONTAINER_(rc) = container;
   PREPARED_(rc) = NULL;
-  GAP_(rc) = gap_;
+  GAP_(rc) = rc->data + 4;
   HGAP(rc) = hgap;
   VGAP(rc) = vgap;
-  ALIGN_(rc) = align_;
+  ALIGN_(rc) = (dimension_t*)(GAP_(rc)) + 2;
   ALIGN(rc) = alignment;
   return rc;
 }
@@ -0,0 +1,286 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "frame_governor.h"
+#include "itkmacros.h"
+#include "metrics.h"
+
+#include <stdlib.h>
+
+
+#define __this__  itk_frame_governor* this
+
+
+/**
+ * The weight of a new frame time in the moving average
+ */
+#define AVERAGE_WEIGHT  (1. / 8)
+
+/**
+ * The number of frames after a switch of quality before the moving average
+ * reflects the new quality, about the reciprocal of `AVERAGE_WEIGHT`
+ */
+#define SETTLE_FRAMES  8
+
+/**
+ * The number of consecutive frames over the target before the quality is lowered
+ */
+#define DEGRADE_FRAMES  4
+
+/**
+ * The number of consecutive frames with room to spare before the quality is raised,
+ * higher than `DEGRADE_FRAMES` so that the quality does not flap
+ */
+#define RESTORE_FRAMES  60
+
+/**
+ * The part of the target the frame time predicted for the next higher
+ * quality must be below for a frame to have room to spare
+ */
+#define RESTORE_MARGIN  0.8
+
+
+
+/**
+ * Get the least number of nanoseconds between two updates of a volatile component
+ * 
+ * @return  The time, zero if updates are not held back
+ */
+static inline uint64_t update_interval(__this__)
+{
+  /* Every level of degradation halves the update rate */
+  return this->quality == ITK_GRAPHICS_QUALITY_FULL ? 0 : (uint64_t)(this->target) << this->quality;
+}
+
+
+/**
+ * Pass on an update of a volatile component to the scheduler
+ * 
+ * @param  v  The volatile component
+ */
+static void pass(__this__, itk_volatile_component* v)
+{
+  if (v->held)
+    {
+      v->held = false;
+      this->held--;
+    }
+  v->last_update = this->now;
+  itk_paint_scheduler_damage(this->scheduler, v->component);
+}
+
+
+
+/**
+ * Constructor
+ * 
+ * @param   scheduler  The scheduler that components are passed on to be repainted,
+ *                     its `loop`, if any, is used to request frames for held back updates
+ * @param   target     The number of nanoseconds a frame should take at most
+ * @return             The frame governor
+ */
+itk_frame_governor* itk_new_frame_governor(itk_paint_scheduler* scheduler, long target)
+{
+  itk_frame_governor* rc = calloc(1, sizeof(itk_frame_governor));
+  rc->scheduler = scheduler;
+  rc->target = target;
+  rc->quality = ITK_GRAPHICS_QUALITY_FULL;
+  rc->volatiles = itk_new_hash_table();
+  return rc;
+}
+
+
+/**
+ * Destructor
+ */
+void itk_free_frame_governor(__this__)
+{
+  /* The quality is no longer lowered by this governor */
+  itk_metrics_add(ITK_METRIC_QUALITY_TIER, -(this->quality));
+  itk_free_hash_table(this->volatiles, true, false);
+  free(this);
+}
+
+
+/**
+ * Mark a component as changing rapidly, so that, while painting cannot
+ * keep up, its intermediate updates may be dropped
+ * 
+ * @param  component  The component
+ */
+void itk_frame_governor_add_volatile(__this__, itk_component* component)
+{
+  itk_volatile_component* v;
+  
+  if (itk_hash_table_contains_key(this->volatiles, component))
+    return;
+  
+  v = calloc(1, sizeof(itk_volatile_component));
+  v->component = component;
+  itk_hash_table_put(this->volatiles, component, v);
+}
+
+
+/**
+ * Unmark a component as changing rapidly, this must be done before a marked component is freed
+ * 
+ * @param  component  The component
+ */
+void itk_frame_governor_remove_volatile(__this__, itk_component* component)
+{
+  itk_volatile_component* v = itk_hash_table_remove(this->volatiles, component);
+  
+  if (v == NULL)
+    return;
+  if (v->held)
+    this->held--;
+  free(v);
+}
+
+
+/**
+ * Queue a component to be repainted, unless it is volatile and was updated
+ * so recently that the update should be held back, in which case it is
+ * passed on, with any later updates dropped, when it is due
+ * 
+ * @param  component  The component
+ */
+void itk_frame_governor_damage(__this__, itk_component* component)
+{
+  itk_volatile_component* v = itk_hash_table_get(this->volatiles, component);
+  
+  if (v == NULL)
+    {
+      itk_paint_scheduler_damage(this->scheduler, component);
+      return;
+    }
+  
+  if ((v->last_update == 0) || (this->now - v->last_update >= update_interval(this)))
+    {
+      pass(this, v);
+      return;
+    }
+  
+  /* Only the last of the updates that arrive while one is held back is drawn */
+  if (v->held)
+    itk_metrics_add(ITK_METRIC_UPDATES_DROPPED, 1);
+  else
+    {
+      v->held = true;
+      this->held++;
+    }
+  if (this->scheduler->loop)
+    itk_main_loop_request_frame(this->scheduler->loop);
+}
+
+
+/**
+ * Start a frame, passing on held back updates that are due
+ * 
+ * @param  now  The time of the frame, in nanoseconds on the monotonic clock
+ */
+void itk_frame_governor_frame(__this__, uint64_t now)
+{
+  uint64_t interval = update_interval(this);
+  itk_volatile_component* v;
+  itk_hash_cursor cursor;
+  itk_hash_entry* entry;
+  
+  this->now = now;
+  if (this->held == 0)
+    return;
+  
+  itk_hash_table_cursor(this->volatiles, &cursor);
+  while ((entry = itk_hash_cursor_next(&cursor)))
+    {
+      v = entry->value;
+      if (v->held && (now - v->last_update >= interval))
+	pass(this, v);
+    }
+  
+  /* Nothing else may cause a frame when the held back updates are due */
+  if (this->held && this->scheduler->loop)
+    itk_main_loop_request_frame(this->scheduler->loop);
+}
+
+
+/**
+ * Switch quality and start over measuring the frame time
+ * 
+ * @param  quality  The new quality, `ITK_GRAPHICS_QUALITY_*`
+ */
+static void switch_quality(__this__, int quality)
+{
+  itk_metrics_add(ITK_METRIC_QUALITY_TIER, quality - this->quality);
+  this->quality = quality;
+  this->average = 0;
+  this->over = 0;
+  this->under = 0;
+  this->frames = 0;
+}
+
+
+/**
+ * Report how long a frame took, and switch quality if called for
+ * 
+ * @param   frame_time  The number of nanoseconds the frame took
+ * @return              Whether the quality was switched
+ */
+bool_t itk_frame_governor_record(__this__, long frame_time)
+{
+  if (this->frames++ == 0)
+    this->average = frame_time;
+  else
+    this->average += (frame_time - this->average) * AVERAGE_WEIGHT;
+  
+  /* Frames from before the last switch still weigh in on the average */
+  if (this->frames < SETTLE_FRAMES)
+    return false;
+  
+  /* Measure how much the quality was worth, once it has been lowered */
+  if (this->left > 0)
+    {
+      this->cost[this->quality] = this->left / this->average;
+      this->left = 0;
+    }
+  
+  if (this->average > this->target)
+    this->over++, this->under = 0;
+  else if ((this->quality > ITK_GRAPHICS_QUALITY_FULL) &&
+	   (this->average * this->cost[this->quality] < this->target * RESTORE_MARGIN))
+    this->under++, this->over = 0;
+  else
+    this->over = this->under = 0;
+  
+  if ((this->over >= DEGRADE_FRAMES) && (this->quality < ITK_GRAPHICS_QUALITY_MINIMAL))
+    {
+      this->left = this->average;
+      switch_quality(this, this->quality + 1);
+      itk_metrics_add(ITK_METRIC_QUALITY_REDUCED, 1);
+      return true;
+    }
+  
+  if ((this->under >= RESTORE_FRAMES) && (this->quality > ITK_GRAPHICS_QUALITY_FULL))
+    {
+      switch_quality(this, this->quality - 1);
+      itk_metrics_add(ITK_METRIC_QUALITY_RESTORED, 1);
+      return true;
+    }
+  
+  return false;
+}
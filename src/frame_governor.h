@@ -0,0 +1,204 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_FRAME_GOVERNOR_H__
+#define __ITK_FRAME_GOVERNOR_H__
+
+#include "itktypes.h"
+#include "component.h"
+#include "graphics.h"
+#include "hash_table.h"
+#include "paint_scheduler.h"
+
+
+/**
+ * A component that changes rapidly, whose updates may be dropped
+ */
+typedef struct _itk_volatile_component
+{
+  /**
+   * The component
+   */
+  itk_component* component;
+  
+  /**
+   * When the component was last passed on to be repainted, 0 if never
+   */
+  uint64_t last_update;
+  
+  /**
+   * Whether an update of the component has been held back
+   */
+  bool_t held;
+  
+} itk_volatile_component;
+
+
+/**
+ * Keeps up with a frame rate when painting is too slow, by drawing with lower
+ * quality and by dropping intermediate updates of rapidly changing components,
+ * such as progress bars and live plots, and restores full quality when the
+ * frames fit in the target again
+ * 
+ * Switches of quality are counted in `ITK_METRIC_QUALITY_REDUCED` and
+ * `ITK_METRIC_QUALITY_RESTORED`, the current quality is the gauge
+ * `ITK_METRIC_QUALITY_TIER`, and dropped updates are counted in
+ * `ITK_METRIC_UPDATES_DROPPED`
+ */
+typedef struct _itk_frame_governor
+{
+  /**
+   * The number of nanoseconds a frame should take at most
+   */
+  long target;
+  
+  /**
+   * The moving average of the frame time, in nanoseconds
+   */
+  double average;
+  
+  /**
+   * The current quality, `ITK_GRAPHICS_QUALITY_*`
+   */
+  int quality;
+  
+  /**
+   * The number of consecutive frames that have been over the target
+   */
+  long over;
+  
+  /**
+   * The number of consecutive frames that have had room to spare
+   */
+  long under;
+  
+  /**
+   * The number of frames since the last switch of quality
+   */
+  long frames;
+  
+  /**
+   * The average frame time, in nanoseconds, when the quality was last lowered,
+   * until the cost of the quality has been measured, otherwise zero
+   */
+  double left;
+  
+  /**
+   * For each quality, how many times longer frames took with the next
+   * higher quality, measured when the quality was lowered
+   */
+  double cost[ITK_GRAPHICS_QUALITY_MINIMAL + 1];
+  
+  /**
+   * Map from volatile component to its `itk_volatile_component`
+   */
+  itk_hash_table* volatiles;
+  
+  /**
+   * The number of volatile components with an update held back
+   */
+  long held;
+  
+  /**
+   * The scheduler that components are passed on to be repainted
+   */
+  itk_paint_scheduler* scheduler;
+  
+  /**
+   * The time of the current frame, in nanoseconds on the monotonic clock
+   */
+  uint64_t now;
+  
+} itk_frame_governor;
+
+
+/**
+ * Constructor
+ * 
+ * @param   scheduler  The scheduler that components are passed on to be repainted,
+ *                     its `loop`, if any, is used to request frames for held back updates
+ * @param   target     The number of nanoseconds a frame should take at most
+ * @return             The frame governor
+ */
+itk_frame_governor* itk_new_frame_governor(itk_paint_scheduler* scheduler, long target);
+
+/**
+ * Destructor
+ * 
+ * @param  this  The frame governor
+ */
+void itk_free_frame_governor(itk_frame_governor* this);
+
+/**
+ * Mark a component as changing rapidly, so that, while painting cannot
+ * keep up, its intermediate updates may be dropped
+ * 
+ * @param  this       The frame governor
+ * @param  component  The component
+ */
+void itk_frame_governor_add_volatile(itk_frame_governor* this, itk_component* component);
+
+/**
+ * Unmark a component as changing rapidly, this must be done before a marked component is freed
+ * 
+ * @param  this       The frame governor
+ * @param  component  The component
+ */
+void itk_frame_governor_remove_volatile(itk_frame_governor* this, itk_component* component);
+
+/**
+ * Queue a component to be repainted, unless it is volatile and was updated
+ * so recently that the update should be held back, in which case it is
+ * passed on, with any later updates dropped, when it is due
+ * 
+ * @param  this       The frame governor
+ * @param  component  The component
+ */
+void itk_frame_governor_damage(itk_frame_governor* this, itk_component* component);
+
+/**
+ * Start a frame, passing on held back updates that are due
+ * 
+ * @param  this  The frame governor
+ * @param  now   The time of the frame, in nanoseconds on the monotonic clock
+ */
+void itk_frame_governor_frame(itk_frame_governor* this, uint64_t now);
+
+/**
+ * Report how long a frame took, and switch quality if called for
+ * 
+ * @param   this        The frame governor
+ * @param   frame_time  The number of nanoseconds the frame took
+ * @return              Whether the quality was switched
+ */
+bool_t itk_frame_governor_record(itk_frame_governor* this, long frame_time);
+
+/**
+ * Make a graphics context, used for one frame, draw with the current quality
+ * 
+ * @param  this  The frame governor
+ * @param  g     The graphics context
+ */
+static inline void itk_frame_governor_degrade(itk_frame_governor* this, itk_graphics* g)
+{
+  itk_graphics_degrade(g, this->quality);
+}
+
+
+#endif
+
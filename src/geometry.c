@@ -0,0 +1,414 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "geometry.h"
+#include "itkmacros.h"
+
+#include <string.h>
+
+
+/*
+ * The batch functions are written with GCC's vector extension, with two
+ * rectangles per vector, and compiled once for each instruction set, the
+ * best version the processor supports is selected when the program loads
+ */
+#if defined(__has_attribute) && (defined(__x86_64__) || defined(__i386__))
+# if __has_attribute(target_clones)
+#  define TARGETS  __attribute__((target_clones("avx2", "sse4.1", "default")))
+# endif
+#endif
+#ifndef TARGETS
+# define TARGETS
+#endif
+
+
+/**
+ * Two packed rectangles
+ */
+typedef int32_t v8si __attribute__((vector_size(32)));
+
+/**
+ * Two packed rectangles, with wrapping arithmetic
+ */
+typedef uint32_t v8su __attribute__((vector_size(32)));
+
+/**
+ * The number of rectangles in a vector
+ */
+#define LANES  2
+
+/**
+ * Vector with all elements set to the same value
+ */
+#define SPLAT(value)  ((v8si){value, value, value, value, value, value, value, value})
+
+/**
+ * Set each element of both rectangles to the rectangles' element at a lane
+ */
+#define SPREAD(v, lane)  __builtin_shuffle(v, ((v8si){lane, lane, lane, lane, lane + 4, lane + 4, lane + 4, lane + 4}))
+
+/**
+ * Two rectangles that are not defined
+ */
+#define UNDEFINED_RECTANGLES  ((v8si){0, 0, ITK_UNDEFINED, 0, 0, 0, ITK_UNDEFINED, 0})
+
+
+/* The helpers below are macros rather than functions, as 32 byte vectors
+   cannot be passed to functions the same way with and without AVX */
+
+/**
+ * Select the smaller element from each lane of two vectors
+ */
+#define VMIN(a, b)  ({ v8si a_ = (a), b_ = (b), m_ = a_ < b_;  (a_ & m_) | (b_ & ~m_); })
+
+/**
+ * Select the larger element from each lane of two vectors
+ */
+#define VMAX(a, b)  ({ v8si a_ = (a), b_ = (b), m_ = a_ > b_;  (a_ & m_) | (b_ & ~m_); })
+
+/**
+ * Select elements from `a` where `mask` is set and from `b` elsewhere
+ */
+#define VSELECT(mask, a, b)  ({ v8si m_ = (mask);  ((a) & m_) | ((b) & ~m_); })
+
+/**
+ * Load two rectangles, they do not have to be aligned
+ */
+#define LOAD(rects)  ({ v8si v_;  memcpy(&v_, (rects), sizeof(v8si));  v_; })
+
+/**
+ * Store two rectangles, they do not have to be aligned
+ */
+#define STORE(rects, v)  ({ v8si v_ = (v);  memcpy((rects), &v_, sizeof(v8si)); })
+
+/**
+ * Vector with a rectangle twice
+ */
+#define BROADCAST(r)  ((v8si){(r).x, (r).y, (r).width, (r).height, (r).x, (r).y, (r).width, (r).height})
+
+/**
+ * Replace the positions of two rectangles with their right and bottom edges
+ */
+#define ENDS(v)								\
+  ({									\
+    v8si v_ = (v);							\
+    v8si size_ = __builtin_shuffle(v_, ((v8si){2, 3, 2, 3, 6, 7, 6, 7})); \
+    (v8si)((v8su)v_ + (v8su)size_);					\
+  })
+
+/**
+ * Set all bits in each of two rectangles that is not defined
+ */
+#define UNDEFINED(v)  SPREAD((v) == UNDEFINED_RECTANGLES, 2)
+
+/**
+ * Set all bits in each of two rectangles that is defined and has an area
+ */
+#define NONEMPTY(v)							\
+  ({									\
+    v8si positive_ = (v) > SPLAT(0);					\
+    SPREAD(positive_, 2) & SPREAD(positive_, 3);			\
+  })
+
+/**
+ * Intersect two rectangles with a clip rectangle
+ * 
+ * @param   v     Two rectangles
+ * @param   clip  The clip rectangle, twice
+ * @param   edge  `ENDS(clip)`
+ * @return        The intersections
+ */
+#define INTERSECT(v, clip, edge)					\
+  ({									\
+    v8si r_ = (v);							\
+    v8si low_ = VMAX(r_, clip);						\
+    v8si size_ = VMAX((v8si)((v8su)VMIN(ENDS(r_), edge) - (v8su)low_), SPLAT(0)); \
+    v8si rc_ = __builtin_shuffle(low_, size_, ((v8si){0, 1, 8, 9, 4, 5, 12, 13})); \
+    VSELECT(UNDEFINED(r_), UNDEFINED_RECTANGLES, rc_);			\
+  })
+
+
+/**
+ * Calculate the right edge of a rectangle
+ */
+#define RIGHT(r)   ((position_t)((uint32_t)(r).x + (uint32_t)(r).width))
+
+/**
+ * Calculate the bottom edge of a rectangle
+ */
+#define BOTTOM(r)  ((position_t)((uint32_t)(r).y + (uint32_t)(r).height))
+
+#define MIN(a, b)  ((a) < (b) ? (a) : (b))
+#define MAX(a, b)  ((a) > (b) ? (a) : (b))
+
+
+
+/**
+ * Calculate the intersection of two rectangles
+ * 
+ * @param   a  One of the rectangles
+ * @param   b  The other rectangle
+ * @return     The intersection, with zero width or height if the rectangles
+ *             do not overlap, not defined if either rectangle is not defined
+ */
+packed_rectangle_t itk_rectangle_intersection(packed_rectangle_t a, packed_rectangle_t b)
+{
+  position_t x, y;
+  dimension_t width, height;
+  
+  if (!packed_rectangle_defined(a) || !packed_rectangle_defined(b))
+    return undefined_packed_rectangle();
+  
+  x = MAX(a.x, b.x);
+  y = MAX(a.y, b.y);
+  width  = (dimension_t)((uint32_t)MIN(RIGHT(a),  RIGHT(b))  - (uint32_t)x);
+  height = (dimension_t)((uint32_t)MIN(BOTTOM(a), BOTTOM(b)) - (uint32_t)y);
+  
+  return new_packed_rectangle(x, y, MAX(width, 0), MAX(height, 0));
+}
+
+
+/**
+ * Calculate the smallest rectangle that contains two rectangles
+ * 
+ * @param   a  One of the rectangles
+ * @param   b  The other rectangle
+ * @return     The bounding box of the non-empty rectangles of `a` and `b`,
+ *             not defined if both are empty
+ */
+packed_rectangle_t itk_rectangle_union(packed_rectangle_t a, packed_rectangle_t b)
+{
+  position_t x1, y1, x2, y2;
+  
+  if (itk_rectangle_is_empty(a))
+    return itk_rectangle_is_empty(b) ? undefined_packed_rectangle() : b;
+  if (itk_rectangle_is_empty(b))
+    return a;
+  
+  x1 = MIN(a.x, b.x);
+  y1 = MIN(a.y, b.y);
+  x2 = MAX(RIGHT(a),  RIGHT(b));
+  y2 = MAX(BOTTOM(a), BOTTOM(b));
+  
+  return new_packed_rectangle(x1, y1, x2 - x1, y2 - y1);
+}
+
+
+/**
+ * Check whether a rectangle is empty
+ * 
+ * @param   rectangle  The rectangle
+ * @return             Whether the rectangle is not defined or has no area
+ */
+bool_t itk_rectangle_is_empty(packed_rectangle_t rectangle)
+{
+  /* `ITK_UNDEFINED` is negative */
+  return (rectangle.width <= 0) || (rectangle.height <= 0);
+}
+
+
+/**
+ * Check whether a rectangle contains a point
+ * 
+ * @param   rectangle  The rectangle
+ * @param   point      The point
+ * @return             Whether the point is inside the rectangle
+ */
+bool_t itk_rectangle_contains(packed_rectangle_t rectangle, packed_position2_t point)
+{
+  return packed_rectangle_defined(rectangle) &&
+    (rectangle.x <= point.x) && (point.x < RIGHT(rectangle)) &&
+    (rectangle.y <= point.y) && (point.y < BOTTOM(rectangle));
+}
+
+
+
+/**
+ * Intersect rectangles with a clip rectangle
+ * 
+ * @param  out    Output array for the intersections, may be `rectangles`
+ * @param  rects  The rectangles
+ * @param  n      The number of rectangles
+ * @param  clip   The clip rectangle
+ */
+TARGETS
+void itk_rectangles_intersect(packed_rectangle_t* out, const packed_rectangle_t* rects,
+			      long n, packed_rectangle_t clip)
+{
+  v8si c = BROADCAST(clip), edge = ENDS(c);
+  long i = 0;
+  
+  if (packed_rectangle_defined(clip))
+    for (; i + LANES <= n; i += LANES)
+      STORE(out + i, INTERSECT(LOAD(rects + i), c, edge));
+  
+  for (; i < n; i++)
+    *(out + i) = itk_rectangle_intersection(*(rects + i), clip);
+}
+
+
+/**
+ * Find the rectangles that are at least partially inside a clip rectangle
+ * 
+ * @param   visible  Output array, set to 1 for each rectangle that overlaps
+ *                   `clip` with a non-zero area, and 0 for the others
+ * @param   rects    The rectangles
+ * @param   n        The number of rectangles
+ * @param   clip     The clip rectangle
+ * @return           The number of rectangles that overlap `clip`
+ */
+TARGETS
+long itk_rectangles_cull(bool_t* visible, const packed_rectangle_t* rects, long n, packed_rectangle_t clip)
+{
+  v8si c = BROADCAST(clip), edge = ENDS(c), m;
+  long i = 0, rc = 0;
+  
+  if (packed_rectangle_defined(clip))
+    for (; i + LANES <= n; i += LANES)
+      {
+	m = NONEMPTY(INTERSECT(LOAD(rects + i), c, edge));
+	rc += *(visible + i + 0) = m[0] & 1;
+	rc += *(visible + i + 1) = m[4] & 1;
+      }
+  
+  for (; i < n; i++)
+    rc += *(visible + i) = !itk_rectangle_is_empty(itk_rectangle_intersection(*(rects + i), clip));
+  
+  return rc;
+}
+
+
+/**
+ * Calculate the smallest rectangle that contains a set of rectangles
+ * 
+ * @param   rects  The rectangles
+ * @param   n      The number of rectangles
+ * @return         The bounding box of the non-empty rectangles,
+ *                 not defined if all rectangles are empty
+ */
+TARGETS
+packed_rectangle_t itk_rectangles_union(const packed_rectangle_t* rects, long n)
+{
+  v8si low = SPLAT(INT32_MAX), high = SPLAT(INT32_MIN), v, m;
+  packed_rectangle_t rc = undefined_packed_rectangle();
+  long i = 0;
+  
+  for (; i + LANES <= n; i += LANES)
+    {
+      v = LOAD(rects + i);
+      m = NONEMPTY(v);
+      low  = VMIN(low,  VSELECT(m, v,       SPLAT(INT32_MAX)));
+      high = VMAX(high, VSELECT(m, ENDS(v), SPLAT(INT32_MIN)));
+    }
+  
+  if (low[0] <= high[0])
+    rc = new_packed_rectangle(low[0], low[1], high[0] - low[0], high[1] - low[1]);
+  if (low[4] <= high[4])
+    rc = itk_rectangle_union(rc, new_packed_rectangle(low[4], low[5], high[4] - low[4], high[5] - low[5]));
+  
+  for (; i < n; i++)
+    rc = itk_rectangle_union(rc, *(rects + i));
+  
+  return rc;
+}
+
+
+/**
+ * Find the rectangles that contain a point
+ * 
+ * @param   out    Output array, set to 1 for each rectangle
+ *                 that contains `point`, and 0 for the others
+ * @param   rects  The rectangles
+ * @param   n      The number of rectangles
+ * @param   point  The point
+ * @return         The number of rectangles that contain `point`
+ */
+TARGETS
+long itk_rectangles_contain(bool_t* out, const packed_rectangle_t* rects, long n, packed_position2_t point)
+{
+  v8si p = {point.x, point.y, 0, 0, point.x, point.y, 0, 0}, v, m;
+  long i = 0, rc = 0;
+  
+  for (; i + LANES <= n; i += LANES)
+    {
+      v = LOAD(rects + i);
+      m = (p >= v) & (p < ENDS(v));
+      m = SPREAD(m, 0) & SPREAD(m, 1) & ~UNDEFINED(v);
+      rc += *(out + i + 0) = m[0] & 1;
+      rc += *(out + i + 1) = m[4] & 1;
+    }
+  
+  for (; i < n; i++)
+    rc += *(out + i) = itk_rectangle_contains(*(rects + i), point);
+  
+  return rc;
+}
+
+
+/**
+ * Translate rectangles
+ * 
+ * @param  rects   The rectangles
+ * @param  n       The number of rectangles
+ * @param  offset  The distance to move the rectangles
+ */
+TARGETS
+void itk_rectangles_translate(packed_rectangle_t* rects, long n, packed_position2_t offset)
+{
+  v8si d = {offset.x, offset.y, 0, 0, offset.x, offset.y, 0, 0};
+  long i = 0;
+  
+  for (; i + LANES <= n; i += LANES)
+    STORE(rects + i, (v8si)((v8su)LOAD(rects + i) + (v8su)d));
+  
+  for (; i < n; i++)
+    {
+      (rects + i)->x = (position_t)((uint32_t)(rects + i)->x + (uint32_t)offset.x);
+      (rects + i)->y = (position_t)((uint32_t)(rects + i)->y + (uint32_t)offset.y);
+    }
+}
+
+
+/**
+ * Find the empty rectangles
+ * 
+ * @param   out    Output array, set to 1 for each rectangle
+ *                 that is empty, and 0 for the others
+ * @param   rects  The rectangles
+ * @param   n      The number of rectangles
+ * @return         The number of empty rectangles
+ */
+TARGETS
+long itk_rectangles_empty(bool_t* out, const packed_rectangle_t* rects, long n)
+{
+  long i = 0, rc = 0;
+  v8si m;
+  
+  for (; i + LANES <= n; i += LANES)
+    {
+      m = ~NONEMPTY(LOAD(rects + i));
+      rc += *(out + i + 0) = m[0] & 1;
+      rc += *(out + i + 1) = m[4] & 1;
+    }
+  
+  for (; i < n; i++)
+    rc += *(out + i) = itk_rectangle_is_empty(*(rects + i));
+  
+  return rc;
+}
+
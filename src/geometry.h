@@ -0,0 +1,139 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_GEOMETRY_H__
+#define __ITK_GEOMETRY_H__
+
+#include "itktypes.h"
+
+
+/**
+ * Rectangle arithmetic on packed rectangles, the batch functions work on
+ * arrays and use SSE4.1 or AVX2, when the processor supports it, to handle
+ * multiple rectangles per instruction
+ * 
+ * A rectangle is empty if it is not defined or has no area
+ */
+
+
+/**
+ * Calculate the intersection of two rectangles
+ * 
+ * @param   a  One of the rectangles
+ * @param   b  The other rectangle
+ * @return     The intersection, with zero width or height if the rectangles
+ *             do not overlap, not defined if either rectangle is not defined
+ */
+packed_rectangle_t itk_rectangle_intersection(packed_rectangle_t a, packed_rectangle_t b);
+
+/**
+ * Calculate the smallest rectangle that contains two rectangles
+ * 
+ * @param   a  One of the rectangles
+ * @param   b  The other rectangle
+ * @return     The bounding box of the non-empty rectangles of `a` and `b`,
+ *             not defined if both are empty
+ */
+packed_rectangle_t itk_rectangle_union(packed_rectangle_t a, packed_rectangle_t b);
+
+/**
+ * Check whether a rectangle is empty
+ * 
+ * @param   rectangle  The rectangle
+ * @return             Whether the rectangle is not defined or has no area
+ */
+bool_t itk_rectangle_is_empty(packed_rectangle_t rectangle);
+
+/**
+ * Check whether a rectangle contains a point
+ * 
+ * @param   rectangle  The rectangle
+ * @param   point      The point
+ * @return             Whether the point is inside the rectangle
+ */
+bool_t itk_rectangle_contains(packed_rectangle_t rectangle, packed_position2_t point);
+
+
+/**
+ * Intersect rectangles with a clip rectangle
+ * 
+ * @param  out    Output array for the intersections, may be `rectangles`
+ * @param  rects  The rectangles
+ * @param  n      The number of rectangles
+ * @param  clip   The clip rectangle
+ */
+void itk_rectangles_intersect(packed_rectangle_t* out, const packed_rectangle_t* rects,
+			      long n, packed_rectangle_t clip);
+
+/**
+ * Find the rectangles that are at least partially inside a clip rectangle
+ * 
+ * @param   visible  Output array, set to 1 for each rectangle that overlaps
+ *                   `clip` with a non-zero area, and 0 for the others
+ * @param   rects    The rectangles
+ * @param   n        The number of rectangles
+ * @param   clip     The clip rectangle
+ * @return           The number of rectangles that overlap `clip`
+ */
+long itk_rectangles_cull(bool_t* visible, const packed_rectangle_t* rects, long n, packed_rectangle_t clip);
+
+/**
+ * Calculate the smallest rectangle that contains a set of rectangles
+ * 
+ * @param   rects  The rectangles
+ * @param   n      The number of rectangles
+ * @return         The bounding box of the non-empty rectangles,
+ *                 not defined if all rectangles are empty
+ */
+packed_rectangle_t itk_rectangles_union(const packed_rectangle_t* rects, long n);
+
+/**
+ * Find the rectangles that contain a point
+ * 
+ * @param   out    Output array, set to 1 for each rectangle
+ *                 that contains `point`, and 0 for the others
+ * @param   rects  The rectangles
+ * @param   n      The number of rectangles
+ * @param   point  The point
+ * @return         The number of rectangles that contain `point`
+ */
+long itk_rectangles_contain(bool_t* out, const packed_rectangle_t* rects, long n, packed_position2_t point);
+
+/**
+ * Translate rectangles
+ * 
+ * @param  rects   The rectangles
+ * @param  n       The number of rectangles
+ * @param  offset  The distance to move the rectangles
+ */
+void itk_rectangles_translate(packed_rectangle_t* rects, long n, packed_position2_t offset);
+
+/**
+ * Find the empty rectangles
+ * 
+ * @param   out    Output array, set to 1 for each rectangle
+ *                 that is empty, and 0 for the others
+ * @param   rects  The rectangles
+ * @param   n      The number of rectangles
+ * @return         The number of empty rectangles
+ */
+long itk_rectangles_empty(bool_t* out, const packed_rectangle_t* rects, long n);
+
+
+#endif
+
@@ -18,13 +18,26 @@
  */
 #include "graphics.h"
 #include "itkmacros.h"
+#include "region.h"
 
+#include <math.h>
 #include <stdlib.h>
 
 
 #define __this__  itk_graphics* this
 
 
+/**
+ * The number of segments a full turn is approximated with by `ITK_GRAPHICS_QUALITY_REDUCED`
+ */
+#define REDUCED_ARC_SEGMENTS  16
+
+/**
+ * The number of segments a full turn is approximated with by `ITK_GRAPHICS_QUALITY_MINIMAL`
+ */
+#define MINIMAL_ARC_SEGMENTS  8
+
+
 /**
  * Fork the graphics context but clip to a subset of the affected area.
  * The new context will be translate so that the top left corner of the
@@ -33,21 +46,37 @@
  * This is equivalent to:
  *     itk_graphics* rc = this->fork(this);
  *     rc->clip(rc, area);
- *     rc->translate(rc, new_position2(-(area.x), -(area.y)));
+ *     rc->translate(rc, new_packed_position2(-(area.x), -(area.y)));
  *     return rc;
  * 
  * @param   area  The new clip area
  * @return        The new graphics context
  */
-static itk_graphics* create(__this__, rectangle_t area)
+static itk_graphics* create(__this__, packed_rectangle_t area)
 {
   itk_graphics* rc = this->fork(this);
   rc->clip(rc, area);
-  rc->translate(rc, new_position2(-(area.x), -(area.y)));
+  rc->translate(rc, new_packed_position2(-(area.x), -(area.y)));
   return rc;
 }
 
 
+/**
+ * Clip the affected area to a region
+ * 
+ * Without native support for regions, the clip area
+ * is the smallest rectangle that contains the region
+ * 
+ * @param  region  The new only area is affected by usage of this
+ *                 graphics context. The effective area is the
+ *                 intersection of the region and the old clip area.
+ */
+static void clip_region(__this__, const itk_region* region)
+{
+  this->clip(this, itk_region_bounds(region));
+}
+
+
 /**
  * Draw a solid rectangle
  * 
@@ -224,6 +253,149 @@ static void draw_point(__this__, position2_t point)
 }
 
 
+/**
+ * Approximate an arc with line segments, for graphics
+ * contexts that do not draw arcs natively
+ * 
+ * @param   points       Output parameter for the points, room for `segments + 1` is required
+ * @param   area         The rectangle the sliced circles is scribed into
+ * @param   start_angle  The start of the arc, in degrees anti-clockwise from the three-o'clock position
+ * @param   arc_angles   The number of degrees between the arc start and arc end,
+ *                       the magnitude is truncated to 360
+ * @param   segments     The number of segments a full turn is approximated with
+ * @return               The number of points
+ */
+long itk_graphics_arc_points(position2_t* points, rectangle_t area, float start_angle, float arc_angles,
+			     long segments)
+{
+  double rx = area.width / 2., ry = area.height / 2., cx = area.x + rx, cy = area.y + ry, angle;
+  long i, n;
+  
+  arc_angles = arc_angles > 360 ? 360 : arc_angles < -360 ? -360 : arc_angles;
+  n = (long)ceil(fabs(arc_angles) * segments / 360);
+  n = n < 1 ? 1 : n;
+  
+  for (i = 0; i <= n; i++)
+    {
+      angle = (start_angle + arc_angles * i / n) * M_PI / 180;
+      (points + i)->defined = true;
+      (points + i)->x = (position_t)lround(cx + rx * cos(angle));
+      (points + i)->y = (position_t)lround(cy - ry * sin(angle));
+    }
+  
+  return n + 1;
+}
+
+
+/**
+ * Draw a solid pie slice as a polygon
+ * 
+ * @param  segments  The number of segments a full turn is approximated with
+ */
+static void coarse_fill_pie(__this__, rectangle_t area, float start_angle, float arc_angles, long segments)
+{
+  position2_t* points = alloca((segments + 2) * sizeof(position2_t));
+  long n = itk_graphics_arc_points(points, area, start_angle, arc_angles, segments);
+  
+  (points + n)->defined = true;
+  (points + n)->x = area.x + area.width / 2;
+  (points + n)->y = area.y + area.height / 2;
+  
+  this->fill_polygon(this, points, n + 1, fabsf(arc_angles) > 180 ? ITK_GRAPHICS_SHAPE_NONCONVEX : ITK_GRAPHICS_SHAPE_CONVEX,
+		     ITK_GRAPHICS_MODE_ABSOLUTE);
+}
+
+
+/**
+ * Draw a solid arc chord as a polygon
+ * 
+ * @param  segments  The number of segments a full turn is approximated with
+ */
+static void coarse_fill_chord(__this__, rectangle_t area, float start_angle, float arc_angles, long segments)
+{
+  position2_t* points = alloca((segments + 2) * sizeof(position2_t));
+  long n = itk_graphics_arc_points(points, area, start_angle, arc_angles, segments);
+  
+  this->fill_polygon(this, points, n, ITK_GRAPHICS_SHAPE_CONVEX, ITK_GRAPHICS_MODE_ABSOLUTE);
+}
+
+
+/**
+ * Draw an arc as a polyline
+ * 
+ * @param  segments  The number of segments a full turn is approximated with
+ */
+static void coarse_draw_arc(__this__, rectangle_t area, float start_angle, float arc_angles, long segments)
+{
+  position2_t* points = alloca((segments + 2) * sizeof(position2_t));
+  long n = itk_graphics_arc_points(points, area, start_angle, arc_angles, segments);
+  
+  this->draw_polyline(this, points, n, ITK_GRAPHICS_MODE_ABSOLUTE);
+}
+
+
+/**
+ * Define the methods that approximate arcs with a number of segments
+ * 
+ * @param  QUALITY   The name of the quality, in lower case
+ * @param  SEGMENTS  The number of segments a full turn is approximated with
+ */
+#define COARSE_METHODS(QUALITY, SEGMENTS)								\
+  static void QUALITY##_fill_pie(__this__, rectangle_t area, float start_angle, float arc_angles)	\
+  {													\
+    coarse_fill_pie(this, area, start_angle, arc_angles, SEGMENTS);					\
+  }													\
+  static void QUALITY##_fill_chord(__this__, rectangle_t area, float start_angle, float arc_angles)	\
+  {													\
+    coarse_fill_chord(this, area, start_angle, arc_angles, SEGMENTS);					\
+  }													\
+  static void QUALITY##_fill_oval(__this__, rectangle_t area)						\
+  {													\
+    coarse_fill_chord(this, area, 0.f, 360.f, SEGMENTS);						\
+  }													\
+  static void QUALITY##_draw_arc(__this__, rectangle_t area, float start_angle, float arc_angles)	\
+  {													\
+    coarse_draw_arc(this, area, start_angle, arc_angles, SEGMENTS);					\
+  }													\
+  static void QUALITY##_draw_oval(__this__, rectangle_t area)						\
+  {													\
+    coarse_draw_arc(this, area, 0.f, 360.f, SEGMENTS);							\
+  }
+
+COARSE_METHODS(reduced, REDUCED_ARC_SEGMENTS)
+COARSE_METHODS(minimal, MINIMAL_ARC_SEGMENTS)
+
+#undef COARSE_METHODS
+
+
+/**
+ * Draw a solid rectangle, without rounding the corners
+ * 
+ * @param  area      The rectangle to draw
+ * @param  arc_size  Ignored
+ */
+static void square_fill_rounded_rectangle(__this__, rectangle_t area, size2_t arc_size)
+{
+  (void) arc_size;
+  
+  this->fill_rectangle(this, area);
+}
+
+
+/**
+ * Draw a hollow rectangle, without rounding the corners
+ * 
+ * @param  area      The rectangle to draw
+ * @param  arc_size  Ignored
+ */
+static void square_draw_rounded_rectangle(__this__, rectangle_t area, size2_t arc_size)
+{
+  (void) arc_size;
+  
+  this->draw_rectangle(this, area);
+}
+
+
 /**
  * This function is intended to be used by
  * implementations of this interface. This
@@ -231,6 +403,7 @@ static void draw_point(__this__, position2_t point)
  * can be derived from other functions,
  * this includes:
  *     • create
+ *     • clip_region
  *     • fill_rectangle
  *     • fill_rounded_rectangle
  *     • fill_oval
@@ -258,6 +431,7 @@ void itk_graphics_derive_methods(__this__)
 {
 #define __(FUNC)  if (this->FUNC == NULL)  this->FUNC = FUNC
   __(create);
+  __(clip_region);
   __(fill_rectangle);
   __(fill_rounded_rectangle);
   __(fill_oval);
@@ -270,3 +444,31 @@ void itk_graphics_derive_methods(__this__)
 #undef __
 }
 
+
+/**
+ * Replace the methods of a graphics context that draw expensive
+ * primitives with methods that draw cheaper approximations
+ * 
+ * The methods are copied by `fork` and `create`, so this should
+ * be done on a context, or a fork, that is used for one frame
+ * 
+ * @param  quality  The quality to draw with, `ITK_GRAPHICS_QUALITY_*`,
+ *                  nothing is changed for `ITK_GRAPHICS_QUALITY_FULL`
+ */
+void itk_graphics_degrade(__this__, int quality)
+{
+  if (quality <= ITK_GRAPHICS_QUALITY_FULL)
+    return;
+  
+  this->fill_rounded_rectangle = square_fill_rounded_rectangle;
+  this->draw_rounded_rectangle = square_draw_rounded_rectangle;
+  
+#define __(FUNC)  this->FUNC = quality == ITK_GRAPHICS_QUALITY_REDUCED ? reduced_##FUNC : minimal_##FUNC
+  __(fill_pie);
+  __(fill_chord);
+  __(fill_oval);
+  __(draw_arc);
+  __(draw_oval);
+#undef __
+}
+
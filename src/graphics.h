@@ -21,6 +21,8 @@
 
 #include "itktypes.h"
 
+struct _itk_region;
+
 
 /**
  * Paths may self-intersect
@@ -51,6 +53,24 @@
 
 
 
+/**
+ * Everything is drawn as requested
+ */
+#define ITK_GRAPHICS_QUALITY_FULL 0
+
+/**
+ * Rounded corners are drawn square, and arcs and
+ * ellipses as polygons with few segments
+ */
+#define ITK_GRAPHICS_QUALITY_REDUCED 1
+
+/**
+ * As `ITK_GRAPHICS_QUALITY_REDUCED`, but with even fewer segments
+ */
+#define ITK_GRAPHICS_QUALITY_MINIMAL 2
+
+
+
 #define __this__  struct _itk_graphics* this
 
 /**
@@ -72,13 +92,13 @@ typedef struct _itk_graphics
    * This is equivalent to:
    *     itk_graphics* rc = this->fork(this);
    *     rc->clip(rc, area);
-   *     rc->translate(rc, new_position2(-(area.x), -(area.y)));
+   *     rc->translate(rc, new_packed_position2(-(area.x), -(area.y)));
    *     return rc;
    * 
    * @param   area  The new clip area
    * @return        The new graphics context
    */
-  struct _itk_graphics* (*create)(__this__, rectangle_t area);
+  struct _itk_graphics* (*create)(__this__, packed_rectangle_t area);
   
   /**
    * Clip the affected area
@@ -87,14 +107,24 @@ typedef struct _itk_graphics
    *               graphics context. The effective area is the
    *               intersection area and the old clip area.
    */
-  void (*clip)(__this__, rectangle_t area);
+  void (*clip)(__this__, packed_rectangle_t area);
+  
+  /**
+   * Clip the affected area to a region, so that a set of disjoint
+   * rectangles can be painted with a single traversal
+   * 
+   * @param  region  The new only area is affected by usage of this
+   *                 graphics context. The effective area is the
+   *                 intersection of the region and the old clip area.
+   */
+  void (*clip_region)(__this__, const struct _itk_region* region);
   
   /**
    * Translate origin to `offset`
    * 
    * @param  offset  The new position of the old origin
    */
-  void (*translate)(__this__, position2_t offset);
+  void (*translate)(__this__, packed_position2_t offset);
   
   
   /**
@@ -245,6 +275,12 @@ typedef struct _itk_graphics
    */
   void (*draw_point)(__this__, position2_t point);
   
+  /**
+   * Draw a string, graphics contexts without fonts draw nothing
+   * 
+   * @param  point  The position of the left end of the baseline
+   * @param  text   The text, NUL-terminated
+   */
   void (*draw_string)(__this__, position2_t point, char* text);
   
   
@@ -267,6 +303,7 @@ typedef struct _itk_graphics
  * can be derived from other functions,
  * this includes:
  *     • create
+ *     • clip_region
  *     • fill_rectangle
  *     • fill_rounded_rectangle
  *     • fill_oval
@@ -292,6 +329,33 @@ typedef struct _itk_graphics
  */
 void itk_graphics_derive_methods(__this__);
 
+/**
+ * Replace the methods of a graphics context that draw expensive
+ * primitives with methods that draw cheaper approximations
+ * 
+ * The methods are copied by `fork` and `create`, so this should
+ * be done on a context, or a fork, that is used for one frame
+ * 
+ * @param  quality  The quality to draw with, `ITK_GRAPHICS_QUALITY_*`,
+ *                  nothing is changed for `ITK_GRAPHICS_QUALITY_FULL`
+ */
+void itk_graphics_degrade(__this__, int quality);
+
+/**
+ * Approximate an arc with line segments, for graphics
+ * contexts that do not draw arcs natively
+ * 
+ * @param   points       Output parameter for the points, room for `segments + 1` is required
+ * @param   area         The rectangle the sliced circles is scribed into
+ * @param   start_angle  The start of the arc, in degrees anti-clockwise from the three-o'clock position
+ * @param   arc_angles   The number of degrees between the arc start and arc end,
+ *                       the magnitude is truncated to 360
+ * @param   segments     The number of segments a full turn is approximated with
+ * @return               The number of points
+ */
+long itk_graphics_arc_points(position2_t* points, rectangle_t area, float start_angle, float arc_angles,
+			     long segments);
+
 #undef __this__
 
 
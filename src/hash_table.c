@@ -18,8 +18,11 @@
  */
 #include "hash_table.h"
 #include "itkmacros.h"
+#include "probes.h"
+#include "metrics.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 
 #define __this__  itk_hash_table* this
@@ -51,58 +54,233 @@ static inline long hash(__this__, void* key)
 /**
  * Truncates the hash of a key to constrain it to the buckets
  * 
- * @param   key  The key to hash
- * @return       A non-negative value less the the table's capacity
+ * @param   hash      The hash of the key
+ * @param   capacity  The number of buckets
+ * @return            A non-negative value less the the capacity
  */
-static inline long truncate_hash(__this__, long hash)
+static inline long truncate_hash(long hash, long capacity)
 {
-  long rc = hash % this->capacity;
+  long rc = hash % capacity;
   return rc < 0 ? -rc : rc;
 }
 
 
 /**
- * Grow the table
+ * Add a slab of unused entries to the table
+ * 
+ * @param  count  The number of entries in the slab
  */
-static void rehash(__this__)
+static void add_slab(__this__, long count)
+{
+  itk_hash_slab* slab = malloc(sizeof(itk_hash_slab) + count * sizeof(itk_hash_entry));
+  
+  slab->next = this->slabs;
+  slab->count = count;
+  this->slabs = slab;
+  
+  while (this->fresh_count)
+    {
+      this->fresh_count--;
+      this->fresh->next = this->unused;
+      this->unused = this->fresh++;
+      this->unused_count++;
+    }
+  
+  this->fresh = (itk_hash_entry*)(slab + 1);
+  this->fresh_count = count;
+}
+
+
+/**
+ * Take an unused entry, a new slab is allocated if there are none
+ * 
+ * @return  An unused entry
+ */
+static inline itk_hash_entry* new_entry(__this__)
+{
+  itk_hash_entry* rc;
+  
+  if ((rc = this->unused))
+    {
+      this->unused = rc->next;
+      this->unused_count--;
+      return rc;
+    }
+  
+  if (this->fresh_count == 0)
+    add_slab(this, this->size < 16 ? 16 : this->size);
+  
+  this->fresh_count--;
+  return this->fresh++;
+}
+
+
+/**
+ * Return an entry that is no longer in use
+ * 
+ * @param  entry  The entry
+ */
+static inline void recycle_entry(__this__, itk_hash_entry* entry)
+{
+  entry->next = this->unused;
+  this->unused = entry;
+  this->unused_count++;
+}
+
+
+/**
+ * Free all slabs, and thus all entries
+ */
+static void free_slabs(__this__)
+{
+  itk_hash_slab* slab = this->slabs;
+  itk_hash_slab* next;
+  
+  while (slab)
+    {
+      next = slab->next;
+      free(slab);
+      slab = next;
+    }
+  
+  this->slabs = NULL;
+  this->unused = NULL;
+  this->unused_count = 0;
+  this->fresh = NULL;
+  this->fresh_count = 0;
+}
+
+
+/**
+ * Update the reverse index of values, if it is used
+ * 
+ * @param  value  The value
+ * @param  delta  The change in the number of entries with the value
+ */
+static inline void index_value(__this__, void* value, long delta)
+{
+  itk_hash_table* index = this->value_index;
+  long count;
+  
+  if (index == NULL)
+    return;
+  
+  if ((count = (long)itk_hash_table_get(index, value) + delta))
+    itk_hash_table_put(index, value, (void*)count);
+  else
+    itk_hash_table_remove(index, value);
+}
+
+
+/**
+ * Move the entries in a bucket array to the table's current buckets
+ * 
+ * @param  buckets  The bucket array
+ * @param  first    The index of the first bucket to move
+ * @param  end      The index after the last bucket to move
+ */
+static void move_buckets(__this__, itk_hash_entry** buckets, long first, long end)
 {
-  itk_hash_entry** old_buckets = this->buckets;
-  long old_capacity = this->capacity;
-  long i = old_capacity, index;
   itk_hash_entry* bucket;
-  itk_hash_entry* destination;
   itk_hash_entry* next;
+  long index;
   
-  this->capacity = old_capacity * 2 + 1;
-  this->threshold = (long)(this->capacity * this->load_factor);
-  this->buckets = calloc(this->capacity, sizeof(itk_hash_entry*));
-  
-  while (i)
+  while (end > first)
     {
-      bucket = *(this->buckets + --i);
+      bucket = *(buckets + --end);
       while (bucket)
 	{
-	  index = truncate_hash(this, bucket->hash);
-	  if ((destination = *(this->buckets + index)))
-	    {
-	      next = destination->next;
-	      while (next)
-		{
-		  destination = next;
-		  next = destination->next;
-		}
-	      destination->next = bucket;
-	    }
-	  else
-	    *(this->buckets + index) = bucket;
-	  
 	  next = bucket->next;
-	  bucket->next = NULL;
+	  index = truncate_hash(bucket->hash, this->capacity);
+	  bucket->next = *(this->buckets + index);
+	  *(this->buckets + index) = bucket;
 	  bucket = next;
 	}
     }
+}
+
+
+/**
+ * Move some of the buckets that remain in `old_buckets`
+ * 
+ * @param  count  The maximum number of buckets to move, -1 for all
+ */
+static void migrate(__this__, long count)
+{
+  long end = this->migrating;
+  
+  if (this->old_buckets == NULL)
+    return;
+  
+  this->migrating = (count < 0) || (count > end) ? 0 : end - count;
+  move_buckets(this, this->old_buckets, this->migrating, end);
+  
+  if (this->migrating == 0)
+    {
+      free(this->old_buckets);
+      this->old_buckets = NULL;
+    }
+}
+
+
+/**
+ * Grow the table
+ * 
+ * @param  capacity     The new capacity
+ * @param  incremental  Whether to move the entries a few buckets at a time,
+ *                      in later calls to `itk_hash_table_put`
+ */
+static void rehash(__this__, long capacity, bool_t incremental)
+{
+  itk_hash_entry** old_buckets = this->buckets;
+  long old_capacity = this->capacity;
+  
+  ITK_PROBE(hash_rehash_entry, this, old_capacity, capacity, (int)incremental);
+  itk_metrics_add(ITK_METRIC_HASH_REHASHES, 1);
+  migrate(this, -1);
+  
+  this->capacity = capacity;
+  this->threshold = (long)(this->capacity * this->load_factor);
+  this->buckets = calloc(this->capacity, sizeof(itk_hash_entry*));
+  
+  if (incremental)
+    {
+      this->old_buckets = old_buckets;
+      this->old_capacity = old_capacity;
+      this->migrating = old_capacity;
+    }
+  else
+    {
+      move_buckets(this, old_buckets, 0, old_capacity);
+      free(old_buckets);
+    }
+  ITK_PROBE(hash_rehash_return, this, capacity);
+}
+
+
+/**
+ * Find the link to the entry with a specific key
+ * 
+ * @param   key       The key
+ * @param   key_hash  The hash of the key
+ * @return            The bucket or `next` pointer that points to the entry,
+ *                    `NULL` if the key is not used
+ */
+static itk_hash_entry** find(__this__, void* key, long key_hash)
+{
+  itk_hash_entry** link = this->buckets + truncate_hash(key_hash, this->capacity);
+  long index;
   
-  free(old_buckets);
+  for (; *link; link = &((*link)->next))
+    if (TEST_KEY(this, (*link), key, key_hash))
+      return link;
+  
+  if (this->old_buckets && ((index = truncate_hash(key_hash, this->old_capacity)) < this->migrating))
+    for (link = this->old_buckets + index; *link; link = &((*link)->next))
+      if (TEST_KEY(this, (*link), key, key_hash))
+	return link;
+  
+  return NULL;
 }
 
 
@@ -131,24 +309,31 @@ itk_hash_table* itk_new_hash_table_fine_tuned(long initial_capacity, float load_
  */
 void itk_free_hash_table(__this__, bool_t values, bool_t keys)
 {
-  long i = this->capacity;
+  long i;
   itk_hash_entry* bucket;
-  itk_hash_entry* last;
   
-  while (i)
-    {
-      bucket = *(this->buckets + --i);
-      while (bucket)
-	{
-	  if (values)
-	    free(bucket->value);
-	  if (keys)
-	    free(bucket->key);
-	  bucket = (last = bucket)->next;
-	  free(last);
-	}
-    }
+  if (values || keys)
+    migrate(this, -1);
+  
+  i = this->capacity;
+  if (values || keys)
+    while (i)
+      {
+	bucket = *(this->buckets + --i);
+	while (bucket)
+	  {
+	    if (values)
+	      free(bucket->value);
+	    if (keys)
+	      free(bucket->key);
+	    bucket = bucket->next;
+	  }
+      }
   
+  if (this->value_index)
+    itk_free_hash_table(this->value_index, false, false);
+  free_slabs(this);
+  free(this->old_buckets);
   free(this->buckets);
   free(this);
 }
@@ -165,6 +350,9 @@ bool_t itk_hash_table_contains_value(__this__, void* value)
   long i = this->capacity;
   itk_hash_entry* bucket;
   
+  if (this->value_index)
+    return itk_hash_table_contains_key(this->value_index, value);
+  
   while (i)
     {
       bucket = *(this->buckets + --i);
@@ -178,6 +366,19 @@ bool_t itk_hash_table_contains_value(__this__, void* value)
 	}
     }
   
+  for (i = this->old_buckets ? this->migrating : 0; i;)
+    {
+      bucket = *(this->old_buckets + --i);
+      while (bucket)
+	{
+	  if (bucket->value == value)
+	    return true;
+	  if (this->value_comparator && this->value_comparator(bucket->value, value))
+	    return true;
+	  bucket = bucket->next;
+	}
+    }
+  
   return false;
 }
 
@@ -190,18 +391,7 @@ bool_t itk_hash_table_contains_value(__this__, void* value)
  */
 bool_t itk_hash_table_contains_key(__this__, void* key)
 {
-  long key_hash = hash(this, key);
-  long index = truncate_hash(this, key_hash);
-  itk_hash_entry* bucket = *(this->buckets + index);
-  
-  while (bucket)
-    {
-      if (TEST_KEY(this, bucket, key, key_hash))
-	return true;
-      bucket = bucket->next;
-    }
-  
-  return false;
+  return find(this, key, hash(this, key)) != NULL;
 }
 
 
@@ -213,18 +403,8 @@ bool_t itk_hash_table_contains_key(__this__, void* key)
  */
 void* itk_hash_table_get(__this__, void* key)
 {
-  long key_hash = hash(this, key);
-  long index = truncate_hash(this, key_hash);
-  itk_hash_entry* bucket = *(this->buckets + index);
-  
-  while (bucket)
-    {
-      if (TEST_KEY(this, bucket, key, key_hash))
-	return bucket->value;
-      bucket = bucket->next;
-    }
-  
-  return NULL;
+  itk_hash_entry** link = find(this, key, hash(this, key));
+  return link ? (*link)->value : NULL;
 }
 
 
@@ -238,33 +418,37 @@ void* itk_hash_table_get(__this__, void* key)
 void* itk_hash_table_put(__this__, void* key, void* value)
 {
   long key_hash = hash(this, key);
-  long index = truncate_hash(this, key_hash);
-  itk_hash_entry* bucket = *(this->buckets + index);
+  itk_hash_entry** link = find(this, key, key_hash);
+  itk_hash_entry* bucket;
+  long index;
   void* rc;
   
-  while (bucket)
-    if (TEST_KEY(this, bucket, key, key_hash))
-      {
-	rc = bucket->value;
-	bucket->value = value;
-	return rc;
-      }
-    else
-      bucket = bucket->next;
-  
-  if (++(this->size) > this->threshold)
+  if (link)
     {
-      rehash(this);
-      index = truncate_hash(this, key_hash);
+      bucket = *link;
+      rc = bucket->value;
+      bucket->value = value;
+      index_value(this, rc, -1);
+      index_value(this, value, 1);
+      ITK_PROBE(hash_put, this, this->size, this->capacity);
+      return rc;
     }
   
-  bucket = malloc(sizeof(itk_hash_entry));
+  migrate(this, ITK_HASH_MIGRATION_STEP);
+  
+  if (++(this->size) > this->threshold)
+    rehash(this, this->capacity * 2 + 1, this->incremental);
+  
+  index = truncate_hash(key_hash, this->capacity);
+  bucket = new_entry(this);
   bucket->value = value;
   bucket->key = key;
   bucket->hash = key_hash;
   bucket->next = *(this->buckets + index);
   *(this->buckets + index) = bucket;
   
+  index_value(this, value, 1);
+  ITK_PROBE(hash_put, this, this->size, this->capacity);
   return NULL;
 }
 
@@ -277,30 +461,20 @@ void* itk_hash_table_put(__this__, void* key, void* value)
  */
 void* itk_hash_table_remove(__this__, void* key)
 {
-  long key_hash = hash(this, key);
-  long index = truncate_hash(this, key_hash);
-  itk_hash_entry* bucket = *(this->buckets + index);
-  itk_hash_entry* last = NULL;
+  itk_hash_entry** link = find(this, key, hash(this, key));
+  itk_hash_entry* bucket;
   void* rc;
   
-  while (bucket)
-    {
-      if (TEST_KEY(this, bucket, key, key_hash))
-	{
-	  if (last == NULL)
-	    *(this->buckets + index) = bucket->next;
-	  else
-	    last->next = bucket->next;
-	  this->size--;
-	  rc = bucket->value;
-	  free(bucket);
-	  return rc;
-	}
-      last = bucket;
-      bucket = bucket->next;
-    }
+  if (link == NULL)
+    return NULL;
   
-  return NULL;
+  bucket = *link;
+  *link = bucket->next;
+  this->size--;
+  rc = bucket->value;
+  recycle_entry(this, bucket);
+  index_value(this, rc, -1);
+  return rc;
 }
 
 
@@ -309,29 +483,127 @@ void* itk_hash_table_remove(__this__, void* key)
  */
 void itk_hash_table_clear(__this__)
 {
-  itk_hash_entry** buf;
-  itk_hash_entry* bucket;
-  long i, ptr;
-  
   if (this->size)
     {
-      buf = alloca((this->size + 1) * sizeof(itk_hash_entry*));
-      i = this->capacity;
-      while (i)
-	{
-	  bucket = *(this->buckets + --i);
-	  ptr = 0;
-	  *(buf + ptr++) = bucket;
-	  while (bucket)
-	    {
-	      bucket = bucket->next;
-	      *(buf + ptr++) = bucket;
-	    }
-	  while (ptr)
-	    free(*(buf + --ptr));
-	  *(this->buckets + i) = NULL;
-	}
+      memset(this->buckets, 0, this->capacity * sizeof(itk_hash_entry*));
       this->size = 0;
     }
+  free(this->old_buckets);
+  this->old_buckets = NULL;
+  this->migrating = 0;
+  free_slabs(this);
+  if (this->value_index)
+    itk_hash_table_clear(this->value_index);
+}
+
+
+/**
+ * Make room for a number of entries, so that the
+ * table does not need to grow until it holds more
+ * entries than that
+ * 
+ * @param  n  The number of entries the table should be able to hold
+ */
+void itk_hash_table_reserve(__this__, long n)
+{
+  if (n > this->threshold)
+    rehash(this, (long)(n / this->load_factor) + 1, false);
+  
+  if (n > this->size + this->unused_count + this->fresh_count)
+    add_slab(this, n - this->size - this->unused_count);
+}
+
+
+
+/**
+ * Add multiple entries to the table, the table
+ * is grown at most once
+ * 
+ * @param  keys    The keys of the entries to add
+ * @param  values  The values of the entries to add
+ * @param  n       The number of elements in `keys` and in `values`
+ */
+void itk_hash_table_put_all(__this__, void** keys, void** values, long n)
+{
+  long i;
+  
+  itk_hash_table_reserve(this, this->size + n);
+  for (i = 0; i < n; i++)
+    itk_hash_table_put(this, *(keys + i), *(values + i));
+}
+
+
+/**
+ * Maintain a reverse index of the values in the table,
+ * which makes `itk_hash_table_contains_value` run in
+ * constant time rather than linear time
+ * 
+ * If `value_comparator` is used, it must be set before
+ * this function is called and `value_hasher` must return
+ * the same hash for values that it considers equal
+ * 
+ * @param  value_hasher  Function that calculates the hash of a value,
+ *                       `NULL` for the identity hash
+ */
+void itk_hash_table_index_values(__this__, long (*value_hasher)(void* value))
+{
+  itk_hash_cursor cursor;
+  itk_hash_entry* entry;
+  
+  if (this->value_index)
+    itk_free_hash_table(this->value_index, false, false);
+  
+  this->value_index = itk_new_hash_table();
+  this->value_index->key_comparator = this->value_comparator;
+  this->value_index->hasher = value_hasher;
+  itk_hash_table_reserve(this->value_index, this->size);
+  
+  itk_hash_table_cursor(this, &cursor);
+  while ((entry = itk_hash_cursor_next(&cursor)))
+    index_value(this, entry->value, 1);
 }
 
+
+/**
+ * Start iterating over the entries in the table
+ * 
+ * The table must not be modified while it is iterated,
+ * except that the last returned entry may be removed
+ * 
+ * @param  cursor  Output parameter for the cursor
+ */
+void itk_hash_table_cursor(__this__, itk_hash_cursor* cursor)
+{
+  cursor->table = this;
+  cursor->bucket = 0;
+  cursor->entry = NULL;
+}
+
+#undef __this__
+
+
+/**
+ * Get the next entry in an iteration
+ * 
+ * @param   cursor  The cursor
+ * @return          The next entry, `NULL` when all entries have been visited
+ */
+itk_hash_entry* itk_hash_cursor_next(itk_hash_cursor* cursor)
+{
+  itk_hash_table* table = cursor->table;
+  itk_hash_entry* rc = cursor->entry;
+  long end = table->capacity + (table->old_buckets ? table->migrating : 0);
+  
+  while (rc == NULL)
+    {
+      if (cursor->bucket == end)
+	return NULL;
+      if (cursor->bucket < table->capacity)
+	rc = *(table->buckets + cursor->bucket++);
+      else
+	rc = *(table->old_buckets + cursor->bucket++ - table->capacity);
+    }
+  
+  cursor->entry = rc->next;
+  return rc;
+}
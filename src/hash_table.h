@@ -22,6 +22,12 @@
 #include "itktypes.h"
 
 
+/**
+ * The number of buckets an incrementally growing table moves per insertion
+ */
+#define ITK_HASH_MIGRATION_STEP  4
+
+
 /**
  * Hash table entry
  */
@@ -50,6 +56,25 @@ typedef struct _itk_hash_entry
 } itk_hash_entry;
 
 
+/**
+ * Block of hash table entries that are allocated together,
+ * the entries are stored directly after this header
+ */
+typedef struct _itk_hash_slab
+{
+  /**
+   * The next slab owned by the same table
+   */
+  struct _itk_hash_slab* next;
+  
+  /**
+   * The number of entries in the slab
+   */
+  long count;
+  
+} itk_hash_slab;
+
+
 /**
  * Value lookup table based on hash value, that do not support `NULL` keys nor `NULL` values
  */
@@ -80,6 +105,61 @@ typedef struct _itk_hash_table
    */
   long size;
   
+  /**
+   * The slabs from which entries are allocated
+   */
+  itk_hash_slab* slabs;
+  
+  /**
+   * Entries in `slabs` that are not in use, linked by `next`
+   */
+  itk_hash_entry* unused;
+  
+  /**
+   * The number of entries in `unused`
+   */
+  long unused_count;
+  
+  /**
+   * Entries at the end of the newest slab that have never been used
+   */
+  itk_hash_entry* fresh;
+  
+  /**
+   * The number of entries in `fresh`
+   */
+  long fresh_count;
+  
+  /**
+   * Whether the table grows incrementally, in that case the entries
+   * are moved a few buckets at a time by each insertion rather than
+   * all at once by the insertion that makes the table grow
+   */
+  bool_t incremental;
+  
+  /**
+   * The bucket array the entries are being moved from when
+   * the table grows incrementally, `NULL` when not growing
+   */
+  itk_hash_entry** old_buckets;
+  
+  /**
+   * The capacity of `old_buckets`
+   */
+  long old_capacity;
+  
+  /**
+   * The number of buckets, at the beginning of `old_buckets`,
+   * that have not yet been moved
+   */
+  long migrating;
+  
+  /**
+   * Reverse index that maps values to the number of entries
+   * with that value, `NULL` if values are not indexed
+   */
+  struct _itk_hash_table* value_index;
+  
   /**
    * Check whether two values are equal
    * 
@@ -115,6 +195,29 @@ typedef struct _itk_hash_table
 } itk_hash_table;
 
 
+/**
+ * Cursor for iterating over the entries in a hash table
+ */
+typedef struct _itk_hash_cursor
+{
+  /**
+   * The table whose entries are iterated
+   */
+  itk_hash_table* table;
+  
+  /**
+   * The index of the next bucket to visit
+   */
+  long bucket;
+  
+  /**
+   * The next entry to return, `NULL` if `bucket` should be visited next
+   */
+  itk_hash_entry* entry;
+  
+} itk_hash_cursor;
+
+
 #define __this__  itk_hash_table* this
 
 /**
@@ -191,8 +294,60 @@ void* itk_hash_table_remove(__this__, void* key);
  */
 void itk_hash_table_clear(__this__);
 
+/**
+ * Make room for a number of entries, so that the
+ * table does not need to grow until it holds more
+ * entries than that
+ * 
+ * @param  n  The number of entries the table should be able to hold
+ */
+void itk_hash_table_reserve(__this__, long n);
+
+/**
+ * Add multiple entries to the table, the table
+ * is grown at most once
+ * 
+ * @param  keys    The keys of the entries to add
+ * @param  values  The values of the entries to add
+ * @param  n       The number of elements in `keys` and in `values`
+ */
+void itk_hash_table_put_all(__this__, void** keys, void** values, long n);
+
+/**
+ * Maintain a reverse index of the values in the table,
+ * which makes `itk_hash_table_contains_value` run in
+ * constant time rather than linear time
+ * 
+ * If `value_comparator` is used, it must be set before
+ * this function is called and `value_hasher` must return
+ * the same hash for values that it considers equal
+ * 
+ * @param  value_hasher  Function that calculates the hash of a value,
+ *                       `NULL` for the identity hash
+ */
+void itk_hash_table_index_values(__this__, long (*value_hasher)(void* value));
+
+/**
+ * Start iterating over the entries in the table
+ * 
+ * The table must not be modified while it is iterated,
+ * except that the last returned entry may be removed
+ * 
+ * @param  cursor  Output parameter for the cursor
+ */
+void itk_hash_table_cursor(__this__, itk_hash_cursor* cursor);
+
 #undef __this__
 
 
+/**
+ * Get the next entry in an iteration
+ * 
+ * @param   cursor  The cursor
+ * @return          The next entry, `NULL` when all entries have been visited
+ */
+itk_hash_entry* itk_hash_cursor_next(itk_hash_cursor* cursor);
+
+
 #endif
 
@@ -223,5 +223,174 @@ static inline rectangle_t new_rectangle(position_t x, position_t y, dimension_t
 }
 
 
+/**
+ * Create a packed two-dimensional size value
+ * 
+ * @param   width   The width, can be `UNBOUNDED`
+ * @param   height  The height, can be `UNBOUNDED`
+ * @return          A value containing both `width` and `height`
+ */
+static inline packed_size2_t new_packed_size2(dimension_t width, dimension_t height)
+{
+  packed_size2_t rc;
+  rc.width = width;
+  rc.height = height;
+  return rc;
+}
+
+
+/**
+ * Create a packed two-dimensional position value
+ * 
+ * @param   x  The position on the horizontal axis
+ * @param   y  The position on the vertical axis
+ * @return     A value containing both `x` and `y`
+ */
+static inline packed_position2_t new_packed_position2(position_t x, position_t y)
+{
+  packed_position2_t rc;
+  rc.x = x;
+  rc.y = y;
+  return rc;
+}
+
+
+/**
+ * Create a packed rectangle value
+ * 
+ * @param   x       The position on the horizontal axis
+ * @param   y       The position on the vertical axis
+ * @param   width   The width
+ * @param   height  The height
+ * @return          A value containing the parameters
+ */
+static inline packed_rectangle_t new_packed_rectangle(position_t x, position_t y,
+						      dimension_t width, dimension_t height)
+{
+  packed_rectangle_t rc;
+  rc.x = x;
+  rc.y = y;
+  rc.width = width;
+  rc.height = height;
+  return rc;
+}
+
+
+/**
+ * Create a packed rectangle value that is not defined
+ * 
+ * @return  A rectangle that is not defined
+ */
+static inline packed_rectangle_t undefined_packed_rectangle(void)
+{
+  return new_packed_rectangle(0, 0, ITK_UNDEFINED, 0);
+}
+
+
+/**
+ * Check whether a packed size is defined
+ * 
+ * @param   size  The size
+ * @return        Whether the size is defined
+ */
+#define packed_size2_defined(size)  ((size).width != ITK_UNDEFINED)
+
+/**
+ * Check whether a packed position is defined
+ * 
+ * @param   position  The position
+ * @return            Whether the position is defined
+ */
+#define packed_position2_defined(position)  ((position).x != ITK_UNDEFINED)
+
+/**
+ * Check whether a packed rectangle is defined
+ * 
+ * @param   rectangle  The rectangle
+ * @return             Whether the rectangle is defined
+ */
+#define packed_rectangle_defined(rectangle)  ((rectangle).width != ITK_UNDEFINED)
+
+
+/**
+ * Convert a size to a packed size
+ * 
+ * @param   size  The size
+ * @return        The size, packed
+ */
+static inline packed_size2_t pack_size2(size2_t size)
+{
+  return new_packed_size2(size.defined ? size.width : ITK_UNDEFINED, size.height);
+}
+
+
+/**
+ * Convert a packed size to a size
+ * 
+ * @param   size  The packed size
+ * @return        The size
+ */
+static inline size2_t unpack_size2(packed_size2_t size)
+{
+  size2_t rc = new_size2(size.width, size.height);
+  rc.defined = packed_size2_defined(size);
+  return rc;
+}
+
+
+/**
+ * Convert a position to a packed position
+ * 
+ * @param   position  The position
+ * @return            The position, packed
+ */
+static inline packed_position2_t pack_position2(position2_t position)
+{
+  return new_packed_position2(position.defined ? position.x : ITK_UNDEFINED, position.y);
+}
+
+
+/**
+ * Convert a packed position to a position
+ * 
+ * @param   position  The packed position
+ * @return            The position
+ */
+static inline position2_t unpack_position2(packed_position2_t position)
+{
+  position2_t rc = new_position2(position.x, position.y);
+  rc.defined = packed_position2_defined(position);
+  return rc;
+}
+
+
+/**
+ * Convert a rectangle to a packed rectangle
+ * 
+ * @param   rectangle  The rectangle
+ * @return             The rectangle, packed
+ */
+static inline packed_rectangle_t pack_rectangle(rectangle_t rectangle)
+{
+  return new_packed_rectangle(rectangle.x, rectangle.y,
+			      rectangle.defined ? rectangle.width : ITK_UNDEFINED,
+			      rectangle.height);
+}
+
+
+/**
+ * Convert a packed rectangle to a rectangle
+ * 
+ * @param   rectangle  The packed rectangle
+ * @return             The rectangle
+ */
+static inline rectangle_t unpack_rectangle(packed_rectangle_t rectangle)
+{
+  rectangle_t rc = new_rectangle(rectangle.x, rectangle.y, rectangle.width, rectangle.height);
+  rc.defined = packed_rectangle_defined(rectangle);
+  return rc;
+}
+
+
 #endif
 
@@ -227,5 +227,82 @@ typedef struct _rectangle_t
 } rectangle_t;
 
 
+/**
+ * The value that marks a packed geometry value as not defined, it is stored in
+ * `x` of positions, and in `width` of sizes and rectangles, see each type
+ */
+#define ITK_UNDEFINED  INT32_MIN
+
+
+/**
+ * Two-dimensional size structure without `defined`,
+ * `width` is `ITK_UNDEFINED` if the value is not defined
+ */
+typedef struct _packed_size2_t
+{
+  /**
+   * The width component of the size
+   */
+  dimension_t width;
+  
+  /**
+   * The height component of the size
+   */
+  dimension_t height;
+  
+} packed_size2_t;
+
+
+/**
+ * Two-dimensional position structure without `defined`,
+ * `x` is `ITK_UNDEFINED` if the value is not defined
+ */
+typedef struct _packed_position2_t
+{
+  /**
+   * The position on the horizontal axis
+   */
+  position_t x;
+  
+  /**
+   * The position on the vertical axis
+   */
+  position_t y;
+  
+} packed_position2_t;
+
+
+/**
+ * Rectangle structure without `defined`, `width`
+ * is `ITK_UNDEFINED` if the value is not defined
+ * 
+ * It is 16 bytes, so it fits in two registers or one
+ * SSE register, and four of them fill a cache line
+ */
+typedef struct _packed_rectangle_t
+{
+  /**
+   * The position on the horizontal axis
+   */
+  position_t x;
+  
+  /**
+   * The position on the vertical axis
+   */
+  position_t y;
+  
+  /**
+   * The width component of the size
+   */
+  dimension_t width;
+  
+  /**
+   * The height component of the size
+   */
+  dimension_t height;
+  
+} packed_rectangle_t;
+
+
 #endif
 
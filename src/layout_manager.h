@@ -22,21 +22,19 @@
 #include "itktypes.h"
 
 struct _itk_component;
+struct _itk_layout_manager;
 
 
 #define __this__  struct _itk_layout_manager* this
 
 /**
- * Component layout manager
+ * The methods of a kind of layout manager
+ * 
+ * Layout managers of the same kind share one vtable, to override
+ * methods point `vtable` to a modified copy of the vtable
  */
-typedef struct _itk_layout_manager
+typedef struct _itk_layout_manager_vtable
 {
-  /**
-   * Internal use data
-   */
-  void** data;
-  
-  
   /**
    * Prepare the layout manager for locating of multiple components, probably all of them
    */
@@ -53,7 +51,7 @@ typedef struct _itk_layout_manager
    * @param   child  The child, to the component using the layout manager, of interest
    * @return         The rectangle the child is confound in
    */
-  rectangle_t (*locate)(__this__, struct _itk_component* child);
+  packed_rectangle_t (*locate)(__this__, struct _itk_component* child);
   
   /**
    * Calculate the combined advisory minimum size of all components
@@ -82,6 +80,27 @@ typedef struct _itk_layout_manager
    */
   void (*free)(__this__);
   
+} itk_layout_manager_vtable;
+
+
+/**
+ * Component layout manager
+ * 
+ * Layout managers are allocated together with their
+ * internal use data, so a single `free` releases both
+ */
+typedef struct _itk_layout_manager
+{
+  /**
+   * The layout manager's methods
+   */
+  const itk_layout_manager_vtable* vtable;
+  
+  /**
+   * Internal use data
+   */
+  void** data;
+  
 } itk_layout_manager;
 
 #undef __this__
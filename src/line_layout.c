@@ -18,6 +18,7 @@
  */
 #include "line_layout.h"
 #include "hash_table.h"
+#include "child_hints.h"
 #include "itkmacros.h"
 
 #include <stdlib.h>
@@ -29,10 +30,29 @@
 #define PREPARED_(layout)   *((void**)(layout->data) + 1)
 #define GAP_(layout)        *((void**)(layout->data) + 2)
 
-#define CONTAINER(layout)   ((itk_component*)(CONTAINER_(layout)))
+#define CONTAINER(layout)   itk_component_compact_children(CONTAINER_(layout))
+#define HINTS(layout)       itk_component_child_hints(CONTAINER_(layout))
 #define PREPARED(layout)    ((itk_hash_table*)(PREPARED_(layout)))
 #define GAP(layout)         *((dimension_t*)(GAP_(layout)))
 
+/**
+ * The arguments to `itk_child_hints_totals` for the totals
+ * to calculate, when the major size is the width
+ * 
+ * @param  MAJOR_TOTAL  The total to calculate of the major size
+ * @param  MINOR_TOTAL  The total to calculate of the minor size
+ */
+#define TOTALS_width(MAJOR_TOTAL, MINOR_TOTAL)   MAJOR_TOTAL, MINOR_TOTAL
+
+/**
+ * The arguments to `itk_child_hints_totals` for the totals
+ * to calculate, when the major size is the height
+ * 
+ * @param  MAJOR_TOTAL  The total to calculate of the major size
+ * @param  MINOR_TOTAL  The total to calculate of the minor size
+ */
+#define TOTALS_height(MAJOR_TOTAL, MINOR_TOTAL)  MINOR_TOTAL, MAJOR_TOTAL
+
 
 /**
  * Prepare the layout manager for locating of multiple components, probably all of them
@@ -45,49 +65,50 @@
 #define prepare_(this, MAJOR, MINOR, AXIS, REVERSED)			\
   ({									\
     itk_hash_table* prepared = PREPARED_(this) = itk_new_hash_table();	\
-    itk_component* container = CONTAINER(this);				\
+    itk_child_hints* hints = HINTS(this);				\
+    itk_component* container = CONTAINER_(this);			\
     long i, n;								\
-    if ((n = container->children_count))				\
+    if ((n = hints->count))						\
       {									\
+	itk_hash_table_reserve(prepared, n);				\
 	itk_component** children = container->children;			\
+	bool_t* visible = hints->visible;				\
+	dimension_t* minimum = hints->minimum_##MAJOR;			\
+	dimension_t* preferred = hints->preferred_##MAJOR;		\
 	rectangle_t* buf = alloca(n * sizeof(rectangle_t));		\
 	dimension_t gap = GAP(this);					\
 	dimension_t MINOR = container->size.MINOR;			\
 	dimension_t MAJOR = container->size.MAJOR - gap * (n - 1);	\
 	position_t AXIS = 0;						\
 	for (i = 0; i < n; i++)						\
-	  if ((*(children + i))->visible)				\
+	  if (*(visible + i))						\
 	    {								\
-	      if (((buf + i)->MAJOR = (*(children + i))->minimum_size.MAJOR) < 0) \
+	      if (((buf + i)->MAJOR = *(minimum + i)) < 0)		\
 		(buf + i)->MAJOR = 0;					\
 	      MAJOR -= (buf + i)->MAJOR;				\
 	    }								\
 	while (MAJOR > 0)						\
 	  {								\
-	    itk_component** child;					\
-	    itk_component** end = children + n;				\
 	    long can_grow = 0;						\
-	    for (child = children; child != end; child++)		\
-	      if ((*(children + i))->visible)				\
-		if ((buf + i)->MAJOR < (*child)->preferred_size.MAJOR)	\
-		  can_grow++;						\
-	    if (can_grow)						\
-	      {								\
-		dimension_t increment = MAJOR / can_grow, max, now;	\
-		if (increment == 0)					\
-		  increment = 1;					\
-		for (child = children; (child != end) && MAJOR; child++) \
-		  if ((*(children + i))->visible)			\
-		    if ((now = (buf + i)->MAJOR) < (max = (*child)->preferred_size.MAJOR)) \
-		      {							\
-			dimension_t soon = now + increment;		\
-			(buf + i)->MAJOR = soon < max ? soon : max;	\
-			MAJOR -= (buf + i)->MAJOR - now;		\
-		      }							\
-	      }								\
+	    for (i = 0; i < n; i++)					\
+	      if (*(visible + i) && ((buf + i)->MAJOR < *(preferred + i))) \
+		can_grow++;						\
+	    if (can_grow == 0)						\
+	      break;							\
+	    dimension_t increment = MAJOR / can_grow, max, now;		\
+	    if (increment == 0)						\
+	      increment = 1;						\
+	    for (i = 0; (i < n) && MAJOR; i++)				\
+	      if (*(visible + i))					\
+		if ((now = (buf + i)->MAJOR) < (max = *(preferred + i))) \
+		  {							\
+		    dimension_t soon = now + increment;			\
+		    (buf + i)->MAJOR = soon < max ? soon : max;		\
+		    MAJOR -= (buf + i)->MAJOR - now;			\
+		  }							\
 	  }								\
 	for (i = 0; i < n; i++)						\
-	  if (((buf + i)->defined = (*(children + i))->visible))	\
+	  if (((buf + i)->defined = *(visible + i)))			\
 	    {								\
 	      (buf + i)->MINOR = MINOR;					\
 	      (buf + i)->y = (buf + i)->x = 0;				\
@@ -164,28 +185,25 @@ static void done(__this__)
  * @param   child  The child, to the component using the layout manager, of interest
  * @return         The rectangle the child is confound in
  */
-static rectangle_t locate(__this__, itk_component* child)
+static packed_rectangle_t locate(__this__, itk_component* child)
 {
+  packed_rectangle_t rc = undefined_packed_rectangle();
   rectangle_t* r;
   bool_t p = PREPARED(this) == NULL;
   
   if (p)
-    this->prepare(this);
+    this->vtable->prepare(this);
   
   if ((r = itk_hash_table_get(PREPARED(this), child)))
-    child->size = new_size2(r->width, r->height);
+    {
+      child->size = new_size2(r->width, r->height);
+      rc = pack_rectangle(*r);
+    }
   
   if (p)
-    this->done(this);
+    this->vtable->done(this);
   
-  if (r)
-    return *r;
-  else
-    {
-      rectangle_t rc;
-      rc.defined = false;
-      return rc;
-    }
+  return rc;
 }
 
 
@@ -198,23 +216,15 @@ static rectangle_t locate(__this__, itk_component* child)
  */
 #define minimum_size_(this, MAJOR, MINOR)			\
   ({								\
-    itk_component** children = CONTAINER(this)->children;	\
-    long i, n = CONTAINER(this)->children_count, n_ = 0;	\
-    size2_t rc, t;						\
-    rc.width = rc.height = 0;					\
+    itk_child_totals totals = itk_child_hints_totals(CONTAINER_(this), ITK_CHILD_HINT_MINIMUM, \
+						     TOTALS_##MAJOR(ITK_CHILD_TOTAL_BOUNDED_SUM, \
+								    ITK_CHILD_TOTAL_MAX)); \
+    long n = totals.visible_count;				\
+    size2_t rc;							\
     rc.defined = true;						\
-    for (i = 0; i < n; i++)					\
-      if ((*(children + i))->visible)				\
-	{							\
-	  t = (*(children + i))->minimum_size;			\
-	  if (t.MAJOR > 0)					\
-	    rc.MAJOR += t.MAJOR;				\
-	  if ((rc.MINOR < t.MINOR) && (t.MINOR > 0))		\
-	    rc.MINOR = t.MINOR;					\
-	}							\
-      else							\
-	n_++;							\
-    if ((n -= n_))						\
+    rc.MAJOR = totals.MAJOR;					\
+    rc.MINOR = totals.MINOR;					\
+    if (n)							\
       rc.MAJOR += GAP(this) * (n - 1);				\
     rc /* return */;						\
   })
@@ -229,30 +239,18 @@ static rectangle_t locate(__this__, itk_component* child)
  */
 #define maximum_size_(this, MAJOR, MINOR)				\
   ({									\
-    bool_t unbounded = false;						\
-    itk_component** children = CONTAINER(this)->children;		\
-    long i, n = CONTAINER(this)->children_count, n_ = 0;		\
-    size2_t rc, t;							\
-    rc.MAJOR = 0;							\
-    rc.MINOR = UNBOUNDED;						\
+    itk_child_totals totals = itk_child_hints_totals(CONTAINER_(this), ITK_CHILD_HINT_MAXIMUM, \
+						     TOTALS_##MAJOR(ITK_CHILD_TOTAL_BOUNDED_SUM, \
+								    ITK_CHILD_TOTAL_BOUNDED_MIN)); \
+    long n = totals.visible_count;					\
+    size2_t rc;								\
     rc.defined = true;							\
-    for (i = 0; i < n; i++)						\
-      if ((*(children + i))->visible)					\
-	{								\
-	  t = (*(children + i))->maximum_size;				\
-	  if (t.MAJOR < 0)						\
-	    unbounded = true;						\
-	  else								\
-	    rc.MAJOR += t.MAJOR;					\
-	  if (((rc.MINOR < 0) || (rc.MINOR > t.MINOR)) && (t.MINOR >= 0)) \
-	    rc.MINOR = t.MINOR;						\
-	}								\
-      else								\
-	n_++;								\
-    if ((n -= n_))							\
+    rc.MAJOR = totals.MAJOR;						\
+    rc.MINOR = totals.MINOR;						\
+    if (n)								\
       rc.MAJOR += GAP(this) * (n - 1);					\
     else								\
-      if (unbounded)							\
+      if (totals.MAJOR##_unbounded)					\
 	rc.MAJOR = UNBOUNDED;						\
     rc; /* return */							\
   })
@@ -265,26 +263,17 @@ static rectangle_t locate(__this__, itk_component* child)
  */
 #define preferred_size_(this, MAJOR, MINOR)			\
   ({								\
-    size2_t min = this->minimum_size(this);			\
-    size2_t max = this->minimum_size(this);			\
-    itk_component** children = CONTAINER(this)->children;	\
-    long i, n = CONTAINER(this)->children_count, n_ = 0;	\
-    size2_t rc, t;						\
+    size2_t min = this->vtable->minimum_size(this);		\
+    size2_t max = this->vtable->minimum_size(this);		\
+    itk_child_totals totals = itk_child_hints_totals(CONTAINER_(this), ITK_CHILD_HINT_PREFERRED, \
+						     TOTALS_##MAJOR(ITK_CHILD_TOTAL_SUM, \
+								    ITK_CHILD_TOTAL_MAX)); \
+    long n = totals.visible_count;				\
+    size2_t rc;							\
     rc.defined = true;						\
-    rc.MINOR = min.MINOR;					\
-    rc.MAJOR = 0;						\
-								\
-    for (i = 0; i < n; i++)					\
-      if ((*(children + i))->visible)				\
-	{							\
-	  t = (*(children + i))->preferred_size;		\
-	  if (rc.MINOR < t.MINOR)				\
-	    rc.MINOR = t.MINOR;					\
-	  rc.MAJOR += t.MAJOR;					\
-	}							\
-      else							\
-	n_++;							\
-    if ((n -= n_))						\
+    rc.MINOR = totals.MINOR < min.MINOR ? min.MINOR : totals.MINOR; \
+    rc.MAJOR = totals.MAJOR;					\
+    if (n)							\
       rc.MAJOR += GAP(this) * (n - 1);				\
 								\
     if ((rc.MINOR > max.MINOR) && (max.MINOR >= 0))		\
@@ -371,12 +360,67 @@ static void free_line_layout(__this__)
   itk_hash_table* hash_table = PREPARED(this);
   if (hash_table)
     itk_free_hash_table(hash_table, true, false);
-  free(GAP_(this));
-  free(this->data);
   free(this);
 }
 
 
+/**
+ * The methods of horizontal line layout managers
+ */
+static const itk_layout_manager_vtable horizontal_line_layout_vtable =
+  {
+    .prepare        = prepare_h,
+    .done           = done,
+    .locate         = locate,
+    .minimum_size   = minimum_size_h,
+    .preferred_size = preferred_size_h,
+    .maximum_size   = maximum_size_h,
+    .free           = free_line_layout
+  };
+
+/**
+ * The methods of vertical line layout managers
+ */
+static const itk_layout_manager_vtable vertical_line_layout_vtable =
+  {
+    .prepare        = prepare_v,
+    .done           = done,
+    .locate         = locate,
+    .minimum_size   = minimum_size_v,
+    .preferred_size = preferred_size_v,
+    .maximum_size   = maximum_size_v,
+    .free           = free_line_layout
+  };
+
+/**
+ * The methods of reversed horizontal line layout managers
+ */
+static const itk_layout_manager_vtable reversed_horizontal_line_layout_vtable =
+  {
+    .prepare        = prepare_hr,
+    .done           = done,
+    .locate         = locate,
+    .minimum_size   = minimum_size_h,
+    .preferred_size = preferred_size_h,
+    .maximum_size   = maximum_size_h,
+    .free           = free_line_layout
+  };
+
+/**
+ * The methods of reversed vertical line layout managers
+ */
+static const itk_layout_manager_vtable reversed_vertical_line_layout_vtable =
+  {
+    .prepare        = prepare_vr,
+    .done           = done,
+    .locate         = locate,
+    .minimum_size   = minimum_size_v,
+    .preferred_size = preferred_size_v,
+    .maximum_size   = maximum_size_v,
+    .free           = free_line_layout
+  };
+
+
 /**
  * Constructor
  * 
@@ -386,24 +430,17 @@ static void free_line_layout(__this__)
  */
 itk_layout_manager* itk_new_line_layout(itk_component* container, int8_t orientation, dimension_t gap)
 {
-  itk_layout_manager* rc = malloc(sizeof(itk_layout_manager));
-  dimension_t* gap_ = malloc(sizeof(dimension_t));
+  itk_layout_manager* rc = malloc(sizeof(itk_layout_manager) + 3 * sizeof(void*) + sizeof(dimension_t));
   bool_t is_horizontal = orientation < 2;
   bool_t is_reversed = orientation & 1;
-  rc->data = malloc(3 * sizeof(void*));
   if (is_reversed)
-    rc->prepare      = is_horizontal ? prepare_hr : prepare_vr;
+    rc->vtable = is_horizontal ? &reversed_horizontal_line_layout_vtable : &reversed_vertical_line_layout_vtable;
   else
-    rc->prepare      = is_horizontal ? prepare_h  : prepare_v;
-  rc->done           = done;
-  rc->locate         = locate;
-  rc->minimum_size   = is_horizontal ? minimum_size_h   : minimum_size_v;
-  rc->preferred_size = is_horizontal ? preferred_size_h : preferred_size_v;
-  rc->maximum_size   = is_horizontal ? maximum_size_h   : maximum_size_v;
-  rc->free = free_line_layout;
+    rc->vtable = is_horizontal ? &horizontal_line_layout_vtable : &vertical_line_layout_vtable;
+  rc->data = (void**)(rc + 1);
   CONTAINER_(rc) = container;
   PREPARED_(rc) = NULL;
-  GAP_(rc) = gap_;
+  GAP_(rc) = rc->data + 3;
   GAP(rc) = gap;
   return rc;
 }
@@ -0,0 +1,520 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "main_loop.h"
+#include "itkmacros.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+
+#define __this__  itk_main_loop* this
+
+
+/**
+ * A watch that is ready to be dispatched
+ */
+typedef struct ready
+{
+  /**
+   * The watch
+   */
+  itk_main_loop_watch* watch;
+  
+  /**
+   * The ready events
+   */
+  uint32_t events;
+  
+} ready_t;
+
+
+
+/**
+ * Read the monotonic clock
+ * 
+ * @return  The time, in nanoseconds
+ */
+static uint64_t now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)(ts.tv_sec) * 1000000000ULL + (uint64_t)(ts.tv_nsec);
+}
+
+
+/**
+ * Convert a number of nanoseconds to a `struct timespec`
+ * 
+ * @param   ns  The number of nanoseconds
+ * @return      The time
+ */
+static inline struct timespec to_timespec(uint64_t ns)
+{
+  struct timespec rc;
+  rc.tv_sec = (time_t)(ns / 1000000000ULL);
+  rc.tv_nsec = (long)(ns % 1000000000ULL);
+  return rc;
+}
+
+
+/**
+ * Add a watch to the epoll instance and the list of watches
+ * 
+ * @param   watch  The watch, with everything but `next` set
+ * @param   events The events to wait for
+ * @return         `watch`, `NULL` on error, in which case `errno` is set and `watch` is freed
+ */
+static itk_main_loop_watch* add_watch(__this__, itk_main_loop_watch* watch, uint32_t events)
+{
+  struct epoll_event event;
+  int saved_errno;
+  
+  event.events = events;
+  event.data.ptr = watch;
+  if (epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, watch->fd, &event))
+    {
+      saved_errno = errno;
+      if (watch->owns_fd)
+	close(watch->fd);
+      free(watch);
+      errno = saved_errno;
+      return NULL;
+    }
+  
+  watch->next = this->watches;
+  this->watches = watch;
+  return watch;
+}
+
+
+/**
+ * Create a watch
+ * 
+ * @param   fd         The file descriptor
+ * @param   priority   The dispatch priority
+ * @param   callback   Called when the file descriptor is ready
+ * @param   user_data  User data for the callback
+ * @return             The watch, not yet added
+ */
+static itk_main_loop_watch* new_watch(int fd, int priority,
+				      void (*callback)(itk_main_loop* loop, itk_main_loop_watch* watch, uint32_t events),
+				      void* user_data)
+{
+  itk_main_loop_watch* rc = calloc(1, sizeof(itk_main_loop_watch));
+  rc->fd = fd;
+  rc->priority = priority;
+  rc->callback = callback;
+  rc->user_data = user_data;
+  return rc;
+}
+
+
+/**
+ * Run the posted work, called when the wake-up eventfd is readable
+ */
+static void run_work(itk_main_loop* this, itk_main_loop_watch* watch, uint32_t events)
+{
+  itk_main_loop_work* work;
+  itk_main_loop_work* next;
+  
+  (void) watch;
+  (void) events;
+  
+  /* Take the whole queue, so that work posted by work waits for the next iteration */
+  pthread_mutex_lock(&(this->work_lock));
+  work = this->work;
+  this->work = this->last_work = NULL;
+  pthread_mutex_unlock(&(this->work_lock));
+  
+  for (; work; work = next)
+    {
+      next = work->next;
+      work->callback(this, work->user_data);
+      free(work);
+    }
+}
+
+
+/**
+ * Draw a frame, called when the frame timer expires
+ */
+static void draw_frame(itk_main_loop* this, itk_main_loop_watch* watch, uint32_t events)
+{
+  (void) watch;
+  (void) events;
+  
+  this->frame_requested = false;
+  this->last_frame = now();
+  if (this->frame)
+    {
+      ITK_TRACE_BEGIN("main_loop.frame", NULL);
+      this->frame(this, this->frame_user_data);
+      ITK_TRACE_END("main_loop.frame", NULL);
+    }
+}
+
+
+
+/**
+ * Constructor
+ * 
+ * @return  The main loop, `NULL` on error, in which case `errno` is set
+ */
+itk_main_loop* itk_new_main_loop(void)
+{
+  itk_main_loop* rc = calloc(1, sizeof(itk_main_loop));
+  int wakeup_fd = -1, timer_fd = -1, saved_errno;
+  
+  rc->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (rc->epoll_fd < 0)
+    goto fail;
+  pthread_mutex_init(&(rc->work_lock), NULL);
+  atomic_init(&(rc->running), false);
+  
+  if ((wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+    goto fail;
+  rc->wakeup = new_watch(wakeup_fd, ITK_MAIN_LOOP_PRIORITY_DEFAULT, run_work, NULL);
+  rc->wakeup->counter = rc->wakeup->owns_fd = true;
+  if (add_watch(rc, rc->wakeup, EPOLLIN) == NULL)
+    goto fail;
+  
+  if ((timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)) < 0)
+    goto fail;
+  rc->frame_timer = new_watch(timer_fd, ITK_MAIN_LOOP_PRIORITY_FRAME, draw_frame, NULL);
+  rc->frame_timer->counter = rc->frame_timer->owns_fd = true;
+  if (add_watch(rc, rc->frame_timer, EPOLLIN) == NULL)
+    goto fail;
+  
+  return rc;
+  
+ fail:
+  saved_errno = errno;
+  itk_free_main_loop(rc);
+  errno = saved_errno;
+  return NULL;
+}
+
+
+/**
+ * Destructor, posted work that has not been run is discarded
+ */
+void itk_free_main_loop(__this__)
+{
+  itk_main_loop_watch* watch;
+  itk_main_loop_work* work;
+  
+  while ((watch = this->watches))
+    {
+      this->watches = watch->next;
+      if (watch->owns_fd)
+	close(watch->fd);
+      free(watch);
+    }
+  while ((watch = this->removed_watches))
+    {
+      this->removed_watches = watch->next;
+      free(watch);
+    }
+  while ((work = this->work))
+    {
+      this->work = work->next;
+      free(work);
+    }
+  
+  if (this->epoll_fd >= 0)
+    {
+      close(this->epoll_fd);
+      pthread_mutex_destroy(&(this->work_lock));
+    }
+  free(this);
+}
+
+
+/**
+ * Watch a file descriptor
+ * 
+ * @param   fd         The file descriptor, it is not closed by the main loop
+ * @param   events     The events to wait for, `EPOLLIN` et cetera
+ * @param   priority   The dispatch priority, `ITK_MAIN_LOOP_PRIORITY_*`
+ * @param   callback   Called when the file descriptor is ready
+ * @param   user_data  User data for the callback
+ * @return             The watch, `NULL` on error, in which case `errno` is set
+ */
+itk_main_loop_watch* itk_main_loop_add_watch(__this__, int fd, uint32_t events, int priority,
+					     void (*callback)(itk_main_loop* loop, itk_main_loop_watch* watch,
+							      uint32_t events),
+					     void* user_data)
+{
+  return add_watch(this, new_watch(fd, priority, callback, user_data), events);
+}
+
+
+/**
+ * Stop watching a file descriptor, this may be done from a callback
+ * 
+ * @param  watch  The watch
+ */
+void itk_main_loop_remove_watch(__this__, itk_main_loop_watch* watch)
+{
+  itk_main_loop_watch** link = &(this->watches);
+  
+  while (*link != watch)
+    link = &((*link)->next);
+  *link = watch->next;
+  
+  epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL);
+  if (watch->owns_fd)
+    close(watch->fd);
+  
+  /* Events for the watch may already have been collected in this iteration */
+  watch->removed = true;
+  watch->next = this->removed_watches;
+  this->removed_watches = watch;
+}
+
+
+/**
+ * Add a timer
+ * 
+ * @param   delay      The number of nanoseconds until the timer expires the first time
+ * @param   interval   The number of nanoseconds between later expirations, 0 for a one-shot timer
+ * @param   callback   Called when the timer expires, the expirations are read by the main loop
+ * @param   user_data  User data for the callback
+ * @return             The timer, `NULL` on error, in which case `errno` is set
+ */
+itk_main_loop_timer* itk_main_loop_add_timer(__this__, long delay, long interval,
+					     void (*callback)(itk_main_loop* loop, itk_main_loop_watch* timer,
+							      uint32_t events),
+					     void* user_data)
+{
+  itk_main_loop_timer* rc;
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  
+  if (fd < 0)
+    return NULL;
+  
+  rc = new_watch(fd, ITK_MAIN_LOOP_PRIORITY_DEFAULT, callback, user_data);
+  rc->counter = rc->owns_fd = true;
+  if (add_watch(this, rc, EPOLLIN) == NULL)
+    return NULL;
+  
+  itk_main_loop_set_timer(this, rc, delay, interval);
+  return rc;
+}
+
+
+/**
+ * Remove a timer, this may be done from a callback, one-shot timers are not
+ * removed automatically, they can be restarted with `itk_main_loop_set_timer`
+ * 
+ * @param  timer  The timer
+ */
+void itk_main_loop_remove_timer(__this__, itk_main_loop_timer* timer)
+{
+  itk_main_loop_remove_watch(this, timer);
+}
+
+
+/**
+ * Restart a timer
+ * 
+ * @param  timer     The timer
+ * @param  delay     The number of nanoseconds until the timer expires the first time, 0 to disarm it
+ * @param  interval  The number of nanoseconds between later expirations, 0 for a one-shot timer
+ */
+void itk_main_loop_set_timer(__this__, itk_main_loop_timer* timer, long delay, long interval)
+{
+  struct itimerspec spec;
+  
+  (void) this;
+  
+  spec.it_value = to_timespec((uint64_t)delay);
+  spec.it_interval = to_timespec((uint64_t)interval);
+  timerfd_settime(timer->fd, 0, &spec, NULL);
+}
+
+
+/**
+ * Run a function in the main loop's thread, this may be done from any thread
+ * 
+ * @param  callback   The function
+ * @param  user_data  Passed to `callback`
+ */
+void itk_main_loop_post(__this__, void (*callback)(itk_main_loop* loop, void* user_data), void* user_data)
+{
+  itk_main_loop_work* work = malloc(sizeof(itk_main_loop_work));
+  uint64_t one = 1;
+  
+  work->callback = callback;
+  work->user_data = user_data;
+  work->next = NULL;
+  
+  pthread_mutex_lock(&(this->work_lock));
+  if (this->last_work)
+    this->last_work->next = work;
+  else
+    this->work = work;
+  this->last_work = work;
+  pthread_mutex_unlock(&(this->work_lock));
+  
+  /* Cannot fail but by overflowing, and then the main loop is already awake */
+  if (write(this->wakeup->fd, &one, sizeof(one)) < 0)
+    return;
+}
+
+
+/**
+ * Set the function that draws frames
+ * 
+ * @param  interval   The least number of nanoseconds between frames
+ * @param  frame      Draws a frame, `NULL` to stop drawing frames
+ * @param  user_data  Passed to `frame`
+ */
+void itk_main_loop_set_frame(__this__, long interval,
+			     void (*frame)(itk_main_loop* loop, void* user_data), void* user_data)
+{
+  this->frame_interval = interval;
+  this->frame = frame;
+  this->frame_user_data = user_data;
+}
+
+
+/**
+ * Request a frame, it is drawn once everything else that is ready has been dispatched, but no
+ * sooner than `frame_interval` after the last frame, requests made before then are combined
+ */
+void itk_main_loop_request_frame(__this__)
+{
+  struct itimerspec spec;
+  uint64_t due = this->last_frame + (uint64_t)(this->frame_interval);
+  uint64_t time = now();
+  
+  if (this->frame_requested)
+    return;
+  this->frame_requested = true;
+  
+  /* A time that has passed expires the timer at once, but 0 would disarm it */
+  spec.it_value = to_timespec(due > time ? due : time);
+  spec.it_interval = to_timespec(0);
+  timerfd_settime(this->frame_timer->fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+
+/**
+ * Dispatch events until `itk_main_loop_quit` is called
+ * 
+ * @return  Zero when the main loop has quit, -1 on error, in which case `errno` is set
+ */
+int itk_main_loop_run(__this__)
+{
+  atomic_store(&(this->running), true);
+  while (atomic_load(&(this->running)))
+    if ((itk_main_loop_iterate(this, -1) < 0) && (errno != EINTR))
+      return -1;
+  return 0;
+}
+
+
+/**
+ * Dispatch everything that is ready, waiting if nothing is
+ * 
+ * @param   timeout  The maximum number of milliseconds to wait, -1 for no limit
+ * @return           The number of callbacks that were called, -1 on error,
+ *                   in which case `errno` is set
+ */
+long itk_main_loop_iterate(__this__, int timeout)
+{
+  struct epoll_event events[ITK_MAIN_LOOP_MAX_EVENTS];
+  ready_t ready[2 * ITK_MAIN_LOOP_MAX_EVENTS];
+  ready_t r;
+  itk_main_loop_watch* watch;
+  long i, j, n = 0, rc = 0;
+  uint64_t counter;
+  int count;
+  
+  /* Input that has already been read from a file descriptor does not make it
+   * readable, so ask the watches that buffer input before waiting */
+  for (watch = this->watches; watch && (n < ITK_MAIN_LOOP_MAX_EVENTS); watch = watch->next)
+    if (watch->pending && watch->pending(this, watch))
+      {
+	(ready + n)->watch = watch;
+	(ready + n++)->events = EPOLLIN;
+      }
+  
+  count = epoll_wait(this->epoll_fd, events, ITK_MAIN_LOOP_MAX_EVENTS, n ? 0 : timeout);
+  if (count < 0)
+    return -1;
+  
+  for (i = 0; i < count; i++)
+    {
+      for (j = 0; j < n; j++)
+	if ((ready + j)->watch == (events + i)->data.ptr)
+	  break;
+      (ready + j)->watch = (events + i)->data.ptr;
+      (ready + j)->events = j < n ? ((ready + j)->events | (events + i)->events) : (events + i)->events;
+      n += j == n;
+    }
+  
+  /* Stable insertion sort by priority, so input is dispatched before repaint work */
+  for (i = 1; i < n; i++)
+    {
+      r = *(ready + i);
+      for (j = i; (j > 0) && ((ready + j - 1)->watch->priority > r.watch->priority); j--)
+	*(ready + j) = *(ready + j - 1);
+      *(ready + j) = r;
+    }
+  
+  for (i = 0; i < n; i++)
+    {
+      watch = (ready + i)->watch;
+      if (watch->removed)
+	continue;
+      if (watch->counter && (read(watch->fd, &counter, sizeof(counter)) < 0))
+	continue;
+      watch->callback(this, watch, (ready + i)->events);
+      rc++;
+    }
+  
+  while ((watch = this->removed_watches))
+    {
+      this->removed_watches = watch->next;
+      free(watch);
+    }
+  
+  return rc;
+}
+
+
+/**
+ * Make `itk_main_loop_run` return, this may be done from any thread
+ */
+void itk_main_loop_quit(__this__)
+{
+  uint64_t one = 1;
+  atomic_store(&(this->running), false);
+  if (write(this->wakeup->fd, &one, sizeof(one)) < 0)
+    return;
+}
+
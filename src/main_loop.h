@@ -0,0 +1,362 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_MAIN_LOOP_H__
+#define __ITK_MAIN_LOOP_H__
+
+#include "itktypes.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+
+/**
+ * Priority of watches for user input, dispatched before anything else
+ */
+#define ITK_MAIN_LOOP_PRIORITY_INPUT  0
+
+/**
+ * Priority of timers, posted work and, normally, other watches
+ */
+#define ITK_MAIN_LOOP_PRIORITY_DEFAULT  1
+
+/**
+ * Priority of the frame, dispatched after everything else that is ready
+ */
+#define ITK_MAIN_LOOP_PRIORITY_FRAME  2
+
+/**
+ * The maximum number of ready file descriptors handled per iteration
+ */
+#define ITK_MAIN_LOOP_MAX_EVENTS  64
+
+
+struct _itk_main_loop;
+
+
+/**
+ * A file descriptor watched by a main loop
+ */
+typedef struct _itk_main_loop_watch
+{
+  /**
+   * The file descriptor
+   */
+  int fd;
+  
+  /**
+   * The dispatch priority, `ITK_MAIN_LOOP_PRIORITY_*`, lower is earlier
+   */
+  int priority;
+  
+  /**
+   * Called when the file descriptor is ready
+   * 
+   * @param  loop    The main loop
+   * @param  watch   The watch
+   * @param  events  The ready events, `EPOLLIN` et cetera
+   */
+  void (*callback)(struct _itk_main_loop* loop, struct _itk_main_loop_watch* watch, uint32_t events);
+  
+  /**
+   * Called before the main loop waits, may be `NULL`, for file descriptors whose
+   * reader buffers input, such as the X connection, whose events can be queued
+   * in Xlib while the file descriptor is not readable
+   * 
+   * @param   loop   The main loop
+   * @param   watch  The watch
+   * @return         Whether input is buffered, in which case
+   *                 `callback` is called without waiting
+   */
+  bool_t (*pending)(struct _itk_main_loop* loop, struct _itk_main_loop_watch* watch);
+  
+  /**
+   * User data for the callbacks
+   */
+  void* user_data;
+  
+  /**
+   * Whether `fd` is a timerfd or an eventfd, whose counter
+   * the main loop reads before `callback` is called
+   */
+  bool_t counter;
+  
+  /**
+   * Whether `fd` is closed when the watch is removed
+   */
+  bool_t owns_fd;
+  
+  /**
+   * Whether the watch has been removed, it is freed at the end of the iteration
+   */
+  bool_t removed;
+  
+  /**
+   * The next watch in the main loop's list of watches, or of removed watches
+   */
+  struct _itk_main_loop_watch* next;
+  
+} itk_main_loop_watch;
+
+
+/**
+ * A piece of work posted to a main loop
+ */
+typedef struct _itk_main_loop_work
+{
+  /**
+   * The work
+   * 
+   * @param  loop       The main loop
+   * @param  user_data  `user_data`
+   */
+  void (*callback)(struct _itk_main_loop* loop, void* user_data);
+  
+  /**
+   * Passed to `callback`
+   */
+  void* user_data;
+  
+  /**
+   * The next piece of work in the queue
+   */
+  struct _itk_main_loop_work* next;
+  
+} itk_main_loop_work;
+
+
+/**
+ * An event loop built on epoll, that sleeps until a watched file descriptor
+ * is ready, a timer expires, work is posted or a frame is due, so that an
+ * idle program uses no CPU
+ * 
+ * Everything but `itk_main_loop_post` and `itk_main_loop_quit` must be
+ * called from the thread that runs the main loop
+ */
+typedef struct _itk_main_loop
+{
+  /**
+   * The epoll instance
+   */
+  int epoll_fd;
+  
+  /**
+   * The watches
+   */
+  itk_main_loop_watch* watches;
+  
+  /**
+   * Removed watches, freed at the end of the iteration
+   */
+  itk_main_loop_watch* removed_watches;
+  
+  /**
+   * Watch of an eventfd, written when work is posted or the loop is told to quit
+   */
+  itk_main_loop_watch* wakeup;
+  
+  /**
+   * Guards `work` and `last_work`
+   */
+  pthread_mutex_t work_lock;
+  
+  /**
+   * Posted work, oldest first
+   */
+  itk_main_loop_work* work;
+  
+  /**
+   * The last element of `work`
+   */
+  itk_main_loop_work* last_work;
+  
+  /**
+   * Watch of a timerfd, armed when a frame has been requested
+   */
+  itk_main_loop_watch* frame_timer;
+  
+  /**
+   * The least number of nanoseconds between frames
+   */
+  long frame_interval;
+  
+  /**
+   * Draws a frame, may be `NULL`
+   * 
+   * @param  loop       The main loop
+   * @param  user_data  `frame_user_data`
+   */
+  void (*frame)(struct _itk_main_loop* loop, void* user_data);
+  
+  /**
+   * Passed to `frame`
+   */
+  void* frame_user_data;
+  
+  /**
+   * Whether a frame has been requested and not yet drawn
+   */
+  bool_t frame_requested;
+  
+  /**
+   * When the last frame was drawn, in nanoseconds on the monotonic clock
+   */
+  uint64_t last_frame;
+  
+  /**
+   * Whether `itk_main_loop_run` shall keep running
+   */
+  atomic_bool running;
+  
+} itk_main_loop;
+
+
+/**
+ * A timer of a main loop, it is a watch of a timerfd
+ */
+typedef itk_main_loop_watch itk_main_loop_timer;
+
+
+/**
+ * Constructor
+ * 
+ * @return  The main loop, `NULL` on error, in which case `errno` is set
+ */
+itk_main_loop* itk_new_main_loop(void);
+
+/**
+ * Destructor, posted work that has not been run is discarded
+ * 
+ * @param  this  The main loop
+ */
+void itk_free_main_loop(itk_main_loop* this);
+
+/**
+ * Watch a file descriptor
+ * 
+ * @param   this       The main loop
+ * @param   fd         The file descriptor, it is not closed by the main loop
+ * @param   events     The events to wait for, `EPOLLIN` et cetera
+ * @param   priority   The dispatch priority, `ITK_MAIN_LOOP_PRIORITY_*`
+ * @param   callback   Called when the file descriptor is ready
+ * @param   user_data  User data for the callback
+ * @return             The watch, `NULL` on error, in which case `errno` is set
+ */
+itk_main_loop_watch* itk_main_loop_add_watch(itk_main_loop* this, int fd, uint32_t events, int priority,
+					     void (*callback)(itk_main_loop* loop, itk_main_loop_watch* watch,
+							      uint32_t events),
+					     void* user_data);
+
+/**
+ * Stop watching a file descriptor, this may be done from a callback
+ * 
+ * @param  this   The main loop
+ * @param  watch  The watch
+ */
+void itk_main_loop_remove_watch(itk_main_loop* this, itk_main_loop_watch* watch);
+
+/**
+ * Add a timer
+ * 
+ * @param   this       The main loop
+ * @param   delay      The number of nanoseconds until the timer expires the first time
+ * @param   interval   The number of nanoseconds between later expirations, 0 for a one-shot timer
+ * @param   callback   Called when the timer expires, the expirations are read by the main loop
+ * @param   user_data  User data for the callback
+ * @return             The timer, `NULL` on error, in which case `errno` is set
+ */
+itk_main_loop_timer* itk_main_loop_add_timer(itk_main_loop* this, long delay, long interval,
+					     void (*callback)(itk_main_loop* loop, itk_main_loop_watch* timer,
+							      uint32_t events),
+					     void* user_data);
+
+/**
+ * Remove a timer, this may be done from a callback, one-shot timers are not
+ * removed automatically, they can be restarted with `itk_main_loop_set_timer`
+ * 
+ * @param  this   The main loop
+ * @param  timer  The timer
+ */
+void itk_main_loop_remove_timer(itk_main_loop* this, itk_main_loop_timer* timer);
+
+/**
+ * Restart a timer
+ * 
+ * @param  this      The main loop
+ * @param  timer     The timer
+ * @param  delay     The number of nanoseconds until the timer expires the first time, 0 to disarm it
+ * @param  interval  The number of nanoseconds between later expirations, 0 for a one-shot timer
+ */
+void itk_main_loop_set_timer(itk_main_loop* this, itk_main_loop_timer* timer, long delay, long interval);
+
+/**
+ * Run a function in the main loop's thread, this may be done from any thread
+ * 
+ * @param  this       The main loop
+ * @param  callback   The function
+ * @param  user_data  Passed to `callback`
+ */
+void itk_main_loop_post(itk_main_loop* this, void (*callback)(itk_main_loop* loop, void* user_data), void* user_data);
+
+/**
+ * Set the function that draws frames
+ * 
+ * @param  this       The main loop
+ * @param  interval   The least number of nanoseconds between frames
+ * @param  frame      Draws a frame, `NULL` to stop drawing frames
+ * @param  user_data  Passed to `frame`
+ */
+void itk_main_loop_set_frame(itk_main_loop* this, long interval,
+			     void (*frame)(itk_main_loop* loop, void* user_data), void* user_data);
+
+/**
+ * Request a frame, it is drawn once everything else that is ready has been dispatched, but no
+ * sooner than `frame_interval` after the last frame, requests made before then are combined
+ * 
+ * @param  this  The main loop
+ */
+void itk_main_loop_request_frame(itk_main_loop* this);
+
+/**
+ * Dispatch events until `itk_main_loop_quit` is called
+ * 
+ * @param   this  The main loop
+ * @return        Zero when the main loop has quit, -1 on error, in which case `errno` is set
+ */
+int itk_main_loop_run(itk_main_loop* this);
+
+/**
+ * Dispatch everything that is ready, waiting if nothing is
+ * 
+ * @param   this     The main loop
+ * @param   timeout  The maximum number of milliseconds to wait, -1 for no limit
+ * @return           The number of callbacks that were called, -1 on error,
+ *                   in which case `errno` is set
+ */
+long itk_main_loop_iterate(itk_main_loop* this, int timeout);
+
+/**
+ * Make `itk_main_loop_run` return, this may be done from any thread
+ * 
+ * @param  this  The main loop
+ */
+void itk_main_loop_quit(itk_main_loop* this);
+
+
+#endif
+
@@ -0,0 +1,302 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "metrics.h"
+#include "itkmacros.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/**
+ * The metrics before they are published, and after they are unpublished
+ */
+static itk_metrics_page private_page =
+  {
+    .magic = ITK_METRICS_MAGIC,
+    .version = ITK_METRICS_VERSION,
+    .counter_count = ITK_METRICS_BUILTIN_COUNTERS,
+    .histogram_count = ITK_METRICS_BUILTIN_HISTOGRAMS,
+    .counters =
+      {
+	[ITK_METRIC_FRAMES]             = { .name = "frames" },
+	[ITK_METRIC_COMPONENTS_PAINTED] = { .name = "components_painted" },
+	[ITK_METRIC_LAYOUT_PASSES]      = { .name = "layout_passes" },
+	[ITK_METRIC_HASH_REHASHES]      = { .name = "hash_rehashes" },
+	[ITK_METRIC_BUFFER_BYTES]       = { .name = "buffer_bytes" },
+	[ITK_METRIC_QUALITY_REDUCED]    = { .name = "quality_reduced" },
+	[ITK_METRIC_QUALITY_RESTORED]   = { .name = "quality_restored" },
+	[ITK_METRIC_QUALITY_TIER]       = { .name = "quality_tier" },
+	[ITK_METRIC_UPDATES_DROPPED]    = { .name = "updates_dropped" },
+      },
+    .histograms =
+      {
+	[ITK_METRIC_FRAME_TIME]     = { .name = "frame_time_ns" },
+	[ITK_METRIC_FRAME_INTERVAL] = { .name = "frame_interval_ns" },
+      },
+  };
+
+itk_metrics_page* _Atomic itk_metrics = &private_page;
+
+/**
+ * The name of the shared memory object the metrics are published in, empty if not published
+ */
+static char published_name[256];
+
+/**
+ * The last unpublished page, it is kept mapped, as other threads may still
+ * be updating it, until it has been replaced by the next published page
+ */
+static itk_metrics_page* retired_page = NULL;
+
+
+
+/**
+ * Get the current time, for measuring durations that are recorded in histograms
+ * 
+ * @return  The time, in nanoseconds, on the monotonic clock
+ */
+uint64_t itk_metrics_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)(now.tv_sec) * 1000000000ULL + (uint64_t)(now.tv_nsec);
+}
+
+
+/**
+ * Register a counter
+ * 
+ * @param   name  The name of the counter, it is copied and truncated
+ * @return        The index of the counter, -1 if the page is full
+ */
+long itk_metrics_register_counter(const char* name)
+{
+  itk_metrics_page* page = atomic_load_explicit(&itk_metrics, memory_order_relaxed);
+  long rc = (long)atomic_fetch_add(&(page->counter_count), 1);
+  
+  if (rc >= ITK_METRICS_MAX_COUNTERS)
+    {
+      atomic_fetch_sub(&(page->counter_count), 1);
+      return -1;
+    }
+  
+  strncpy(page->counters[rc].name, name, ITK_METRICS_NAME_SIZE - 1);
+  return rc;
+}
+
+
+/**
+ * Register a histogram
+ * 
+ * @param   name  The name of the histogram, it is copied and truncated
+ * @return        The index of the histogram, -1 if the page is full
+ */
+long itk_metrics_register_histogram(const char* name)
+{
+  itk_metrics_page* page = atomic_load_explicit(&itk_metrics, memory_order_relaxed);
+  long rc = (long)atomic_fetch_add(&(page->histogram_count), 1);
+  
+  if (rc >= ITK_METRICS_MAX_HISTOGRAMS)
+    {
+      atomic_fetch_sub(&(page->histogram_count), 1);
+      return -1;
+    }
+  
+  strncpy(page->histograms[rc].name, name, ITK_METRICS_NAME_SIZE - 1);
+  return rc;
+}
+
+
+/**
+ * Move the metrics into a POSIX shared memory object, so that they
+ * can be read by other processes, for example with `itk-metrics`
+ * 
+ * Updates made by other threads while the metrics are moved can be lost
+ * 
+ * @param   name  The name of the shared memory object, `NULL` for "/itk-<pid>"
+ * @return        Zero on success, -1 on error, in which case `errno` is set
+ */
+int itk_metrics_publish(const char* name)
+{
+  itk_metrics_page* page;
+  int fd, saved_errno;
+  
+  if (*published_name)
+    {
+      errno = EALREADY;
+      return -1;
+    }
+  
+  if (name)
+    snprintf(published_name, sizeof(published_name), "%s", name);
+  else
+    snprintf(published_name, sizeof(published_name), "/itk-%li", (long)getpid());
+  
+  fd = shm_open(published_name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0)
+    goto fail;
+  if (ftruncate(fd, sizeof(itk_metrics_page)))
+    goto fail_unlink;
+  page = mmap(NULL, sizeof(itk_metrics_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (page == MAP_FAILED)
+    goto fail_unlink;
+  close(fd);
+  
+  memcpy(page, &private_page, sizeof(itk_metrics_page));
+  page->pid = (int32_t)getpid();
+  atomic_store(&itk_metrics, page);
+  
+  /* Threads that were updating the retired page have had a whole
+   * published period, and the private page before it, to finish */
+  if (retired_page)
+    {
+      munmap(retired_page, sizeof(itk_metrics_page));
+      retired_page = NULL;
+    }
+  return 0;
+  
+ fail_unlink:
+  saved_errno = errno;
+  close(fd);
+  shm_unlink(published_name);
+  errno = saved_errno;
+ fail:
+  *published_name = '\0';
+  return -1;
+}
+
+
+/**
+ * Move the metrics back to private memory and remove the shared memory object
+ * 
+ * Updates made by other threads while the metrics are moved can be lost
+ * 
+ * Other threads, such as a render thread, may still be updating the shared
+ * page through a pointer they loaded before it was replaced, so the page
+ * stays mapped until the metrics are published again, or the process exits
+ */
+void itk_metrics_unpublish(void)
+{
+  itk_metrics_page* page = atomic_load(&itk_metrics);
+  
+  if (*published_name == '\0')
+    return;
+  
+  memcpy(&private_page, page, sizeof(itk_metrics_page));
+  atomic_store(&itk_metrics, &private_page);
+  /* `page` is not unmapped, the name can be unlinked as the mapping keeps the object alive */
+  retired_page = page;
+  shm_unlink(published_name);
+  *published_name = '\0';
+}
+
+
+/**
+ * Map the metrics page of another process, read only
+ * 
+ * @param   name  The name of the shared memory object
+ * @return        The metrics, `NULL` on error, in which case `errno` is set,
+ *                `EPROTO` if the object is not a metrics page of this version
+ */
+const itk_metrics_page* itk_metrics_open(const char* name)
+{
+  itk_metrics_page* page;
+  struct stat attr;
+  int fd = shm_open(name, O_RDONLY, 0);
+  
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &attr))
+    {
+      close(fd);
+      return NULL;
+    }
+  if ((size_t)(attr.st_size) < sizeof(itk_metrics_page))
+    {
+      close(fd);
+      errno = EPROTO;
+      return NULL;
+    }
+  page = mmap(NULL, sizeof(itk_metrics_page), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (page == MAP_FAILED)
+    return NULL;
+  
+  if ((page->magic != ITK_METRICS_MAGIC) || (page->version != ITK_METRICS_VERSION))
+    {
+      munmap(page, sizeof(itk_metrics_page));
+      errno = EPROTO;
+      return NULL;
+    }
+  return page;
+}
+
+
+/**
+ * Unmap a metrics page mapped with `itk_metrics_open`
+ * 
+ * @param  page  The metrics
+ */
+void itk_metrics_close(const itk_metrics_page* page)
+{
+  munmap((void*)page, sizeof(itk_metrics_page));
+}
+
+
+/**
+ * Estimate a percentile of a histogram
+ * 
+ * @param   histogram   The histogram
+ * @param   percentile  The percentile, between 0 and 100
+ * @return              The estimated value, 0 if the histogram is empty
+ */
+double itk_metrics_percentile(const itk_metrics_histogram* histogram, double percentile)
+{
+  uint64_t total = 0, seen = 0, n, start, end;
+  double rank;
+  long i;
+  
+  for (i = 0; i < ITK_METRICS_BUCKETS; i++)
+    total += atomic_load_explicit(histogram->buckets + i, memory_order_relaxed);
+  if (total == 0)
+    return 0;
+  
+  rank = percentile / 100 * (double)total;
+  for (i = 0; i < ITK_METRICS_BUCKETS; i++)
+    {
+      n = atomic_load_explicit(histogram->buckets + i, memory_order_relaxed);
+      if ((n == 0) || ((double)(seen + n) < rank))
+	{
+	  seen += n;
+	  continue;
+	}
+      /* Interpolate linearly within the bucket */
+      start = itk_metrics_bucket_start(i);
+      end = i + 1 < ITK_METRICS_BUCKETS ? itk_metrics_bucket_start(i + 1) : UINT64_MAX;
+      return (double)start + (double)(end - start) * ((rank - (double)seen) / (double)n);
+    }
+  return (double)itk_metrics_bucket_start(ITK_METRICS_BUCKETS - 1);
+}
+
@@ -0,0 +1,353 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_METRICS_H__
+#define __ITK_METRICS_H__
+
+#include "itktypes.h"
+
+#include <stdatomic.h>
+
+
+/**
+ * Identifies a metrics page, "ITKM" in little endian
+ */
+#define ITK_METRICS_MAGIC  0x4D4B5449UL
+
+/**
+ * The layout version of the metrics page, incremented on incompatible changes
+ */
+#define ITK_METRICS_VERSION  1
+
+/**
+ * The number of counters a metrics page has room for
+ */
+#define ITK_METRICS_MAX_COUNTERS  64
+
+/**
+ * The number of histograms a metrics page has room for
+ */
+#define ITK_METRICS_MAX_HISTOGRAMS  16
+
+/**
+ * The number of bytes, including the NUL, of the name of a metric
+ */
+#define ITK_METRICS_NAME_SIZE  40
+
+/**
+ * The number of buckets in a histogram, values below 4 have a bucket
+ * each, every other power of two is split into four buckets
+ */
+#define ITK_METRICS_BUCKETS  252
+
+
+/**
+ * Frames presented, counter
+ */
+#define ITK_METRIC_FRAMES  0
+
+/**
+ * Components painted, counter
+ */
+#define ITK_METRIC_COMPONENTS_PAINTED  1
+
+/**
+ * Layout passes, that is, layout manager preparations, counter
+ */
+#define ITK_METRIC_LAYOUT_PASSES  2
+
+/**
+ * Hash table rehashes, counter
+ */
+#define ITK_METRIC_HASH_REHASHES  3
+
+/**
+ * Bytes held in off-screen buffers, gauge
+ */
+#define ITK_METRIC_BUFFER_BYTES  4
+
+/**
+ * Switches to a lower drawing quality by the frame governor, counter
+ */
+#define ITK_METRIC_QUALITY_REDUCED  5
+
+/**
+ * Switches to a higher drawing quality by the frame governor, counter
+ */
+#define ITK_METRIC_QUALITY_RESTORED  6
+
+/**
+ * The frame governor's quality tier, `ITK_GRAPHICS_QUALITY_*`, gauge
+ */
+#define ITK_METRIC_QUALITY_TIER  7
+
+/**
+ * Updates of volatile components dropped by the frame governor, counter
+ */
+#define ITK_METRIC_UPDATES_DROPPED  8
+
+/**
+ * The number of built-in counters
+ */
+#define ITK_METRICS_BUILTIN_COUNTERS  9
+
+
+/**
+ * Time to paint a root component, in nanoseconds, histogram
+ */
+#define ITK_METRIC_FRAME_TIME  0
+
+/**
+ * Time between presented frames, in nanoseconds, histogram
+ */
+#define ITK_METRIC_FRAME_INTERVAL  1
+
+/**
+ * The number of built-in histograms
+ */
+#define ITK_METRICS_BUILTIN_HISTOGRAMS  2
+
+
+
+/**
+ * A counter or gauge
+ */
+typedef struct _itk_metrics_counter
+{
+  /**
+   * The name of the counter
+   */
+  char name[ITK_METRICS_NAME_SIZE];
+  
+  /**
+   * The value of the counter
+   */
+  _Atomic int64_t value;
+  
+} itk_metrics_counter;
+
+
+/**
+ * A histogram of nonnegative values
+ */
+typedef struct _itk_metrics_histogram
+{
+  /**
+   * The name of the histogram
+   */
+  char name[ITK_METRICS_NAME_SIZE];
+  
+  /**
+   * The number of recorded values
+   */
+  _Atomic uint64_t count;
+  
+  /**
+   * The sum of the recorded values
+   */
+  _Atomic uint64_t sum;
+  
+  /**
+   * The number of recorded values in each bucket, see `itk_metrics_bucket`
+   */
+  _Atomic uint64_t buckets[ITK_METRICS_BUCKETS];
+  
+} itk_metrics_histogram;
+
+
+/**
+ * All metrics of a process, in a layout that is shared with readers in other processes
+ * 
+ * The fields are updated with relaxed atomics, so a reader can see a histogram's
+ * `count` and `sum` and buckets slightly out of step with each other
+ */
+typedef struct _itk_metrics_page
+{
+  /**
+   * `ITK_METRICS_MAGIC`
+   */
+  uint32_t magic;
+  
+  /**
+   * `ITK_METRICS_VERSION`
+   */
+  uint32_t version;
+  
+  /**
+   * The process the metrics belong to
+   */
+  int32_t pid;
+  
+  /**
+   * The number of counters in use
+   */
+  _Atomic uint32_t counter_count;
+  
+  /**
+   * The number of histograms in use
+   */
+  _Atomic uint32_t histogram_count;
+  
+  /**
+   * The counters, the built-in come first
+   */
+  itk_metrics_counter counters[ITK_METRICS_MAX_COUNTERS];
+  
+  /**
+   * The histograms, the built-in come first
+   */
+  itk_metrics_histogram histograms[ITK_METRICS_MAX_HISTOGRAMS];
+  
+} itk_metrics_page;
+
+
+/**
+ * The metrics of the process, a private page until `itk_metrics_publish` is called
+ */
+extern itk_metrics_page* _Atomic itk_metrics;
+
+
+/**
+ * Get the histogram bucket of a value
+ * 
+ * @param   value  The value
+ * @return         The index of the value's bucket
+ */
+static inline long itk_metrics_bucket(uint64_t value)
+{
+  long e;
+  if (value < 4)
+    return (long)value;
+  e = 63 - __builtin_clzll(value);
+  return 4 * (e - 1) + (long)((value >> (e - 2)) & 3);
+}
+
+/**
+ * Get the smallest value of a histogram bucket
+ * 
+ * @param   bucket  The index of the bucket
+ * @return          The smallest value that goes in the bucket
+ */
+static inline uint64_t itk_metrics_bucket_start(long bucket)
+{
+  if (bucket < 4)
+    return (uint64_t)bucket;
+  return (uint64_t)(4 + (bucket & 3)) << (bucket / 4 - 1);
+}
+
+/**
+ * Add to a counter, or subtract from a gauge
+ * 
+ * @param  counter  The index of the counter
+ * @param  delta    The value to add
+ */
+static inline void itk_metrics_add(long counter, int64_t delta)
+{
+  itk_metrics_page* page = atomic_load_explicit(&itk_metrics, memory_order_relaxed);
+  atomic_fetch_add_explicit(&(page->counters[counter].value), delta, memory_order_relaxed);
+}
+
+/**
+ * Record a value in a histogram
+ * 
+ * @param  histogram  The index of the histogram
+ * @param  value      The value
+ */
+static inline void itk_metrics_record(long histogram, uint64_t value)
+{
+  itk_metrics_page* page = atomic_load_explicit(&itk_metrics, memory_order_relaxed);
+  itk_metrics_histogram* h = page->histograms + histogram;
+  atomic_fetch_add_explicit(&(h->count), 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&(h->sum), value, memory_order_relaxed);
+  atomic_fetch_add_explicit(h->buckets + itk_metrics_bucket(value), 1, memory_order_relaxed);
+}
+
+
+/**
+ * Get the current time, for measuring durations that are recorded in histograms
+ * 
+ * @return  The time, in nanoseconds, on the monotonic clock
+ */
+uint64_t itk_metrics_now(void);
+
+/**
+ * Register a counter
+ * 
+ * @param   name  The name of the counter, it is copied and truncated
+ * @return        The index of the counter, -1 if the page is full
+ */
+long itk_metrics_register_counter(const char* name);
+
+/**
+ * Register a histogram
+ * 
+ * @param   name  The name of the histogram, it is copied and truncated
+ * @return        The index of the histogram, -1 if the page is full
+ */
+long itk_metrics_register_histogram(const char* name);
+
+/**
+ * Move the metrics into a POSIX shared memory object, so that they
+ * can be read by other processes, for example with `itk-metrics`
+ * 
+ * Updates made by other threads while the metrics are moved can be lost
+ * 
+ * @param   name  The name of the shared memory object, `NULL` for "/itk-<pid>"
+ * @return        Zero on success, -1 on error, in which case `errno` is set
+ */
+int itk_metrics_publish(const char* name);
+
+/**
+ * Move the metrics back to private memory and remove the shared memory object
+ * 
+ * Updates made by other threads while the metrics are moved can be lost
+ * 
+ * Other threads, such as a render thread, may still be updating the shared
+ * page through a pointer they loaded before it was replaced, so the page
+ * stays mapped until the metrics are published again, or the process exits
+ */
+void itk_metrics_unpublish(void);
+
+/**
+ * Map the metrics page of another process, read only
+ * 
+ * @param   name  The name of the shared memory object
+ * @return        The metrics, `NULL` on error, in which case `errno` is set,
+ *                `EPROTO` if the object is not a metrics page of this version
+ */
+const itk_metrics_page* itk_metrics_open(const char* name);
+
+/**
+ * Unmap a metrics page mapped with `itk_metrics_open`
+ * 
+ * @param  page  The metrics
+ */
+void itk_metrics_close(const itk_metrics_page* page);
+
+/**
+ * Estimate a percentile of a histogram
+ * 
+ * @param   histogram   The histogram
+ * @param   percentile  The percentile, between 0 and 100
+ * @return              The estimated value, 0 if the histogram is empty
+ */
+double itk_metrics_percentile(const itk_metrics_histogram* histogram, double percentile);
+
+
+#endif
+
@@ -0,0 +1,500 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "paint_scheduler.h"
+#include "geometry.h"
+#include "itkmacros.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __this__  itk_paint_scheduler* this
+
+
+
+/**
+ * Get the position of a component's origin in the coordinates of its root
+ * 
+ * @param   component  The component, it must be located
+ * @return             The position of its top left corner
+ */
+static packed_position2_t origin_in_root(itk_component* component)
+{
+  packed_position2_t rc = new_packed_position2(0, 0);
+  packed_rectangle_t area;
+  
+  for (; component->parent; component = component->parent)
+    {
+      area = component->parent->vtable->locate_child(component->parent, component);
+      rc.x += area.x;
+      rc.y += area.y;
+    }
+  
+  return rc;
+}
+
+
+/**
+ * Start painting a component, and paint it unless it has children,
+ * its children are left to be painted by `step`
+ * 
+ * @param  unit       The unit
+ * @param  component  The component
+ * @param  g          The graphics context to paint the component with, it is freed when it is done
+ */
+static void push(itk_paint_unit* unit, itk_component* component, itk_graphics* g)
+{
+  itk_paint_frame* frame;
+  long n;
+  
+  /* A component that paints itself in its own way is painted in one go */
+  if (component->vtable->paint != itk_component_class.paint)
+    {
+      component->vtable->paint(component, g);
+      g->free(g);
+      return;
+    }
+  
+  ITK_TRACE_BEGIN("paint_component", component->name);
+  component->vtable->paint_component(component, g);
+  itk_metrics_add(ITK_METRIC_COMPONENTS_PAINTED, 1);
+  ITK_TRACE_END("paint_component", component->name);
+  
+  if ((n = itk_component_compact_children(component)->children_count) == 0)
+    {
+      g->free(g);
+      return;
+    }
+  
+  if (unit->depth == unit->stack_capacity)
+    {
+      unit->stack_capacity = unit->stack_capacity ? unit->stack_capacity << 1 : 8;
+      unit->stack = realloc(unit->stack, unit->stack_capacity * sizeof(itk_paint_frame));
+    }
+  
+  /* The children are laid out now, so the layout manager is
+   * not kept in the middle of a layout between frames */
+  frame = unit->stack + unit->depth++;
+  frame->component = component;
+  frame->graphics = g;
+  frame->children = malloc(n * sizeof(itk_component*));
+  frame->rects = malloc(n * sizeof(packed_rectangle_t));
+  frame->count = n;
+  frame->next = 0;
+  memcpy(frame->children, component->children, n * sizeof(itk_component*));
+  itk_component_locate_children(component, frame->rects);
+}
+
+
+/**
+ * Paint the next component of a unit
+ * 
+ * @param  unit  The unit, it must have been started and not be complete
+ */
+static void step(itk_paint_unit* unit)
+{
+  itk_paint_frame* frame;
+  packed_rectangle_t rect;
+  
+  for (;;)
+    {
+      frame = unit->stack + unit->depth - 1;
+      if (frame->next == frame->count)
+	{
+	  frame->graphics->free(frame->graphics);
+	  free(frame->children);
+	  free(frame->rects);
+	  if (--(unit->depth) == 0)
+	    return;
+	  continue;
+	}
+      
+      rect = *(frame->rects + frame->next);
+      if (packed_rectangle_defined(rect) && (rect.width | rect.height) > 0)
+	{
+	  push(unit, *(frame->children + frame->next++), frame->graphics->create(frame->graphics, rect));
+	  return;
+	}
+      frame->next++;
+    }
+}
+
+
+/**
+ * Start painting a unit
+ * 
+ * @param   unit  The unit
+ * @return        Whether the component can be seen, otherwise the unit was not started
+ */
+static bool_t start(itk_paint_unit* unit)
+{
+  itk_component* painter = unit->component;
+  packed_rectangle_t area = itk_component_locate_in_root(painter);
+  packed_position2_t origin;
+  itk_graphics* g;
+  
+  if (itk_rectangle_is_empty(area))
+    return false;
+  
+  /* What shows through a translucent component is painted by its ancestors */
+  while (painter->parent && (painter->background_colour.argb_colour.c.alpha != 255))
+    painter = painter->parent;
+  origin = origin_in_root(painter);
+  
+  if (unit->list == NULL)
+    unit->list = itk_new_display_list();
+  unit->recorder = itk_new_recording_graphics(unit->list);
+  
+  g = unit->recorder->fork(unit->recorder);
+  g->clip(g, area);
+  g->translate(g, new_packed_position2(-(origin.x), -(origin.y)));
+  push(unit, painter, g);
+  return true;
+}
+
+
+/**
+ * Discard what has been recorded for a unit, so that it can be started again
+ * 
+ * @param  unit  The unit
+ */
+static void reset(itk_paint_unit* unit)
+{
+  itk_paint_frame* frame;
+  
+  while (unit->depth)
+    {
+      frame = unit->stack + --(unit->depth);
+      frame->graphics->free(frame->graphics);
+      free(frame->children);
+      free(frame->rects);
+    }
+  if (unit->recorder)
+    {
+      unit->recorder->free(unit->recorder);
+      unit->recorder = NULL;
+    }
+  if (unit->list)
+    itk_display_list_clear(unit->list);
+}
+
+
+/**
+ * Free a unit
+ * 
+ * @param  unit  The unit
+ */
+static void free_unit(itk_paint_unit* unit)
+{
+  reset(unit);
+  if (unit->list)
+    itk_free_display_list(unit->list);
+  free(unit->stack);
+  free(unit->redo);
+  free(unit);
+}
+
+
+/**
+ * Queue a component to be painted again when a unit is complete
+ * 
+ * @param  unit       The unit, it must have started
+ * @param  component  The component, the unit's component or one of its descendants
+ */
+static void add_redo(itk_paint_unit* unit, itk_component* component)
+{
+  long i;
+  
+  for (i = 0; i < unit->redo_count; i++)
+    if (*(unit->redo + i) == component)
+      return;
+  
+  unit->redo = realloc(unit->redo, (unit->redo_count + 1) * sizeof(itk_component*));
+  *(unit->redo + unit->redo_count++) = component;
+}
+
+
+/**
+ * Compare the priorities of two units
+ * 
+ * @param   a  Pointer to the first unit
+ * @param   b  Pointer to the second unit
+ * @return     Negative if the first unit shall be painted first, positive if the second
+ */
+static int compare(const void* a, const void* b)
+{
+  const itk_paint_unit* x = *(itk_paint_unit* const*)a;
+  const itk_paint_unit* y = *(itk_paint_unit* const*)b;
+  
+  if (x->rank != y->rank)          return x->rank - y->rank;
+  if (x->distance != y->distance)  return x->distance < y->distance ? -1 : 1;
+  return x->sequence < y->sequence ? -1 : 1;
+}
+
+
+/**
+ * Rank a unit, by whether it is focused and how far from the focus it is
+ * 
+ * @param   unit   The unit
+ * @param   focus  The focused component, may be `NULL`
+ * @param   where  The area of the focused component, in the coordinates of its root
+ * @return         Whether the component can be seen
+ */
+static bool_t rank(itk_paint_unit* unit, itk_component* focus, packed_rectangle_t where)
+{
+  packed_rectangle_t area = itk_component_locate_in_root(unit->component);
+  itk_component* ancestor;
+  double dx, dy;
+  
+  if (itk_rectangle_is_empty(area))
+    return false;
+  
+  unit->rank = 1;
+  unit->distance = 0;
+  
+  for (ancestor = unit->component; ancestor; ancestor = ancestor->parent)
+    if (ancestor == focus)
+      {
+	unit->rank = 0;
+	return true;
+      }
+  
+  if (focus && !itk_rectangle_is_empty(where))
+    {
+      dx = (area.x + area.width / 2.) - (where.x + where.width / 2.);
+      dy = (area.y + area.height / 2.) - (where.y + where.height / 2.);
+      unit->distance = dx * dx + dy * dy;
+    }
+  return true;
+}
+
+
+
+/**
+ * Constructor
+ * 
+ * @param   loop    The main loop to request frames from, may be `NULL`
+ * @param   budget  The number of nanoseconds a frame may spend painting
+ * @return          The paint scheduler
+ */
+itk_paint_scheduler* itk_new_paint_scheduler(itk_main_loop* loop, long budget)
+{
+  itk_paint_scheduler* rc = calloc(1, sizeof(itk_paint_scheduler));
+  rc->queued = itk_new_hash_table();
+  rc->loop = loop;
+  rc->budget = budget;
+  return rc;
+}
+
+
+/**
+ * Destructor, queued units are dropped
+ */
+void itk_free_paint_scheduler(__this__)
+{
+  long i;
+  
+  for (i = 0; i < this->count; i++)
+    free_unit(*(this->units + i));
+  free(this->units);
+  itk_free_hash_table(this->queued, false, false);
+  free(this);
+}
+
+
+/**
+ * Queue a component, and its descendants, to be repainted
+ * 
+ * If the component is already being painted, painting continues and the
+ * component is painted again once it is complete, rather than starting over,
+ * so that a component that is damaged every frame is still painted even if
+ * painting it takes more than one frame
+ * 
+ * @param  component  The component, it must be in a tree whose root is painted with the scheduler
+ */
+void itk_paint_scheduler_damage(__this__, itk_component* component)
+{
+  itk_paint_unit* unit = itk_hash_table_get(this->queued, component);
+  itk_paint_unit* ancestor_unit;
+  itk_component* ancestor;
+  
+  if (unit)
+    {
+      if (unit->recorder)
+	add_redo(unit, component);
+    }
+  else
+    {
+      unit = calloc(1, sizeof(itk_paint_unit));
+      unit->component = component;
+      unit->sequence = this->sequence++;
+      if (this->count == this->capacity)
+	{
+	  this->capacity = this->capacity ? this->capacity << 1 : 16;
+	  this->units = realloc(this->units, this->capacity * sizeof(itk_paint_unit*));
+	}
+      *(this->units + this->count++) = unit;
+      itk_hash_table_put(this->queued, component, unit);
+    }
+  
+  /* An ancestor that has started may already have painted the
+   * component's old look, which would be drawn after the new */
+  for (ancestor = component->parent; ancestor; ancestor = ancestor->parent)
+    if ((ancestor_unit = itk_hash_table_get(this->queued, ancestor)) && ancestor_unit->recorder)
+      add_redo(ancestor_unit, component);
+  
+  if (this->loop)
+    itk_main_loop_request_frame(this->loop);
+}
+
+
+/**
+ * Forget a component, this must be done before it is removed from its parent or freed,
+ * and for each of its descendants that are freed with it, painting that has started
+ * is started over as it may have been laid out with it
+ * 
+ * @param  component  The component
+ */
+void itk_paint_scheduler_cancel_component(__this__, itk_component* component)
+{
+  itk_paint_unit* unit;
+  long i, j, k = 0;
+  
+  for (i = 0; i < this->count; i++)
+    {
+      unit = *(this->units + i);
+      if (unit->component == component)
+	{
+	  itk_hash_table_remove(this->queued, component);
+	  free_unit(unit);
+	  continue;
+	}
+      
+      reset(unit);
+      for (j = 0; j < unit->redo_count;)
+	if (*(unit->redo + j) == component)
+	  *(unit->redo + j) = *(unit->redo + --(unit->redo_count));
+	else
+	  j++;
+      *(this->units + k++) = unit;
+    }
+  this->count = k;
+}
+
+
+/**
+ * Paint queued components until the deadline, at least one component
+ * is painted so that painting progresses however small the budget is
+ * 
+ * Components that cannot be seen are dropped, as nothing would be drawn for them
+ * 
+ * @param   target    The graphics context of the root, in its coordinates, that
+ *                    the completely painted components are drawn with
+ * @param   deadline  When painting shall stop, in nanoseconds on the monotonic clock
+ * @return            The number of units that remain, if non-zero
+ *                    and there is a `loop`, a frame has been requested
+ */
+long itk_paint_scheduler_run(__this__, itk_graphics* target, uint64_t deadline)
+{
+  packed_rectangle_t where = undefined_packed_rectangle();
+  itk_component** redo = NULL;
+  itk_paint_unit* unit;
+  long i, k = 0, redo_count = 0;
+  bool_t progressed = false;
+  
+  if (this->count == 0)
+    return 0;
+  
+  ITK_TRACE_BEGIN("paint_scheduler.run", NULL);
+  
+  if (this->focus)
+    where = itk_component_locate_in_root(this->focus);
+  for (i = 0; i < this->count; i++)
+    {
+      unit = *(this->units + i);
+      if (rank(unit, this->focus, where))
+	*(this->units + k++) = unit;
+      else
+	{
+	  itk_hash_table_remove(this->queued, unit->component);
+	  free_unit(unit);
+	}
+    }
+  this->count = k;
+  qsort(this->units, this->count, sizeof(itk_paint_unit*), compare);
+  
+#define OUT_OF_TIME  (progressed && (itk_metrics_now() >= deadline))
+  
+  for (i = 0; (i < this->count) && !OUT_OF_TIME; i++)
+    {
+      unit = *(this->units + i);
+      if (unit->recorder == NULL)
+	{
+	  if (start(unit) == false)
+	    continue;
+	  progressed = true;
+	}
+      
+      while (unit->depth && !OUT_OF_TIME)
+	{
+	  step(unit);
+	  progressed = true;
+	}
+      if (unit->depth)
+	break;
+      
+      /* Complete, draw it at once */
+      ITK_TRACE_BEGIN("paint_scheduler.replay", unit->component->name);
+      unit->recorder->free(unit->recorder);
+      unit->recorder = NULL;
+      itk_display_list_replay(unit->list, target);
+      ITK_TRACE_END("paint_scheduler.replay", unit->component->name);
+      
+      if (unit->redo_count)
+	{
+	  redo = realloc(redo, (redo_count + unit->redo_count) * sizeof(itk_component*));
+	  memcpy(redo + redo_count, unit->redo, unit->redo_count * sizeof(itk_component*));
+	  redo_count += unit->redo_count;
+	}
+      
+      itk_hash_table_remove(this->queued, unit->component);
+      free_unit(unit);
+      *(this->units + i) = NULL;
+    }
+  
+#undef OUT_OF_TIME
+  
+  for (i = k = 0; i < this->count; i++)
+    if (*(this->units + i))
+      *(this->units + k++) = *(this->units + i);
+  this->count = k;
+  
+  for (i = 0; i < redo_count; i++)
+    itk_paint_scheduler_damage(this, *(redo + i));
+  free(redo);
+  
+  if (this->count && this->loop)
+    itk_main_loop_request_frame(this->loop);
+  
+  ITK_TRACE_END("paint_scheduler.run", NULL);
+  return this->count;
+}
+
@@ -0,0 +1,244 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_PAINT_SCHEDULER_H__
+#define __ITK_PAINT_SCHEDULER_H__
+
+#include "itktypes.h"
+#include "component.h"
+#include "display_list.h"
+#include "graphics.h"
+#include "hash_table.h"
+#include "main_loop.h"
+
+
+/**
+ * A component that is being painted, with the children that remain
+ */
+typedef struct _itk_paint_frame
+{
+  /**
+   * The component
+   */
+  itk_component* component;
+  
+  /**
+   * The graphics context the component is painted with
+   */
+  itk_graphics* graphics;
+  
+  /**
+   * The children of the component when it was laid out
+   */
+  itk_component** children;
+  
+  /**
+   * The rectangles the children are confound in
+   */
+  packed_rectangle_t* rects;
+  
+  /**
+   * The number of elements in `children` and `rects`
+   */
+  long count;
+  
+  /**
+   * The index of the next child to paint
+   */
+  long next;
+  
+} itk_paint_frame;
+
+
+/**
+ * A damaged component, and its paint as recorded so far
+ */
+typedef struct _itk_paint_unit
+{
+  /**
+   * The damaged component
+   */
+  itk_component* component;
+  
+  /**
+   * The recorded paint
+   */
+  itk_display_list* list;
+  
+  /**
+   * The graphics context `list` is recorded with, `NULL` until painting has started
+   */
+  itk_graphics* recorder;
+  
+  /**
+   * The components that are being painted, the
+   * innermost last, empty when painting is complete
+   */
+  itk_paint_frame* stack;
+  
+  /**
+   * The number of elements in `stack`
+   */
+  long depth;
+  
+  /**
+   * The number of elements `stack` has room for
+   */
+  long stack_capacity;
+  
+  /**
+   * The component and descendants that have been damaged after
+   * painting started, and must be painted again after this unit is complete
+   */
+  itk_component** redo;
+  
+  /**
+   * The number of elements in `redo`
+   */
+  long redo_count;
+  
+  /**
+   * The order in which the units were queued
+   */
+  long sequence;
+  
+  /**
+   * The priority class, 0 for the focused component and its descendants, otherwise 1
+   */
+  int rank;
+  
+  /**
+   * The squared distance to the focused component, ranks units of the same class
+   */
+  double distance;
+  
+} itk_paint_unit;
+
+
+/**
+ * Paints damaged components incrementally, in order of priority, and
+ * only as many per frame as fit in a time budget
+ * 
+ * Each damaged component is painted into a display list, which is drawn
+ * only when the component has been painted completely, so the window never
+ * shows a partially painted component, painting of a large component is
+ * continued in the next frame where it was left
+ */
+typedef struct _itk_paint_scheduler
+{
+  /**
+   * The queued units
+   */
+  itk_paint_unit** units;
+  
+  /**
+   * The number of elements in `units`
+   */
+  long count;
+  
+  /**
+   * The number of elements `units` has room for
+   */
+  long capacity;
+  
+  /**
+   * Map from component to its queued unit
+   */
+  itk_hash_table* queued;
+  
+  /**
+   * The focused component, painted before everything else, with the
+   * components nearest to it following, may be `NULL`
+   */
+  itk_component* focus;
+  
+  /**
+   * The number of nanoseconds a frame may spend painting
+   */
+  long budget;
+  
+  /**
+   * The main loop to request frames from, may be `NULL`
+   */
+  itk_main_loop* loop;
+  
+  /**
+   * The sequence number of the next queued unit
+   */
+  long sequence;
+  
+} itk_paint_scheduler;
+
+
+/**
+ * Constructor
+ * 
+ * @param   loop    The main loop to request frames from, may be `NULL`
+ * @param   budget  The number of nanoseconds a frame may spend painting
+ * @return          The paint scheduler
+ */
+itk_paint_scheduler* itk_new_paint_scheduler(itk_main_loop* loop, long budget);
+
+/**
+ * Destructor, queued units are dropped
+ * 
+ * @param  this  The paint scheduler
+ */
+void itk_free_paint_scheduler(itk_paint_scheduler* this);
+
+/**
+ * Queue a component, and its descendants, to be repainted
+ * 
+ * If the component is already being painted, painting continues and the
+ * component is painted again once it is complete, rather than starting over,
+ * so that a component that is damaged every frame is still painted even if
+ * painting it takes more than one frame
+ * 
+ * @param  this       The paint scheduler
+ * @param  component  The component, it must be in a tree whose root is painted with the scheduler
+ */
+void itk_paint_scheduler_damage(itk_paint_scheduler* this, itk_component* component);
+
+/**
+ * Forget a component, this must be done before it is removed from its parent or freed,
+ * and for each of its descendants that are freed with it, painting that has started
+ * is started over as it may have been laid out with it
+ * 
+ * @param  this       The paint scheduler
+ * @param  component  The component
+ */
+void itk_paint_scheduler_cancel_component(itk_paint_scheduler* this, itk_component* component);
+
+/**
+ * Paint queued components until the deadline, at least one component
+ * is painted so that painting progresses however small the budget is
+ * 
+ * Components that cannot be seen are dropped, as nothing would be drawn for them
+ * 
+ * @param   this      The paint scheduler
+ * @param   target    The graphics context of the root, in its coordinates, that
+ *                    the completely painted components are drawn with
+ * @param   deadline  When painting shall stop, in nanoseconds on the monotonic clock
+ * @return            The number of units that remain, if non-zero
+ *                    and there is a `loop`, a frame has been requested
+ */
+long itk_paint_scheduler_run(itk_paint_scheduler* this, itk_graphics* target, uint64_t deadline);
+
+
+#endif
+
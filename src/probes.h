@@ -0,0 +1,82 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_PROBES_H__
+#define __ITK_PROBES_H__
+
+
+/**
+ * Static probe points, compatible with SystemTap, perf and bpftrace (USDT)
+ * 
+ * A probe point compiles to a single `nop` and a note in the `.note.stapsdt`
+ * section, so it costs nothing but evaluating its arguments when nothing is
+ * attached, and nothing at all when `ITK_NO_PROBES` is defined or
+ * <sys/sdt.h> (from SystemTap) is not available at compile time
+ * 
+ * The probes, all in the provider `itk`, are
+ * 
+ *   hash_put              table, size, capacity
+ *   hash_rehash_entry     table, old capacity, new capacity, incremental
+ *   hash_rehash_return    table, new capacity
+ *   layout_prepare_entry  layout manager, vtable, component name, children count
+ *   layout_prepare_return layout manager
+ *   layout_done_entry     layout manager, vtable, component name
+ *   layout_done_return    layout manager
+ *   layout_locate_entry   layout manager, vtable, child name
+ *   layout_locate_return  layout manager, width, height
+ *   paint_child_entry     component name, child name, width, height
+ *   paint_child_return    component name, child name
+ *   x_request             request name, element count
+ * 
+ * Names are `char*` and may be `NULL`, the `_entry` and `_return`
+ * pairs nest, so they can be used to measure latency
+ */
+
+
+#if !defined(ITK_NO_PROBES) && defined(__has_include)
+# if __has_include(<sys/sdt.h>)
+#  include <sys/sdt.h>
+# endif
+#endif
+
+
+#ifdef STAP_PROBEV
+
+/**
+ * Fire a probe point
+ * 
+ * @param  NAME  The name of the probe, without the provider
+ * @param  ...   Up to 12 integer or pointer arguments
+ */
+# define ITK_PROBE(...)  STAP_PROBEV(itk, __VA_ARGS__)
+
+#else
+
+/**
+ * Fire a probe point
+ * 
+ * @param  NAME  The name of the probe, without the provider
+ * @param  ...   Up to 12 integer or pointer arguments
+ */
+# define ITK_PROBE(...)  ((void)0)
+
+#endif
+
+
+#endif
+
@@ -0,0 +1,456 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "region.h"
+#include "geometry.h"
+#include "itkmacros.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * The number of rectangles a region has room for at least
+ */
+#define MINIMUM_CAPACITY  8
+
+/**
+ * The right edge of a rectangle in a region
+ */
+#define RIGHT(r)   ((r)->x + (r)->width)
+
+/**
+ * The bottom edge of a rectangle in a region
+ */
+#define BOTTOM(r)  ((r)->y + (r)->height)
+
+#define MIN(a, b)  ((a) < (b) ? (a) : (b))
+#define MAX(a, b)  ((a) > (b) ? (a) : (b))
+
+
+
+/**
+ * Constructor
+ * 
+ * @return  An empty region
+ */
+itk_region* itk_new_region(void)
+{
+  return calloc(1, sizeof(itk_region));
+}
+
+
+/**
+ * Destructor
+ * 
+ * @param  this  The region
+ */
+void itk_free_region(itk_region* this)
+{
+  free(this->rectangles);
+  free(this);
+}
+
+
+/**
+ * Make room for rectangles
+ * 
+ * @param  this  The region
+ * @param  n     The number of rectangles the region should have room for
+ */
+static void reserve(itk_region* this, long n)
+{
+  if (n <= this->capacity)
+    return;
+  
+  this->capacity = MAX(MAX(n, this->capacity << 1), MINIMUM_CAPACITY);
+  this->rectangles = realloc(this->rectangles, this->capacity * sizeof(packed_rectangle_t));
+}
+
+
+/**
+ * Append a span to the band being built, merging it
+ * with the band's last span if they overlap or touch
+ * 
+ * @param  this  The region
+ * @param  band  The index of the band's first rectangle
+ * @param  x1    The left edge of the span
+ * @param  x2    The right edge of the span
+ * @param  y1    The top edge of the band
+ * @param  y2    The bottom edge of the band
+ */
+static void push(itk_region* this, long band, position_t x1, position_t x2, position_t y1, position_t y2)
+{
+  packed_rectangle_t* last;
+  
+  if (this->count > band)
+    {
+      last = this->rectangles + this->count - 1;
+      if (RIGHT(last) >= x1)
+	{
+	  if (RIGHT(last) < x2)
+	    last->width = x2 - last->x;
+	  return;
+	}
+    }
+  
+  reserve(this, this->count + 1);
+  *(this->rectangles + this->count++) = new_packed_rectangle(x1, y1, x2 - x1, y2 - y1);
+}
+
+
+/**
+ * Finish the band being built, merging it into the previous
+ * band if they touch and have the same spans
+ * 
+ * @param  this      The region
+ * @param  previous  The index of the previous band's first rectangle,
+ *                   updated to the band's index unless it was merged
+ * @param  band      The index of the band's first rectangle
+ */
+static void finish_band(itk_region* this, long* previous, long band)
+{
+  packed_rectangle_t* p = this->rectangles + *previous;
+  packed_rectangle_t* c = this->rectangles + band;
+  long i, n = this->count - band;
+  
+  if (n == 0)
+    return;
+  
+  if ((band - *previous == n) && (BOTTOM(p) == c->y))
+    {
+      for (i = 0; i < n; i++)
+	if (((p + i)->x != (c + i)->x) || ((p + i)->width != (c + i)->width))
+	  break;
+      if (i == n)
+	{
+	  for (i = 0; i < n; i++)
+	    (p + i)->height += c->height;
+	  this->count = band;
+	  return;
+	}
+    }
+  
+  *previous = band;
+}
+
+
+/**
+ * Find the end of a band
+ * 
+ * @param   this  The region
+ * @param   i     The index of the band's first rectangle
+ * @return        The index of the first rectangle after the band
+ */
+static long band_end(const itk_region* this, long i)
+{
+  position_t y = (this->rectangles + i)->y;
+  while ((++i < this->count) && ((this->rectangles + i)->y == y));
+  return i;
+}
+
+
+/**
+ * Append the intersections of the spans of two bands to the band being built
+ * 
+ * @param  this   The region
+ * @param  band   The index of the band's first rectangle
+ * @param  a      The first span of one of the bands
+ * @param  a_end  The end of the spans of the band
+ * @param  b      The first span of the other band
+ * @param  b_end  The end of the spans of the other band
+ * @param  y1     The top edge of the band
+ * @param  y2     The bottom edge of the band
+ */
+static void intersect_spans(itk_region* this, long band,
+			    const packed_rectangle_t* a, const packed_rectangle_t* a_end,
+			    const packed_rectangle_t* b, const packed_rectangle_t* b_end,
+			    position_t y1, position_t y2)
+{
+  position_t x1, x2;
+  
+  while ((a != a_end) && (b != b_end))
+    {
+      x1 = MAX(a->x, b->x);
+      x2 = MIN(RIGHT(a), RIGHT(b));
+      if (x1 < x2)
+	push(this, band, x1, x2, y1, y2);
+      if (RIGHT(a) < RIGHT(b))
+	a++;
+      else
+	b++;
+    }
+}
+
+
+/**
+ * Append the spans of two bands, in order, to the band being built
+ * 
+ * @param  this   The region
+ * @param  band   The index of the band's first rectangle
+ * @param  a      The first span of one of the bands
+ * @param  a_end  The end of the spans of the band
+ * @param  b      The first span of the other band
+ * @param  b_end  The end of the spans of the other band
+ * @param  y1     The top edge of the band
+ * @param  y2     The bottom edge of the band
+ */
+static void unite_spans(itk_region* this, long band,
+			const packed_rectangle_t* a, const packed_rectangle_t* a_end,
+			const packed_rectangle_t* b, const packed_rectangle_t* b_end,
+			position_t y1, position_t y2)
+{
+  const packed_rectangle_t* span;
+  
+  while ((a != a_end) || (b != b_end))
+    {
+      if ((b == b_end) || ((a != a_end) && (a->x <= b->x)))
+	span = a++;
+      else
+	span = b++;
+      push(this, band, span->x, RIGHT(span), y1, y2);
+    }
+}
+
+
+/**
+ * Calculate the union or intersection of two regions by sweeping over
+ * their bands from top to bottom, the spans of the bands that overlap
+ * each interval between two band edges are merged into a new band
+ * 
+ * @param  this       Output parameter for the result, may be `a` or `b`
+ * @param  a          One of the regions
+ * @param  b          The other region
+ * @param  intersect  Whether to calculate the intersection rather than the union
+ */
+static void combine(itk_region* this, const itk_region* a, const itk_region* b, bool_t intersect)
+{
+  itk_region out = { .count = 0, .capacity = 0, .rectangles = NULL };
+  const packed_rectangle_t* ra = a->rectangles;
+  const packed_rectangle_t* rb = b->rectangles;
+  long ia = 0, ib = 0, ea = 0, eb = 0, band, previous = 0;
+  position_t y = INT32_MIN, y_next, a_bottom = 0, b_bottom = 0;
+  bool_t in_a, in_b;
+  
+  reserve(&out, a->count + b->count);
+  
+  while ((ia < a->count) || (ib < b->count))
+    {
+      if (intersect && ((ia == a->count) || (ib == b->count)))
+	break;
+      
+      in_a = in_b = false;
+      y_next = INT32_MAX;
+      if (ia < a->count)
+	{
+	  ea = band_end(a, ia);
+	  a_bottom = BOTTOM(ra + ia);
+	  in_a = (ra + ia)->y <= y;
+	  y_next = in_a ? a_bottom : (ra + ia)->y;
+	}
+      if (ib < b->count)
+	{
+	  eb = band_end(b, ib);
+	  b_bottom = BOTTOM(rb + ib);
+	  in_b = (rb + ib)->y <= y;
+	  y_next = MIN(y_next, in_b ? b_bottom : (rb + ib)->y);
+	}
+      
+      band = out.count;
+      if (intersect == false)
+	unite_spans(&out, band, ra + ia, in_a ? ra + ea : ra + ia, rb + ib, in_b ? rb + eb : rb + ib, y, y_next);
+      else if (in_a && in_b)
+	intersect_spans(&out, band, ra + ia, ra + ea, rb + ib, rb + eb, y, y_next);
+      finish_band(&out, &previous, band);
+      
+      y = y_next;
+      if ((ia < a->count) && (a_bottom == y))
+	ia = ea;
+      if ((ib < b->count) && (b_bottom == y))
+	ib = eb;
+    }
+  
+  free(this->rectangles);
+  *this = out;
+}
+
+
+/**
+ * Make a region empty
+ * 
+ * @param  this  The region
+ */
+void itk_region_clear(itk_region* this)
+{
+  this->count = 0;
+}
+
+
+/**
+ * Make a region cover exactly one rectangle
+ * 
+ * @param  this       The region
+ * @param  rectangle  The rectangle, the region becomes empty if it is empty
+ */
+void itk_region_set_rectangle(itk_region* this, packed_rectangle_t rectangle)
+{
+  this->count = 0;
+  if (itk_rectangle_is_empty(rectangle))
+    return;
+  
+  reserve(this, 1);
+  *(this->rectangles) = rectangle;
+  this->count = 1;
+}
+
+
+/**
+ * Make a region cover the same area as another region
+ * 
+ * @param  this    The region
+ * @param  source  The region to copy
+ */
+void itk_region_copy(itk_region* this, const itk_region* source)
+{
+  if (this == source)
+    return;
+  
+  reserve(this, source->count);
+  if (source->count)
+    memcpy(this->rectangles, source->rectangles, source->count * sizeof(packed_rectangle_t));
+  this->count = source->count;
+}
+
+
+/**
+ * Add a rectangle to a region
+ * 
+ * @param  this       The region
+ * @param  rectangle  The rectangle
+ */
+void itk_region_add_rectangle(itk_region* this, packed_rectangle_t rectangle)
+{
+  itk_region other = { .count = 1, .capacity = 1, .rectangles = &rectangle };
+  
+  if (itk_rectangle_is_empty(rectangle) == false)
+    combine(this, this, &other, false);
+}
+
+
+/**
+ * Add the area of another region to a region
+ * 
+ * @param  this   The region
+ * @param  other  The other region, may be `this`
+ */
+void itk_region_union(itk_region* this, const itk_region* other)
+{
+  if ((this != other) && other->count)
+    combine(this, this, other, false);
+}
+
+
+/**
+ * Remove everything outside a rectangle from a region
+ * 
+ * @param  this       The region
+ * @param  rectangle  The rectangle
+ */
+void itk_region_intersect_rectangle(itk_region* this, packed_rectangle_t rectangle)
+{
+  itk_region other = { .count = 1, .capacity = 1, .rectangles = &rectangle };
+  
+  if (itk_rectangle_is_empty(rectangle))
+    this->count = 0;
+  else
+    combine(this, this, &other, true);
+}
+
+
+/**
+ * Remove everything outside another region from a region
+ * 
+ * @param  this   The region
+ * @param  other  The other region, may be `this`
+ */
+void itk_region_intersect(itk_region* this, const itk_region* other)
+{
+  if (this != other)
+    combine(this, this, other, true);
+}
+
+
+/**
+ * Move a region
+ * 
+ * @param  this    The region
+ * @param  offset  The distance to move the region
+ */
+void itk_region_translate(itk_region* this, packed_position2_t offset)
+{
+  itk_rectangles_translate(this->rectangles, this->count, offset);
+}
+
+
+/**
+ * Calculate the smallest rectangle that contains a region
+ * 
+ * @param   this  The region
+ * @return        The bounding box, not defined if the region is empty
+ */
+packed_rectangle_t itk_region_bounds(const itk_region* this)
+{
+  const packed_rectangle_t* first = this->rectangles;
+  const packed_rectangle_t* last;
+  position_t x1, x2;
+  long i;
+  
+  if (this->count == 0)
+    return undefined_packed_rectangle();
+  
+  last = first + this->count - 1;
+  x1 = first->x;
+  x2 = RIGHT(first);
+  for (i = 1; i < this->count; i++)
+    {
+      x1 = MIN(x1, (first + i)->x);
+      x2 = MAX(x2, RIGHT(first + i));
+    }
+  
+  return new_packed_rectangle(x1, first->y, x2 - x1, BOTTOM(last) - first->y);
+}
+
+
+/**
+ * Check whether a region contains a point
+ * 
+ * @param   this   The region
+ * @param   point  The point
+ * @return         Whether the point is inside the region
+ */
+bool_t itk_region_contains(const itk_region* this, packed_position2_t point)
+{
+  long i;
+  
+  for (i = 0; (i < this->count) && ((this->rectangles + i)->y <= point.y); i++)
+    if (itk_rectangle_contains(*(this->rectangles + i), point))
+      return true;
+  
+  return false;
+}
+
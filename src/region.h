@@ -0,0 +1,150 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_REGION_H__
+#define __ITK_REGION_H__
+
+#include "itktypes.h"
+
+
+/**
+ * An area made up of rectangles, stored YX-banded: the rectangles are
+ * sorted by their top edge and then by their left edge, rectangles with
+ * the same top edge form a band and have the same height, bands do not
+ * overlap, and rectangles in the same band neither overlap nor touch
+ * 
+ * This is the same order as X's `YXBanded`, so the rectangles can
+ * be passed directly to `XSetClipRectangles`
+ */
+typedef struct _itk_region
+{
+  /**
+   * The number of rectangles in the region, zero if the region is empty
+   */
+  long count;
+  
+  /**
+   * The number of rectangles `rectangles` has room for
+   */
+  long capacity;
+  
+  /**
+   * The rectangles, none of them are empty
+   */
+  packed_rectangle_t* rectangles;
+  
+} itk_region;
+
+
+/**
+ * Constructor
+ * 
+ * @return  An empty region
+ */
+itk_region* itk_new_region(void);
+
+/**
+ * Destructor
+ * 
+ * @param  this  The region
+ */
+void itk_free_region(itk_region* this);
+
+/**
+ * Make a region empty
+ * 
+ * @param  this  The region
+ */
+void itk_region_clear(itk_region* this);
+
+/**
+ * Make a region cover exactly one rectangle
+ * 
+ * @param  this       The region
+ * @param  rectangle  The rectangle, the region becomes empty if it is empty
+ */
+void itk_region_set_rectangle(itk_region* this, packed_rectangle_t rectangle);
+
+/**
+ * Make a region cover the same area as another region
+ * 
+ * @param  this    The region
+ * @param  source  The region to copy
+ */
+void itk_region_copy(itk_region* this, const itk_region* source);
+
+/**
+ * Add a rectangle to a region
+ * 
+ * @param  this       The region
+ * @param  rectangle  The rectangle
+ */
+void itk_region_add_rectangle(itk_region* this, packed_rectangle_t rectangle);
+
+/**
+ * Add the area of another region to a region
+ * 
+ * @param  this   The region
+ * @param  other  The other region, may be `this`
+ */
+void itk_region_union(itk_region* this, const itk_region* other);
+
+/**
+ * Remove everything outside a rectangle from a region
+ * 
+ * @param  this       The region
+ * @param  rectangle  The rectangle
+ */
+void itk_region_intersect_rectangle(itk_region* this, packed_rectangle_t rectangle);
+
+/**
+ * Remove everything outside another region from a region
+ * 
+ * @param  this   The region
+ * @param  other  The other region, may be `this`
+ */
+void itk_region_intersect(itk_region* this, const itk_region* other);
+
+/**
+ * Move a region
+ * 
+ * @param  this    The region
+ * @param  offset  The distance to move the region
+ */
+void itk_region_translate(itk_region* this, packed_position2_t offset);
+
+/**
+ * Calculate the smallest rectangle that contains a region
+ * 
+ * @param   this  The region
+ * @return        The bounding box, not defined if the region is empty
+ */
+packed_rectangle_t itk_region_bounds(const itk_region* this);
+
+/**
+ * Check whether a region contains a point
+ * 
+ * @param   this   The region
+ * @param   point  The point
+ * @return         Whether the point is inside the region
+ */
+bool_t itk_region_contains(const itk_region* this, packed_position2_t point);
+
+
+#endif
+
@@ -0,0 +1,262 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "render_thread.h"
+#include "itkmacros.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+
+#define __this__  itk_render_thread* this
+
+
+
+/**
+ * Request a frame, posted to the UI thread's main loop
+ */
+static void request_frame(itk_main_loop* loop, void* user_data)
+{
+  (void) user_data;
+  
+  itk_main_loop_request_frame(loop);
+}
+
+
+/**
+ * Draw and present the submitted display lists until the thread is stopped
+ * 
+ * @param   data  The render thread
+ * @return        `NULL`
+ */
+static void* render(void* data)
+{
+  itk_render_thread* this = data;
+  itk_display_list* lists;
+  itk_display_list* list;
+  uint64_t start;
+  
+  pthread_mutex_lock(&(this->lock));
+  for (;;)
+    {
+      while ((this->pending == NULL) && (this->stopping == false))
+	pthread_cond_wait(&(this->submitted), &(this->lock));
+      if (this->pending == NULL)
+	break;
+      
+      lists = this->pending;
+      this->pending = this->last_pending = NULL;
+      this->rendering = true;
+      
+      /* The slot is free again, so the UI thread can start on the next frame */
+      if (this->stalled && this->loop)
+	{
+	  this->stalled = false;
+	  itk_main_loop_post(this->loop, request_frame, NULL);
+	}
+      pthread_mutex_unlock(&(this->lock));
+      
+      ITK_TRACE_BEGIN("render_thread.frame", NULL);
+      start = itk_metrics_now();
+      for (list = lists; list; list = list->next)
+	itk_display_list_replay(list, this->target);
+      if (this->present)
+	this->present(this, this->user_data);
+      ITK_TRACE_END("render_thread.frame", NULL);
+      
+      pthread_mutex_lock(&(this->lock));
+      while ((list = lists))
+	{
+	  lists = list->next;
+	  itk_display_list_clear(list);
+	  list->next = this->spare;
+	  this->spare = list;
+	}
+      this->rendering = false;
+      this->frames++;
+      this->frame_time = (long)(itk_metrics_now() - start);
+      pthread_cond_broadcast(&(this->presented));
+    }
+  pthread_mutex_unlock(&(this->lock));
+  
+  return NULL;
+}
+
+
+
+/**
+ * Constructor, starts the thread
+ * 
+ * @param   target     The graphics context to draw with, it is not freed with the render thread
+ * @param   present    Makes a frame visible, on the render thread, may be `NULL`
+ * @param   user_data  User data for `present`
+ * @param   loop       The UI thread's main loop, may be `NULL`
+ * @return             The render thread, `NULL` on error, in which case `errno` is set
+ */
+itk_render_thread* itk_new_render_thread(itk_graphics* target,
+					 void (*present)(itk_render_thread* render_thread, void* user_data),
+					 void* user_data, itk_main_loop* loop)
+{
+  itk_render_thread* rc = calloc(1, sizeof(itk_render_thread));
+  int error;
+  
+  rc->target = target;
+  rc->present = present;
+  rc->user_data = user_data;
+  rc->loop = loop;
+  pthread_mutex_init(&(rc->lock), NULL);
+  pthread_cond_init(&(rc->submitted), NULL);
+  pthread_cond_init(&(rc->presented), NULL);
+  
+  if ((error = pthread_create(&(rc->thread), NULL, render, rc)))
+    {
+      pthread_cond_destroy(&(rc->presented));
+      pthread_cond_destroy(&(rc->submitted));
+      pthread_mutex_destroy(&(rc->lock));
+      free(rc);
+      errno = error;
+      return NULL;
+    }
+  
+  return rc;
+}
+
+
+/**
+ * Destructor, the submitted frames are drawn before the thread stops
+ */
+void itk_free_render_thread(__this__)
+{
+  itk_display_list* list;
+  
+  pthread_mutex_lock(&(this->lock));
+  this->stopping = true;
+  pthread_cond_signal(&(this->submitted));
+  pthread_mutex_unlock(&(this->lock));
+  pthread_join(this->thread, NULL);
+  
+  while ((list = this->spare))
+    {
+      this->spare = list->next;
+      itk_free_display_list(list);
+    }
+  
+  pthread_cond_destroy(&(this->presented));
+  pthread_cond_destroy(&(this->submitted));
+  pthread_mutex_destroy(&(this->lock));
+  free(this);
+}
+
+
+/**
+ * Get an empty display list to record a frame into, on the UI thread
+ * 
+ * @return  The display list, it shall be submitted with `itk_render_thread_submit`
+ */
+itk_display_list* itk_render_thread_begin(__this__)
+{
+  itk_display_list* rc;
+  
+  pthread_mutex_lock(&(this->lock));
+  if ((rc = this->spare))
+    this->spare = rc->next;
+  pthread_mutex_unlock(&(this->lock));
+  
+  if (rc == NULL)
+    rc = itk_new_display_list();
+  rc->next = NULL;
+  return rc;
+}
+
+
+/**
+ * Hand over a recorded display list to the render thread, on the UI thread
+ * 
+ * The recording graphics contexts must have been freed
+ * 
+ * @param  list  The display list, from `itk_render_thread_begin`
+ */
+void itk_render_thread_submit(__this__, itk_display_list* list)
+{
+  list->next = NULL;
+  
+  pthread_mutex_lock(&(this->lock));
+  /* Lists that have not been started are drawn together, in order,
+   * since each of them only repaints its own damaged area */
+  if (this->last_pending)
+    this->last_pending->next = list;
+  else
+    this->pending = list;
+  this->last_pending = list;
+  pthread_cond_signal(&(this->submitted));
+  pthread_mutex_unlock(&(this->lock));
+}
+
+
+/**
+ * Check whether the render thread has started drawing the last submitted frame,
+ * so that recording the next one keeps it at most one frame behind
+ * 
+ * If not, a frame is requested from `loop` when it has
+ * 
+ * @return  Whether the next frame should be recorded now
+ */
+bool_t itk_render_thread_ready(__this__)
+{
+  bool_t rc;
+  
+  pthread_mutex_lock(&(this->lock));
+  rc = this->pending == NULL;
+  if (rc == false)
+    this->stalled = true;
+  pthread_mutex_unlock(&(this->lock));
+  
+  return rc;
+}
+
+
+/**
+ * Get the number of nanoseconds the last frame took to draw and present
+ * 
+ * @return  The time of the last frame, 0 if none has been presented
+ */
+long itk_render_thread_frame_time(__this__)
+{
+  long rc;
+  
+  pthread_mutex_lock(&(this->lock));
+  rc = this->frame_time;
+  pthread_mutex_unlock(&(this->lock));
+  
+  return rc;
+}
+
+
+/**
+ * Wait until every submitted frame has been presented
+ */
+void itk_render_thread_wait(__this__)
+{
+  pthread_mutex_lock(&(this->lock));
+  while (this->pending || this->rendering)
+    pthread_cond_wait(&(this->presented), &(this->lock));
+  pthread_mutex_unlock(&(this->lock));
+}
+
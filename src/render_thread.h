@@ -0,0 +1,198 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_RENDER_THREAD_H__
+#define __ITK_RENDER_THREAD_H__
+
+#include "display_list.h"
+#include "main_loop.h"
+
+#include <pthread.h>
+
+
+/**
+ * A thread that draws and presents display lists recorded by another thread,
+ * the UI thread, so that frame N is drawn while frame N + 1 is painted
+ * 
+ * Only the UI thread touches the components, they are painted with a graphics
+ * context from `itk_new_recording_graphics`, and only the render thread uses
+ * the target graphics context, until the render thread has been freed
+ * 
+ * With an X graphics context as the target, `XInitThreads` must have been
+ * called before the display was opened, because both threads use it
+ */
+typedef struct _itk_render_thread
+{
+  /**
+   * The thread
+   */
+  pthread_t thread;
+  
+  /**
+   * Protects the fields that both threads use
+   */
+  pthread_mutex_t lock;
+  
+  /**
+   * Signalled when a list is submitted or the thread shall stop
+   */
+  pthread_cond_t submitted;
+  
+  /**
+   * Signalled when a frame has been presented
+   */
+  pthread_cond_t presented;
+  
+  /**
+   * The graphics context the display lists are drawn with
+   */
+  itk_graphics* target;
+  
+  /**
+   * Called on the render thread after the display lists of a
+   * frame have been drawn, to make the frame visible, may be `NULL`
+   * 
+   * @param  render_thread  The render thread
+   * @param  user_data      `user_data` of the render thread
+   */
+  void (*present)(struct _itk_render_thread* render_thread, void* user_data);
+  
+  /**
+   * User data for `present`
+   */
+  void* user_data;
+  
+  /**
+   * The main loop to request a frame from when the render thread
+   * is ready for the next one after `itk_render_thread_ready`
+   * has returned `false`, may be `NULL`
+   */
+  itk_main_loop* loop;
+  
+  /**
+   * Submitted display lists that have not yet been started, in order,
+   * linked by their `next`, they are drawn as one frame
+   */
+  itk_display_list* pending;
+  
+  /**
+   * The last list in `pending`
+   */
+  itk_display_list* last_pending;
+  
+  /**
+   * Display lists that have been drawn, kept for reuse
+   */
+  itk_display_list* spare;
+  
+  /**
+   * Whether a frame is being drawn
+   */
+  bool_t rendering;
+  
+  /**
+   * Whether `itk_render_thread_ready` has returned `false`
+   * and no frame has been requested from `loop` since
+   */
+  bool_t stalled;
+  
+  /**
+   * Whether the thread shall stop once `pending` is empty
+   */
+  bool_t stopping;
+  
+  /**
+   * The number of frames that have been presented
+   */
+  long frames;
+  
+  /**
+   * The number of nanoseconds the last frame took to draw and present
+   */
+  long frame_time;
+  
+} itk_render_thread;
+
+
+/**
+ * Constructor, starts the thread
+ * 
+ * @param   target     The graphics context to draw with, it is not freed with the render thread
+ * @param   present    Makes a frame visible, on the render thread, may be `NULL`
+ * @param   user_data  User data for `present`
+ * @param   loop       The UI thread's main loop, may be `NULL`
+ * @return             The render thread, `NULL` on error, in which case `errno` is set
+ */
+itk_render_thread* itk_new_render_thread(itk_graphics* target,
+					 void (*present)(itk_render_thread* render_thread, void* user_data),
+					 void* user_data, itk_main_loop* loop);
+
+/**
+ * Destructor, the submitted frames are drawn before the thread stops
+ * 
+ * @param  this  The render thread
+ */
+void itk_free_render_thread(itk_render_thread* this);
+
+/**
+ * Get an empty display list to record a frame into, on the UI thread
+ * 
+ * @param   this  The render thread
+ * @return        The display list, it shall be submitted with `itk_render_thread_submit`
+ */
+itk_display_list* itk_render_thread_begin(itk_render_thread* this);
+
+/**
+ * Hand over a recorded display list to the render thread, on the UI thread
+ * 
+ * The recording graphics contexts must have been freed
+ * 
+ * @param  this  The render thread
+ * @param  list  The display list, from `itk_render_thread_begin`
+ */
+void itk_render_thread_submit(itk_render_thread* this, itk_display_list* list);
+
+/**
+ * Check whether the render thread has started drawing the last submitted frame,
+ * so that recording the next one keeps it at most one frame behind
+ * 
+ * If not, a frame is requested from `loop` when it has
+ * 
+ * @param   this  The render thread
+ * @return        Whether the next frame should be recorded now
+ */
+bool_t itk_render_thread_ready(itk_render_thread* this);
+
+/**
+ * Get the number of nanoseconds the last frame took to draw and present
+ * 
+ * @param   this  The render thread
+ * @return        The time of the last frame, 0 if none has been presented
+ */
+long itk_render_thread_frame_time(itk_render_thread* this);
+
+/**
+ * Wait until every submitted frame has been presented
+ * 
+ * @param  this  The render thread
+ */
+void itk_render_thread_wait(itk_render_thread* this);
+
+
+#endif
+
@@ -0,0 +1,254 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "snapshot.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * The largest number of bytes in a stored deflate block
+ */
+#define STORED_BLOCK_SIZE  65535
+
+
+/**
+ * Get the colour of a pixel in the front buffer
+ * 
+ * @param   framebuffer  The framebuffer
+ * @param   x            The column of the pixel
+ * @param   y            The row of the pixel
+ * @return               The pixel
+ */
+static inline argb_colour_t pixel(const itk_framebuffer* framebuffer, long x, long y)
+{
+  argb_colour_t rc;
+  rc.value = *((uint32_t*)((char*)(framebuffer->front) + y * framebuffer->stride) + x);
+  return rc;
+}
+
+
+/**
+ * Close a file that has been written
+ * 
+ * @param   file  The file
+ * @param   ok    Whether everything was written
+ * @return        Zero on success, -1 on error, in which case `errno` is set
+ */
+static int finish(FILE* file, int ok)
+{
+  int saved_errno = errno;
+  
+  if (ferror(file))
+    ok = 0;
+  if (fclose(file))
+    return -1;
+  if (ok)
+    return 0;
+  
+  errno = saved_errno ? saved_errno : EIO;
+  return -1;
+}
+
+
+/**
+ * Write the front buffer of a framebuffer to a binary PPM (P6) file
+ * 
+ * @param   framebuffer  The framebuffer
+ * @param   pathname     The pathname of the file
+ * @return               Zero on success, -1 on error, in which case `errno` is set
+ */
+int itk_write_ppm(const itk_framebuffer* framebuffer, const char* pathname)
+{
+  FILE* file = fopen(pathname, "wb");
+  argb_colour_t p;
+  long x, y;
+  
+  if (file == NULL)
+    return -1;
+  
+  fprintf(file, "P6\n%li %li\n255\n", (long)(framebuffer->width), (long)(framebuffer->height));
+  for (y = 0; y < framebuffer->height; y++)
+    for (x = 0; x < framebuffer->width; x++)
+      {
+	p = pixel(framebuffer, x, y);
+	putc(p.c.red, file);
+	putc(p.c.green, file);
+	putc(p.c.blue, file);
+      }
+  
+  return finish(file, 1);
+}
+
+
+/**
+ * Update a CRC-32, as used by PNG, with more data
+ * 
+ * @param   crc   The CRC of the previous data, 0 initially
+ * @param   data  The data
+ * @param   n     The number of bytes in `data`
+ * @return        The CRC of all the data
+ */
+static uint32_t crc32(uint32_t crc, const uint8_t* data, long n)
+{
+  static uint32_t table[256];
+  uint32_t c;
+  long i, k;
+  
+  if (*(table + 1) == 0)
+    for (i = 0; i < 256; i++)
+      {
+	for (c = (uint32_t)i, k = 0; k < 8; k++)
+	  c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+	*(table + i) = c;
+      }
+  
+  crc = ~crc;
+  for (i = 0; i < n; i++)
+    crc = *(table + ((crc ^ *(data + i)) & 255)) ^ (crc >> 8);
+  return ~crc;
+}
+
+
+/**
+ * Store a 32-bit integer in big-endian
+ * 
+ * @param  out    The output buffer
+ * @param  value  The integer
+ */
+static inline void big_endian(uint8_t* out, uint32_t value)
+{
+  *(out + 0) = (uint8_t)(value >> 24);
+  *(out + 1) = (uint8_t)(value >> 16);
+  *(out + 2) = (uint8_t)(value >> 8);
+  *(out + 3) = (uint8_t)(value >> 0);
+}
+
+
+/**
+ * Write a PNG chunk
+ * 
+ * @param   file  The file
+ * @param   type  The type of the chunk, four letters
+ * @param   data  The data of the chunk
+ * @param   n     The number of bytes in `data`
+ * @return        Whether the chunk was written
+ */
+static int write_chunk(FILE* file, const char* type, const uint8_t* data, long n)
+{
+  uint8_t header[8], trailer[4];
+  uint32_t crc;
+  
+  big_endian(header, (uint32_t)n);
+  memcpy(header + 4, type, 4);
+  crc = crc32(crc32(0, header + 4, 4), data, n);
+  big_endian(trailer, crc);
+  
+  return (fwrite(header, 1, 8, file) == 8) &&
+    ((n == 0) || (fwrite(data, 1, n, file) == (size_t)n)) &&
+    (fwrite(trailer, 1, 4, file) == 4);
+}
+
+
+/**
+ * Write the front buffer of a framebuffer to a PNG file, with 8-bit RGB
+ * pixels, the image data is stored without compression, so that no
+ * compression library is required
+ * 
+ * @param   framebuffer  The framebuffer, it must not be empty
+ * @param   pathname     The pathname of the file
+ * @return               Zero on success, -1 on error, in which case `errno` is set
+ */
+int itk_write_png(const itk_framebuffer* framebuffer, const char* pathname)
+{
+  static const uint8_t signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+  long row = 1 + 3 * (long)(framebuffer->width), size = row * framebuffer->height;
+  long blocks = (size + STORED_BLOCK_SIZE - 1) / STORED_BLOCK_SIZE;
+  uint8_t* raw = malloc(size);
+  uint8_t* zlib = malloc(2 + 5 * blocks + size + 4);
+  uint8_t* z = zlib;
+  uint8_t header[13];
+  uint32_t a = 1, b = 0;
+  argb_colour_t p;
+  long x, y, i, n;
+  FILE* file;
+  int ok;
+  
+  /* Scanlines, each prefixed with filter type 0, none */
+  for (y = 0; y < framebuffer->height; y++)
+    {
+      *(raw + y * row) = 0;
+      for (x = 0; x < framebuffer->width; x++)
+	{
+	  p = pixel(framebuffer, x, y);
+	  *(raw + y * row + 1 + 3 * x + 0) = p.c.red;
+	  *(raw + y * row + 1 + 3 * x + 1) = p.c.green;
+	  *(raw + y * row + 1 + 3 * x + 2) = p.c.blue;
+	}
+    }
+  
+  /* A zlib stream of stored deflate blocks, followed by the Adler-32 of the data */
+  *z++ = 0x78;
+  *z++ = 0x01;
+  for (i = 0; i < size; i += n)
+    {
+      n = size - i < STORED_BLOCK_SIZE ? size - i : STORED_BLOCK_SIZE;
+      *z++ = i + n == size;
+      *z++ = (uint8_t)(n & 255);
+      *z++ = (uint8_t)(n >> 8);
+      *z++ = (uint8_t)(~n & 255);
+      *z++ = (uint8_t)((~n >> 8) & 255);
+      memcpy(z, raw + i, n);
+      z += n;
+    }
+  for (i = 0; i < size; i++)
+    {
+      a = (a + *(raw + i)) % 65521;
+      b = (b + a) % 65521;
+    }
+  big_endian(z, (b << 16) | a);
+  z += 4;
+  
+  big_endian(header + 0, (uint32_t)(framebuffer->width));
+  big_endian(header + 4, (uint32_t)(framebuffer->height));
+  *(header + 8) = 8;   /* bit depth */
+  *(header + 9) = 2;   /* colour type, RGB */
+  *(header + 10) = 0;  /* compression method, deflate */
+  *(header + 11) = 0;  /* filter method */
+  *(header + 12) = 0;  /* interlace method, none */
+  
+  file = fopen(pathname, "wb");
+  if (file == NULL)
+    ok = -1;
+  else
+    {
+      ok = (fwrite(signature, 1, 8, file) == 8) &&
+	write_chunk(file, "IHDR", header, 13) &&
+	write_chunk(file, "IDAT", zlib, z - zlib) &&
+	write_chunk(file, "IEND", NULL, 0);
+      ok = finish(file, ok);
+    }
+  
+  free(raw);
+  free(zlib);
+  return ok;
+}
+
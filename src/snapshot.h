@@ -0,0 +1,47 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_SNAPSHOT_H__
+#define __ITK_SNAPSHOT_H__
+
+#include "fb_graphics.h"
+
+
+/**
+ * Write the front buffer of a framebuffer to a binary PPM (P6) file
+ * 
+ * @param   framebuffer  The framebuffer
+ * @param   pathname     The pathname of the file
+ * @return               Zero on success, -1 on error, in which case `errno` is set
+ */
+int itk_write_ppm(const itk_framebuffer* framebuffer, const char* pathname);
+
+/**
+ * Write the front buffer of a framebuffer to a PNG file, with 8-bit RGB
+ * pixels, the image data is stored without compression, so that no
+ * compression library is required
+ * 
+ * @param   framebuffer  The framebuffer, it must not be empty
+ * @param   pathname     The pathname of the file
+ * @return               Zero on success, -1 on error, in which case `errno` is set
+ */
+int itk_write_png(const itk_framebuffer* framebuffer, const char* pathname);
+
+
+#endif
+
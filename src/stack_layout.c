@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "stack_layout.h"
+#include "child_hints.h"
 #include "itkmacros.h"
 
 #include <stdlib.h>
@@ -25,7 +26,7 @@
 #define __this__  itk_layout_manager* this
 
 #define CONTAINER_(layout)  *((void**)(layout->data) + 0)
-#define CONTAINER(layout)   ((itk_component*)(CONTAINER_(layout)))
+#define CONTAINER(layout)   itk_component_compact_children(CONTAINER_(layout))
 
 
 /**
@@ -52,19 +53,15 @@ static void done(__this__)
  * @param   child  The child, to the component using the layout manager, of interest
  * @return         The rectangle the child is confound in
  */
-static rectangle_t locate(__this__, itk_component* child)
+static packed_rectangle_t locate(__this__, itk_component* child)
 {
   if (child->visible)
     {
       size2_t c = CONTAINER(this)->size;
-      return new_rectangle(0, 0, c.width, c.height);
+      return new_packed_rectangle(0, 0, c.width, c.height);
     }
   else
-    {
-      rectangle_t rc;
-      rc.defined = false;
-      return rc;
-    }
+    return undefined_packed_rectangle();
 }
 
 
@@ -75,19 +72,12 @@ static rectangle_t locate(__this__, itk_component* child)
  */
 static size2_t minimum_size(__this__)
 { 
-  itk_component** children = CONTAINER(this)->children;
-  long i, n = CONTAINER(this)->children_count;
+  itk_child_totals totals = itk_child_hints_totals(CONTAINER_(this), ITK_CHILD_HINT_MINIMUM,
+						   ITK_CHILD_TOTAL_MAX, ITK_CHILD_TOTAL_MAX);
   size2_t rc;
-  rc.width = rc.height = 0;
   rc.defined = true;
-  for (i = 0; i < n; i++)
-    if ((*(children + i))->visible)
-      {
-	if (rc.width < (*(children + i))->minimum_size.width)
-	  rc.width = (*(children + i))->minimum_size.width;
-	if (rc.height < (*(children + i))->minimum_size.height)
-	  rc.height = (*(children + i))->minimum_size.height;
-      }
+  rc.width  = totals.width;
+  rc.height = totals.height;
   return rc;
 }
 
@@ -99,20 +89,12 @@ static size2_t minimum_size(__this__)
  */
 static size2_t maximum_size(__this__)
 {
-  itk_component** children = CONTAINER(this)->children;
-  long i, n = CONTAINER(this)->children_count;
-  size2_t rc, t;
-  rc.width = rc.height = UNBOUNDED;
+  itk_child_totals totals = itk_child_hints_totals(CONTAINER_(this), ITK_CHILD_HINT_MAXIMUM,
+						   ITK_CHILD_TOTAL_BOUNDED_MIN, ITK_CHILD_TOTAL_BOUNDED_MIN);
+  size2_t rc;
   rc.defined = true;
-  for (i = 0; i < n; i++)
-    if ((*(children + i))->visible)
-      {
-	t = (*(children + i))->maximum_size;
-	if (((rc.width < 0) || (rc.width > t.width)) && (t.width >= 0))
-	  rc.width = t.width;
-	if (((rc.height < 0) || (rc.height > t.height)) && (t.height >= 0))
-	  rc.height = t.height;
-      }
+  rc.width  = totals.width;
+  rc.height = totals.height;
   return rc;
 }
 
@@ -124,19 +106,12 @@ static size2_t maximum_size(__this__)
  */
 static size2_t preferred_size(__this__)
 {
-  itk_component** children = CONTAINER(this)->children;
-  long i, n = CONTAINER(this)->children_count;
+  itk_child_totals totals = itk_child_hints_totals(CONTAINER_(this), ITK_CHILD_HINT_PREFERRED,
+						   ITK_CHILD_TOTAL_MAX, ITK_CHILD_TOTAL_MAX);
   size2_t rc;
-  rc.width = rc.height = 0;
   rc.defined = true;
-  for (i = 0; i < n; i++)
-    if ((*(children + i))->visible)
-      {
-	if (rc.width < (*(children + i))->preferred_size.width)
-	  rc.width = (*(children + i))->preferred_size.width;
-	if (rc.height < (*(children + i))->preferred_size.height)
-	  rc.height = (*(children + i))->preferred_size.height;
-      }
+  rc.width  = totals.width;
+  rc.height = totals.height;
   return rc;
 }
 
@@ -144,13 +119,27 @@ static size2_t preferred_size(__this__)
 /**
  * Destructor
  */
-static void free_margin_layout(__this__)
+static void free_stack_layout(__this__)
 {
-  free(this->data);
   free(this);
 }
 
 
+/**
+ * The methods of stack layout managers
+ */
+static const itk_layout_manager_vtable stack_layout_vtable =
+  {
+    .prepare        = prepare,
+    .done           = done,
+    .locate         = locate,
+    .minimum_size   = minimum_size,
+    .preferred_size = preferred_size,
+    .maximum_size   = maximum_size,
+    .free           = free_stack_layout
+  };
+
+
 /**
  * Constructor
  * 
@@ -158,16 +147,9 @@ static void free_margin_layout(__this__)
  */
 itk_layout_manager* itk_new_stack_layout(itk_component* container)
 {
-  itk_layout_manager* rc = malloc(sizeof(itk_layout_manager));
-  dimension_t* margins = malloc(sizeof(dimension_t));
-  rc->data = malloc(2 * sizeof(void*));
-  rc->prepare = prepare;
-  rc->done = done;
-  rc->locate = locate;
-  rc->minimum_size = minimum_size;
-  rc->preferred_size = preferred_size;
-  rc->maximum_size = maximum_size;
-  rc->free = free_margin_layout;
+  itk_layout_manager* rc = malloc(sizeof(itk_layout_manager) + sizeof(void*));
+  rc->vtable = &stack_layout_vtable;
+  rc->data = (void**)(rc + 1);
   CONTAINER_(rc) = container;
   return rc;
 }
@@ -1,7 +1,27 @@
+#include "component.h"
+#include "main_loop.h"
+#include "x_event_pump.h"
+#include "x_graphics.h"
+#include "itkmacros.h"
+
 #include <X11/Xlib.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
+
+
+/**
+ * Paint the demo component
+ * 
+ * @param  this  The component
+ * @param  g     The object with which to paint
+ */
+static void paint_hello(itk_component* this, itk_graphics* g)
+{
+  (void) this;
+  
+  g->fill_rectangle(g, new_rectangle(20, 20, 10, 10));
+  g->draw_string(g, new_position2(10, 50), "Hello world!");
+}
 
 
 int main(void)
@@ -10,7 +30,11 @@ int main(void)
   int screen;
   Window root_window;
   Window window;
-  XEvent event;
+  itk_component_vtable hello_class = { .paint_component = paint_hello };
+  itk_component* hello;
+  itk_graphics* g;
+  itk_x_event_pump* pump;
+  itk_main_loop* loop;
   
   if ((display = XOpenDisplay(NULL)) == NULL)
     {
@@ -23,18 +47,23 @@ int main(void)
   window = XCreateSimpleWindow(display, root_window, 0, 0, 800, 600, 50,
 			       BlackPixel(display, screen),
 			       WhitePixel(display, screen));
-  XSelectInput(display, window, ExposureMask);
+  
+  itk_derive_component_vtable(&hello_class, &itk_component_class);
+  hello = itk_new_component("hello");
+  hello->vtable = &hello_class;
+  g = itk_new_x_graphics(display, screen, window);
+  
+  /* Expose and resize bursts are coalesced into at most one repaint per frame */
+  loop = itk_new_main_loop();
+  pump = itk_new_x_event_pump(display, window, hello, g);
+  itk_x_event_pump_attach(pump, loop, 1000000000L / 60);
   XMapWindow(display, window);
- 
-  for (;;)
-    {
-      XNextEvent(display, &event);
-      if (event.type == Expose)
-	{
-	  XFillRectangle(display, window, DefaultGC(display, screen), 20, 20, 10, 10);
-	  XDrawString(display, window, DefaultGC(display, screen), 10, 50, "Hello world!", strlen("Hello world!"));
-	}
-    }
+  itk_main_loop_run(loop);
+  
+  itk_free_main_loop(loop);
+  itk_free_x_event_pump(pump);
+  g->free(g);
+  hello->vtable->free(hello);
   XCloseDisplay(display);
   return 0;
 }
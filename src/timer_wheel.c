@@ -0,0 +1,424 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "timer_wheel.h"
+#include "itkmacros.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+
+#define __this__  itk_timer_wheel* this
+
+
+/**
+ * The slot mask of a level
+ */
+#define MASK  (ITK_TIMER_WHEEL_SLOTS - 1)
+
+/**
+ * The first bit of the tick that selects the slot in a level
+ * 
+ * @param  LEVEL  The level
+ */
+#define SHIFT(LEVEL)  (ITK_TIMER_WHEEL_BITS * (LEVEL))
+
+/**
+ * The number of ticks the wheel spans
+ */
+#define SPAN  (1ULL << SHIFT(ITK_TIMER_WHEEL_LEVELS))
+
+
+
+/**
+ * Read the monotonic clock
+ * 
+ * @return  The time, in nanoseconds
+ */
+static uint64_t now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)(ts.tv_sec) * 1000000000ULL + (uint64_t)(ts.tv_nsec);
+}
+
+
+/**
+ * Insert a timer into a list
+ * 
+ * @param  list   The pointer to the first timer in the list
+ * @param  timer  The timer
+ */
+static inline void push(itk_timer** list, itk_timer* timer)
+{
+  timer->next = *list;
+  if (timer->next)
+    timer->next->link = &(timer->next);
+  timer->link = list;
+  *list = timer;
+}
+
+
+/**
+ * Remove a timer from the list it is in
+ * 
+ * @param  timer  The timer
+ */
+static inline void unlink_timer(itk_timer* timer)
+{
+  *(timer->link) = timer->next;
+  if (timer->next)
+    timer->next->link = timer->link;
+  timer->link = NULL;
+}
+
+
+/**
+ * Put a timer in the slot for its expiry, relative to the current tick
+ * 
+ * @param  timer  The timer, not in any list
+ */
+static void place(__this__, itk_timer* timer)
+{
+  uint64_t expires = timer->expires, delta;
+  long level;
+  
+  /* Only when cascading, a timer due now goes in the slot that is about to expire */
+  if (expires <= this->current)
+    {
+      push(this->slots[0] + (this->current & MASK), timer);
+      return;
+    }
+  
+  /* Timers beyond the wheel wait in the last slot and are placed again when it comes around */
+  delta = expires - this->current;
+  if (delta >= SPAN)
+    expires = this->current + SPAN - 1, delta = SPAN - 1;
+  
+  for (level = 0; delta >> SHIFT(level + 1); level++);
+  push(this->slots[level] + ((expires >> SHIFT(level)) & MASK), timer);
+}
+
+
+/**
+ * Move the timers in a slot to lower levels
+ * 
+ * @param  level  The level of the slot
+ * @param  slot   The index of the slot
+ */
+static void cascade(__this__, long level, long slot)
+{
+  itk_timer* timer = this->slots[level][slot];
+  itk_timer* next;
+  
+  this->slots[level][slot] = NULL;
+  for (; timer; timer = next)
+    {
+      next = timer->next;
+      timer->link = NULL;
+      place(this, timer);
+    }
+}
+
+
+/**
+ * Process the next tick
+ * 
+ * @return  The number of timers that fired
+ */
+static long step(__this__)
+{
+  itk_timer* batch;
+  itk_timer* timer;
+  long level, slot, rc = 0;
+  
+  slot = (long)(++(this->current) & MASK);
+  for (level = 1; (slot == 0) && (level < ITK_TIMER_WHEEL_LEVELS); level++)
+    {
+      slot = (long)((this->current >> SHIFT(level)) & MASK);
+      cascade(this, level, slot);
+    }
+  
+  /* Take the whole slot, callbacks can start timers that expire at
+   * this tick, they go in the slot again and wait a revolution */
+  slot = (long)(this->current & MASK);
+  batch = this->slots[0][slot];
+  this->slots[0][slot] = NULL;
+  if (batch)
+    batch->link = &batch;
+  
+  while ((timer = batch))
+    {
+      unlink_timer(timer);
+      if (timer->expires > this->current)
+	{
+	  place(this, timer);
+	  continue;
+	}
+      
+      if (timer->interval)
+	{
+	  timer->expires = this->current + timer->interval;
+	  place(this, timer);
+	}
+      else
+	this->count--;
+      
+      timer->callback(this, timer);
+      rc++;
+    }
+  
+  return rc;
+}
+
+
+/**
+ * Set the main loop's timer
+ * 
+ * @param  tick  The tick to wake up at, 0 to disarm the timer
+ */
+static void set_alarm(__this__, uint64_t tick)
+{
+  uint64_t at, time;
+  
+  this->alarm_tick = tick;
+  if (tick == 0)
+    {
+      itk_main_loop_set_timer(this->loop, this->alarm, 0, 0);
+      return;
+    }
+  
+  at = this->origin + tick * (uint64_t)(this->resolution);
+  time = now();
+  itk_main_loop_set_timer(this->loop, this->alarm, at > time ? (long)(at - time) : 1, 0);
+}
+
+
+/**
+ * Set the main loop's timer to the next tick the wheel must be advanced at
+ */
+static void arm(__this__)
+{
+  uint64_t tick;
+  
+  if (this->alarm == NULL)
+    return;
+  
+  tick = itk_timer_wheel_next_tick(this);
+  if (tick != this->alarm_tick)
+    set_alarm(this, tick);
+}
+
+
+/**
+ * Advance the wheel, called by the main loop
+ */
+static void alarm_expired(itk_main_loop* loop, itk_main_loop_watch* watch, uint32_t events)
+{
+  itk_timer_wheel* this = watch->user_data;
+  
+  (void) loop;
+  (void) events;
+  
+  /* The timer is one-shot, so it is disarmed now */
+  this->alarm_tick = 0;
+  itk_timer_wheel_advance(this, now());
+}
+
+
+/**
+ * Request a frame, the default flush when attached to a main loop
+ */
+static void request_frame(__this__)
+{
+  itk_main_loop_request_frame(this->loop);
+}
+
+
+
+/**
+ * Constructor
+ * 
+ * @param   loop        The main loop that shall advance the wheel, `NULL`
+ *                      to advance it manually with `itk_timer_wheel_advance`
+ * @param   resolution  The number of nanoseconds per tick
+ * @return              The timer wheel, `NULL` on error, in which case `errno` is set
+ */
+itk_timer_wheel* itk_new_timer_wheel(itk_main_loop* loop, long resolution)
+{
+  itk_timer_wheel* rc = calloc(1, sizeof(itk_timer_wheel));
+  
+  rc->resolution = resolution;
+  rc->origin = now();
+  rc->loop = loop;
+  
+  if (loop)
+    {
+      rc->alarm = itk_main_loop_add_timer(loop, 0, 0, alarm_expired, rc);
+      if (rc->alarm == NULL)
+	{
+	  free(rc);
+	  return NULL;
+	}
+      rc->flush = request_frame;
+    }
+  
+  return rc;
+}
+
+
+/**
+ * Destructor, pending timers are cancelled
+ */
+void itk_free_timer_wheel(__this__)
+{
+  long level, slot;
+  
+  for (level = 0; level < ITK_TIMER_WHEEL_LEVELS; level++)
+    for (slot = 0; slot < ITK_TIMER_WHEEL_SLOTS; slot++)
+      while (this->slots[level][slot])
+	unlink_timer(this->slots[level][slot]);
+  
+  if (this->alarm)
+    itk_main_loop_remove_timer(this->loop, this->alarm);
+  free(this);
+}
+
+
+/**
+ * Initialise a timer
+ * 
+ * @param  timer      The timer
+ * @param  callback   Called when the timer expires
+ * @param  user_data  User data for the callback
+ */
+void itk_init_timer(itk_timer* timer, void (*callback)(itk_timer_wheel* wheel, itk_timer* timer), void* user_data)
+{
+  timer->next = NULL;
+  timer->link = NULL;
+  timer->expires = 0;
+  timer->interval = 0;
+  timer->callback = callback;
+  timer->user_data = user_data;
+}
+
+
+/**
+ * Start, or restart, a timer
+ * 
+ * @param  timer     The timer
+ * @param  delay     The number of nanoseconds until the timer expires, rounded up to whole ticks
+ * @param  interval  The number of nanoseconds between later expirations, 0 for a one-shot timer
+ */
+void itk_timer_wheel_start(__this__, itk_timer* timer, long delay, long interval)
+{
+  uint64_t resolution = (uint64_t)(this->resolution);
+  uint64_t tick = (now() - this->origin + (uint64_t)delay + resolution - 1) / resolution;
+  
+  if (timer->link)
+    unlink_timer(timer);
+  else
+    this->count++;
+  
+  /* The current tick has been processed, and the wheel can lag behind the clock */
+  timer->expires = tick > this->current ? tick : this->current + 1;
+  timer->interval = interval > 0 ? ((uint64_t)interval + resolution - 1) / resolution : 0;
+  place(this, timer);
+  
+  /* Waking up at the expiry is enough, cascades on the way are done when the wheel is advanced */
+  if (this->alarm && ((this->alarm_tick == 0) || (timer->expires < this->alarm_tick)))
+    set_alarm(this, timer->expires);
+}
+
+
+/**
+ * Cancel a timer, nothing happens if it is not pending
+ * 
+ * @param  timer  The timer
+ */
+void itk_timer_wheel_cancel(__this__, itk_timer* timer)
+{
+  /* The main loop's timer is left as is, waking up for nothing once is cheaper than finding the next tick */
+  if (timer->link)
+    {
+      unlink_timer(timer);
+      this->count--;
+    }
+}
+
+
+/**
+ * Fire all timers that have expired, this is done by the main loop if the wheel is attached to one
+ * 
+ * @param   now   The current time, in nanoseconds on the monotonic clock
+ * @return        The number of timers that fired
+ */
+long itk_timer_wheel_advance(__this__, uint64_t now)
+{
+  uint64_t target = now > this->origin ? (now - this->origin) / (uint64_t)(this->resolution) : 0, next;
+  long rc = 0;
+  
+  while (this->current < target)
+    {
+      /* Skip the ticks where nothing happens */
+      next = this->count ? itk_timer_wheel_next_tick(this) : 0;
+      if ((next == 0) || (next > target))
+	{
+	  this->current = target;
+	  break;
+	}
+      this->current = next - 1;
+      rc += step(this);
+    }
+  
+  if (rc && this->flush)
+    this->flush(this);
+  arm(this);
+  return rc;
+}
+
+
+/**
+ * Get the earliest tick at which a timer can expire, or a timer must be moved to a
+ * lower level, the wheel need not be advanced before then
+ * 
+ * @return  The tick, 0 if there are no pending timers
+ */
+uint64_t itk_timer_wheel_next_tick(const __this__)
+{
+  uint64_t rc = 0, base, tick;
+  long level, k;
+  
+  if (this->count == 0)
+    return 0;
+  
+  for (level = 0; level < ITK_TIMER_WHEEL_LEVELS; level++)
+    {
+      base = this->current >> SHIFT(level);
+      for (k = 1; k <= ITK_TIMER_WHEEL_SLOTS; k++)
+	if (this->slots[level][(base + k) & MASK])
+	  {
+	    tick = (base + k) << SHIFT(level);
+	    rc = ((rc == 0) || (tick < rc)) ? tick : rc;
+	    break;
+	  }
+    }
+  
+  return rc;
+}
+
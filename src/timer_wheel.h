@@ -0,0 +1,224 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_TIMER_WHEEL_H__
+#define __ITK_TIMER_WHEEL_H__
+
+#include "itktypes.h"
+#include "main_loop.h"
+
+
+/**
+ * The number of levels in a timer wheel
+ */
+#define ITK_TIMER_WHEEL_LEVELS  4
+
+/**
+ * The binary logarithm of the number of slots per level
+ */
+#define ITK_TIMER_WHEEL_BITS  6
+
+/**
+ * The number of slots per level
+ */
+#define ITK_TIMER_WHEEL_SLOTS  (1L << ITK_TIMER_WHEEL_BITS)
+
+
+struct _itk_timer_wheel;
+
+
+/**
+ * A timer, owned by its user, that can be started in a timer wheel
+ * 
+ * Initialise it with `itk_init_timer`, it must not be moved or freed while pending
+ */
+typedef struct _itk_timer
+{
+  /**
+   * The next timer in the same slot
+   */
+  struct _itk_timer* next;
+  
+  /**
+   * The pointer that points to this timer, `NULL` if the timer is not pending
+   */
+  struct _itk_timer** link;
+  
+  /**
+   * The tick the timer expires at
+   */
+  uint64_t expires;
+  
+  /**
+   * The number of ticks between expirations, 0 for a one-shot timer
+   */
+  uint64_t interval;
+  
+  /**
+   * Called when the timer expires, the timer may be restarted or cancelled from here
+   * 
+   * @param  wheel  The timer wheel
+   * @param  timer  The timer
+   */
+  void (*callback)(struct _itk_timer_wheel* wheel, struct _itk_timer* timer);
+  
+  /**
+   * User data for the callback
+   */
+  void* user_data;
+  
+} itk_timer;
+
+
+/**
+ * A hierarchical timing wheel, timers are started and cancelled in constant
+ * time, and all timers expiring at the same tick are handled as one batch
+ * 
+ * Each level has `ITK_TIMER_WHEEL_SLOTS` slots, a slot in level 0 spans
+ * one tick and a slot in level n spans as many ticks as all of level n - 1,
+ * timers move to lower levels as their expiry comes closer
+ */
+typedef struct _itk_timer_wheel
+{
+  /**
+   * The slots, each the first timer in a list
+   */
+  itk_timer* slots[ITK_TIMER_WHEEL_LEVELS][ITK_TIMER_WHEEL_SLOTS];
+  
+  /**
+   * The number of nanoseconds per tick
+   */
+  long resolution;
+  
+  /**
+   * The time of tick 0, in nanoseconds on the monotonic clock
+   */
+  uint64_t origin;
+  
+  /**
+   * The last tick that has been processed
+   */
+  uint64_t current;
+  
+  /**
+   * The number of pending timers
+   */
+  long count;
+  
+  /**
+   * The main loop timer that advances the wheel, `NULL` if not attached to a main loop
+   */
+  itk_main_loop_timer* alarm;
+  
+  /**
+   * The tick `alarm` is set to, 0 if it is disarmed
+   */
+  uint64_t alarm_tick;
+  
+  /**
+   * The main loop, `NULL` if the wheel is advanced manually
+   */
+  itk_main_loop* loop;
+  
+  /**
+   * Called once after a batch of timers has expired, may be `NULL`, so that
+   * the timers' damage is flushed together, by default it requests a frame
+   * 
+   * @param  wheel  The timer wheel
+   */
+  void (*flush)(struct _itk_timer_wheel* wheel);
+  
+} itk_timer_wheel;
+
+
+/**
+ * Constructor
+ * 
+ * @param   loop        The main loop that shall advance the wheel, `NULL`
+ *                      to advance it manually with `itk_timer_wheel_advance`
+ * @param   resolution  The number of nanoseconds per tick
+ * @return              The timer wheel, `NULL` on error, in which case `errno` is set
+ */
+itk_timer_wheel* itk_new_timer_wheel(itk_main_loop* loop, long resolution);
+
+/**
+ * Destructor, pending timers are cancelled
+ * 
+ * @param  this  The timer wheel
+ */
+void itk_free_timer_wheel(itk_timer_wheel* this);
+
+/**
+ * Initialise a timer
+ * 
+ * @param  timer      The timer
+ * @param  callback   Called when the timer expires
+ * @param  user_data  User data for the callback
+ */
+void itk_init_timer(itk_timer* timer, void (*callback)(itk_timer_wheel* wheel, itk_timer* timer), void* user_data);
+
+/**
+ * Start, or restart, a timer
+ * 
+ * @param  this      The timer wheel
+ * @param  timer     The timer
+ * @param  delay     The number of nanoseconds until the timer expires, rounded up to whole ticks
+ * @param  interval  The number of nanoseconds between later expirations, 0 for a one-shot timer
+ */
+void itk_timer_wheel_start(itk_timer_wheel* this, itk_timer* timer, long delay, long interval);
+
+/**
+ * Cancel a timer, nothing happens if it is not pending
+ * 
+ * @param  this   The timer wheel
+ * @param  timer  The timer
+ */
+void itk_timer_wheel_cancel(itk_timer_wheel* this, itk_timer* timer);
+
+/**
+ * Check whether a timer is pending
+ * 
+ * @param   timer  The timer
+ * @return         Whether the timer is started and has not expired, or is periodic
+ */
+static inline bool_t itk_timer_pending(const itk_timer* timer)
+{
+  return timer->link != NULL;
+}
+
+/**
+ * Fire all timers that have expired, this is done by the main loop if the wheel is attached to one
+ * 
+ * @param   this  The timer wheel
+ * @param   now   The current time, in nanoseconds on the monotonic clock
+ * @return        The number of timers that fired
+ */
+long itk_timer_wheel_advance(itk_timer_wheel* this, uint64_t now);
+
+/**
+ * Get the earliest tick at which a timer can expire, or a timer must be moved to a
+ * lower level, the wheel need not be advanced before then
+ * 
+ * @param   this  The timer wheel
+ * @return        The tick, 0 if there are no pending timers
+ */
+uint64_t itk_timer_wheel_next_tick(const itk_timer_wheel* this);
+
+
+#endif
+
@@ -0,0 +1,313 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "trace.h"
+#include "itkmacros.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+
+/**
+ * The number of events a thread's ring buffer holds if not specified
+ */
+#define DEFAULT_CAPACITY  (1L << 16)
+
+/**
+ * The number of bytes, including the NUL, of a component name that are kept
+ */
+#define COMPONENT_NAME_SIZE  23
+
+
+/**
+ * A recorded event
+ */
+typedef struct trace_event
+{
+  /**
+   * The time of the event, in nanoseconds on the monotonic clock
+   */
+  uint64_t time;
+  
+  /**
+   * The name of the event, not owned
+   */
+  const char* name;
+  
+  /**
+   * 'B' for begin and 'E' for end
+   */
+  char phase;
+  
+  /**
+   * The name of the component the event concerns, empty if none
+   */
+  char component[COMPONENT_NAME_SIZE];
+  
+} trace_event_t;
+
+
+/**
+ * The ring buffer of a thread
+ */
+typedef struct trace_buffer
+{
+  /**
+   * The next buffer in `buffers`
+   */
+  struct trace_buffer* next;
+  
+  /**
+   * The thread's ID
+   */
+  long tid;
+  
+  /**
+   * The number of events that have been recorded, including overwritten ones
+   */
+  atomic_ulong count;
+  
+  /**
+   * The number of elements in `events` less one, a power of two less one
+   */
+  unsigned long mask;
+  
+  /**
+   * The events, `count & mask` is the next slot to write
+   */
+  trace_event_t events[];
+  
+} trace_buffer_t;
+
+
+
+atomic_bool itk_trace_enabled = false;
+
+/**
+ * The capacity of ring buffers created from now on
+ */
+static atomic_long buffer_capacity = DEFAULT_CAPACITY;
+
+/**
+ * All threads' ring buffers, they are never removed
+ * so that threads that have exited can be exported
+ */
+static trace_buffer_t* _Atomic buffers = NULL;
+
+/**
+ * The ring buffer of threads whose ring buffer could not be allocated,
+ * it has no room for events, and is not in `buffers`
+ */
+static trace_buffer_t no_buffer;
+
+/**
+ * The calling thread's ring buffer, `NULL` until it records its first event,
+ * `&no_buffer` if it could not be allocated
+ */
+static __thread trace_buffer_t* buffer = NULL;
+
+
+
+/**
+ * Create and register the calling thread's ring buffer
+ * 
+ * @return  The ring buffer, `&no_buffer` if it could not be allocated,
+ *          in which case the thread does not record any events
+ */
+static trace_buffer_t* new_buffer(void)
+{
+  unsigned long n = 1, size = (unsigned long)atomic_load_explicit(&buffer_capacity, memory_order_relaxed);
+  trace_buffer_t* head;
+  
+  while (n < size)
+    n <<= 1;
+  
+  buffer = malloc(sizeof(trace_buffer_t) + n * sizeof(trace_event_t));
+  if (buffer == NULL)
+    return buffer = &no_buffer;
+  buffer->tid = (long)syscall(SYS_gettid);
+  buffer->mask = n - 1;
+  atomic_init(&(buffer->count), 0);
+  
+  head = atomic_load_explicit(&buffers, memory_order_relaxed);
+  do
+    buffer->next = head;
+  while (!atomic_compare_exchange_weak_explicit(&buffers, &head, buffer,
+						memory_order_release, memory_order_relaxed));
+  
+  return buffer;
+}
+
+
+/**
+ * Record an event, use `ITK_TRACE_BEGIN` and `ITK_TRACE_END` instead
+ * 
+ * @param  phase      'B' for begin and 'E' for end
+ * @param  event      The name of the event, a string literal
+ * @param  component  The name of the component the event concerns, may be `NULL`,
+ *                    it is copied and truncated
+ */
+void itk_trace_record(char phase, const char* event, const char* component)
+{
+  trace_buffer_t* buf = buffer ? buffer : new_buffer();
+  unsigned long count;
+  trace_event_t* e;
+  struct timespec now;
+  
+  if (buf == &no_buffer)
+    return;
+  count = atomic_load_explicit(&(buf->count), memory_order_relaxed);
+  e = buf->events + (count & buf->mask);
+  
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  e->time = (uint64_t)(now.tv_sec) * 1000000000ULL + (uint64_t)(now.tv_nsec);
+  e->name = event;
+  e->phase = phase;
+  if (component == NULL)
+    *(e->component) = '\0';
+  else
+    {
+      strncpy(e->component, component, COMPONENT_NAME_SIZE - 1);
+      *(e->component + COMPONENT_NAME_SIZE - 1) = '\0';
+    }
+  
+  atomic_store_explicit(&(buf->count), count + 1, memory_order_release);
+}
+
+
+/**
+ * Start tracing
+ * 
+ * @param  capacity  The number of events each thread's ring buffer can hold, the
+ *                   oldest events are overwritten when it is full, it is rounded
+ *                   up to a power of two, only used by threads that have not yet
+ *                   recorded any events, 0 for the default
+ */
+void itk_trace_start(long capacity)
+{
+  atomic_store_explicit(&buffer_capacity, capacity > 0 ? capacity : DEFAULT_CAPACITY, memory_order_relaxed);
+  atomic_store_explicit(&itk_trace_enabled, true, memory_order_relaxed);
+}
+
+
+/**
+ * Stop tracing, the recorded events are kept
+ */
+void itk_trace_stop(void)
+{
+  atomic_store_explicit(&itk_trace_enabled, false, memory_order_relaxed);
+}
+
+
+/**
+ * Discard all recorded events
+ * 
+ * Tracing should be stopped and no events be being recorded
+ */
+void itk_trace_clear(void)
+{
+  trace_buffer_t* buf = atomic_load_explicit(&buffers, memory_order_acquire);
+  for (; buf; buf = buf->next)
+    atomic_store_explicit(&(buf->count), 0, memory_order_relaxed);
+}
+
+
+/**
+ * Write a string as a JSON string literal
+ * 
+ * @param  file    The file to write to
+ * @param  string  The string
+ */
+static void write_json_string(FILE* file, const char* string)
+{
+  unsigned char c;
+  
+  fputc('"', file);
+  while ((c = (unsigned char)*string++))
+    if ((c == '"') || (c == '\\'))
+      fprintf(file, "\\%c", c);
+    else if (c < ' ')
+      fprintf(file, "\\u%04x", c);
+    else
+      fputc(c, file);
+  fputc('"', file);
+}
+
+
+/**
+ * Write the recorded events, of all threads, to a file as Chrome trace JSON
+ * 
+ * Tracing should be stopped and no events be being recorded
+ * 
+ * @param   pathname  The pathname of the file
+ * @return            Zero on success, -1 on error, in which case `errno` is set
+ */
+int itk_trace_export(const char* pathname)
+{
+  trace_buffer_t* buf = atomic_load_explicit(&buffers, memory_order_acquire);
+  FILE* file = fopen(pathname, "w");
+  const char* separator = "\n";
+  unsigned long i, n, count;
+  trace_event_t* e;
+  int saved_errno, ok;
+  long pid = (long)getpid();
+  
+  if (file == NULL)
+    return -1;
+  
+  fputs("{\"traceEvents\":[", file);
+  for (; buf; buf = buf->next)
+    {
+      count = atomic_load_explicit(&(buf->count), memory_order_acquire);
+      n = count > buf->mask ? buf->mask + 1 : count;
+      for (i = count - n; i != count; i++)
+	{
+	  e = buf->events + (i & buf->mask);
+	  fprintf(file, "%s{\"name\":", separator);
+	  write_json_string(file, e->name);
+	  fprintf(file, ",\"cat\":\"itk\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%li,\"tid\":%li",
+		  e->phase, (unsigned long long)(e->time / 1000), (unsigned)(e->time % 1000),
+		  pid, buf->tid);
+	  if (*(e->component))
+	    {
+	      fputs(",\"args\":{\"component\":", file);
+	      write_json_string(file, e->component);
+	      fputc('}', file);
+	    }
+	  fputc('}', file);
+	  separator = ",\n";
+	}
+    }
+  fputs("\n],\"displayTimeUnit\":\"ms\"}\n", file);
+  
+  saved_errno = errno;
+  ok = !ferror(file);
+  if (fclose(file))
+    return -1;
+  if (ok)
+    return 0;
+  errno = saved_errno ? saved_errno : EIO;
+  return -1;
+}
+
@@ -0,0 +1,108 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_TRACE_H__
+#define __ITK_TRACE_H__
+
+#include "itktypes.h"
+
+#include <stdatomic.h>
+
+
+/**
+ * Frame tracing, events are recorded with `ITK_TRACE_BEGIN` and
+ * `ITK_TRACE_END` into a ring buffer per thread, and can be exported
+ * in Chrome's trace event format, for chrome://tracing or Perfetto
+ * 
+ * Tracing is off until `itk_trace_start` is called, while it is off
+ * an event costs one load and one branch that is predicted not taken
+ */
+
+
+/**
+ * Whether tracing is on, use `itk_trace_start` and `itk_trace_stop` to change
+ */
+extern atomic_bool itk_trace_enabled;
+
+
+/**
+ * Record the start of a scoped event
+ * 
+ * @param  EVENT      The name of the event, a string literal
+ * @param  COMPONENT  The name of the component the event concerns, may be `NULL`
+ */
+#define ITK_TRACE_BEGIN(EVENT, COMPONENT)				\
+  (__builtin_expect(atomic_load_explicit(&itk_trace_enabled, memory_order_relaxed), 0) \
+   ? itk_trace_record('B', EVENT, COMPONENT) : (void)0)
+
+/**
+ * Record the end of a scoped event
+ * 
+ * @param  EVENT      The name of the event, the same as for `ITK_TRACE_BEGIN`
+ * @param  COMPONENT  The name of the component the event concerns, may be `NULL`
+ */
+#define ITK_TRACE_END(EVENT, COMPONENT)					\
+  (__builtin_expect(atomic_load_explicit(&itk_trace_enabled, memory_order_relaxed), 0) \
+   ? itk_trace_record('E', EVENT, COMPONENT) : (void)0)
+
+
+/**
+ * Start tracing
+ * 
+ * @param  capacity  The number of events each thread's ring buffer can hold, the
+ *                   oldest events are overwritten when it is full, it is rounded
+ *                   up to a power of two, only used by threads that have not yet
+ *                   recorded any events, 0 for the default
+ */
+void itk_trace_start(long capacity);
+
+/**
+ * Stop tracing, the recorded events are kept
+ */
+void itk_trace_stop(void);
+
+/**
+ * Discard all recorded events
+ * 
+ * Tracing should be stopped and no events be being recorded
+ */
+void itk_trace_clear(void);
+
+/**
+ * Write the recorded events, of all threads, to a file as Chrome trace JSON
+ * 
+ * Tracing should be stopped and no events be being recorded
+ * 
+ * @param   pathname  The pathname of the file
+ * @return            Zero on success, -1 on error, in which case `errno` is set
+ */
+int itk_trace_export(const char* pathname);
+
+/**
+ * Record an event, use `ITK_TRACE_BEGIN` and `ITK_TRACE_END` instead
+ * 
+ * @param  phase      'B' for begin and 'E' for end
+ * @param  event      The name of the event, a string literal
+ * @param  component  The name of the component the event concerns, may be `NULL`,
+ *                    it is copied and truncated
+ */
+void itk_trace_record(char phase, const char* event, const char* component);
+
+
+#endif
+
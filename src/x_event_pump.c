@@ -0,0 +1,291 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "x_event_pump.h"
+#include "itkmacros.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <stdlib.h>
+#include <sys/epoll.h>
+
+
+#define __this__  itk_x_event_pump* this
+
+
+
+/**
+ * Check for events that Xlib has read but not yet returned, which do not
+ * make the X connection readable, called before the main loop waits
+ */
+static bool_t x_pending(itk_main_loop* loop, itk_main_loop_watch* watch)
+{
+  itk_x_event_pump* pump = watch->user_data;
+  
+  (void) loop;
+  
+  /* Send our requests before the main loop waits for the replies */
+  XFlush(pump->display);
+  return XEventsQueued(pump->display, QueuedAlready) > 0;
+}
+
+
+/**
+ * Read the events, called by the main loop when the X connection is readable
+ */
+static void x_readable(itk_main_loop* loop, itk_main_loop_watch* watch, uint32_t events)
+{
+  itk_x_event_pump* pump = watch->user_data;
+  
+  (void) events;
+  
+  itk_x_event_pump_drain(pump);
+  if (pump->resized || pump->damage->count)
+    itk_main_loop_request_frame(loop);
+}
+
+
+/**
+ * Repaint, called by the main loop when a frame is due
+ */
+static void x_frame(itk_main_loop* loop, void* user_data)
+{
+  itk_x_event_pump* pump = user_data;
+  
+  /* Volatile components whose updates were held back are damaged first */
+  if (pump->governor)
+    itk_frame_governor_frame(pump->governor, loop->last_frame);
+  
+  /* The animations' changes are repainted together with the exposed area */
+  if (pump->animator)
+    itk_animator_frame(pump->animator, loop->last_frame, pump->damage);
+  itk_x_event_pump_flush(pump);
+}
+
+
+
+/**
+ * Constructor
+ * 
+ * ExposureMask and StructureNotifyMask are added to the events selected for the window
+ * 
+ * @param   display   The X display, a connection to the X server
+ * @param   window    The window
+ * @param   root      The component filling the window, it should not have a parent
+ * @param   graphics  The object with which to paint the window, it is not freed with the pump
+ * @return            The event pump
+ */
+itk_x_event_pump* itk_new_x_event_pump(Display* display, Window window, itk_component* root, itk_graphics* graphics)
+{
+  itk_x_event_pump* rc = calloc(1, sizeof(itk_x_event_pump));
+  XWindowAttributes attributes;
+  
+  XGetWindowAttributes(display, window, &attributes);
+  XSelectInput(display, window, attributes.your_event_mask | ExposureMask | StructureNotifyMask);
+  
+  rc->display = display;
+  rc->window = window;
+  rc->root = root;
+  rc->graphics = graphics;
+  rc->damage = itk_new_region();
+  rc->size = new_size2(attributes.width, attributes.height);
+  rc->resized = true;
+  return rc;
+}
+
+
+/**
+ * Destructor
+ */
+void itk_free_x_event_pump(__this__)
+{
+  itk_free_region(this->damage);
+  free(this);
+}
+
+
+/**
+ * Read every event that has been received, without blocking, unioning
+ * the exposed areas and collapsing changes of size to the last one
+ * 
+ * @return  The number of events that were read
+ */
+long itk_x_event_pump_drain(__this__)
+{
+  XEvent event;
+  long rc = 0;
+  
+  /* XPending also flushes our requests and reads what the server has sent */
+  while (XPending(this->display))
+    {
+      XNextEvent(this->display, &event);
+      rc++;
+      
+      if ((event.type == Expose) && (event.xexpose.window == this->window))
+	/* All rectangles are unioned, so `count` does not need to be waited for */
+	itk_region_add_rectangle(this->damage, new_packed_rectangle(event.xexpose.x, event.xexpose.y,
+								     event.xexpose.width, event.xexpose.height));
+      else if ((event.type == GraphicsExpose) && (event.xgraphicsexpose.drawable == this->window))
+	itk_region_add_rectangle(this->damage, new_packed_rectangle(event.xgraphicsexpose.x,
+								     event.xgraphicsexpose.y,
+								     event.xgraphicsexpose.width,
+								     event.xgraphicsexpose.height));
+      else if ((event.type == ConfigureNotify) && (event.xconfigure.window == this->window))
+	{
+	  /* Only the last size of a burst matters, it is applied in `itk_x_event_pump_flush` */
+	  if ((event.xconfigure.width != this->size.width) || (event.xconfigure.height != this->size.height))
+	    {
+	      this->size = new_size2(event.xconfigure.width, event.xconfigure.height);
+	      this->resized = true;
+	    }
+	}
+      else if (this->handler)
+	this->handler(this, &event, this->user_data);
+    }
+  
+  return rc;
+}
+
+
+/**
+ * Repaint the damaged area of the window, if any, with one clipped paint of
+ * the root component, everything is damaged if the window has changed size,
+ * followed by the components queued in `scheduler` that fit in its budget
+ * 
+ * @return  Whether anything was repainted, or recorded for `renderer`
+ */
+bool_t itk_x_event_pump_flush(__this__)
+{
+  itk_graphics* target = this->graphics;
+  itk_display_list* list = NULL;
+  uint64_t deadline = 0, start = 0;
+  long frame_time;
+  bool_t scheduled;
+  itk_graphics* g;
+  
+  if (this->resized)
+    {
+      this->root->size = this->size;
+      itk_component_invalidate_child_hints(this->root);
+      itk_region_set_rectangle(this->damage, new_packed_rectangle(0, 0, this->size.width, this->size.height));
+      this->resized = false;
+    }
+  
+  scheduled = this->scheduler && this->scheduler->count;
+  if ((this->damage->count == 0) && (scheduled == false))
+    return false;
+  
+  if (this->renderer)
+    {
+      /* Do not queue up frames behind a slow renderer, the damage is kept
+       * and painted, as one frame, when the renderer has caught up */
+      if (itk_render_thread_ready(this->renderer) == false)
+	return false;
+      list = itk_render_thread_begin(this->renderer);
+      target = itk_new_recording_graphics(list);
+    }
+  if (this->governor)
+    {
+      start = itk_metrics_now();
+      /* Degradation must not outlast the frame, so `graphics` is left as it is */
+      if ((this->governor->quality != ITK_GRAPHICS_QUALITY_FULL) && (target == this->graphics))
+	target = target->fork(target);
+      itk_frame_governor_degrade(this->governor, target);
+    }
+  if (scheduled)
+    deadline = itk_metrics_now() + this->scheduler->budget;
+  
+  ITK_TRACE_BEGIN("x_event_pump.flush", this->root->name);
+  
+  if (this->damage->count)
+    {
+      /* The root has no parent to synchronise it, so this is its `sync_area` */
+      g = target->fork(target);
+      g->clip_region(g, this->damage);
+      this->root->vtable->paint(this->root, g);
+      g->free(g);
+      itk_region_clear(this->damage);
+    }
+  
+  /* Exposed areas must be painted at once, damaged
+   * components only as far as the budget allows */
+  if (scheduled)
+    itk_paint_scheduler_run(this->scheduler, target, deadline);
+  
+  if (target != this->graphics)
+    target->free(target);
+  if (this->renderer)
+    itk_render_thread_submit(this->renderer, list);
+  else
+    /* Wait for the server to catch up, so that the events that arrive
+     * meanwhile are handled as one batch rather than a backlog */
+    XSync(this->display, False);
+  
+  if (this->governor)
+    {
+      /* The render thread is at most one frame behind, so its last frame is as recent as can be */
+      frame_time = (long)(itk_metrics_now() - start);
+      if (this->renderer && (itk_render_thread_frame_time(this->renderer) > frame_time))
+	frame_time = itk_render_thread_frame_time(this->renderer);
+      itk_frame_governor_record(this->governor, frame_time);
+    }
+  
+  ITK_TRACE_END("x_event_pump.flush", this->root->name);
+  return true;
+}
+
+
+/**
+ * Wait for events, read them and repaint, until `running` is cleared, by `handler`
+ */
+void itk_x_event_pump_run(__this__)
+{
+  XEvent event;
+  
+  this->running = true;
+  while (this->running)
+    {
+      /* Block until there is something to do, without removing the event */
+      XPeekEvent(this->display, &event);
+      itk_x_event_pump_drain(this);
+      itk_x_event_pump_flush(this);
+    }
+}
+
+
+/**
+ * Let a main loop drive the event pump, instead of `itk_x_event_pump_run`, the
+ * X connection is watched with input priority, and repaints become the main
+ * loop's frames, so they are drawn after input and at most once per interval
+ * 
+ * @param   loop      The main loop
+ * @param   interval  The least number of nanoseconds between repaints
+ * @return            The watch of the X connection, `NULL` on error, in which case `errno` is set
+ */
+itk_main_loop_watch* itk_x_event_pump_attach(__this__, itk_main_loop* loop, long interval)
+{
+  itk_main_loop_watch* rc = itk_main_loop_add_watch(loop, ConnectionNumber(this->display), EPOLLIN,
+						    ITK_MAIN_LOOP_PRIORITY_INPUT, x_readable, this);
+  if (rc == NULL)
+    return NULL;
+  
+  rc->pending = x_pending;
+  itk_main_loop_set_frame(loop, interval, x_frame, this);
+  return rc;
+}
+
@@ -0,0 +1,188 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ITK_X_EVENT_PUMP_H__
+#define __ITK_X_EVENT_PUMP_H__
+
+#include "animation.h"
+#include "component.h"
+#include "frame_governor.h"
+#include "graphics.h"
+#include "main_loop.h"
+#include "paint_scheduler.h"
+#include "region.h"
+#include "render_thread.h"
+
+#include <X11/Xlib.h>
+
+
+/**
+ * Reads the events of a window and repaints a component tree in it, at most once
+ * per batch of events, so that bursts of Expose and ConfigureNotify events, as
+ * during an interactive resize, cannot build up a backlog
+ */
+typedef struct _itk_x_event_pump
+{
+  /**
+   * The X display, a connection to the X server
+   */
+  Display* display;
+  
+  /**
+   * The window
+   */
+  Window window;
+  
+  /**
+   * The component filling the window, it should not have a parent
+   */
+  itk_component* root;
+  
+  /**
+   * The object with which to paint the window
+   */
+  itk_graphics* graphics;
+  
+  /**
+   * The area that has been exposed since the last repaint
+   */
+  itk_region* damage;
+  
+  /**
+   * The size the window had at the end of the last batch of events
+   */
+  size2_t size;
+  
+  /**
+   * Whether the window has changed size since the last repaint
+   */
+  bool_t resized;
+  
+  /**
+   * Animations to advance before each repaint, may be `NULL`, only
+   * used when the pump is attached to a main loop
+   */
+  itk_animator* animator;
+  
+  /**
+   * The thread that draws the repaints, may be `NULL` to draw them on the
+   * caller's thread with `graphics`, if set, the repaints are recorded as
+   * display lists and handed over, its `present` should flush the display,
+   * and if it falls behind, repaints are postponed and the damage kept,
+   * its `loop` should be the main loop the pump is attached to, so that
+   * postponed repaints are made as soon as it has caught up
+   */
+  itk_render_thread* renderer;
+  
+  /**
+   * Damaged components to repaint, within its budget, after the exposed
+   * area has been repainted, may be `NULL`, its `loop` should be the
+   * main loop the pump is attached to
+   */
+  itk_paint_scheduler* scheduler;
+  
+  /**
+   * Lowers the drawing quality while repaints take too long, may be `NULL`,
+   * it is told how long every repaint took, including the render thread's
+   * part if `renderer` is used, and it is started at each main loop frame
+   */
+  itk_frame_governor* governor;
+  
+  /**
+   * Whether `itk_x_event_pump_run` shall keep running
+   */
+  bool_t running;
+  
+  /**
+   * Called for every event that is not Expose, GraphicsExpose or ConfigureNotify, may be `NULL`
+   * 
+   * @param  pump       The event pump
+   * @param  event      The event
+   * @param  user_data  `user_data`
+   */
+  void (*handler)(struct _itk_x_event_pump* pump, XEvent* event, void* user_data);
+  
+  /**
+   * Passed to `handler`
+   */
+  void* user_data;
+  
+} itk_x_event_pump;
+
+
+/**
+ * Constructor
+ * 
+ * ExposureMask and StructureNotifyMask are added to the events selected for the window
+ * 
+ * @param   display   The X display, a connection to the X server
+ * @param   window    The window
+ * @param   root      The component filling the window, it should not have a parent
+ * @param   graphics  The object with which to paint the window, it is not freed with the pump
+ * @return            The event pump
+ */
+itk_x_event_pump* itk_new_x_event_pump(Display* display, Window window, itk_component* root, itk_graphics* graphics);
+
+/**
+ * Destructor
+ * 
+ * @param  this  The event pump
+ */
+void itk_free_x_event_pump(itk_x_event_pump* this);
+
+/**
+ * Read every event that has been received, without blocking, unioning
+ * the exposed areas and collapsing changes of size to the last one
+ * 
+ * @param   this  The event pump
+ * @return        The number of events that were read
+ */
+long itk_x_event_pump_drain(itk_x_event_pump* this);
+
+/**
+ * Repaint the damaged area of the window, if any, with one clipped paint of
+ * the root component, everything is damaged if the window has changed size,
+ * followed by the components queued in `scheduler` that fit in its budget
+ * 
+ * @param   this  The event pump
+ * @return        Whether anything was repainted, or recorded for `renderer`
+ */
+bool_t itk_x_event_pump_flush(itk_x_event_pump* this);
+
+/**
+ * Wait for events, read them and repaint, until `running` is cleared, by `handler`
+ * 
+ * @param  this  The event pump
+ */
+void itk_x_event_pump_run(itk_x_event_pump* this);
+
+/**
+ * Let a main loop drive the event pump, instead of `itk_x_event_pump_run`, the
+ * X connection is watched with input priority, and repaints become the main
+ * loop's frames, so they are drawn after input and at most once per interval
+ * 
+ * @param   this      The event pump
+ * @param   loop      The main loop
+ * @param   interval  The least number of nanoseconds between repaints
+ * @return            The watch of the X connection, `NULL` on error, in which case `errno` is set
+ */
+itk_main_loop_watch* itk_x_event_pump_attach(itk_x_event_pump* this, itk_main_loop* loop, long interval);
+
+
+#endif
+
@@ -18,44 +18,83 @@
  */
 #include "x_graphics.h"
 #include "itkmacros.h"
+#include "probes.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 
 #define DATA(this)  ((itk_x_graphics_data*)(this->data))
+#define OX(this)    (DATA(this)->origin.x)
+#define OY(this)    (DATA(this)->origin.y)
 
 
 #define __this__  itk_graphics* this
 
 
 /**
- * Clip the affected area
+ * Pass the clip region to the X server, in one request
  * 
- * @param  area  The new only area is affected by usage of this
- *               graphics context. The effective area is the
- *               intersection area and the old clip area.
+ * The clip region is stored in the drawable's coordinates,
+ * so the clip origin of the X graphics context is always zero
  */
-static void clip(__this__, rectangle_t area)
+static void update_clip(__this__)
 {
-  rectangle_t old = DATA(this)->clip_area;
-  position_t x2 = old.x + old.width, y2 = old.y + old.height;
-  XRectangle rect;
-  XGCValues value;
-  
-  rect.x = old.x < area.x ? area.x : old.x;
-  rect.y = old.y < area.y ? area.y : old.y;
-  
-  XGetGCValues(DATA(this)->display, DATA(this)->context, GCClipXOrigin | GCClipYOrigin, &value);
+  itk_region* region = DATA(this)->clip_region;
+  XRectangle* rects = malloc((region->count ? region->count : 1) * sizeof(XRectangle));
+  long i;
   
-  if (x2 > area.x + area.width)   x2 = area.x + area.width;
-  if (y2 > area.y + area.height)  y2 = area.y + area.height;
+  for (i = 0; i < region->count; i++)
+    {
+      (rects + i)->x = (region->rectangles + i)->x;
+      (rects + i)->y = (region->rectangles + i)->y;
+      (rects + i)->width = (region->rectangles + i)->width;
+      (rects + i)->height = (region->rectangles + i)->height;
+    }
   
-  rect.width = x2 < rect.x ? 0 : x2 - rect.x;
-  rect.height = y2 < rect.y ? 0 : y2 - rect.y;
+  ITK_PROBE(x_request, "XSetClipRectangles", region->count);
   XSetClipRectangles(DATA(this)->display,
 		     DATA(this)->context,
-		     value.clip_x_origin, value.clip_y_origin,
-		     &rect, 1, Unsorted);
+		     0, 0,
+		     rects, (int)(region->count), YXBanded);
+  free(rects);
+}
+
+
+/**
+ * Clip the affected area
+ * 
+ * @param  area  The new only area is affected by usage of this
+ *               graphics context. The effective area is the
+ *               intersection area and the old clip area.
+ */
+static void clip(__this__, packed_rectangle_t area)
+{
+  if (packed_rectangle_defined(area))
+    {
+      area.x += OX(this);
+      area.y += OY(this);
+    }
+  itk_region_intersect_rectangle(DATA(this)->clip_region, area);
+  update_clip(this);
+}
+
+
+/**
+ * Clip the affected area to a region
+ * 
+ * @param  region  The new only area is affected by usage of this
+ *                 graphics context. The effective area is the
+ *                 intersection of the region and the old clip area.
+ */
+static void clip_region(__this__, const itk_region* region)
+{
+  itk_region* translated = itk_new_region();
+  itk_region_copy(translated, region);
+  itk_region_translate(translated, DATA(this)->origin);
+  itk_region_intersect(DATA(this)->clip_region, translated);
+  itk_free_region(translated);
+  update_clip(this);
 }
 
 
@@ -64,14 +103,12 @@ static void clip(__this__, rectangle_t area)
  * 
  * @param  offset  The new position of the old origin
  */
-static void translate(__this__, position2_t offset)
+static void translate(__this__, packed_position2_t offset)
 {
-  long mask = GCClipXOrigin | GCClipYOrigin;
-  XGCValues value;
-  XGetGCValues(DATA(this)->display, DATA(this)->context, mask, &value);
-  value.clip_x_origin += offset.x;
-  value.clip_y_origin += offset.y;
-  XChangeGC(DATA(this)->display, DATA(this)->context, mask, &value);
+  /* X has no drawing origin, so it is applied to the coordinates of every
+   * request, and the clip region is kept in the drawable's coordinates */
+  OX(this) -= offset.x;
+  OY(this) -= offset.y;
 }
 
 
@@ -108,10 +145,11 @@ static void fill_polygon(__this__, position2_t* points, long point_count, int8_t
   
   for (i = 0; i < point_count; i++)
     {
-      (x_points + i)->x = (points + i)->x;
-      (x_points + i)->y = (points + i)->y;
+      (x_points + i)->x = (points + i)->x + ((i == 0) || (mode != ITK_GRAPHICS_MODE_RELATIVE) ? OX(this) : 0);
+      (x_points + i)->y = (points + i)->y + ((i == 0) || (mode != ITK_GRAPHICS_MODE_RELATIVE) ? OY(this) : 0);
     }
   
+  ITK_PROBE(x_request, "XFillPolygon", point_count);
   XFillPolygon(DATA(this)->display,
 	       DATA(this)->drawable,
 	       DATA(this)->context,
@@ -139,13 +177,15 @@ static void fill_pie(__this__, rectangle_t area, float start_angle, float arc_an
 {
   if (DATA(this)->chord_mode)
     {
+      ITK_PROBE(x_request, "XSetArcMode", 1L);
       XSetArcMode(DATA(this)->display, DATA(this)->context, ArcPieSlice);
       DATA(this)->chord_mode = false;
     }
+  ITK_PROBE(x_request, "XFillArc", 1L);
   XFillArc(DATA(this)->display,
 	   DATA(this)->drawable,
 	   DATA(this)->context,
-	   area.x, area.y, area.width, area.height,
+	   area.x + OX(this), area.y + OY(this), area.width, area.height,
 	   (int)(start_angle * 64 + 0.5), (int)(arc_angles * 64 + 0.5));
 }
 
@@ -164,13 +204,15 @@ static void fill_chord(__this__, rectangle_t area, float start_angle, float arc_
 {
   if (DATA(this)->chord_mode == false)
     {
+      ITK_PROBE(x_request, "XSetArcMode", 1L);
       XSetArcMode(DATA(this)->display, DATA(this)->context, ArcChord);
       DATA(this)->chord_mode = true;
     }
+  ITK_PROBE(x_request, "XFillArc", 1L);
   XFillArc(DATA(this)->display,
 	   DATA(this)->drawable,
 	   DATA(this)->context,
-	   area.x, area.y, area.width, area.height,
+	   area.x + OX(this), area.y + OY(this), area.width, area.height,
 	   (int)(start_angle * 64 + 0.5), (int)(arc_angles * 64 + 0.5));
 }
 
@@ -191,10 +233,11 @@ static void draw_polyline(__this__, position2_t* points, long point_count, int8_
   
       for (i = 0; i < point_count; i++)
 	{
-	  (x_points + i)->x = (points + i)->x;
-	  (x_points + i)->y = (points + i)->y;
+	  (x_points + i)->x = (points + i)->x + ((i == 0) || (mode != ITK_GRAPHICS_MODE_RELATIVE) ? OX(this) : 0);
+	  (x_points + i)->y = (points + i)->y + ((i == 0) || (mode != ITK_GRAPHICS_MODE_RELATIVE) ? OY(this) : 0);
 	}
       
+      ITK_PROBE(x_request, "XDrawLines", point_count);
       XDrawLines(DATA(this)->display,
                  DATA(this)->drawable,
                  DATA(this)->context,
@@ -202,10 +245,13 @@ static void draw_polyline(__this__, position2_t* points, long point_count, int8_
 		 mode == ITK_GRAPHICS_MODE_RELATIVE ? CoordModePrevious : CoordModeOrigin);
     }
   else if (point_count == 1)
-    XDrawPoint(DATA(this)->display,
-	       DATA(this)->drawable,
-	       DATA(this)->context,
-	       points->x, points->y);
+    {
+      ITK_PROBE(x_request, "XDrawPoint", 1L);
+      XDrawPoint(DATA(this)->display,
+		 DATA(this)->drawable,
+		 DATA(this)->context,
+		 points->x + OX(this), points->y + OY(this));
+    }
 }
 
 
@@ -223,12 +269,13 @@ static void draw_lines(__this__, position2_t* starts, position2_t* ends, long li
   
   for (i = 0; i < lines; i++)
     {
-      (x_segments + i)->x1 = (starts + i)->x;
-      (x_segments + i)->y1 = (starts + i)->y;
-      (x_segments + i)->x2 = (ends + i)->x;
-      (x_segments + i)->y2 = (ends + i)->y;
+      (x_segments + i)->x1 = (starts + i)->x + OX(this);
+      (x_segments + i)->y1 = (starts + i)->y + OY(this);
+      (x_segments + i)->x2 = (ends + i)->x + OX(this);
+      (x_segments + i)->y2 = (ends + i)->y + OY(this);
     }
   
+  ITK_PROBE(x_request, "XDrawSegments", lines);
   XDrawSegments(DATA(this)->display,
 		DATA(this)->drawable,
 		DATA(this)->context,
@@ -249,17 +296,29 @@ static void draw_lines(__this__, position2_t* starts, position2_t* ends, long li
  */
 static void draw_arc(__this__, rectangle_t area, float start_angle, float arc_angles)
 {
+  ITK_PROBE(x_request, "XDrawArc", 1L);
   XDrawArc(DATA(this)->display,
 	   DATA(this)->drawable,
 	   DATA(this)->context,
-	   area.x, area.y, area.width, area.height,
+	   area.x + OX(this), area.y + OY(this), area.width, area.height,
 	   (int)(start_angle * 64 + 0.5), (int)(arc_angles * 64 + 0.5));
 }
 
 
+/**
+ * Draw a string, with the font of the X graphics context
+ * 
+ * @param  point  The position of the left end of the baseline
+ * @param  text   The text, NUL-terminated
+ */
 static void draw_string(__this__, position2_t point, char* text)
 {
-  /* TODO x_graphics.draw_string */
+  ITK_PROBE(x_request, "XDrawString", 1L);
+  XDrawString(DATA(this)->display,
+	      DATA(this)->drawable,
+	      DATA(this)->context,
+	      point.x + OX(this), point.y + OY(this),
+	      text, (int)strlen(text));
 }
 
 
@@ -269,7 +328,15 @@ static void draw_string(__this__, position2_t point, char* text)
 static void free_xgc(__this__)
 {
   if (this->data)
-    free(this->data);
+    {
+      if (DATA(this)->owns_context)
+	{
+	  ITK_PROBE(x_request, "XFreeGC", 1L);
+	  XFreeGC(DATA(this)->display, DATA(this)->context);
+	}
+      itk_free_region(DATA(this)->clip_region);
+      free(this->data);
+    }
   free(this);
 }
 
@@ -286,8 +353,14 @@ static itk_graphics* fork_xgc(__this__)
       GC context;
       rc->data = malloc(sizeof(itk_x_graphics_data));
       *(DATA(rc)) = *(DATA(this));
-      XCopyGC(DATA(rc)->display, DATA(this)->context, ~0, context);
+      DATA(rc)->clip_region = itk_new_region();
+      itk_region_copy(DATA(rc)->clip_region, DATA(this)->clip_region);
+      ITK_PROBE(x_request, "XCreateGC", 1L);
+      context = XCreateGC(DATA(rc)->display, DATA(rc)->drawable, 0, NULL);
+      ITK_PROBE(x_request, "XCopyGC", 1L);
+      XCopyGC(DATA(rc)->display, DATA(this)->context, ~0UL, context);
       DATA(rc)->context = context;
+      DATA(rc)->owns_context = true;
     }
   return rc;
 }
@@ -303,10 +376,11 @@ static itk_graphics* fork_xgc(__this__)
  */
 void fill_rectangle(__this__, rectangle_t area)
 {
+  ITK_PROBE(x_request, "XFillRectangle", 1L);
   XFillRectangle(DATA(this)->display,
 		 DATA(this)->drawable,
 		 DATA(this)->context,
-		 area.x, area.y,
+		 area.x + OX(this), area.y + OY(this),
 		 area.width, area.height);
 }
 
@@ -318,10 +392,11 @@ void fill_rectangle(__this__, rectangle_t area)
  */
 void draw_rectangle(__this__, rectangle_t area)
 {
+  ITK_PROBE(x_request, "XDrawRectangle", 1L);
   XDrawRectangle(DATA(this)->display,
 		 DATA(this)->drawable,
 		 DATA(this)->context,
-		 area.x, area.y,
+		 area.x + OX(this), area.y + OY(this),
 		 area.width, area.height);
 }
 
@@ -334,11 +409,12 @@ void draw_rectangle(__this__, rectangle_t area)
  */
 void draw_line(__this__, position2_t start, position2_t end)
 {
+  ITK_PROBE(x_request, "XDrawLine", 1L);
   XDrawLine(DATA(this)->display,
 	    DATA(this)->drawable,
 	    DATA(this)->context,
-	    start.x, start.y,
-	    end.x, end.y);
+	    start.x + OX(this), start.y + OY(this),
+	    end.x + OX(this), end.y + OY(this));
 }
 
 
@@ -349,10 +425,11 @@ void draw_line(__this__, position2_t start, position2_t end)
  */
 void draw_point(__this__, position2_t point)
 {
+  ITK_PROBE(x_request, "XDrawPoint", 1L);
   XDrawPoint(DATA(this)->display,
 	     DATA(this)->drawable,
 	     DATA(this)->context,
-	     point.x, point.y);
+	     point.x + OX(this), point.y + OY(this));
 }
 
 
@@ -373,6 +450,7 @@ itk_graphics* itk_new_x_graphics(Display* display, int screen, Drawable drawable
   
 #define __(FUNC)  rc->FUNC = FUNC
   __(clip);
+  __(clip_region);
   __(translate);
   __(set_colour);
   __(set_background_colour);
@@ -397,9 +475,11 @@ itk_graphics* itk_new_x_graphics(Display* display, int screen, Drawable drawable
   data->display = display;
   data->drawable = drawable;
   data->context = DefaultGC(display, screen);
-  data->clip_area.x = data->clip_area.y = 0;
-  data->clip_area.width = data->clip_area.height = (1 << 16) - 1;
+  data->clip_region = itk_new_region();
+  itk_region_set_rectangle(data->clip_region, new_packed_rectangle(0, 0, (1 << 16) - 1, (1 << 16) - 1));
+  data->origin = new_packed_position2(0, 0);
   data->chord_mode = false;
+  data->owns_context = false;
   
   itk_graphics_derive_methods(rc);
   return rc;
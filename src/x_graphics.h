@@ -20,6 +20,7 @@
 #define __ITK_X_GRAPHICS_H__
 
 #include "graphics.h"
+#include "region.h"
 
 #include <X11/Xlib.h>
 
@@ -45,15 +46,25 @@ typedef struct _itk_x_graphics_data
   GC context;
   
   /**
-   * The current clip area
+   * The current clip area, in the drawable's coordinates
    */
-  rectangle_t clip_area;
+  itk_region* clip_region;
+  
+  /**
+   * The position of the origin in the drawable
+   */
+  packed_position2_t origin;
   
   /**
    * Whether the current arc mode is arc chord
    */
   bool_t chord_mode;
   
+  /**
+   * Whether `context` was created for this graphics context, and shall be freed with it
+   */
+  bool_t owns_context;
+  
 } itk_x_graphics_data;
 
 
@@ -0,0 +1,155 @@
+/**
+ * itk — The Impressive Toolkit
+ * 
+ * Copyright © 2013  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "../src/metrics.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/**
+ * Print usage information and exit
+ * 
+ * @param  argv0  The name of the program
+ */
+static void usage(const char* argv0)
+{
+  fprintf(stderr,
+	  "Usage: %s [-f seconds] [-c count] (pid | /name)\n"
+	  "\n"
+	  "Prints the metrics a process has published with itk_metrics_publish,\n"
+	  "a process ID refers to the default name, /itk-<pid>.  With -f the\n"
+	  "metrics are printed every interval, with rates since the previous\n"
+	  "print, until count prints have been made or the process is gone.\n",
+	  argv0);
+  exit(2);
+}
+
+
+/**
+ * Print the metrics
+ * 
+ * @param  page      The metrics
+ * @param  previous  The counters when they were last printed, updated
+ * @param  seconds   The time since the counters were last printed, 0 if never
+ */
+static void print_metrics(const itk_metrics_page* page, int64_t* previous, double seconds)
+{
+  const itk_metrics_histogram* h;
+  uint64_t count, sum;
+  int64_t value, frames = 0;
+  long i, n;
+  
+  printf("pid %li\n", (long)(page->pid));
+  
+  n = (long)atomic_load_explicit(&(page->counter_count), memory_order_relaxed);
+  n = n < ITK_METRICS_MAX_COUNTERS ? n : ITK_METRICS_MAX_COUNTERS;
+  for (i = 0; i < n; i++)
+    {
+      value = atomic_load_explicit(&(page->counters[i].value), memory_order_relaxed);
+      if (seconds > 0)
+	printf("  %-*s %16lli %14.1f/s\n", ITK_METRICS_NAME_SIZE, page->counters[i].name,
+	       (long long)value, (double)(value - *(previous + i)) / seconds);
+      else
+	printf("  %-*s %16lli\n", ITK_METRICS_NAME_SIZE, page->counters[i].name, (long long)value);
+      if (i == ITK_METRIC_FRAMES)
+	frames = value - *(previous + i);
+      if ((i == ITK_METRIC_COMPONENTS_PAINTED) && (seconds > 0) && (frames > 0))
+	printf("  %-*s %16.1f\n", ITK_METRICS_NAME_SIZE, "components_painted/frame",
+	       (double)(value - *(previous + i)) / (double)frames);
+      *(previous + i) = value;
+    }
+  
+  n = (long)atomic_load_explicit(&(page->histogram_count), memory_order_relaxed);
+  n = n < ITK_METRICS_MAX_HISTOGRAMS ? n : ITK_METRICS_MAX_HISTOGRAMS;
+  for (i = 0; i < n; i++)
+    {
+      h = page->histograms + i;
+      count = atomic_load_explicit(&(h->count), memory_order_relaxed);
+      sum = atomic_load_explicit(&(h->sum), memory_order_relaxed);
+      printf("  %-*s n=%-10llu mean=%-12.0f p50=%-12.0f p90=%-12.0f p99=%-12.0f\n",
+	     ITK_METRICS_NAME_SIZE, h->name, (unsigned long long)count,
+	     count ? (double)sum / (double)count : 0.,
+	     itk_metrics_percentile(h, 50), itk_metrics_percentile(h, 90), itk_metrics_percentile(h, 99));
+    }
+  
+  fflush(stdout);
+}
+
+
+/**
+ * Print the metrics of a process
+ * 
+ * @param   argc  The number of command line arguments
+ * @param   argv  The command line arguments
+ * @return        Zero on success
+ */
+int main(int argc, char** argv)
+{
+  int64_t previous[ITK_METRICS_MAX_COUNTERS] = { 0 };
+  const itk_metrics_page* page;
+  double interval = 0, seconds = 0;
+  long count = -1;
+  char name[256];
+  char* end;
+  int opt;
+  
+  while ((opt = getopt(argc, argv, "f:c:")) != -1)
+    switch (opt)
+      {
+      case 'f':  interval = atof(optarg);  break;
+      case 'c':  count = atol(optarg);     break;
+      default:
+	usage(*argv);
+      }
+  if ((optind + 1 != argc) || (interval < 0))
+    usage(*argv);
+  
+  strtol(argv[optind], &end, 10);
+  if (*end == '\0')
+    snprintf(name, sizeof(name), "/itk-%s", argv[optind]);
+  else
+    snprintf(name, sizeof(name), "%s", argv[optind]);
+  
+  page = itk_metrics_open(name);
+  if (page == NULL)
+    {
+      fprintf(stderr, "%s: %s: %s\n", *argv, name, strerror(errno));
+      return 1;
+    }
+  
+  for (;;)
+    {
+      print_metrics(page, previous, seconds);
+      if ((interval == 0) || (count > 0 && --count == 0))
+	break;
+      if ((page->pid > 0) && kill(page->pid, 0) && (errno == ESRCH))
+	break;
+      usleep((useconds_t)(interval * 1000000));
+      seconds = interval;
+      printf("\n");
+    }
+  
+  itk_metrics_close(page);
+  return 0;
+}
+